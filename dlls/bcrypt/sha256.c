@@ -22,6 +22,13 @@
 
 #include "bcrypt_internal.h"
 
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define USE_SHANI
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 static DWORD ror(DWORD n, int k) { return (n >> k) | (n << (32-k)); }
 #define Ch(x,y,z)  (z ^ (x & (y ^ z)))
 #define Maj(x,y,z) ((x & y) | (z & (x | y)))
@@ -91,6 +98,92 @@ static void processblock(SHA256_CTX *ctx, const UCHAR *buffer)
     ctx->h[7] += h;
 }
 
+#ifdef USE_SHANI
+
+static int have_shani(void)
+{
+    static int shani = -1;
+    unsigned int eax, ebx, ecx, edx;
+
+    if (shani == -1)
+    {
+        shani = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3) && (ecx & bit_SSE4_1) &&
+                __get_cpuid_max(0, NULL) >= 7;
+        if (shani)
+        {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            shani = !!(ebx & (1 << 29));
+        }
+    }
+    return shani;
+}
+
+/* Each iteration handles four rounds; the message schedule for the next
+ * groups is computed on the fly, as in the reference SHA extensions code. */
+static void __attribute__((target("sha,sse4.1"))) processblocks_shani(SHA256_CTX *ctx, const UCHAR *buffer,
+                                                                      ULONG count)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, abef, cdgh, msg, tmp, w[4];
+    int i;
+
+    tmp = _mm_loadu_si128((const __m128i *)&ctx->h[0]);
+    state1 = _mm_loadu_si128((const __m128i *)&ctx->h[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);
+    state1 = _mm_shuffle_epi32(state1, 0x1b);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (; count; count--, buffer += 64)
+    {
+        abef = state0;
+        cdgh = state1;
+
+        for (i = 0; i < 16; i++)
+        {
+            if (i < 4) w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + 16 * i)), mask);
+
+            msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i *)&K[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (i >= 3 && i < 15)
+            {
+                tmp = _mm_alignr_epi8(w[i & 3], w[(i - 1) & 3], 4);
+                w[(i + 1) & 3] = _mm_add_epi32(w[(i + 1) & 3], tmp);
+                w[(i + 1) & 3] = _mm_sha256msg2_epu32(w[(i + 1) & 3], w[i & 3]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (i >= 1 && i < 13)
+                w[(i - 1) & 3] = _mm_sha256msg1_epu32(w[(i - 1) & 3], w[i & 3]);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *)&ctx->h[0], state0);
+    _mm_storeu_si128((__m128i *)&ctx->h[4], state1);
+}
+
+#endif  /* USE_SHANI */
+
+static void processblocks(SHA256_CTX *ctx, const UCHAR *buffer, ULONG count)
+{
+#ifdef USE_SHANI
+    if (have_shani())
+    {
+        processblocks_shani(ctx, buffer, count);
+        return;
+    }
+#endif
+    for (; count; count--, buffer += 64)
+        processblock(ctx, buffer);
+}
+
 static void pad(SHA256_CTX *ctx)
 {
     ULONG64 r = ctx->len % 64;
@@ -101,7 +194,7 @@ static void pad(SHA256_CTX *ctx)
     {
         memset(ctx->buf + r, 0, 64 - r);
         r = 0;
-        processblock(ctx, ctx->buf);
+        processblocks(ctx, ctx->buf, 1);
     }
 
     memset(ctx->buf + r, 0, 56 - r);
@@ -115,7 +208,7 @@ static void pad(SHA256_CTX *ctx)
     ctx->buf[62] = ctx->len >> 8;
     ctx->buf[63] = ctx->len;
 
-    processblock(ctx, ctx->buf);
+    processblocks(ctx, ctx->buf, 1);
 }
 
 void sha256_init(SHA256_CTX *ctx)
@@ -147,10 +240,11 @@ void sha256_update(SHA256_CTX *ctx, const UCHAR *buffer, ULONG len)
         memcpy(ctx->buf + r, p, 64 - r);
         len -= 64 - r;
         p += 64 - r;
-        processblock(ctx, ctx->buf);
+        processblocks(ctx, ctx->buf, 1);
     }
-    for (; len >= 64; len -= 64, p += 64)
-        processblock(ctx, p);
+    processblocks(ctx, p, len / 64);
+    p += len & ~63;
+    len &= 63;
     memcpy(ctx->buf, p, len);
 }
 
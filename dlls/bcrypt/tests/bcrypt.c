@@ -312,12 +312,14 @@ static void test_sha256(void)
         "ceb73749c899693706ede1e30c9929b3fd5dd926163831c2fb8bd41e6efb1126";
     static const char expected_hmac[] =
         "34c1aa473a4468a91d06e7cdbc75bc4f93b830ccfc2a47ffd74e8e6ed29e4c72";
+    static const char expected_long[] =
+        "89f4ff56a25dd1db06a4ce6033603775d705fb96f30f8693733fef602a1ca532";
     BCRYPT_ALG_HANDLE alg;
     BCRYPT_HASH_HANDLE hash;
-    UCHAR buf[512], buf_hmac[1024], sha256[32], sha256_hmac[32];
+    UCHAR buf[512], buf_hmac[1024], sha256[32], sha256_hmac[32], data[1000];
     char str[65];
     NTSTATUS ret;
-    ULONG len;
+    ULONG len, i;
 
     alg = NULL;
     ret = pBCryptOpenAlgorithmProvider(&alg, BCRYPT_SHA256_ALGORITHM, MS_PRIMITIVE_PROVIDER, 0);
@@ -352,6 +354,23 @@ static void test_sha256(void)
     ret = pBCryptDestroyHash(hash);
     ok(ret == STATUS_SUCCESS, "got %08x\n", ret);
 
+    /* multiple blocks, not starting on a block boundary */
+    for (i = 0; i < sizeof(data); i++) data[i] = i * 7;
+    hash = NULL;
+    ret = pBCryptCreateHash(alg, &hash, buf, sizeof(buf), NULL, 0, 0);
+    ok(ret == STATUS_SUCCESS, "got %08x\n", ret);
+    ret = pBCryptHashData(hash, data, 1, 0);
+    ok(ret == STATUS_SUCCESS, "got %08x\n", ret);
+    ret = pBCryptHashData(hash, data + 1, sizeof(data) - 1, 0);
+    ok(ret == STATUS_SUCCESS, "got %08x\n", ret);
+    memset(sha256, 0, sizeof(sha256));
+    ret = pBCryptFinishHash(hash, sha256, sizeof(sha256), 0);
+    ok(ret == STATUS_SUCCESS, "got %08x\n", ret);
+    format_hash( sha256, sizeof(sha256), str );
+    ok(!strcmp(str, expected_long), "got %s\n", str);
+    ret = pBCryptDestroyHash(hash);
+    ok(ret == STATUS_SUCCESS, "got %08x\n", ret);
+
     ret = pBCryptCloseAlgorithmProvider(alg, 0);
     ok(ret == STATUS_SUCCESS, "got %08x\n", ret);
 
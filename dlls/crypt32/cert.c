@@ -226,6 +226,7 @@ static BOOL add_cert_to_store(WINECRYPT_CERTSTORE *store, const CERT_CONTEXT *ce
         if (existing)
         {
             Context_CopyProperties(existing, cert);
+            CRYPT_InvalidateCertIndexes();
             if (ret_context)
                 *ret_context = CertDuplicateCertificateContext(existing);
             return TRUE;
@@ -266,7 +267,10 @@ static BOOL add_cert_to_store(WINECRYPT_CERTSTORE *store, const CERT_CONTEXT *ce
         return FALSE;
 
     if(inherit_props)
+    {
         Context_CopyProperties(context_ptr(new_context), existing);
+        CRYPT_InvalidateCertIndexes();
+    }
 
     if(ret_context)
         *ret_context = context_ptr(new_context);
@@ -807,6 +811,16 @@ BOOL WINAPI CertSetCertificateContextProperty(PCCERT_CONTEXT pCertContext,
     }
     ret = CertContext_SetProperty(cert_from_ptr(pCertContext), dwPropId, dwFlags,
      pvData);
+    if (ret && (dwPropId == CERT_HASH_PROP_ID || dwPropId == CERT_KEY_IDENTIFIER_PROP_ID))
+    {
+        const context_t *context = &cert_from_ptr(pCertContext)->base;
+
+        /* Stores index certificates by these, unless nothing can refer to
+         * the context yet.
+         */
+        if (context->store != &empty_store || context->linked || context->ref > 1)
+            CRYPT_InvalidateCertIndexes();
+    }
     TRACE("returning %d\n", ret);
     return ret;
 }
@@ -1335,9 +1349,6 @@ DWORD WINAPI CertGetPublicKeyLength(DWORD dwCertEncodingType,
     return len;
 }
 
-typedef BOOL (*CertCompareFunc)(PCCERT_CONTEXT pCertContext, DWORD dwType,
- DWORD dwFlags, const void *pvPara);
-
 static BOOL compare_cert_by_md5_hash(PCCERT_CONTEXT pCertContext, DWORD dwType,
  DWORD dwFlags, const void *pvPara)
 {
@@ -1517,12 +1528,70 @@ static BOOL compare_cert_by_signature_hash(PCCERT_CONTEXT pCertContext, DWORD dw
     return ret;
 }
 
+/* Returns the index stores can use to find the certificates matching compare
+ * and pvPara, if any.  This has to match what the compare functions check.
+ */
+static BOOL cert_get_find_index(CertCompareFunc compare, DWORD dwType,
+ const void *pvPara, CERT_FIND_PARA *para)
+{
+    if (compare == compare_cert_by_sha1_hash)
+    {
+        para->index = CertIndexSHA1Hash;
+        para->key = pvPara;
+    }
+    else if (compare == compare_cert_by_name)
+    {
+        para->index = (dwType & CERT_INFO_SUBJECT_FLAG) ? CertIndexSubject : CertIndexIssuer;
+        para->key = pvPara;
+    }
+    else if (compare == compare_cert_by_cert_id)
+    {
+        const CERT_ID *id = pvPara;
+
+        switch (id->dwIdChoice)
+        {
+        case CERT_ID_ISSUER_SERIAL_NUMBER:
+            para->index = CertIndexIssuer;
+            para->key = &id->u.IssuerSerialNumber.Issuer;
+            break;
+        case CERT_ID_SHA1_HASH:
+            para->index = CertIndexSHA1Hash;
+            para->key = &id->u.HashId;
+            break;
+        case CERT_ID_KEY_IDENTIFIER:
+            para->index = CertIndexKeyId;
+            para->key = &id->u.KeyId;
+            break;
+        default:
+            return FALSE;
+        }
+    }
+    else
+        return FALSE;
+    return TRUE;
+}
+
 static inline PCCERT_CONTEXT cert_compare_certs_in_store(HCERTSTORE store,
  PCCERT_CONTEXT prev, CertCompareFunc compare, DWORD dwType, DWORD dwFlags,
  const void *pvPara)
 {
+    WINECRYPT_CERTSTORE *hcs = store;
     BOOL matches = FALSE;
     PCCERT_CONTEXT ret;
+    CERT_FIND_PARA para;
+
+    if (hcs && hcs->dwMagic == WINE_CRYPTCERTSTORE_MAGIC &&
+     cert_get_find_index(compare, dwType, pvPara, &para))
+    {
+        context_t *found;
+
+        para.compare = compare;
+        para.type = dwType;
+        para.flags = dwFlags;
+        para.para = pvPara;
+        found = CRYPT_StoreFindCert(hcs, &para, prev ? &cert_from_ptr(prev)->base : NULL);
+        return found ? context_ptr(found) : NULL;
+    }
 
     ret = prev;
     do {
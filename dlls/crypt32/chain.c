@@ -25,6 +25,7 @@
 #include "wincrypt.h"
 #include "wininet.h"
 #include "wine/debug.h"
+#include "wine/rbtree.h"
 #include "wine/unicode.h"
 #include "crypt32_private.h"
 
@@ -32,6 +33,11 @@ WINE_DEFAULT_DEBUG_CHANNEL(crypt);
 WINE_DECLARE_DEBUG_CHANNEL(chain);
 
 #define DEFAULT_CYCLE_MODULUS 7
+#define DEFAULT_CHAIN_CACHE_SIZE 256
+/* How long, in seconds, chains whose revocation status was checked are
+ * cached.
+ */
+#define CHAIN_CACHE_REVOCATION_TIMEOUT (5 * 60)
 
 /* This represents a subset of a certificate chain engine:  it doesn't include
  * the "hOther" store described by MSDN, because I'm not sure how that's used.
@@ -47,8 +53,61 @@ typedef struct _CertificateChainEngine
     DWORD      dwUrlRetrievalTimeout;
     DWORD      MaximumCachedCertificates;
     DWORD      CycleDetectionModulus;
+    CRITICAL_SECTION    cs;
+    struct wine_rb_tree chain_cache; /* struct chain_cache_entry */
+    struct list         chain_lru;
+    DWORD               chain_count;
+    LONG                chain_generation;
 } CertificateChainEngine;
 
+/* Successfully validated chains are cached per engine, keyed by the end
+ * certificate's hash and the chain building flags.  Entries expire when any
+ * certificate in the chain does, when its revocation status is due to be
+ * checked again, and when the engine's stores change.
+ */
+struct chain_cache_key
+{
+    BYTE  hash[20];
+    DWORD flags;
+};
+
+struct chain_cache_entry
+{
+    struct wine_rb_entry   entry;
+    struct list            lru;
+    struct chain_cache_key key;
+    ULONGLONG              expires;
+    PCCERT_CHAIN_CONTEXT   chain;
+};
+
+static int chain_cache_compare(const void *key, const struct wine_rb_entry *entry)
+{
+    const struct chain_cache_key *k = key;
+    const struct chain_cache_entry *e = WINE_RB_ENTRY_VALUE(entry, const struct chain_cache_entry, entry);
+    int ret = memcmp(k->hash, e->key.hash, sizeof(k->hash));
+
+    if (!ret && k->flags != e->key.flags)
+        ret = k->flags < e->key.flags ? -1 : 1;
+    return ret;
+}
+
+static void chain_cache_remove(CertificateChainEngine *engine, struct chain_cache_entry *entry)
+{
+    wine_rb_remove(&engine->chain_cache, &entry->entry);
+    list_remove(&entry->lru);
+    CertFreeCertificateChain(entry->chain);
+    CryptMemFree(entry);
+    engine->chain_count--;
+}
+
+static void chain_cache_clear(CertificateChainEngine *engine)
+{
+    struct chain_cache_entry *entry, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE(entry, next, &engine->chain_lru, struct chain_cache_entry, lru)
+        chain_cache_remove(engine, entry);
+}
+
 static inline void CRYPT_AddStoresToCollection(HCERTSTORE collection,
  DWORD cStores, HCERTSTORE *stores)
 {
@@ -140,6 +199,12 @@ HCERTCHAINENGINE CRYPT_CreateChainEngine(HCERTSTORE root, DWORD system_store, co
 
     engine->ref = 1;
     engine->hRoot = root;
+    InitializeCriticalSection(&engine->cs);
+    engine->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": CertificateChainEngine.cs");
+    wine_rb_init(&engine->chain_cache, chain_cache_compare);
+    list_init(&engine->chain_lru);
+    engine->chain_count = 0;
+    engine->chain_generation = 0;
     engine->hWorld = CertOpenStore(CERT_STORE_PROV_COLLECTION, 0, 0, CERT_STORE_CREATE_NEW_FLAG, NULL);
     worldStores[0] = CertDuplicateStore(engine->hRoot);
     worldStores[1] = CertOpenStore(CERT_STORE_PROV_SYSTEM_W, 0, 0, system_store, caW);
@@ -203,6 +268,9 @@ static void free_chain_engine(CertificateChainEngine *engine)
     if(!engine || InterlockedDecrement(&engine->ref))
         return;
 
+    chain_cache_clear(engine);
+    engine->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&engine->cs);
     CertCloseStore(engine->hWorld, 0);
     CertCloseStore(engine->hRoot, 0);
     CryptMemFree(engine);
@@ -2891,14 +2959,193 @@ static void dump_chain_para(const CERT_CHAIN_PARA *pChainPara)
     }
 }
 
+/* Returns whether a chain built with these parameters may be cached, and if
+ * so the cache key for it.
+ */
+static BOOL chain_cache_get_key(PCCERT_CONTEXT cert, const FILETIME *time,
+ HCERTSTORE additional_store, const CERT_CHAIN_PARA *para, DWORD flags,
+ struct chain_cache_key *key)
+{
+    DWORD size = sizeof(key->hash);
+
+    if (time || additional_store || (flags & CERT_CHAIN_RETURN_LOWER_QUALITY_CONTEXTS))
+        return FALSE;
+    if (para->cbSize >= sizeof(CERT_CHAIN_PARA_NO_EXTRA_FIELDS) &&
+     para->RequestedUsage.Usage.cUsageIdentifier)
+        return FALSE;
+    if (para->cbSize >= sizeof(CERT_CHAIN_PARA) &&
+     (para->RequestedIssuancePolicy.Usage.cUsageIdentifier ||
+     para->fCheckRevocationFreshnessTime))
+        return FALSE;
+
+    memset(key, 0, sizeof(*key));
+    key->flags = flags;
+    return CertGetCertificateContextProperty(cert, CERT_HASH_PROP_ID, key->hash, &size);
+}
+
+static ULONGLONG get_current_time(void)
+{
+    FILETIME now;
+
+    GetSystemTimeAsFileTime(&now);
+    return ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+}
+
+/* Flushes the cache if any of the engine's stores changed.  Assumes the
+ * engine's lock is held.
+ */
+static void chain_cache_validate(CertificateChainEngine *engine)
+{
+    LONG generation = CRYPT_StoreGeneration(engine->hWorld);
+
+    if (generation != engine->chain_generation)
+    {
+        if (engine->chain_count)
+            TRACE("stores changed, flushing %u chains\n", engine->chain_count);
+        chain_cache_clear(engine);
+        engine->chain_generation = generation;
+    }
+}
+
+/* Makes a copy of a cached chain for another request for the same end
+ * certificate.  The caller's context is used as the end certificate, since it
+ * may come from another store and have different properties.
+ */
+static CertificateChain *chain_cache_copy(const CertificateChain *chain,
+ PCCERT_CONTEXT cert)
+{
+    CertificateChain *copy = CryptMemAlloc(sizeof(CertificateChain));
+    PCERT_CHAIN_ELEMENT end;
+    DWORD i, j;
+
+    if (!copy)
+        return NULL;
+    copy->ref = 1;
+    copy->world = CertDuplicateStore(chain->world);
+    copy->context = chain->context;
+    copy->context.cChain = 0;
+    copy->context.rgpChain = CryptMemAlloc(
+     chain->context.cChain * sizeof(PCERT_SIMPLE_CHAIN));
+    if (!copy->context.rgpChain)
+    {
+        CertCloseStore(copy->world, 0);
+        CryptMemFree(copy);
+        return NULL;
+    }
+    for (i = 0; i < chain->context.cChain; i++)
+    {
+        const CERT_SIMPLE_CHAIN *simple = chain->context.rgpChain[i];
+        PCERT_SIMPLE_CHAIN simple_copy =
+         CRYPT_CopySimpleChainToElement(simple, simple->cElement - 1);
+
+        if (!simple_copy)
+        {
+            CRYPT_FreeChainContext(copy);
+            return NULL;
+        }
+        /* unlike when building alternate chains, the trust status is kept */
+        simple_copy->TrustStatus = simple->TrustStatus;
+        simple_copy->pTrustListInfo = simple->pTrustListInfo;
+        simple_copy->fHasRevocationFreshnessTime =
+         simple->fHasRevocationFreshnessTime;
+        simple_copy->dwRevocationFreshnessTime =
+         simple->dwRevocationFreshnessTime;
+        for (j = 0; j < simple->cElement; j++)
+            simple_copy->rgpElement[j]->TrustStatus =
+             simple->rgpElement[j]->TrustStatus;
+        copy->context.rgpChain[copy->context.cChain++] = simple_copy;
+    }
+    end = copy->context.rgpChain[0]->rgpElement[0];
+    CertFreeCertificateContext(end->pCertContext);
+    end->pCertContext = CertDuplicateCertificateContext(cert);
+    return copy;
+}
+
+static PCCERT_CHAIN_CONTEXT chain_cache_get(CertificateChainEngine *engine,
+ const struct chain_cache_key *key, PCCERT_CONTEXT cert)
+{
+    PCCERT_CHAIN_CONTEXT chain = NULL;
+    struct wine_rb_entry *entry;
+
+    EnterCriticalSection(&engine->cs);
+    chain_cache_validate(engine);
+    if ((entry = wine_rb_get(&engine->chain_cache, key)))
+    {
+        struct chain_cache_entry *cached = WINE_RB_ENTRY_VALUE(entry, struct chain_cache_entry, entry);
+
+        if (cached->expires > get_current_time())
+        {
+            list_remove(&cached->lru);
+            list_add_head(&engine->chain_lru, &cached->lru);
+            chain = (PCCERT_CHAIN_CONTEXT)chain_cache_copy(
+             (const CertificateChain *)cached->chain, cert);
+        }
+        else
+            chain_cache_remove(engine, cached);
+    }
+    LeaveCriticalSection(&engine->cs);
+    return chain;
+}
+
+static void chain_cache_put(CertificateChainEngine *engine,
+ const struct chain_cache_key *key, PCCERT_CHAIN_CONTEXT chain)
+{
+    DWORD max_count = engine->MaximumCachedCertificates ?
+     engine->MaximumCachedCertificates : DEFAULT_CHAIN_CACHE_SIZE;
+    struct chain_cache_entry *entry;
+    struct wine_rb_entry *existing;
+    ULONGLONG expires = ~(ULONGLONG)0;
+    DWORD i, j;
+
+    for (i = 0; i < chain->cChain; i++)
+    {
+        for (j = 0; j < chain->rgpChain[i]->cElement; j++)
+        {
+            const FILETIME *not_after =
+             &chain->rgpChain[i]->rgpElement[j]->pCertContext->pCertInfo->NotAfter;
+            ULONGLONG time = ((ULONGLONG)not_after->dwHighDateTime << 32) | not_after->dwLowDateTime;
+
+            if (time < expires)
+                expires = time;
+        }
+    }
+    if (key->flags & (CERT_CHAIN_REVOCATION_CHECK_END_CERT |
+     CERT_CHAIN_REVOCATION_CHECK_CHAIN |
+     CERT_CHAIN_REVOCATION_CHECK_CHAIN_EXCLUDE_ROOT))
+    {
+        ULONGLONG time = get_current_time() + (ULONGLONG)CHAIN_CACHE_REVOCATION_TIMEOUT * 10000000;
+
+        if (time < expires)
+            expires = time;
+    }
+
+    if (!(entry = CryptMemAlloc(sizeof(*entry))))
+        return;
+    entry->key = *key;
+    entry->expires = expires;
+    entry->chain = CertDuplicateCertificateChain(chain);
+
+    EnterCriticalSection(&engine->cs);
+    chain_cache_validate(engine);
+    if ((existing = wine_rb_get(&engine->chain_cache, key)))
+        chain_cache_remove(engine, WINE_RB_ENTRY_VALUE(existing, struct chain_cache_entry, entry));
+    while (engine->chain_count >= max_count)
+        chain_cache_remove(engine, LIST_ENTRY(list_tail(&engine->chain_lru), struct chain_cache_entry, lru));
+    wine_rb_put(&engine->chain_cache, key, &entry->entry);
+    list_add_head(&engine->chain_lru, &entry->lru);
+    engine->chain_count++;
+    LeaveCriticalSection(&engine->cs);
+}
+
 BOOL WINAPI CertGetCertificateChain(HCERTCHAINENGINE hChainEngine,
  PCCERT_CONTEXT pCertContext, LPFILETIME pTime, HCERTSTORE hAdditionalStore,
  PCERT_CHAIN_PARA pChainPara, DWORD dwFlags, LPVOID pvReserved,
  PCCERT_CHAIN_CONTEXT* ppChainContext)
 {
     CertificateChainEngine *engine;
-    BOOL ret;
+    BOOL ret, cacheable;
     CertificateChain *chain = NULL;
+    struct chain_cache_key key;
 
     TRACE("(%p, %p, %s, %p, %p, %08x, %p, %p)\n", hChainEngine, pCertContext,
      debugstr_filetime(pTime), hAdditionalStore, pChainPara, dwFlags,
@@ -2923,6 +3170,25 @@ BOOL WINAPI CertGetCertificateChain(HCERTCHAINENGINE hChainEngine,
 
     if (TRACE_ON(chain))
         dump_chain_para(pChainPara);
+
+    cacheable = chain_cache_get_key(pCertContext, pTime, hAdditionalStore,
+     pChainPara, dwFlags, &key);
+    if (cacheable)
+    {
+        PCCERT_CHAIN_CONTEXT cached = chain_cache_get(engine, &key,
+         pCertContext);
+
+        if (cached)
+        {
+            TRACE_(chain)("using cached chain %p\n", cached);
+            if (ppChainContext)
+                *ppChainContext = cached;
+            else
+                CertFreeCertificateChain(cached);
+            return TRUE;
+        }
+    }
+
     /* FIXME: what about HCCE_LOCAL_MACHINE? */
     ret = CRYPT_BuildCandidateChainFromCert(engine, pCertContext, pTime,
      hAdditionalStore, dwFlags, &chain);
@@ -2951,6 +3217,8 @@ BOOL WINAPI CertGetCertificateChain(HCERTCHAINENGINE hChainEngine,
         CRYPT_CheckUsages(pChain, pChainPara);
         TRACE_(chain)("error status: %08x\n",
          pChain->TrustStatus.dwErrorStatus);
+        if (cacheable && pChain->TrustStatus.dwErrorStatus == CERT_TRUST_NO_ERROR)
+            chain_cache_put(engine, &key, pChain);
         if (ppChainContext)
             *ppChainContext = pChain;
         else
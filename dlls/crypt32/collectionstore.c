@@ -37,6 +37,7 @@ typedef struct _WINE_COLLECTIONSTORE
     WINECRYPT_CERTSTORE hdr;
     CRITICAL_SECTION    cs;
     struct list         stores;
+    LONG                generation;
 } WINE_COLLECTIONSTORE;
 
 static void Collection_addref(WINECRYPT_CERTSTORE *store)
@@ -442,6 +443,66 @@ static BOOL Collection_control(WINECRYPT_CERTSTORE *cert_store, DWORD dwFlags,
     return ret;
 }
 
+static context_t *Collection_findCert(WINECRYPT_CERTSTORE *store,
+ const CERT_FIND_PARA *para, context_t *prev)
+{
+    WINE_COLLECTIONSTORE *cs = (WINE_COLLECTIONSTORE*)store;
+    WINE_STORE_LIST_ENTRY *storeEntry;
+    context_t *child = NULL, *ret = NULL;
+    struct list *entry;
+
+    TRACE("(%p, %d, %p)\n", store, para->index, prev);
+
+    EnterCriticalSection(&cs->cs);
+    if (prev)
+    {
+        storeEntry = prev->u.ptr;
+        child = prev->linked;
+        Context_AddRef(child);
+        Context_Release(prev);
+        entry = &storeEntry->entry;
+    }
+    else
+        entry = list_head(&cs->stores);
+
+    /* Look the certificate up in each store in turn, continuing from the
+     * store prev's child came from.
+     */
+    for (; entry; entry = list_next(&cs->stores, entry))
+    {
+        storeEntry = LIST_ENTRY(entry, WINE_STORE_LIST_ENTRY, entry);
+        if ((child = CRYPT_StoreFindCert(storeEntry->store, para, child)))
+        {
+            ret = CRYPT_CollectionCreateContextFromChild(cs, storeEntry, child);
+            Context_Release(child);
+            break;
+        }
+    }
+    LeaveCriticalSection(&cs->cs);
+
+    if (!ret)
+        SetLastError(CRYPT_E_NOT_FOUND);
+    TRACE("returning %p\n", ret);
+    return ret;
+}
+
+static LONG Collection_generation(WINECRYPT_CERTSTORE *store)
+{
+    WINE_COLLECTIONSTORE *cs = (WINE_COLLECTIONSTORE*)store;
+    WINE_STORE_LIST_ENTRY *entry;
+    LONG ret;
+
+    /* Generations only ever increase, so the sum changes whenever any of
+     * the stores changes.
+     */
+    EnterCriticalSection(&cs->cs);
+    ret = cs->generation;
+    LIST_FOR_EACH_ENTRY(entry, &cs->stores, WINE_STORE_LIST_ENTRY, entry)
+        ret += CRYPT_StoreGeneration(entry->store);
+    LeaveCriticalSection(&cs->cs);
+    return ret;
+}
+
 static const store_vtbl_t CollectionStoreVtbl = {
     Collection_addref,
     Collection_release,
@@ -459,7 +520,9 @@ static const store_vtbl_t CollectionStoreVtbl = {
         Collection_addCTL,
         Collection_enumCTL,
         Collection_deleteCTL
-    }
+    },
+    Collection_findCert,
+    Collection_generation
 };
 
 WINECRYPT_CERTSTORE *CRYPT_CollectionOpenStore(HCRYPTPROV hCryptProv,
@@ -546,6 +609,7 @@ BOOL WINAPI CertAddStoreToCollection(HCERTSTORE hCollectionStore,
         }
         else
             list_add_tail(&collection->stores, &entry->entry);
+        collection->generation++;
         LeaveCriticalSection(&collection->cs);
         ret = TRUE;
     }
@@ -585,6 +649,7 @@ void WINAPI CertRemoveStoreFromCollection(HCERTSTORE hCollectionStore,
             list_remove(&store->entry);
             CertCloseStore(store->store, 0);
             CryptMemFree(store);
+            collection->generation++;
             break;
         }
     }
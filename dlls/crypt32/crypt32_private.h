@@ -278,6 +278,32 @@ typedef struct _CONTEXT_FUNCS
     BOOL (*delete)(struct WINE_CRYPTCERTSTORE*,context_t*);
 } CONTEXT_FUNCS;
 
+/* Certificate lookups that stores may answer from an index rather than by
+ * enumerating every certificate.  key is what the index is searched for;
+ * compare, type, flags and para are those given to CertFindCertificateInStore,
+ * and are used to check candidate certificates.
+ */
+typedef enum _CertIndexType {
+    CertIndexSubject,
+    CertIndexIssuer,
+    CertIndexSHA1Hash,
+    CertIndexKeyId,
+    CertIndexCount
+} CertIndexType;
+
+typedef BOOL (*CertCompareFunc)(PCCERT_CONTEXT pCertContext, DWORD dwType,
+ DWORD dwFlags, const void *pvPara);
+
+typedef struct _CERT_FIND_PARA
+{
+    CertIndexType          index;
+    const CRYPT_DATA_BLOB *key;
+    CertCompareFunc        compare;
+    DWORD                  type;
+    DWORD                  flags;
+    const void            *para;
+} CERT_FIND_PARA;
+
 typedef enum _CertStoreType {
     StoreTypeMem,
     StoreTypeCollection,
@@ -293,6 +319,10 @@ typedef enum _CertStoreType {
  * - closeStore is called when the store's ref count becomes 0
  * - control is optional, but should be implemented by any store that supports
  *   persistence
+ * - findCert is optional.  It behaves like certs.enumContext, but only returns
+ *   certificates matching the find parameters.
+ * - generation is optional.  It returns a value that changes whenever
+ *   certificates or CRLs are added to or removed from the store.
  */
 
 typedef struct {
@@ -303,6 +333,8 @@ typedef struct {
     CONTEXT_FUNCS certs;
     CONTEXT_FUNCS crls;
     CONTEXT_FUNCS ctls;
+    context_t *(*findCert)(struct WINE_CRYPTCERTSTORE*,const CERT_FIND_PARA*,context_t*);
+    LONG (*generation)(struct WINE_CRYPTCERTSTORE*);
 } store_vtbl_t;
 
 typedef struct WINE_CRYPTCERTSTORE
@@ -318,6 +350,18 @@ typedef struct WINE_CRYPTCERTSTORE
 void CRYPT_InitStore(WINECRYPT_CERTSTORE *store, DWORD dwFlags,
  CertStoreType type, const store_vtbl_t*) DECLSPEC_HIDDEN;
 void CRYPT_FreeStore(WINECRYPT_CERTSTORE *store) DECLSPEC_HIDDEN;
+
+/* Returns the next certificate after prev matching para, releasing prev.
+ * Uses the store's index if it has one, and enumerates the store otherwise.
+ */
+context_t *CRYPT_StoreFindCert(WINECRYPT_CERTSTORE *store,
+ const CERT_FIND_PARA *para, context_t *prev) DECLSPEC_HIDDEN;
+LONG CRYPT_StoreGeneration(WINECRYPT_CERTSTORE *store) DECLSPEC_HIDDEN;
+
+/* Called when a certificate's hash or key identifier property is changed, as
+ * these are indexed by memory stores.
+ */
+void CRYPT_InvalidateCertIndexes(void) DECLSPEC_HIDDEN;
 BOOL WINAPI I_CertUpdateStore(HCERTSTORE store1, HCERTSTORE store2, DWORD unk0,
  DWORD unk1) DECLSPEC_HIDDEN;
 
@@ -284,6 +284,28 @@ static BOOL ProvStore_control(WINECRYPT_CERTSTORE *cert_store, DWORD dwFlags, DW
     return ret;
 }
 
+static context_t *ProvStore_findCert(WINECRYPT_CERTSTORE *store,
+ const CERT_FIND_PARA *para, context_t *prev)
+{
+    WINE_PROVIDERSTORE *ps = (WINE_PROVIDERSTORE*)store;
+    cert_t *ret;
+
+    ret = (cert_t*)CRYPT_StoreFindCert(ps->memStore, para, prev);
+    if (!ret)
+        return NULL;
+
+    /* same dirty trick as ProvStore_enumCert */
+    ret->ctx.hCertStore = store;
+    return &ret->base;
+}
+
+static LONG ProvStore_generation(WINECRYPT_CERTSTORE *store)
+{
+    WINE_PROVIDERSTORE *ps = (WINE_PROVIDERSTORE*)store;
+
+    return CRYPT_StoreGeneration(ps->memStore);
+}
+
 static const store_vtbl_t ProvStoreVtbl = {
     ProvStore_addref,
     ProvStore_release,
@@ -301,7 +323,9 @@ static const store_vtbl_t ProvStoreVtbl = {
         ProvStore_addCTL,
         ProvStore_enumCTL,
         ProvStore_deleteCTL
-    }
+    },
+    ProvStore_findCert,
+    ProvStore_generation
 };
 
 WINECRYPT_CERTSTORE *CRYPT_ProvCreateStore(DWORD dwFlags,
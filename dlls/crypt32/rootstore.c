@@ -16,12 +16,17 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 #include "config.h"
+#include "wine/port.h"
+
 #include <stdarg.h>
 #include <stdio.h>
 #include <sys/types.h>
 #ifdef HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_DIRENT_H
 #include <dirent.h>
 #endif
@@ -42,6 +47,7 @@
 #include "wincrypt.h"
 #include "winternl.h"
 #include "wine/debug.h"
+#include "wine/library.h"
 #include "crypt32_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(crypt);
@@ -872,6 +878,250 @@ static const struct CONST_BLOB {
     { rootcertauthority2011, sizeof(rootcertauthority2011) },
 };
 
+#ifndef HAVE_SECURITY_SECURITY_H
+
+/* The validated certificates read from the known locations are cached in the
+ * configuration directory, so that other processes don't have to parse and
+ * verify them again.  The cache starts with a root_cache_header, followed by
+ * the key describing the known locations when it was written, followed by
+ * the certificates, each one as a DWORD size and the DWORD-aligned encoded
+ * certificate.
+ */
+#define ROOT_CACHE_MAGIC   0x43524357  /* "WCRC" */
+#define ROOT_CACHE_VERSION 1
+#define ROOT_CACHE_ALIGN(x) (((x) + sizeof(DWORD) - 1) & ~(sizeof(DWORD) - 1))
+
+struct root_cache_header
+{
+    DWORD magic;
+    DWORD version;
+    DWORD key_size;
+    DWORD cert_count;
+};
+
+static const char root_cache_name[] = "/crypt32_roots.cache";
+
+static char *get_root_cache_path(void)
+{
+    const char *dir = wine_get_config_dir();
+    char *path;
+
+    if (!dir || !(path = CryptMemAlloc(strlen(dir) + sizeof(root_cache_name))))
+        return NULL;
+    strcpy(path, dir);
+    strcat(path, root_cache_name);
+    return path;
+}
+
+static BOOL append_root_cache_key(char **key, size_t *bufsize, size_t *len,
+ const char *path, const struct stat *st)
+{
+    char entry[PATH_MAX + 64];
+    size_t entry_len;
+
+    if (st)
+        snprintf(entry, sizeof(entry), "%s:%lx:%lx:%lx\n", path,
+         (unsigned long)st->st_mtime, (unsigned long)st->st_size, (unsigned long)st->st_ino);
+    else
+        snprintf(entry, sizeof(entry), "%s:-\n", path);
+    entry_len = strlen(entry);
+
+    if (*len + entry_len + 1 > *bufsize &&
+     !check_buffer_resize(key, bufsize, max(*len + entry_len + 1, *bufsize * 2)))
+        return FALSE;
+    strcpy(*key + *len, entry);
+    *len += entry_len;
+    return TRUE;
+}
+
+/* Builds a key from the modification time, size and inode of each known
+ * location, and of each file in the locations that are directories, so that
+ * the cache is discarded when any of them changes.
+ */
+static char *get_root_cache_key(DWORD *key_size)
+{
+    size_t len = 0, bufsize = 0;
+    char *key = NULL;
+    BOOL ret = TRUE;
+    DWORD i;
+
+    for (i = 0; ret && i < sizeof(CRYPT_knownLocations) / sizeof(CRYPT_knownLocations[0]); i++)
+    {
+        struct stat st;
+
+        if (stat(CRYPT_knownLocations[i], &st))
+        {
+            ret = append_root_cache_key(&key, &bufsize, &len, CRYPT_knownLocations[i], NULL);
+            continue;
+        }
+        ret = append_root_cache_key(&key, &bufsize, &len, CRYPT_knownLocations[i], &st);
+#ifdef HAVE_READDIR
+        if (ret && S_ISDIR(st.st_mode))
+        {
+            /* files can be edited in place, which doesn't change the directory */
+            DIR *dir = opendir(CRYPT_knownLocations[i]);
+            struct dirent *entry;
+            char path[PATH_MAX];
+
+            while (ret && dir && (entry = readdir(dir)))
+            {
+                if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+                    continue;
+                snprintf(path, sizeof(path), "%s/%s", CRYPT_knownLocations[i], entry->d_name);
+                ret = append_root_cache_key(&key, &bufsize, &len, path, stat(path, &st) ? NULL : &st);
+            }
+            if (dir)
+                closedir(dir);
+        }
+#endif
+    }
+    if (!ret)
+    {
+        CryptMemFree(key);
+        return NULL;
+    }
+    *key_size = len;
+    return key;
+}
+
+/* Adds the cached certificates to store if the cache is up to date.
+ * Returns TRUE if it was.
+ */
+static BOOL read_root_cache(HCERTSTORE store, const char *key, DWORD key_size)
+{
+#ifdef HAVE_SYS_MMAN_H
+    const struct root_cache_header *header;
+    char *path = get_root_cache_path();
+    const BYTE *data, *ptr, *end;
+    BOOL ret = FALSE;
+    struct stat st;
+    DWORD i;
+    int fd;
+
+    if (!path)
+        return FALSE;
+    fd = open(path, O_RDONLY);
+    CryptMemFree(path);
+    if (fd == -1)
+        return FALSE;
+
+    if (fstat(fd, &st) || st.st_size < sizeof(*header) ||
+     (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return FALSE;
+    }
+    close(fd);
+
+    header = (const struct root_cache_header *)data;
+    end = data + st.st_size;
+    ptr = data + sizeof(*header);
+    if (header->magic != ROOT_CACHE_MAGIC || header->version != ROOT_CACHE_VERSION ||
+     header->key_size != key_size || end - ptr < key_size || memcmp(ptr, key, key_size))
+    {
+        TRACE("root certificate cache is out of date\n");
+        goto done;
+    }
+    ptr += ROOT_CACHE_ALIGN(key_size);
+
+    for (i = 0; i < header->cert_count; i++)
+    {
+        DWORD size;
+
+        if (end - ptr < sizeof(DWORD)) break;
+        size = *(const DWORD *)ptr;
+        ptr += sizeof(DWORD);
+        if (end - ptr < size) break;
+        if (!CertAddEncodedCertificateToStore(store, X509_ASN_ENCODING, ptr, size,
+         CERT_STORE_ADD_NEW, NULL))
+            WARN("adding cached root cert %d failed: %08x\n", i, GetLastError());
+        ptr += ROOT_CACHE_ALIGN(size);
+    }
+    if (i < header->cert_count)
+    {
+        /* The store may already contain some of the certificates, they all
+         * have been validated when the cache was written, and the ones
+         * missing are added when the known locations are read again.
+         */
+        WARN("root certificate cache is truncated\n");
+        goto done;
+    }
+    TRACE("read %d certs from the cache\n", i);
+    ret = TRUE;
+
+done:
+    munmap((void *)data, st.st_size);
+    return ret;
+#else
+    return FALSE;
+#endif
+}
+
+static BOOL write_root_cache_data(int fd, const void *data, DWORD size)
+{
+    static const BYTE padding[sizeof(DWORD)];
+    DWORD pad = ROOT_CACHE_ALIGN(size) - size;
+
+    return write(fd, data, size) == size && (!pad || write(fd, padding, pad) == pad);
+}
+
+/* Saves the certificates in store to the cache. */
+static void write_root_cache(HCERTSTORE store, const char *key, DWORD key_size)
+{
+    struct root_cache_header header = { ROOT_CACHE_MAGIC, ROOT_CACHE_VERSION, key_size, 0 };
+    char *path = get_root_cache_path(), *tmp;
+    PCCERT_CONTEXT cert = NULL;
+    BOOL ret;
+    int fd;
+
+    if (!path)
+        return;
+    if (!(tmp = CryptMemAlloc(strlen(path) + sizeof(".XXXXXX"))))
+    {
+        CryptMemFree(path);
+        return;
+    }
+    strcpy(tmp, path);
+    strcat(tmp, ".XXXXXX");
+
+    /* write to a temporary file first, so that other processes never see a
+     * partially written cache
+     */
+    if ((fd = mkstemps(tmp, 0)) == -1)
+    {
+        WARN("failed to create %s: %s\n", debugstr_a(tmp), strerror(errno));
+        goto done;
+    }
+
+    while ((cert = CertEnumCertificatesInStore(store, cert)))
+        header.cert_count++;
+
+    ret = write_root_cache_data(fd, &header, sizeof(header)) &&
+     write_root_cache_data(fd, key, key_size);
+    while (ret && (cert = CertEnumCertificatesInStore(store, cert)))
+    {
+        ret = write_root_cache_data(fd, &cert->cbCertEncoded, sizeof(DWORD)) &&
+         write_root_cache_data(fd, cert->pbCertEncoded, cert->cbCertEncoded);
+    }
+    if (cert)
+        CertFreeCertificateContext(cert);
+    close(fd);
+
+    if (ret && !rename(tmp, path))
+        TRACE("wrote %d certs to %s\n", header.cert_count, debugstr_a(path));
+    else
+    {
+        WARN("failed to write %s\n", debugstr_a(path));
+        unlink(tmp);
+    }
+
+done:
+    CryptMemFree(tmp);
+    CryptMemFree(path);
+}
+
+#endif  /* HAVE_SECURITY_SECURITY_H */
+
 static void add_ms_root_certs(HCERTSTORE to)
 {
     DWORD i;
@@ -891,9 +1141,20 @@ static void add_ms_root_certs(HCERTSTORE to)
  */
 static void read_trusted_roots_from_known_locations(HCERTSTORE store)
 {
-    HCERTSTORE from = CertOpenStore(CERT_STORE_PROV_MEMORY,
-     X509_ASN_ENCODING, 0, CERT_STORE_CREATE_NEW_FLAG, NULL);
+    HCERTSTORE from;
+#ifndef HAVE_SECURITY_SECURITY_H
+    DWORD key_size = 0;
+    char *key = get_root_cache_key(&key_size);
 
+    if (key && read_root_cache(store, key, key_size))
+    {
+        CryptMemFree(key);
+        return;
+    }
+#endif
+
+    from = CertOpenStore(CERT_STORE_PROV_MEMORY,
+     X509_ASN_ENCODING, 0, CERT_STORE_CREATE_NEW_FLAG, NULL);
     if (from)
     {
         DWORD i;
@@ -933,8 +1194,15 @@ static void read_trusted_roots_from_known_locations(HCERTSTORE store)
          i++)
             ret = import_certs_from_path(CRYPT_knownLocations[i], from, TRUE);
         check_and_store_certs(from, store);
+#ifndef HAVE_SECURITY_SECURITY_H
+        if (key)
+            write_root_cache(store, key, key_size);
+#endif
     }
     CertCloseStore(from, 0);
+#ifndef HAVE_SECURITY_SECURITY_H
+    CryptMemFree(key);
+#endif
 }
 
 static HCERTSTORE create_root_store(void)
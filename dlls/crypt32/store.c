@@ -36,6 +36,7 @@
 #include "wincrypt.h"
 #include "wine/debug.h"
 #include "wine/exception.h"
+#include "wine/rbtree.h"
 #include "crypt32_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(crypt);
@@ -79,6 +80,32 @@ static const WINE_CONTEXT_INTERFACE gCTLInterface = {
 };
 const WINE_CONTEXT_INTERFACE *pCTLInterface = &gCTLInterface;
 
+/* Memory stores index their certificates by subject, issuer, hash and key
+ * identifier, so that chain building doesn't have to compare every
+ * certificate in large stores.  The index is built on the first lookup and
+ * kept up to date as certificates are added and removed.
+ */
+struct cert_index_key
+{
+    CertIndexType          index;
+    const CRYPT_DATA_BLOB *blob;
+};
+
+struct cert_index_entry
+{
+    struct wine_rb_entry entry;
+    CertIndexType        index;
+    CRYPT_DATA_BLOB      key;
+    struct list          certs; /* struct cert_index_ref, in enumeration order */
+    BYTE                 data[1];
+};
+
+struct cert_index_ref
+{
+    struct list  entry;
+    context_t   *context;
+};
+
 typedef struct _WINE_MEMSTORE
 {
     WINECRYPT_CERTSTORE hdr;
@@ -86,8 +113,17 @@ typedef struct _WINE_MEMSTORE
     struct list certs;
     struct list crls;
     struct list ctls;
+    LONG generation;
+    struct wine_rb_tree cert_index;
+    BOOL cert_index_valid;
+    LONG cert_index_serial;
 } WINE_MEMSTORE;
 
+/* Incremented whenever a certificate property used by the index is changed,
+ * which invalidates all indexes.
+ */
+static LONG cert_index_serial;
+
 void CRYPT_InitStore(WINECRYPT_CERTSTORE *store, DWORD dwFlags, CertStoreType type, const store_vtbl_t *vtbl)
 {
     store->ref = 1;
@@ -143,6 +179,202 @@ BOOL WINAPI I_CertUpdateStore(HCERTSTORE store1, HCERTSTORE store2, DWORD unk0,
     return TRUE;
 }
 
+void CRYPT_InvalidateCertIndexes(void)
+{
+    InterlockedIncrement(&cert_index_serial);
+}
+
+static int cert_index_compare(const void *key, const struct wine_rb_entry *entry)
+{
+    const struct cert_index_key *k = key;
+    const struct cert_index_entry *e = WINE_RB_ENTRY_VALUE(entry, const struct cert_index_entry, entry);
+
+    if (k->index != e->index)
+        return k->index < e->index ? -1 : 1;
+    if (k->blob->cbData != e->key.cbData)
+        return k->blob->cbData < e->key.cbData ? -1 : 1;
+    return memcmp(k->blob->pbData, e->key.pbData, e->key.cbData);
+}
+
+static void cert_index_free_entry(struct wine_rb_entry *entry, void *context)
+{
+    struct cert_index_entry *index = WINE_RB_ENTRY_VALUE(entry, struct cert_index_entry, entry);
+    struct cert_index_ref *ref, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE(ref, next, &index->certs, struct cert_index_ref, entry)
+        CryptMemFree(ref);
+    CryptMemFree(index);
+}
+
+static void cert_index_free(WINE_MEMSTORE *store)
+{
+    wine_rb_clear(&store->cert_index, cert_index_free_entry, NULL);
+    store->cert_index_valid = FALSE;
+}
+
+/* Gets the key of context in the given index.  Small keys are returned in
+ * buf, larger ones are allocated and must be freed with CryptMemFree.
+ */
+static BOOL cert_index_get_key(context_t *context, CertIndexType index,
+ BYTE *buf, DWORD buf_size, CRYPT_DATA_BLOB *key)
+{
+    const CERT_CONTEXT *cert = context_ptr(context);
+    DWORD prop, size = 0;
+
+    switch (index)
+    {
+    case CertIndexSubject:
+        *key = cert->pCertInfo->Subject;
+        return TRUE;
+    case CertIndexIssuer:
+        *key = cert->pCertInfo->Issuer;
+        return TRUE;
+    case CertIndexSHA1Hash:
+        prop = CERT_SHA1_HASH_PROP_ID;
+        break;
+    case CertIndexKeyId:
+        prop = CERT_KEY_IDENTIFIER_PROP_ID;
+        break;
+    default:
+        return FALSE;
+    }
+
+    if (!CertGetCertificateContextProperty(cert, prop, NULL, &size))
+        return FALSE;
+    if (size <= buf_size)
+        key->pbData = buf;
+    else if (!(key->pbData = CryptMemAlloc(size)))
+        return FALSE;
+    key->cbData = size;
+    if (!CertGetCertificateContextProperty(cert, prop, key->pbData, &key->cbData))
+    {
+        if (key->pbData != buf)
+            CryptMemFree(key->pbData);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Adds context to the index, either first or last in enumeration order.
+ * Assumes the store's lock is held.
+ */
+static BOOL cert_index_add(WINE_MEMSTORE *store, context_t *context, BOOL head)
+{
+    CertIndexType index;
+    BOOL ret = TRUE;
+
+    for (index = 0; ret && index < CertIndexCount; index++)
+    {
+        struct cert_index_key key = { index };
+        struct cert_index_entry *entry;
+        struct cert_index_ref *ref;
+        struct wine_rb_entry *rb;
+        CRYPT_DATA_BLOB blob;
+        BYTE buf[32];
+
+        /* certificates without a hash or key identifier never match a lookup
+         * by it either
+         */
+        if (!cert_index_get_key(context, index, buf, sizeof(buf), &blob))
+            continue;
+        key.blob = &blob;
+
+        if ((rb = wine_rb_get(&store->cert_index, &key)))
+            entry = WINE_RB_ENTRY_VALUE(rb, struct cert_index_entry, entry);
+        else if ((entry = CryptMemAlloc(FIELD_OFFSET(struct cert_index_entry, data[blob.cbData]))))
+        {
+            entry->index = index;
+            entry->key.cbData = blob.cbData;
+            entry->key.pbData = entry->data;
+            memcpy(entry->data, blob.pbData, blob.cbData);
+            list_init(&entry->certs);
+            wine_rb_put(&store->cert_index, &key, &entry->entry);
+        }
+
+        if (entry && (ref = CryptMemAlloc(sizeof(*ref))))
+        {
+            ref->context = context;
+            if (head)
+                list_add_head(&entry->certs, &ref->entry);
+            else
+                list_add_tail(&entry->certs, &ref->entry);
+        }
+        else
+            ret = FALSE;
+
+        if (blob.pbData != buf && index >= CertIndexSHA1Hash)
+            CryptMemFree(blob.pbData);
+    }
+    return ret;
+}
+
+/* Removes context from the index.  Assumes the store's lock is held. */
+static void cert_index_remove(WINE_MEMSTORE *store, context_t *context)
+{
+    CertIndexType index;
+
+    for (index = 0; index < CertIndexCount; index++)
+    {
+        struct cert_index_key key = { index };
+        struct cert_index_entry *entry;
+        struct cert_index_ref *ref;
+        struct wine_rb_entry *rb;
+        CRYPT_DATA_BLOB blob;
+        BYTE buf[32];
+
+        if (!cert_index_get_key(context, index, buf, sizeof(buf), &blob))
+            continue;
+        key.blob = &blob;
+
+        if ((rb = wine_rb_get(&store->cert_index, &key)))
+        {
+            entry = WINE_RB_ENTRY_VALUE(rb, struct cert_index_entry, entry);
+            LIST_FOR_EACH_ENTRY(ref, &entry->certs, struct cert_index_ref, entry)
+            {
+                if (ref->context != context) continue;
+                list_remove(&ref->entry);
+                CryptMemFree(ref);
+                break;
+            }
+            if (list_empty(&entry->certs))
+            {
+                wine_rb_remove(&store->cert_index, &entry->entry);
+                CryptMemFree(entry);
+            }
+        }
+
+        if (blob.pbData != buf && index >= CertIndexSHA1Hash)
+            CryptMemFree(blob.pbData);
+    }
+}
+
+/* Makes sure the index is up to date, building it if needed.  Returns FALSE
+ * if it can't be used.  Assumes the store's lock is held.
+ */
+static BOOL cert_index_validate(WINE_MEMSTORE *store)
+{
+    LONG serial = cert_index_serial;
+    context_t *context;
+
+    if (store->cert_index_valid && store->cert_index_serial == serial)
+        return TRUE;
+
+    cert_index_free(store);
+    LIST_FOR_EACH_ENTRY(context, &store->certs, context_t, u.entry)
+    {
+        if (!cert_index_add(store, context, FALSE))
+        {
+            WARN("failed to build index for %p\n", store);
+            cert_index_free(store);
+            return FALSE;
+        }
+    }
+    TRACE("built index for %p\n", store);
+    store->cert_index_valid = TRUE;
+    store->cert_index_serial = serial;
+    return TRUE;
+}
+
 static BOOL MemStore_addContext(WINE_MEMSTORE *store, struct list *list, context_t *orig_context,
  context_t *existing, context_t **ret_context, BOOL use_link)
 {
@@ -155,6 +387,8 @@ static BOOL MemStore_addContext(WINE_MEMSTORE *store, struct list *list, context
     TRACE("adding %p\n", context);
     EnterCriticalSection(&store->cs);
     if (existing) {
+        if (list == &store->certs)
+            cert_index_free(store);
         context->u.entry.prev = existing->u.entry.prev;
         context->u.entry.next = existing->u.entry.next;
         context->u.entry.prev->next = &context->u.entry;
@@ -164,7 +398,11 @@ static BOOL MemStore_addContext(WINE_MEMSTORE *store, struct list *list, context
             Context_Release(existing);
     }else {
         list_add_head(list, &context->u.entry);
+        if (list == &store->certs && store->cert_index_valid &&
+         !cert_index_add(store, context, TRUE))
+            cert_index_free(store);
     }
+    store->generation++;
     LeaveCriticalSection(&store->cs);
 
     if(ret_context)
@@ -198,14 +436,23 @@ static context_t *MemStore_enumContext(WINE_MEMSTORE *store, struct list *list,
     return ret;
 }
 
-static BOOL MemStore_deleteContext(WINE_MEMSTORE *store, context_t *context)
+static BOOL MemStore_deleteContext(WINE_MEMSTORE *store, struct list *list, context_t *context)
 {
     BOOL in_list = FALSE;
 
     EnterCriticalSection(&store->cs);
     if (!list_empty(&context->u.entry)) {
+        if (list == &store->certs && store->cert_index_valid)
+        {
+            /* the keys may have changed since the context was indexed */
+            if (store->cert_index_serial == cert_index_serial)
+                cert_index_remove(store, context);
+            else
+                cert_index_free(store);
+        }
         list_remove(&context->u.entry);
         list_init(&context->u.entry);
+        store->generation++;
         in_list = TRUE;
     }
     LeaveCriticalSection(&store->cs);
@@ -258,7 +505,7 @@ static BOOL MemStore_deleteCert(WINECRYPT_CERTSTORE *store, context_t *context)
 
     TRACE("(%p, %p)\n", store, context);
 
-    return MemStore_deleteContext(ms, context);
+    return MemStore_deleteContext(ms, &ms->certs, context);
 }
 
 static BOOL MemStore_addCRL(WINECRYPT_CERTSTORE *store, context_t *crl,
@@ -286,7 +533,7 @@ static BOOL MemStore_deleteCRL(WINECRYPT_CERTSTORE *store, context_t *context)
 
     TRACE("(%p, %p)\n", store, context);
 
-    return MemStore_deleteContext(ms, context);
+    return MemStore_deleteContext(ms, &ms->crls, context);
 }
 
 static BOOL MemStore_addCTL(WINECRYPT_CERTSTORE *store, context_t *ctl,
@@ -314,7 +561,95 @@ static BOOL MemStore_deleteCTL(WINECRYPT_CERTSTORE *store, context_t *context)
 
     TRACE("(%p, %p)\n", store, context);
 
-    return MemStore_deleteContext(ms, context);
+    return MemStore_deleteContext(ms, &ms->ctls, context);
+}
+
+static context_t *MemStore_findCertLinear(WINE_MEMSTORE *store,
+ const CERT_FIND_PARA *para, context_t *prev)
+{
+    struct list *next = prev ? &prev->u.entry : &store->certs;
+    context_t *context;
+
+    while ((next = list_next(&store->certs, next)))
+    {
+        context = LIST_ENTRY(next, context_t, u.entry);
+        if (para->compare(context_ptr(context), para->type, para->flags, para->para))
+            return context;
+    }
+    return NULL;
+}
+
+static context_t *MemStore_findCert(WINECRYPT_CERTSTORE *store,
+ const CERT_FIND_PARA *para, context_t *prev)
+{
+    WINE_MEMSTORE *ms = (WINE_MEMSTORE *)store;
+    struct cert_index_key key = { para->index, para->key };
+    context_t *ret = NULL;
+
+    TRACE("(%p, %d, %p)\n", store, para->index, prev);
+
+    EnterCriticalSection(&ms->cs);
+    if (prev && list_empty(&prev->u.entry))
+    {
+        /* prev has been deleted from the store, nothing follows it */
+    }
+    else if (cert_index_validate(ms))
+    {
+        struct wine_rb_entry *rb = wine_rb_get(&ms->cert_index, &key);
+        struct cert_index_entry *entry = NULL;
+        struct cert_index_ref *ref = NULL;
+
+        if (rb)
+        {
+            entry = WINE_RB_ENTRY_VALUE(rb, struct cert_index_entry, entry);
+            if (prev)
+            {
+                LIST_FOR_EACH_ENTRY(ref, &entry->certs, struct cert_index_ref, entry)
+                    if (ref->context == prev) break;
+                if (&ref->entry == &entry->certs)
+                    ref = NULL;
+            }
+        }
+
+        if (prev && !ref)
+        {
+            /* prev doesn't match the lookup, it must come from an enumeration */
+            ret = MemStore_findCertLinear(ms, para, prev);
+        }
+        else if (entry)
+        {
+            struct list *next = ref ? &ref->entry : &entry->certs;
+
+            while ((next = list_next(&entry->certs, next)))
+            {
+                ref = LIST_ENTRY(next, struct cert_index_ref, entry);
+                if (para->compare(context_ptr(ref->context), para->type, para->flags, para->para))
+                {
+                    ret = ref->context;
+                    break;
+                }
+            }
+        }
+    }
+    else
+        ret = MemStore_findCertLinear(ms, para, prev);
+
+    if (ret)
+        Context_AddRef(ret);
+    if (prev)
+        Context_Release(prev);
+    LeaveCriticalSection(&ms->cs);
+
+    if (!ret)
+        SetLastError(CRYPT_E_NOT_FOUND);
+    return ret;
+}
+
+static LONG MemStore_generation(WINECRYPT_CERTSTORE *store)
+{
+    WINE_MEMSTORE *ms = (WINE_MEMSTORE *)store;
+
+    return ms->generation;
 }
 
 static void MemStore_addref(WINECRYPT_CERTSTORE *store)
@@ -336,6 +671,7 @@ static DWORD MemStore_release(WINECRYPT_CERTSTORE *cert_store, DWORD flags)
     if(ref)
         return (flags & CERT_CLOSE_STORE_CHECK_FLAG) ? CRYPT_E_PENDING_CLOSE : ERROR_SUCCESS;
 
+    cert_index_free(store);
     free_contexts(&store->certs);
     free_contexts(&store->crls);
     free_contexts(&store->ctls);
@@ -369,7 +705,9 @@ static const store_vtbl_t MemStoreVtbl = {
         MemStore_addCTL,
         MemStore_enumCTL,
         MemStore_deleteCTL
-    }
+    },
+    MemStore_findCert,
+    MemStore_generation
 };
 
 static WINECRYPT_CERTSTORE *CRYPT_MemOpenStore(HCRYPTPROV hCryptProv,
@@ -396,6 +734,7 @@ static WINECRYPT_CERTSTORE *CRYPT_MemOpenStore(HCRYPTPROV hCryptProv,
             list_init(&store->certs);
             list_init(&store->crls);
             list_init(&store->ctls);
+            wine_rb_init(&store->cert_index, cert_index_compare);
             /* Mem store doesn't need crypto provider, so close it */
             if (hCryptProv && !(dwFlags & CERT_STORE_NO_CRYPT_RELEASE_FLAG))
                 CryptReleaseContext(hCryptProv, 0);
@@ -926,6 +1265,25 @@ HCERTSTORE WINAPI CertOpenSystemStoreW(HCRYPTPROV_LEGACY hProv,
      CERT_SYSTEM_STORE_CURRENT_USER, szSubSystemProtocol);
 }
 
+context_t *CRYPT_StoreFindCert(WINECRYPT_CERTSTORE *store,
+ const CERT_FIND_PARA *para, context_t *prev)
+{
+    context_t *ret = prev;
+
+    if (store->vtbl->findCert)
+        return store->vtbl->findCert(store, para, prev);
+
+    while ((ret = store->vtbl->certs.enumContext(store, ret)))
+        if (para->compare(context_ptr(ret), para->type, para->flags, para->para))
+            break;
+    return ret;
+}
+
+LONG CRYPT_StoreGeneration(WINECRYPT_CERTSTORE *store)
+{
+    return store->vtbl->generation ? store->vtbl->generation(store) : 0;
+}
+
 PCCERT_CONTEXT WINAPI CertEnumCertificatesInStore(HCERTSTORE hCertStore, PCCERT_CONTEXT pPrev)
 {
     cert_t *prev = pPrev ? cert_from_ptr(pPrev) : NULL, *ret;
@@ -1359,6 +1359,140 @@ static void testFindCert(void)
     CertCloseStore(store, 0);
 }
 
+static DWORD count_certs_by_name(HCERTSTORE store, BYTE *name, DWORD size)
+{
+    CERT_NAME_BLOB blob = { size, name };
+    PCCERT_CONTEXT context = NULL;
+    DWORD count = 0;
+
+    while ((context = CertFindCertificateInStore(store, X509_ASN_ENCODING, 0,
+     CERT_FIND_SUBJECT_NAME, &blob, context)))
+        count++;
+    return count;
+}
+
+static void testFindCertUpdates(void)
+{
+    static BYTE fakeHash[] = { 0xde,0xad,0xbe,0xef,0xde,0xad,0xbe,0xef,
+     0xde,0xad,0xbe,0xef,0xde,0xad,0xbe,0xef,0xde,0xad,0xbe,0xef };
+    static BYTE keyId[] = { 1,2,3,4 };
+    HCERTSTORE store, store2, collection;
+    PCCERT_CONTEXT context, found;
+    CRYPT_HASH_BLOB blob;
+    CERT_ID id;
+    BOOL ret;
+
+    store = CertOpenStore(CERT_STORE_PROV_MEMORY, 0, 0,
+     CERT_STORE_CREATE_NEW_FLAG, NULL);
+    store2 = CertOpenStore(CERT_STORE_PROV_MEMORY, 0, 0,
+     CERT_STORE_CREATE_NEW_FLAG, NULL);
+    collection = CertOpenStore(CERT_STORE_PROV_COLLECTION, 0, 0,
+     CERT_STORE_CREATE_NEW_FLAG, NULL);
+    CertAddStoreToCollection(collection, store, 0, 0);
+    CertAddStoreToCollection(collection, store2, 0, 0);
+
+    ret = CertAddEncodedCertificateToStore(store, X509_ASN_ENCODING,
+     bigCert, sizeof(bigCert), CERT_STORE_ADD_NEW, NULL);
+    if (!ret && GetLastError() == OSS_DATA_ERROR)
+    {
+        skip("bigCert can't be decoded, skipping tests\n");
+        CertCloseStore(collection, 0);
+        CertCloseStore(store2, 0);
+        CertCloseStore(store, 0);
+        return;
+    }
+    ok(ret, "CertAddEncodedCertificateToStore failed: %08x\n", GetLastError());
+    ok(count_certs_by_name(store, subjectName, sizeof(subjectName)) == 1,
+     "expected 1 cert\n");
+
+    /* Certificates added after a lookup are found as well */
+    ret = CertAddEncodedCertificateToStore(store, X509_ASN_ENCODING,
+     certWithUsage, sizeof(certWithUsage), CERT_STORE_ADD_NEW, NULL);
+    ok(ret, "CertAddEncodedCertificateToStore failed: %08x\n", GetLastError());
+    ret = CertAddEncodedCertificateToStore(store, X509_ASN_ENCODING,
+     bigCert2, sizeof(bigCert2), CERT_STORE_ADD_NEW, NULL);
+    ok(ret, "CertAddEncodedCertificateToStore failed: %08x\n", GetLastError());
+    ret = CertAddEncodedCertificateToStore(store2, X509_ASN_ENCODING,
+     bigCert, sizeof(bigCert), CERT_STORE_ADD_NEW, NULL);
+    ok(ret, "CertAddEncodedCertificateToStore failed: %08x\n", GetLastError());
+    ok(count_certs_by_name(store, subjectName, sizeof(subjectName)) == 2,
+     "expected 2 certs\n");
+    ok(count_certs_by_name(store, subjectName2, sizeof(subjectName2)) == 1,
+     "expected 1 cert\n");
+    ok(count_certs_by_name(collection, subjectName, sizeof(subjectName)) == 3,
+     "expected 3 certs\n");
+
+    /* Deleted certificates aren't */
+    blob.pbData = bigCertHash;
+    blob.cbData = sizeof(bigCertHash);
+    context = CertFindCertificateInStore(store, X509_ASN_ENCODING, 0,
+     CERT_FIND_SHA1_HASH, &blob, NULL);
+    ok(context != NULL, "CertFindCertificateInStore failed: %08x\n", GetLastError());
+    ret = CertDeleteCertificateFromStore(context);
+    ok(ret, "CertDeleteCertificateFromStore failed: %08x\n", GetLastError());
+    context = CertFindCertificateInStore(store, X509_ASN_ENCODING, 0,
+     CERT_FIND_SHA1_HASH, &blob, NULL);
+    ok(!context, "expected no cert\n");
+    ok(count_certs_by_name(store, subjectName, sizeof(subjectName)) == 1,
+     "expected 1 cert\n");
+    ok(count_certs_by_name(collection, subjectName, sizeof(subjectName)) == 2,
+     "expected 2 certs\n");
+    found = CertFindCertificateInStore(collection, X509_ASN_ENCODING, 0,
+     CERT_FIND_SHA1_HASH, &blob, NULL);
+    ok(found != NULL, "CertFindCertificateInStore failed: %08x\n", GetLastError());
+    if (found)
+    {
+        ok(found->hCertStore == collection, "unexpected store %p\n", found->hCertStore);
+        CertFreeCertificateContext(found);
+    }
+
+    /* Lookups by hash and key identifier use the certificate's properties */
+    blob.pbData = bigCert2Hash;
+    blob.cbData = sizeof(bigCert2Hash);
+    context = CertFindCertificateInStore(store, X509_ASN_ENCODING, 0,
+     CERT_FIND_SHA1_HASH, &blob, NULL);
+    ok(context != NULL, "CertFindCertificateInStore failed: %08x\n", GetLastError());
+    if (context)
+    {
+        blob.pbData = fakeHash;
+        blob.cbData = sizeof(fakeHash);
+        ret = CertSetCertificateContextProperty(context, CERT_HASH_PROP_ID, 0, &blob);
+        ok(ret, "CertSetCertificateContextProperty failed: %08x\n", GetLastError());
+        found = CertFindCertificateInStore(store, X509_ASN_ENCODING, 0,
+         CERT_FIND_SHA1_HASH, &blob, NULL);
+        ok(found == context, "expected %p, got %p\n", context, found);
+        CertFreeCertificateContext(found);
+        blob.pbData = bigCert2Hash;
+        blob.cbData = sizeof(bigCert2Hash);
+        found = CertFindCertificateInStore(store, X509_ASN_ENCODING, 0,
+         CERT_FIND_SHA1_HASH, &blob, NULL);
+        ok(!found, "expected no cert\n");
+
+        blob.pbData = keyId;
+        blob.cbData = sizeof(keyId);
+        ret = CertSetCertificateContextProperty(context, CERT_KEY_IDENTIFIER_PROP_ID, 0, &blob);
+        ok(ret, "CertSetCertificateContextProperty failed: %08x\n", GetLastError());
+        id.dwIdChoice = CERT_ID_KEY_IDENTIFIER;
+        U(id).KeyId = blob;
+        found = CertFindCertificateInStore(collection, X509_ASN_ENCODING, 0,
+         CERT_FIND_CERT_ID, &id, NULL);
+        ok(found != NULL, "CertFindCertificateInStore failed: %08x\n", GetLastError());
+        if (found)
+        {
+            ok(CertCompareCertificate(X509_ASN_ENCODING, found->pCertInfo,
+             context->pCertInfo), "unexpected cert\n");
+            found = CertFindCertificateInStore(collection, X509_ASN_ENCODING, 0,
+             CERT_FIND_CERT_ID, &id, found);
+            ok(!found, "expected one cert only\n");
+        }
+        CertFreeCertificateContext(context);
+    }
+
+    CertCloseStore(collection, 0);
+    CertCloseStore(store2, 0);
+    CertCloseStore(store, 0);
+}
+
 static void testGetSubjectCert(void)
 {
     HCERTSTORE store;
@@ -4022,6 +4156,7 @@ START_TEST(cert)
     testCreateCert();
     testDupCert();
     testFindCert();
+    testFindCertUpdates();
     testGetSubjectCert();
     testGetIssuerCert();
     testLinkCert();
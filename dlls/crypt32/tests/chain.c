@@ -4904,6 +4904,107 @@ static void testVerifyCertChainPolicy(void)
      basicConstraintsPolicyCheck, &oct2007, NULL);
 }
 
+static void test_chain_cache(void)
+{
+    static const WCHAR nameW[] = { 'C','N','=','W','i','n','e',' ','c','h','a','i','n',' ',
+     'c','a','c','h','e',' ','t','e','s','t',0 };
+    static const WCHAR friendlyW[] = { 'c','a','l','l','e','r',0 };
+    CERT_CHAIN_ENGINE_CONFIG config = { sizeof(config) };
+    CERT_CHAIN_PARA para = { sizeof(para) };
+    HCERTCHAINENGINE engine;
+    HCERTSTORE root, store;
+    PCCERT_CONTEXT cert, cert2, root_cert, end;
+    PCCERT_CHAIN_CONTEXT chain;
+    CRYPT_DATA_BLOB blob;
+    CERT_NAME_BLOB name;
+    BYTE buf[256];
+    DWORD size;
+    BOOL ret;
+
+    size = sizeof(buf);
+    ret = CertStrToNameW(X509_ASN_ENCODING, nameW, CERT_X500_NAME_STR, NULL,
+     buf, &size, NULL);
+    ok(ret, "CertStrToNameW failed: %08x\n", GetLastError());
+    name.pbData = buf;
+    name.cbData = size;
+    cert = CertCreateSelfSignCertificate(0, &name, 0, NULL, NULL, NULL, NULL,
+     NULL);
+    if (!cert)
+    {
+        skip("CertCreateSelfSignCertificate failed: %08x\n", GetLastError());
+        return;
+    }
+
+    root = CertOpenStore(CERT_STORE_PROV_MEMORY, 0, 0, 0, NULL);
+    ret = CertAddCertificateContextToStore(root, cert, CERT_STORE_ADD_ALWAYS,
+     &root_cert);
+    ok(ret, "CertAddCertificateContextToStore failed: %08x\n", GetLastError());
+    config.hExclusiveRoot = root;
+    ret = pCertCreateCertificateChainEngine(&config, &engine);
+    if (!ret)
+    {
+        win_skip("hExclusiveRoot is not supported\n");
+        CertFreeCertificateContext(root_cert);
+        CertCloseStore(root, 0);
+        CertFreeCertificateContext(cert);
+        return;
+    }
+
+    ret = pCertGetCertificateChain(engine, cert, NULL, NULL, &para, 0, NULL,
+     &chain);
+    ok(ret, "CertGetCertificateChain failed: %08x\n", GetLastError());
+    ok(!chain->TrustStatus.dwErrorStatus, "unexpected error status %08x\n",
+     chain->TrustStatus.dwErrorStatus);
+    pCertFreeCertificateChain(chain);
+
+    /* The same certificate again, from another store and with a property the
+     * first context doesn't have.  The chain has to use this context.
+     */
+    store = CertOpenStore(CERT_STORE_PROV_MEMORY, 0, 0, 0, NULL);
+    ret = CertAddEncodedCertificateToStore(store, X509_ASN_ENCODING,
+     cert->pbCertEncoded, cert->cbCertEncoded, CERT_STORE_ADD_ALWAYS, &cert2);
+    ok(ret, "CertAddEncodedCertificateToStore failed: %08x\n", GetLastError());
+    blob.pbData = (BYTE *)friendlyW;
+    blob.cbData = sizeof(friendlyW);
+    ret = CertSetCertificateContextProperty(cert2, CERT_FRIENDLY_NAME_PROP_ID,
+     0, &blob);
+    ok(ret, "CertSetCertificateContextProperty failed: %08x\n", GetLastError());
+
+    ret = pCertGetCertificateChain(engine, cert2, NULL, NULL, &para, 0, NULL,
+     &chain);
+    ok(ret, "CertGetCertificateChain failed: %08x\n", GetLastError());
+    ok(!chain->TrustStatus.dwErrorStatus, "unexpected error status %08x\n",
+     chain->TrustStatus.dwErrorStatus);
+    end = chain->rgpChain[0]->rgpElement[0]->pCertContext;
+    ok(end->hCertStore == store, "end certificate is from store %p, expected %p\n",
+     end->hCertStore, store);
+    size = 0;
+    ret = CertGetCertificateContextProperty(end, CERT_FRIENDLY_NAME_PROP_ID,
+     NULL, &size);
+    ok(ret && size == sizeof(friendlyW),
+     "expected the caller's friendly name, ret %d size %u\n", ret, size);
+    pCertFreeCertificateChain(chain);
+
+    /* Removing the root from the engine's store must not leave a trusted
+     * chain behind.
+     */
+    ret = CertDeleteCertificateFromStore(root_cert);
+    ok(ret, "CertDeleteCertificateFromStore failed: %08x\n", GetLastError());
+    ret = pCertGetCertificateChain(engine, cert2, NULL, NULL, &para, 0, NULL,
+     &chain);
+    ok(ret, "CertGetCertificateChain failed: %08x\n", GetLastError());
+    ok(chain->TrustStatus.dwErrorStatus & CERT_TRUST_IS_UNTRUSTED_ROOT,
+     "expected CERT_TRUST_IS_UNTRUSTED_ROOT, got %08x\n",
+     chain->TrustStatus.dwErrorStatus);
+    pCertFreeCertificateChain(chain);
+
+    pCertFreeCertificateChainEngine(engine);
+    CertFreeCertificateContext(cert2);
+    CertCloseStore(store, 0);
+    CertCloseStore(root, 0);
+    CertFreeCertificateContext(cert);
+}
+
 START_TEST(chain)
 {
     HMODULE hCrypt32 = GetModuleHandleA("crypt32.dll");
@@ -4923,5 +5024,6 @@ START_TEST(chain)
         testVerifyCertChainPolicy();
         testGetCertChain();
         test_CERT_CHAIN_PARA_cbSize();
+        test_chain_cache();
     }
 }
@@ -63,6 +63,12 @@ static const WCHAR demiW[] = {'d','e','m','i',0};
 static const WCHAR spaceW[] = {' ',0};
 static const WCHAR enusW[] = {'e','n','-','u','s',0};
 
+struct local_refkey
+{
+    FILETIME writetime;
+    WCHAR name[1];
+};
+
 struct dwrite_font_propvec {
     FLOAT stretch;
     FLOAT style;
@@ -3626,17 +3632,438 @@ static void fontcollection_add_replacements(struct dwrite_fontcollection *collec
     RegCloseKey(hkey);
 }
 
+/* System collection metadata is cached in HKCU\Software\Wine\DirectWrite\FontCache, one binary
+   value per font file, named after file path. Entries are only used while file modification
+   time matches, which lets us build a collection without opening any of the files. */
+#define FONTCACHE_VERSION 1
+
+struct fontcache_file_header {
+    DWORD version;
+    FILETIME writetime;
+    DWORD face_type;
+    DWORD face_count;
+};
+
+struct fontcache_face {
+    DWORD style;
+    DWORD stretch;
+    DWORD weight;
+    DWRITE_PANOSE panose;
+    DWRITE_FONT_METRICS1 metrics;
+    LOGFONTW lf;
+};
+
+struct fontcache_buffer {
+    BYTE *data;
+    DWORD size;
+    DWORD alloc;
+    DWORD pos;
+    BOOL failed;
+};
+
+struct fontfile_enum {
+    struct list entry;
+    IDWriteFontFile *file;
+    const WCHAR *cache_name;
+};
+
+static HKEY fontcache_open_key(void)
+{
+    HKEY hkey;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\DirectWrite\FontCache */
+    if (RegCreateKeyExA(HKEY_CURRENT_USER, "Software\\Wine\\DirectWrite\\FontCache", 0, NULL, 0,
+            KEY_ALL_ACCESS, NULL, &hkey, NULL))
+        return NULL;
+
+    return hkey;
+}
+
+/* Only files referenced with local loader are cached, their keys are used as cache keys. */
+static const struct local_refkey *fontcache_get_refkey(IDWriteFontFile *file)
+{
+    IDWriteLocalFontFileLoader *localloader;
+    const struct local_refkey *refkey;
+    IDWriteFontFileLoader *loader;
+    UINT32 key_size;
+    HRESULT hr;
+
+    if (FAILED(IDWriteFontFile_GetLoader(file, &loader)))
+        return NULL;
+
+    hr = IDWriteFontFileLoader_QueryInterface(loader, &IID_IDWriteLocalFontFileLoader, (void **)&localloader);
+    IDWriteFontFileLoader_Release(loader);
+    if (FAILED(hr))
+        return NULL;
+    IDWriteLocalFontFileLoader_Release(localloader);
+
+    if (FAILED(IDWriteFontFile_GetReferenceKey(file, (const void **)&refkey, &key_size)))
+        return NULL;
+
+    if (key_size < FIELD_OFFSET(struct local_refkey, name) + sizeof(WCHAR))
+        return NULL;
+
+    /* unknown modification time, file is most likely missing */
+    if (!refkey->writetime.dwLowDateTime && !refkey->writetime.dwHighDateTime)
+        return NULL;
+
+    return refkey;
+}
+
+static void fontcache_write(struct fontcache_buffer *buffer, const void *data, DWORD size)
+{
+    if (buffer->failed)
+        return;
+
+    if (buffer->size + size > buffer->alloc) {
+        DWORD alloc = max(buffer->alloc * 2, buffer->size + size);
+        BYTE *ptr;
+
+        if (!(ptr = heap_realloc(buffer->data, alloc))) {
+            buffer->failed = TRUE;
+            return;
+        }
+
+        buffer->data = ptr;
+        buffer->alloc = alloc;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void fontcache_write_string(struct fontcache_buffer *buffer, const WCHAR *string)
+{
+    DWORD length = strlenW(string) + 1;
+
+    fontcache_write(buffer, &length, sizeof(length));
+    fontcache_write(buffer, string, length * sizeof(WCHAR));
+}
+
+static void fontcache_write_strings(struct fontcache_buffer *buffer, IDWriteLocalizedStrings *strings)
+{
+    UINT32 count = IDWriteLocalizedStrings_GetCount(strings), i;
+
+    fontcache_write(buffer, &count, sizeof(count));
+    for (i = 0; i < count; i++) {
+        WCHAR localeW[LOCALE_NAME_MAX_LENGTH], *string;
+        UINT32 length = 0;
+
+        localeW[0] = 0;
+        IDWriteLocalizedStrings_GetLocaleName(strings, i, localeW, sizeof(localeW)/sizeof(WCHAR));
+        IDWriteLocalizedStrings_GetStringLength(strings, i, &length);
+        if (!(string = heap_alloc((length + 1) * sizeof(WCHAR)))) {
+            buffer->failed = TRUE;
+            return;
+        }
+        string[0] = 0;
+        IDWriteLocalizedStrings_GetString(strings, i, string, length + 1);
+
+        fontcache_write_string(buffer, localeW);
+        fontcache_write_string(buffer, string);
+        heap_free(string);
+    }
+}
+
+static void fontcache_write_face(struct fontcache_buffer *buffer, const struct dwrite_font_data *data,
+    IDWriteLocalizedStrings *family_name)
+{
+    struct fontcache_face face;
+    DWORD valid = !!data;
+
+    fontcache_write(buffer, &valid, sizeof(valid));
+    if (!valid)
+        return;
+
+    face.style = data->style;
+    face.stretch = data->stretch;
+    face.weight = data->weight;
+    face.panose = data->panose;
+    face.metrics = data->metrics;
+    face.lf = data->lf;
+    fontcache_write(buffer, &face, sizeof(face));
+    fontcache_write_strings(buffer, family_name);
+    fontcache_write_strings(buffer, data->names);
+}
+
+static BOOL fontcache_read(struct fontcache_buffer *buffer, void *data, DWORD size)
+{
+    if (size > buffer->size - buffer->pos)
+        return FALSE;
+
+    memcpy(data, buffer->data + buffer->pos, size);
+    buffer->pos += size;
+    return TRUE;
+}
+
+static WCHAR *fontcache_read_string(struct fontcache_buffer *buffer)
+{
+    DWORD length;
+    WCHAR *string;
+
+    if (!fontcache_read(buffer, &length, sizeof(length)) || !length ||
+            length > (buffer->size - buffer->pos) / sizeof(WCHAR))
+        return NULL;
+
+    if (!(string = heap_alloc(length * sizeof(WCHAR))))
+        return NULL;
+
+    fontcache_read(buffer, string, length * sizeof(WCHAR));
+    string[length - 1] = 0;
+    return string;
+}
+
+static HRESULT fontcache_read_strings(struct fontcache_buffer *buffer, IDWriteLocalizedStrings **ret)
+{
+    IDWriteLocalizedStrings *strings;
+    UINT32 count, i;
+    HRESULT hr;
+
+    *ret = NULL;
+
+    if (!fontcache_read(buffer, &count, sizeof(count)))
+        return E_FAIL;
+
+    if (FAILED(hr = create_localizedstrings(&strings)))
+        return hr;
+
+    for (i = 0; i < count; i++) {
+        WCHAR *locale, *string = NULL;
+
+        if ((locale = fontcache_read_string(buffer)))
+            string = fontcache_read_string(buffer);
+        hr = locale && string ? add_localizedstring(strings, locale, string) : E_FAIL;
+        heap_free(locale);
+        heap_free(string);
+        if (FAILED(hr)) {
+            IDWriteLocalizedStrings_Release(strings);
+            return hr;
+        }
+    }
+
+    *ret = strings;
+    return S_OK;
+}
+
+static HRESULT init_font_data_from_cache(struct fontcache_buffer *buffer, IDWriteFontFile *file,
+    DWRITE_FONT_FACE_TYPE face_type, UINT32 index, IDWriteLocalizedStrings **family_name,
+    struct dwrite_font_data **ret)
+{
+    struct fontcache_face face;
+    struct dwrite_font_data *data;
+    HRESULT hr;
+
+    *family_name = NULL;
+    *ret = NULL;
+
+    if (!fontcache_read(buffer, &face, sizeof(face)))
+        return E_FAIL;
+
+    data = heap_alloc_zero(sizeof(*data));
+    if (!data)
+        return E_OUTOFMEMORY;
+
+    data->ref = 1;
+    data->file = file;
+    data->face_index = index;
+    data->face_type = face_type;
+    data->simulations = DWRITE_FONT_SIMULATIONS_NONE;
+    data->style = face.style;
+    data->stretch = face.stretch;
+    data->weight = face.weight;
+    data->panose = face.panose;
+    data->metrics = face.metrics;
+    data->lf = face.lf;
+    IDWriteFontFile_AddRef(data->file);
+
+    if (FAILED(hr = fontcache_read_strings(buffer, family_name)) ||
+            FAILED(hr = fontcache_read_strings(buffer, &data->names))) {
+        if (*family_name)
+            IDWriteLocalizedStrings_Release(*family_name);
+        *family_name = NULL;
+        release_font_data(data);
+        return hr;
+    }
+
+    init_font_prop_vec(data->weight, data->stretch, data->style, &data->propvec);
+
+    *ret = data;
+    return S_OK;
+}
+
+/* Returns face count, or ~0u if there's no usable cache entry for this file. Faces are only
+   returned once whole entry was parsed successfully. */
+static UINT32 fontcache_load_file(HKEY hkey, const struct local_refkey *refkey, IDWriteFontFile *file,
+    IDWriteLocalizedStrings ***family_names, struct dwrite_font_data ***fonts)
+{
+    struct fontcache_file_header header;
+    struct fontcache_buffer buffer;
+    UINT32 i, count = ~0u;
+    DWORD type, size = 0;
+
+    *family_names = NULL;
+    *fonts = NULL;
+    memset(&header, 0, sizeof(header));
+
+    if (RegQueryValueExW(hkey, refkey->name, NULL, &type, NULL, &size) || type != REG_BINARY ||
+            size < sizeof(header))
+        return ~0u;
+
+    memset(&buffer, 0, sizeof(buffer));
+    if (!(buffer.data = heap_alloc(size)))
+        return ~0u;
+    buffer.size = size;
+
+    if (RegQueryValueExW(hkey, refkey->name, NULL, &type, buffer.data, &buffer.size))
+        goto done;
+
+    if (!fontcache_read(&buffer, &header, sizeof(header)))
+        goto done;
+
+    if (header.version != FONTCACHE_VERSION || CompareFileTime(&header.writetime, &refkey->writetime) ||
+            header.face_count > (buffer.size - buffer.pos) / sizeof(DWORD))
+        goto done;
+
+    if (header.face_count) {
+        *family_names = heap_alloc_zero(header.face_count * sizeof(**family_names));
+        *fonts = heap_alloc_zero(header.face_count * sizeof(**fonts));
+        if (!*family_names || !*fonts)
+            goto done;
+    }
+
+    for (i = 0; i < header.face_count; i++) {
+        DWORD valid;
+
+        if (!fontcache_read(&buffer, &valid, sizeof(valid)))
+            goto done;
+        if (valid && FAILED(init_font_data_from_cache(&buffer, file, header.face_type, i,
+                &(*family_names)[i], &(*fonts)[i])))
+            goto done;
+    }
+
+    if (buffer.pos == buffer.size)
+        count = header.face_count;
+
+done:
+    heap_free(buffer.data);
+
+    if (count == ~0u) {
+        TRACE("no valid cache entry for %s\n", debugstr_w(refkey->name));
+        for (i = 0; *fonts && i < header.face_count; i++) {
+            if ((*family_names)[i])
+                IDWriteLocalizedStrings_Release((*family_names)[i]);
+            if ((*fonts)[i])
+                release_font_data((*fonts)[i]);
+        }
+        heap_free(*family_names);
+        heap_free(*fonts);
+        *family_names = NULL;
+        *fonts = NULL;
+    }
+
+    return count;
+}
+
+static int fontcache_compare_names(const void *a, const void *b)
+{
+    return strcmpiW(*(const WCHAR * const *)a, *(const WCHAR * const *)b);
+}
+
+/* Remove entries for files that are not a part of system collection anymore. */
+static void fontcache_prune(HKEY hkey, struct list *scannedfiles, DWORD used_count)
+{
+    DWORD value_count, max_namelen, i, namelen, names_count = 0;
+    struct fontfile_enum *fileenum;
+    const WCHAR **names;
+    WCHAR *name;
+
+    if (RegQueryInfoKeyW(hkey, NULL, NULL, NULL, NULL, NULL, NULL, &value_count, &max_namelen, NULL, NULL, NULL))
+        return;
+
+    if (value_count <= used_count)
+        return;
+
+    /* sorted list of live cache keys, so every value is checked with a single lookup */
+    if (!(names = heap_alloc(list_count(scannedfiles) * sizeof(*names))))
+        return;
+
+    LIST_FOR_EACH_ENTRY(fileenum, scannedfiles, struct fontfile_enum, entry) {
+        if (fileenum->cache_name)
+            names[names_count++] = fileenum->cache_name;
+    }
+    qsort(names, names_count, sizeof(*names), fontcache_compare_names);
+
+    max_namelen++;
+    if (!(name = heap_alloc(max_namelen * sizeof(WCHAR)))) {
+        heap_free(names);
+        return;
+    }
+
+    /* going backwards so that deleted values don't shift indices of remaining ones */
+    for (i = value_count; i > 0; i--) {
+        const WCHAR *key = name;
+
+        namelen = max_namelen;
+        if (RegEnumValueW(hkey, i - 1, name, &namelen, NULL, NULL, NULL, NULL))
+            continue;
+
+        if (!bsearch(&key, names, names_count, sizeof(*names), fontcache_compare_names)) {
+            TRACE("removing stale entry %s\n", debugstr_w(name));
+            RegDeleteValueW(hkey, name);
+        }
+    }
+
+    heap_free(names);
+    heap_free(name);
+}
+
+static HRESULT fontcollection_add_font(struct dwrite_fontcollection *collection, IDWriteLocalizedStrings *family_name,
+    struct dwrite_font_data *font_data)
+{
+    WCHAR familyW[255];
+    UINT32 index;
+    HRESULT hr;
+
+    fontstrings_get_en_string(family_name, familyW, sizeof(familyW)/sizeof(WCHAR));
+
+    /* ignore dot named faces */
+    if (familyW[0] == '.') {
+        WARN("Ignoring face %s\n", debugstr_w(familyW));
+        release_font_data(font_data);
+        return S_OK;
+    }
+
+    index = collection_find_family(collection, familyW);
+    if (index != ~0u)
+        hr = fontfamily_add_font(collection->family_data[index], font_data);
+    else {
+        struct dwrite_fontfamily_data *family_data;
+
+        /* create and init new family */
+        hr = init_fontfamily_data(family_name, &family_data);
+        if (hr == S_OK) {
+            /* add font to family, family - to collection */
+            hr = fontfamily_add_font(family_data, font_data);
+            if (hr == S_OK)
+                hr = fontcollection_add_family(collection, family_data);
+
+            if (FAILED(hr))
+                release_fontfamily_data(family_data);
+        }
+    }
+
+    return hr;
+}
+
 HRESULT create_font_collection(IDWriteFactory5 *factory, IDWriteFontFileEnumerator *enumerator, BOOL is_system,
     IDWriteFontCollection1 **ret)
 {
-    struct fontfile_enum {
-        struct list entry;
-        IDWriteFontFile *file;
-    };
     struct fontfile_enum *fileenum, *fileenum2;
     struct dwrite_fontcollection *collection;
+    DWORD cached_count = 0;
     struct list scannedfiles;
     BOOL current = FALSE;
+    HKEY cache_key = NULL;
     HRESULT hr = S_OK;
     UINT32 i;
 
@@ -3655,10 +4082,17 @@ HRESULT create_font_collection(IDWriteFactory5 *factory, IDWriteFontFileEnumerat
 
     TRACE("building font collection:\n");
 
+    if (is_system)
+        cache_key = fontcache_open_key();
+
     list_init(&scannedfiles);
     while (hr == S_OK) {
         DWRITE_FONT_FACE_TYPE face_type;
         DWRITE_FONT_FILE_TYPE file_type;
+        const struct local_refkey *refkey = NULL;
+        IDWriteLocalizedStrings **family_names;
+        struct dwrite_font_data **fonts;
+        struct fontcache_buffer buffer;
         BOOL supported, same = FALSE;
         IDWriteFontFile *file;
         UINT32 face_count;
@@ -3683,26 +4117,61 @@ HRESULT create_font_collection(IDWriteFactory5 *factory, IDWriteFontFileEnumerat
             continue;
         }
 
+        /* add to scanned list, unsupported files are kept too to skip them quickly */
+        fileenum = heap_alloc(sizeof(*fileenum));
+        fileenum->file = file;
+        fileenum->cache_name = NULL;
+        list_add_tail(&scannedfiles, &fileenum->entry);
+
+        if (cache_key && (refkey = fontcache_get_refkey(file))) {
+            /* reference key data stays valid as long as the file is referenced */
+            fileenum->cache_name = refkey->name;
+            face_count = fontcache_load_file(cache_key, refkey, file, &family_names, &fonts);
+            if (face_count != ~0u) {
+                cached_count++;
+
+                for (i = 0; i < face_count; i++) {
+                    if (!fonts[i])
+                        continue;
+
+                    if (SUCCEEDED(hr))
+                        hr = fontcollection_add_font(collection, family_names[i], fonts[i]);
+                    else
+                        release_font_data(fonts[i]);
+                    IDWriteLocalizedStrings_Release(family_names[i]);
+                }
+                heap_free(family_names);
+                heap_free(fonts);
+                continue;
+            }
+        }
+
+        memset(&buffer, 0, sizeof(buffer));
+
         /* failed font files are skipped */
         hr = IDWriteFontFile_Analyze(file, &supported, &file_type, &face_type, &face_count);
         if (FAILED(hr) || !supported || face_count == 0) {
             TRACE("unsupported font (%p, 0x%08x, %d, %u)\n", file, hr, supported, face_count);
-            IDWriteFontFile_Release(file);
+            if (FAILED(hr))
+                refkey = NULL;
+            face_count = 0;
             hr = S_OK;
-            continue;
         }
 
-        /* add to scanned list */
-        fileenum = heap_alloc(sizeof(*fileenum));
-        fileenum->file = file;
-        list_add_tail(&scannedfiles, &fileenum->entry);
+        if (refkey) {
+            struct fontcache_file_header header;
+
+            header.version = FONTCACHE_VERSION;
+            header.writetime = refkey->writetime;
+            header.face_type = face_type;
+            header.face_count = face_count;
+            fontcache_write(&buffer, &header, sizeof(header));
+        }
 
         for (i = 0; i < face_count; i++) {
             IDWriteLocalizedStrings *family_name = NULL;
             struct dwrite_font_data *font_data;
             struct fontface_desc desc;
-            WCHAR familyW[255];
-            UINT32 index;
 
             desc.factory = factory;
             desc.face_type = face_type;
@@ -3714,46 +4183,32 @@ HRESULT create_font_collection(IDWriteFactory5 *factory, IDWriteFontFileEnumerat
 
             /* alloc and init new font data structure */
             hr = init_font_data(&desc, &family_name, &font_data);
+            if (refkey)
+                fontcache_write_face(&buffer, SUCCEEDED(hr) ? font_data : NULL, family_name);
             if (FAILED(hr)) {
                 /* move to next one */
                 hr = S_OK;
                 continue;
             }
 
-            fontstrings_get_en_string(family_name, familyW, sizeof(familyW)/sizeof(WCHAR));
-
-            /* ignore dot named faces */
-            if (familyW[0] == '.') {
-                WARN("Ignoring face %s\n", debugstr_w(familyW));
-                IDWriteLocalizedStrings_Release(family_name);
-                release_font_data(font_data);
-                continue;
-            }
-
-            index = collection_find_family(collection, familyW);
-            if (index != ~0u)
-                hr = fontfamily_add_font(collection->family_data[index], font_data);
-            else {
-                struct dwrite_fontfamily_data *family_data;
-
-                /* create and init new family */
-                hr = init_fontfamily_data(family_name, &family_data);
-                if (hr == S_OK) {
-                    /* add font to family, family - to collection */
-                    hr = fontfamily_add_font(family_data, font_data);
-                    if (hr == S_OK)
-                        hr = fontcollection_add_family(collection, family_data);
-
-                    if (FAILED(hr))
-                        release_fontfamily_data(family_data);
-                }
-            }
-
+            hr = fontcollection_add_font(collection, family_name, font_data);
             IDWriteLocalizedStrings_Release(family_name);
 
             if (FAILED(hr))
                 break;
         }
+
+        if (refkey && !buffer.failed && i == face_count) {
+            RegSetValueExW(cache_key, refkey->name, 0, REG_BINARY, buffer.data, buffer.size);
+            cached_count++;
+        }
+        heap_free(buffer.data);
+    }
+
+    if (cache_key) {
+        if (hr == S_OK)
+            fontcache_prune(cache_key, &scannedfiles, cached_count);
+        RegCloseKey(cache_key);
     }
 
     LIST_FOR_EACH_ENTRY_SAFE(fileenum, fileenum2, &scannedfiles, struct fontfile_enum, entry) {
@@ -4400,12 +4855,6 @@ HRESULT create_fontface(const struct fontface_desc *desc, struct list *cached_li
 }
 
 /* IDWriteLocalFontFileLoader and its required IDWriteFontFileStream */
-struct local_refkey
-{
-    FILETIME writetime;
-    WCHAR name[1];
-};
-
 struct local_cached_stream
 {
     struct list entry;
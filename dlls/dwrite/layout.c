@@ -224,6 +224,12 @@ struct layout_cluster {
 struct layout_line {
     FLOAT height;   /* height based on content */
     FLOAT baseline; /* baseline based on content */
+    FLOAT width;    /* content width, not including trailing whitespace */
+    FLOAT width_trailing; /* content width including trailing whitespace */
+    UINT32 next_cluster; /* line breaking state right after this line was built */
+    UINT32 next_textpos;
+    UINT32 breakpoint;
+    UINT32 examined; /* text position after last cluster used to break this line */
 };
 
 enum layout_recompute_mask {
@@ -232,6 +238,8 @@ enum layout_recompute_mask {
     RECOMPUTE_LINES               = 1 << 2,
     RECOMPUTE_OVERHANGS           = 1 << 3,
     RECOMPUTE_LINES_AND_OVERHANGS = RECOMPUTE_LINES | RECOMPUTE_OVERHANGS,
+    RECOMPUTE_CLUSTERS_RANGE      = 1 << 4, /* only dirty text range has to be reshaped */
+    RECOMPUTE_LINES_RANGE         = 1 << 5, /* line breaking resumes after last kept line */
     RECOMPUTE_EVERYTHING          = 0xffff
 };
 
@@ -260,6 +268,8 @@ struct dwrite_textlayout {
     struct list underlines;
     struct list strikethrough;
     USHORT recompute;
+    UINT32 dirty_start; /* text range to reshape with RECOMPUTE_CLUSTERS_RANGE */
+    UINT32 dirty_end;
 
     DWRITE_LINE_BREAKPOINT *nominal_breakpoints;
     DWRITE_LINE_BREAKPOINT *actual_breakpoints;
@@ -546,6 +556,62 @@ static void free_layout_eruns(struct dwrite_textlayout *layout)
     }
 }
 
+/* Removes lines that used text at 'pos' or after it to find their breaks, together with
+   everything built for them. Line breaking is later resumed after last kept line. */
+static void layout_truncate_lines(struct dwrite_textlayout *layout, UINT32 pos)
+{
+    struct layout_effective_inline *inrun;
+    struct layout_effective_run *erun;
+    struct layout_strikethrough *s;
+    struct layout_underline *u, *u2;
+    struct list *e;
+    UINT32 line;
+
+    /* all lines are going to be rebuilt anyway */
+    if (layout->recompute & RECOMPUTE_LINES) {
+        free_layout_eruns(layout);
+        return;
+    }
+
+    /* underlines could span multiple lines, those are always added again */
+    LIST_FOR_EACH_ENTRY_SAFE(u, u2, &layout->underlines, struct layout_underline, entry) {
+        list_remove(&u->entry);
+        heap_free(u);
+    }
+
+    for (line = 0; line < layout->metrics.lineCount; line++) {
+        if (layout->lines[line].examined > pos)
+            break;
+    }
+
+    while ((e = list_tail(&layout->strikethrough))) {
+        s = LIST_ENTRY(e, struct layout_strikethrough, entry);
+        if (s->run->line < line)
+            break;
+        list_remove(&s->entry);
+        heap_free(s);
+    }
+
+    while ((e = list_tail(&layout->eruns))) {
+        erun = LIST_ENTRY(e, struct layout_effective_run, entry);
+        if (erun->line < line)
+            break;
+        list_remove(&erun->entry);
+        heap_free(erun->clustermap);
+        heap_free(erun);
+    }
+
+    while ((e = list_tail(&layout->inlineobjects))) {
+        inrun = LIST_ENTRY(e, struct layout_effective_inline, entry);
+        if (inrun->line < line)
+            break;
+        list_remove(&inrun->entry);
+        heap_free(inrun);
+    }
+
+    layout->metrics.lineCount = line;
+}
+
 /* Used to resolve break condition by forcing stronger condition over weaker. */
 static inline DWRITE_BREAK_CONDITION override_break_condition(DWRITE_BREAK_CONDITION existingbreak, DWRITE_BREAK_CONDITION newbreak)
 {
@@ -738,39 +804,31 @@ static void layout_get_font_height(FLOAT emsize, DWRITE_FONT_METRICS *fontmetric
     *height = SCALE_FONT_METRIC(fontmetrics->ascent + fontmetrics->descent + fontmetrics->lineGap, emsize, fontmetrics);
 }
 
-static HRESULT layout_compute_runs(struct dwrite_textlayout *layout)
+/* Analyzes and shapes text ranges within [start, end), which has to be aligned to range
+   boundaries. Resulting runs are added to an empty run list, cluster data is written
+   starting at 'cluster_index', which is updated to point past last added cluster. */
+static HRESULT layout_compute_runs_range(struct dwrite_textlayout *layout, UINT32 start, UINT32 end,
+    UINT32 *cluster_index)
 {
     IDWriteFontFallback *fallback;
     IDWriteTextAnalyzer *analyzer;
     struct layout_range *range;
     struct layout_run *r;
-    UINT32 cluster = 0;
+    UINT32 cluster = *cluster_index;
     HRESULT hr;
 
-    free_layout_eruns(layout);
-    free_layout_runs(layout);
-
-    /* Cluster data arrays are allocated once, assuming one text position per cluster. */
-    if (!layout->clustermetrics && layout->len) {
-        layout->clustermetrics = heap_alloc(layout->len*sizeof(*layout->clustermetrics));
-        layout->clusters = heap_alloc(layout->len*sizeof(*layout->clusters));
-        if (!layout->clustermetrics || !layout->clusters) {
-            heap_free(layout->clustermetrics);
-            heap_free(layout->clusters);
-            return E_OUTOFMEMORY;
-        }
-    }
-    layout->cluster_count = 0;
-
     hr = get_textanalyzer(&analyzer);
     if (FAILED(hr))
         return hr;
 
     LIST_FOR_EACH_ENTRY(range, &layout->ranges, struct layout_range, h.entry) {
         /* we don't care about ranges that don't contain any text */
-        if (range->h.range.startPosition >= layout->len)
+        if (range->h.range.startPosition >= layout->len || range->h.range.startPosition >= end)
             break;
 
+        if (range->h.range.startPosition + get_clipped_range_length(layout, range) <= start)
+            continue;
+
         /* inline objects override actual text in a range */
         if (range->object) {
             hr = layout_update_breakpoints_range(layout, range);
@@ -1048,21 +1106,174 @@ static HRESULT layout_compute_runs(struct dwrite_textlayout *layout)
         break;
     }
 
+    *cluster_index = cluster;
+
+    IDWriteTextAnalyzer_Release(analyzer);
+    return hr;
+}
+
+static HRESULT layout_compute_runs(struct dwrite_textlayout *layout)
+{
+    UINT32 cluster = 0;
+    HRESULT hr;
+
+    free_layout_eruns(layout);
+    free_layout_runs(layout);
+
+    /* Cluster data arrays are allocated once, assuming one text position per cluster. */
+    if (!layout->clustermetrics && layout->len) {
+        layout->clustermetrics = heap_alloc(layout->len*sizeof(*layout->clustermetrics));
+        layout->clusters = heap_alloc(layout->len*sizeof(*layout->clusters));
+        if (!layout->clustermetrics || !layout->clusters) {
+            heap_free(layout->clustermetrics);
+            heap_free(layout->clusters);
+            return E_OUTOFMEMORY;
+        }
+    }
+    layout->cluster_count = 0;
+
+    hr = layout_compute_runs_range(layout, 0, layout->len, &cluster);
     if (hr == S_OK) {
         layout->cluster_count = cluster;
         if (cluster)
             layout->clustermetrics[cluster-1].canWrapLineAfter = 1;
     }
 
-    IDWriteTextAnalyzer_Release(analyzer);
     return hr;
 }
 
-static HRESULT layout_compute(struct dwrite_textlayout *layout)
+/* Reshapes paragraphs touched by dirty text range, runs and clusters outside of them are reused. */
+static HRESULT layout_update_runs(struct dwrite_textlayout *layout)
 {
+    UINT32 start, end, pos, first_cluster, last_cluster, tail_count, cluster;
+    struct layout_range *range;
+    struct layout_run *r, *r2;
+    struct list head, tail;
+    BOOL extended;
     HRESULT hr;
 
-    if (!(layout->recompute & RECOMPUTE_CLUSTERS))
+    /* Inline objects modify break conditions outside of their ranges. */
+    if (!layout->clusters || layout->actual_breakpoints)
+        return E_FAIL;
+
+    start = layout->dirty_start;
+    end = layout->dirty_end;
+    if (start >= end)
+        return S_OK;
+
+    while (start && !lb_is_newline_char(layout->str[start - 1]))
+        start--;
+    while (end < layout->len && !lb_is_newline_char(layout->str[end - 1]))
+        end++;
+
+    /* Every range is analyzed as a whole, and runs never cross range boundaries,
+       so extend to cover both ranges and old runs that intersect. */
+    do {
+        extended = FALSE;
+
+        LIST_FOR_EACH_ENTRY(range, &layout->ranges, struct layout_range, h.entry) {
+            UINT32 range_start = range->h.range.startPosition, range_end;
+
+            if (range_start >= layout->len || range_start >= end)
+                break;
+            if (range->object)
+                return E_FAIL;
+
+            range_end = range_start + get_clipped_range_length(layout, range);
+            if (range_end <= start)
+                continue;
+
+            if (range_start < start) {
+                start = range_start;
+                extended = TRUE;
+            }
+            if (range_end > end) {
+                end = range_end;
+                extended = TRUE;
+            }
+        }
+
+        LIST_FOR_EACH_ENTRY(r, &layout->runs, struct layout_run, entry) {
+            const DWRITE_GLYPH_RUN_DESCRIPTION *descr = &r->u.regular.descr;
+
+            if (r->kind == LAYOUT_RUN_INLINE)
+                return E_FAIL;
+            if (descr->textPosition >= end)
+                break;
+            if (descr->textPosition + descr->stringLength <= start)
+                continue;
+
+            if (descr->textPosition < start) {
+                start = descr->textPosition;
+                extended = TRUE;
+            }
+            if (descr->textPosition + descr->stringLength > end) {
+                end = descr->textPosition + descr->stringLength;
+                extended = TRUE;
+            }
+        }
+    } while (extended);
+
+    for (first_cluster = 0, pos = 0; first_cluster < layout->cluster_count && pos < start; first_cluster++)
+        pos += layout->clustermetrics[first_cluster].length;
+    if (pos != start)
+        return E_FAIL;
+    for (last_cluster = first_cluster; last_cluster < layout->cluster_count && pos < end; last_cluster++)
+        pos += layout->clustermetrics[last_cluster].length;
+    if (pos != end)
+        return E_FAIL;
+    tail_count = layout->cluster_count - last_cluster;
+
+    TRACE("reshaping [%u,%u), clusters [%u,%u)\n", start, end, first_cluster, last_cluster);
+
+    /* Effective runs of affected lines reference runs that are about to be released. */
+    layout_truncate_lines(layout, start);
+
+    list_init(&head);
+    list_init(&tail);
+    LIST_FOR_EACH_ENTRY_SAFE(r, r2, &layout->runs, struct layout_run, entry) {
+        const DWRITE_GLYPH_RUN_DESCRIPTION *descr = &r->u.regular.descr;
+
+        if (descr->textPosition + descr->stringLength <= start) {
+            list_remove(&r->entry);
+            list_add_tail(&head, &r->entry);
+        }
+        else if (descr->textPosition >= end) {
+            list_remove(&r->entry);
+            list_add_tail(&tail, &r->entry);
+        }
+    }
+    free_layout_runs(layout);
+
+    /* Move trailing clusters out of the way, reshaped range can't produce more clusters
+       than it has text positions. */
+    memmove(&layout->clustermetrics[layout->len - tail_count], &layout->clustermetrics[last_cluster],
+        tail_count * sizeof(*layout->clustermetrics));
+    memmove(&layout->clusters[layout->len - tail_count], &layout->clusters[last_cluster],
+        tail_count * sizeof(*layout->clusters));
+
+    cluster = first_cluster;
+    hr = layout_compute_runs_range(layout, start, end, &cluster);
+
+    memmove(&layout->clustermetrics[cluster], &layout->clustermetrics[layout->len - tail_count],
+        tail_count * sizeof(*layout->clustermetrics));
+    memmove(&layout->clusters[cluster], &layout->clusters[layout->len - tail_count],
+        tail_count * sizeof(*layout->clusters));
+    layout->cluster_count = cluster + tail_count;
+    if (hr == S_OK && end == layout->len && cluster)
+        layout->clustermetrics[cluster-1].canWrapLineAfter = 1;
+
+    list_move_head(&layout->runs, &head);
+    list_move_tail(&layout->runs, &tail);
+
+    return hr;
+}
+
+static HRESULT layout_compute(struct dwrite_textlayout *layout)
+{
+    HRESULT hr = E_FAIL;
+
+    if (!(layout->recompute & (RECOMPUTE_CLUSTERS | RECOMPUTE_CLUSTERS_RANGE)))
         return S_OK;
 
     /* nominal breakpoints are evaluated only once, because string never changes */
@@ -1082,12 +1293,19 @@ static HRESULT layout_compute(struct dwrite_textlayout *layout)
             0, layout->len, (IDWriteTextAnalysisSink*)&layout->IDWriteTextAnalysisSink1_iface);
         IDWriteTextAnalyzer_Release(analyzer);
     }
-    if (layout->actual_breakpoints) {
-        heap_free(layout->actual_breakpoints);
-        layout->actual_breakpoints = NULL;
-    }
 
-    hr = layout_compute_runs(layout);
+    if (!(layout->recompute & RECOMPUTE_CLUSTERS))
+        hr = layout_update_runs(layout);
+
+    if (FAILED(hr)) {
+        if (layout->actual_breakpoints) {
+            heap_free(layout->actual_breakpoints);
+            layout->actual_breakpoints = NULL;
+        }
+
+        hr = layout_compute_runs(layout);
+        layout->recompute |= RECOMPUTE_LINES;
+    }
 
     if (TRACE_ON(dwrite)) {
         struct layout_run *cur;
@@ -1101,7 +1319,9 @@ static HRESULT layout_compute(struct dwrite_textlayout *layout)
         }
     }
 
-    layout->recompute &= ~RECOMPUTE_CLUSTERS;
+    layout->recompute &= ~(RECOMPUTE_CLUSTERS | RECOMPUTE_CLUSTERS_RANGE);
+    layout->dirty_start = ~0u;
+    layout->dirty_end = 0;
     return hr;
 }
 
@@ -1362,6 +1582,13 @@ static HRESULT layout_set_line_metrics(struct dwrite_textlayout *layout, DWRITE_
 
     layout->lines[i].height = metrics->height;
     layout->lines[i].baseline = metrics->baseline;
+    layout->lines[i].width = 0.0f;
+    layout->lines[i].width_trailing = 0.0f;
+    /* set for regular lines once they are built, dummy line is always rebuilt */
+    layout->lines[i].next_cluster = 0;
+    layout->lines[i].next_textpos = 0;
+    layout->lines[i].breakpoint = ~0u;
+    layout->lines[i].examined = ~0u;
 
     layout->metrics.lineCount++;
     return S_OK;
@@ -1905,6 +2132,10 @@ static void layout_add_line(struct dwrite_textlayout *layout, UINT32 first_clust
     metrics.height = descent + metrics.baseline;
     metrics.isTrimmed = append_trimming_run || width > layout->metrics.layoutWidth;
     layout_set_line_metrics(layout, &metrics);
+    if (line < layout->metrics.lineCount) {
+        layout->lines[line].width = width;
+        layout->lines[line].width_trailing = width + trailingspacewidth;
+    }
 
     *textpos += metrics.length;
 }
@@ -1957,31 +2188,54 @@ static HRESULT layout_compute_effective_runs(struct dwrite_textlayout *layout)
 {
     BOOL is_rtl = layout->format.readingdir == DWRITE_READING_DIRECTION_RIGHT_TO_LEFT;
     struct layout_effective_run *erun, *first_underlined;
-    UINT32 i, start, textpos, last_breaking_point;
+    UINT32 i, j, start, textpos, last_breaking_point, examined;
     DWRITE_LINE_METRICS1 metrics;
     FLOAT width;
     UINT32 line;
     HRESULT hr;
 
-    if (!(layout->recompute & RECOMPUTE_LINES))
+    if (!(layout->recompute & (RECOMPUTE_LINES | RECOMPUTE_LINES_RANGE)))
         return S_OK;
 
-    free_layout_eruns(layout);
+    if (layout->recompute & RECOMPUTE_LINES)
+        free_layout_eruns(layout);
+    else
+        /* trailing dummy line is always rebuilt */
+        layout_truncate_lines(layout, layout->len);
 
     hr = layout_compute(layout);
     if (FAILED(hr))
         return hr;
 
-    layout->metrics.lineCount = 0;
+    if (layout->recompute & RECOMPUTE_LINES)
+        layout->metrics.lineCount = 0;
     memset(&metrics, 0, sizeof(metrics));
 
     layout->metrics.height = 0.0f;
     layout->metrics.width = 0.0f;
     layout->metrics.widthIncludingTrailingWhitespace = 0.0f;
 
-    last_breaking_point = ~0u;
+    /* Lines that were kept are not affected by changes, resume right after them. */
+    for (line = 0; line < layout->metrics.lineCount; line++) {
+        layout->metrics.width = max(layout->lines[line].width, layout->metrics.width);
+        layout->metrics.widthIncludingTrailingWhitespace = max(layout->lines[line].width_trailing,
+            layout->metrics.widthIncludingTrailingWhitespace);
+    }
+
+    if (layout->metrics.lineCount) {
+        const struct layout_line *last = &layout->lines[layout->metrics.lineCount - 1];
 
-    for (i = 0, start = 0, width = 0.0f, textpos = 0; i < layout->cluster_count; i++) {
+        start = last->next_cluster;
+        textpos = last->next_textpos;
+        last_breaking_point = last->breakpoint;
+    }
+    else {
+        start = 0;
+        textpos = 0;
+        last_breaking_point = ~0u;
+    }
+
+    for (i = start, width = 0.0f; i < layout->cluster_count; i++) {
         BOOL overflow = FALSE;
 
         while (i < layout->cluster_count && !layout->clustermetrics[i].isNewline) {
@@ -1997,6 +2251,7 @@ static HRESULT layout_compute_effective_runs(struct dwrite_textlayout *layout)
             i++;
         }
         i = min(i, layout->cluster_count - 1);
+        examined = i;
 
         /* Ignore if overflown on whitespace */
         if (overflow && !(layout->clustermetrics[i].isWhitespace && layout_can_wrap_after(layout, i))) {
@@ -2013,8 +2268,19 @@ static HRESULT layout_compute_effective_runs(struct dwrite_textlayout *layout)
             }
         }
         i = min(i, layout->cluster_count - 1);
+        examined = max(examined, i);
 
+        line = layout->metrics.lineCount;
         layout_add_line(layout, start, i, &textpos);
+        if (line < layout->metrics.lineCount) {
+            struct layout_line *l = &layout->lines[line];
+
+            l->next_cluster = i + 1;
+            l->next_textpos = textpos;
+            l->breakpoint = last_breaking_point;
+            for (j = i + 1, l->examined = textpos; j <= examined; j++)
+                l->examined += layout->clustermetrics[j].length;
+        }
         start = i + 1;
         width = 0.0f;
     }
@@ -2057,7 +2323,7 @@ static HRESULT layout_compute_effective_runs(struct dwrite_textlayout *layout)
     if (layout->format.textalignment != DWRITE_TEXT_ALIGNMENT_LEADING)
         layout_apply_text_alignment(layout);
 
-    layout->recompute &= ~RECOMPUTE_LINES;
+    layout->recompute &= ~(RECOMPUTE_LINES | RECOMPUTE_LINES_RANGE);
     return hr;
 }
 
@@ -2513,6 +2779,37 @@ static inline HRESULT return_range(const struct layout_range_header *h, DWRITE_T
     return S_OK;
 }
 
+/* Marks text range as changed. Decorations and drawing effects only split effective runs,
+   other attributes require reshaping. */
+static void layout_invalidate_range(struct dwrite_textlayout *layout, enum layout_range_attr_kind attr,
+    const DWRITE_TEXT_RANGE *range)
+{
+    UINT32 start, end;
+
+    switch (attr)
+    {
+    case LAYOUT_RANGE_ATTR_INLINE:
+        layout->recompute = RECOMPUTE_EVERYTHING;
+        break;
+    case LAYOUT_RANGE_ATTR_EFFECT:
+    case LAYOUT_RANGE_ATTR_UNDERLINE:
+    case LAYOUT_RANGE_ATTR_STRIKETHROUGH:
+    case LAYOUT_RANGE_ATTR_SPACING:
+    case LAYOUT_RANGE_ATTR_TYPOGRAPHY:
+        layout_truncate_lines(layout, range->startPosition);
+        layout->recompute |= RECOMPUTE_LINES_RANGE | RECOMPUTE_OVERHANGS;
+        break;
+    default:
+        start = min(range->startPosition, layout->len);
+        end = range->length < layout->len - start ? start + range->length : layout->len;
+
+        layout->dirty_start = min(layout->dirty_start, start);
+        layout->dirty_end = max(layout->dirty_end, end);
+        layout->recompute |= RECOMPUTE_CLUSTERS_RANGE | RECOMPUTE_MINIMAL_WIDTH | RECOMPUTE_LINES_RANGE |
+            RECOMPUTE_OVERHANGS;
+    }
+}
+
 /* Sets attribute value for given range, does all needed splitting/merging of existing ranges. */
 static HRESULT set_layout_range_attr(struct dwrite_textlayout *layout, enum layout_range_attr_kind attr, struct layout_range_attr_value *value)
 {
@@ -2617,7 +2914,7 @@ static HRESULT set_layout_range_attr(struct dwrite_textlayout *layout, enum layo
         list_add_after(&outer->entry, &cur->entry);
         list_add_after(&cur->entry, &right->entry);
 
-        layout->recompute = RECOMPUTE_EVERYTHING;
+        layout_invalidate_range(layout, attr, &value->range);
         return S_OK;
     }
 
@@ -2657,7 +2954,7 @@ done:
     if (changed) {
         struct list *next, *i;
 
-        layout->recompute = RECOMPUTE_EVERYTHING;
+        layout_invalidate_range(layout, attr, &value->range);
         i = list_head(ranges);
         while ((next = list_next(ranges, i))) {
             struct layout_range_header *next_range = LIST_ENTRY(next, struct layout_range_header, entry);
@@ -4838,6 +5135,8 @@ static HRESULT init_textlayout(const struct textlayout_desc *desc, struct dwrite
     layout->ref = 1;
     layout->len = desc->length;
     layout->recompute = RECOMPUTE_EVERYTHING;
+    layout->dirty_start = ~0u;
+    layout->dirty_end = 0;
     layout->nominal_breakpoints = NULL;
     layout->actual_breakpoints = NULL;
     layout->cluster_count = 0;
@@ -2317,6 +2317,104 @@ static void test_system_fontcollection(void)
     ok(ref == 0, "factory not released, %u\n", ref);
 }
 
+static void test_system_fontcollection_rebuild(void)
+{
+    IDWriteFontCollection *collection, *collection2;
+    IDWriteFactory *factory, *factory2;
+    UINT32 count, i, j;
+    HRESULT hr;
+
+    /* Collections built by different isolated factories are expected to be identical,
+       regardless of how font information was gathered. Start without Wine's metadata cache,
+       so that the first collection is parsed from font files, and the second one is built
+       from the cache it leaves behind. */
+    RegDeleteKeyA(HKEY_CURRENT_USER, "Software\\Wine\\DirectWrite\\FontCache");
+
+    factory = create_factory();
+    factory2 = create_factory();
+
+    hr = IDWriteFactory_GetSystemFontCollection(factory, &collection, FALSE);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    hr = IDWriteFactory_GetSystemFontCollection(factory2, &collection2, FALSE);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    count = IDWriteFontCollection_GetFontFamilyCount(collection);
+    ok(count == IDWriteFontCollection_GetFontFamilyCount(collection2), "got %u, expected %u\n",
+        IDWriteFontCollection_GetFontFamilyCount(collection2), count);
+
+    for (i = 0; i < count; i++) {
+        WCHAR familynameW[256], familyname2W[256];
+        IDWriteFontFamily *family, *family2;
+        IDWriteLocalizedStrings *names;
+        UINT32 font_count;
+
+        hr = IDWriteFontCollection_GetFontFamily(collection, i, &family);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+
+        hr = IDWriteFontCollection_GetFontFamily(collection2, i, &family2);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+
+        hr = IDWriteFontFamily_GetFamilyNames(family, &names);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+        get_enus_string(names, familynameW, sizeof(familynameW)/sizeof(familynameW[0]));
+        IDWriteLocalizedStrings_Release(names);
+
+        hr = IDWriteFontFamily_GetFamilyNames(family2, &names);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+        get_enus_string(names, familyname2W, sizeof(familyname2W)/sizeof(familyname2W[0]));
+        IDWriteLocalizedStrings_Release(names);
+
+        ok(!lstrcmpW(familynameW, familyname2W), "%u: got family %s, expected %s\n", i,
+            wine_dbgstr_w(familyname2W), wine_dbgstr_w(familynameW));
+
+        font_count = IDWriteFontFamily_GetFontCount(family);
+        ok(font_count == IDWriteFontFamily_GetFontCount(family2), "%s: got %u fonts, expected %u\n",
+            wine_dbgstr_w(familynameW), IDWriteFontFamily_GetFontCount(family2), font_count);
+
+        for (j = 0; j < font_count; j++) {
+            DWRITE_FONT_METRICS metrics, metrics2;
+            IDWriteFont *font, *font2;
+
+            hr = IDWriteFontFamily_GetFont(family, j, &font);
+            ok(hr == S_OK, "got 0x%08x\n", hr);
+
+            hr = IDWriteFontFamily_GetFont(family2, j, &font2);
+            ok(hr == S_OK, "got 0x%08x\n", hr);
+            if (FAILED(hr)) {
+                IDWriteFont_Release(font);
+                break;
+            }
+
+            ok(IDWriteFont_GetWeight(font) == IDWriteFont_GetWeight(font2), "%s: %u: got weight %d, expected %d\n",
+                wine_dbgstr_w(familynameW), j, IDWriteFont_GetWeight(font2), IDWriteFont_GetWeight(font));
+            ok(IDWriteFont_GetStretch(font) == IDWriteFont_GetStretch(font2), "%s: %u: got stretch %d, expected %d\n",
+                wine_dbgstr_w(familynameW), j, IDWriteFont_GetStretch(font2), IDWriteFont_GetStretch(font));
+            ok(IDWriteFont_GetStyle(font) == IDWriteFont_GetStyle(font2), "%s: %u: got style %d, expected %d\n",
+                wine_dbgstr_w(familynameW), j, IDWriteFont_GetStyle(font2), IDWriteFont_GetStyle(font));
+            ok(IDWriteFont_GetSimulations(font) == IDWriteFont_GetSimulations(font2),
+                "%s: %u: got simulations %d, expected %d\n", wine_dbgstr_w(familynameW), j,
+                IDWriteFont_GetSimulations(font2), IDWriteFont_GetSimulations(font));
+
+            IDWriteFont_GetMetrics(font, &metrics);
+            IDWriteFont_GetMetrics(font2, &metrics2);
+            ok(!memcmp(&metrics, &metrics2, sizeof(metrics)), "%s: %u: metrics differ\n",
+                wine_dbgstr_w(familynameW), j);
+
+            IDWriteFont_Release(font);
+            IDWriteFont_Release(font2);
+        }
+
+        IDWriteFontFamily_Release(family);
+        IDWriteFontFamily_Release(family2);
+    }
+
+    IDWriteFontCollection_Release(collection);
+    IDWriteFontCollection_Release(collection2);
+    IDWriteFactory_Release(factory);
+    IDWriteFactory_Release(factory2);
+}
+
 static void get_logfont_from_font(IDWriteFont *font, LOGFONTW *logfont)
 {
     void *os2_context, *head_context;
@@ -7826,6 +7924,7 @@ START_TEST(font)
     test_CreateFontFace();
     test_GetMetrics();
     test_system_fontcollection();
+    test_system_fontcollection_rebuild();
     test_ConvertFontFaceToLOGFONT();
     test_CustomFontCollection();
     test_CreateCustomFontFileReference();
@@ -5255,6 +5255,96 @@ static void test_line_spacing(void)
     IDWriteFactory_Release(factory);
 }
 
+static void set_layout_edits(IDWriteTextLayout *layout)
+{
+    DWRITE_TEXT_RANGE r;
+    HRESULT hr;
+
+    r.startPosition = 13;
+    r.length = 3;
+    hr = IDWriteTextLayout_SetFontSize(layout, 20.0f, r);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    r.startPosition = 0;
+    r.length = 3;
+    hr = IDWriteTextLayout_SetFontWeight(layout, DWRITE_FONT_WEIGHT_BOLD, r);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    r.startPosition = 20;
+    r.length = 5;
+    hr = IDWriteTextLayout_SetUnderline(layout, TRUE, r);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+}
+
+static void test_layout_edits(void)
+{
+    static const WCHAR strW[] = {'a','b','c',' ','d','e','f',' ','g','h','i','\r','\n',
+        'j','k','l',' ','m','n','o',' ','p','q','r','\r','\n','s','t','u',' ','v','w','x',0};
+    DWRITE_CLUSTER_METRICS clusters[64], clusters2[64];
+    DWRITE_LINE_METRICS lines[16], lines2[16];
+    DWRITE_TEXT_METRICS metrics, metrics2;
+    IDWriteTextLayout *layout, *layout2;
+    UINT32 count, count2, i;
+    IDWriteTextFormat *format;
+    IDWriteFactory *factory;
+    HRESULT hr;
+
+    factory = create_factory();
+
+    hr = IDWriteFactory_CreateTextFormat(factory, tahomaW, NULL, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL,
+        DWRITE_FONT_STRETCH_NORMAL, 10.0f, enusW, &format);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    /* layout is computed first, then changed */
+    hr = IDWriteFactory_CreateTextLayout(factory, strW, lstrlenW(strW), format, 40.0f, 1000.0f, &layout);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    hr = IDWriteTextLayout_GetLineMetrics(layout, lines, sizeof(lines)/sizeof(lines[0]), &count);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    set_layout_edits(layout);
+
+    /* same changes applied before layout is computed */
+    hr = IDWriteFactory_CreateTextLayout(factory, strW, lstrlenW(strW), format, 40.0f, 1000.0f, &layout2);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    set_layout_edits(layout2);
+
+    hr = IDWriteTextLayout_GetClusterMetrics(layout, clusters, sizeof(clusters)/sizeof(clusters[0]), &count);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    hr = IDWriteTextLayout_GetClusterMetrics(layout2, clusters2, sizeof(clusters2)/sizeof(clusters2[0]), &count2);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    ok(count == count2, "got %u, expected %u\n", count, count2);
+    for (i = 0; i < min(count, count2); i++) {
+        ok(clusters[i].width == clusters2[i].width && clusters[i].length == clusters2[i].length,
+            "%u: got width %.2f, length %u, expected %.2f, %u\n", i, clusters[i].width, clusters[i].length,
+            clusters2[i].width, clusters2[i].length);
+    }
+
+    hr = IDWriteTextLayout_GetLineMetrics(layout, lines, sizeof(lines)/sizeof(lines[0]), &count);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    hr = IDWriteTextLayout_GetLineMetrics(layout2, lines2, sizeof(lines2)/sizeof(lines2[0]), &count2);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    ok(count > 3, "got %u lines\n", count);
+    ok(count == count2, "got %u, expected %u\n", count, count2);
+    for (i = 0; i < min(count, count2); i++) {
+        ok(!memcmp(&lines[i], &lines2[i], sizeof(lines[i])), "%u: got length %u, height %.2f, expected %u, %.2f\n",
+            i, lines[i].length, lines[i].height, lines2[i].length, lines2[i].height);
+    }
+
+    hr = IDWriteTextLayout_GetMetrics(layout, &metrics);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    hr = IDWriteTextLayout_GetMetrics(layout2, &metrics2);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    ok(!memcmp(&metrics, &metrics2, sizeof(metrics)), "got %.2fx%.2f, expected %.2fx%.2f\n",
+        metrics.width, metrics.height, metrics2.width, metrics2.height);
+
+    IDWriteTextLayout_Release(layout2);
+    IDWriteTextLayout_Release(layout);
+    IDWriteTextFormat_Release(format);
+    IDWriteFactory_Release(factory);
+}
+
 START_TEST(layout)
 {
     IDWriteFactory *factory;
@@ -5304,6 +5394,7 @@ START_TEST(layout)
     test_SetUnderline();
     test_InvalidateLayout();
     test_line_spacing();
+    test_layout_edits();
 
     IDWriteFactory_Release(factory);
 }
@@ -1084,6 +1084,76 @@ static ARGB resample_bitmap_pixel_premult(GDIPCONST GpRect *src_rect, LPBYTE bit
     }
 }
 
+static FORCEINLINE BOOL src_rect_contains(GDIPCONST GpRect *src_rect, INT x, INT y)
+{
+    return x >= src_rect->X && y >= src_rect->Y &&
+           x < src_rect->X + src_rect->Width && y < src_rect->Y + src_rect->Height;
+}
+
+/* Fast path for resample_bitmap_pixel{_premult}: when every sample lies in
+ * the locked area no wrapping is involved, so the pixels can be read directly.
+ * Returns FALSE if the caller has to use the generic path. */
+static FORCEINLINE BOOL resample_bitmap_pixel_fast(GDIPCONST GpRect *src_rect, LPBYTE bits,
+    GpPointF *point, InterpolationMode interpolation, REAL pixel_offset, BOOL premult, ARGB *color)
+{
+    const ARGB *src = (const ARGB *)bits;
+
+    if (interpolation == InterpolationModeNearestNeighbor)
+    {
+        INT x = floorf(point->X + pixel_offset), y = floorf(point->Y + pixel_offset);
+
+        if (!src_rect_contains(src_rect, x, y)) return FALSE;
+
+        *color = src[(x - src_rect->X) + (y - src_rect->Y) * src_rect->Width];
+        return TRUE;
+    }
+    else if (interpolation == InterpolationModeBilinear)
+    {
+        INT leftx, rightx, topy, bottomy;
+        ARGB topleft, topright, bottomleft, bottomright;
+        ARGB top, bottom;
+        const ARGB *row;
+
+        leftx = (INT)point->X;
+        rightx = positive_ceilf(point->X);
+        topy = (INT)point->Y;
+        bottomy = positive_ceilf(point->Y);
+
+        if (!src_rect_contains(src_rect, leftx, topy) || !src_rect_contains(src_rect, rightx, bottomy))
+            return FALSE;
+
+        row = src + (topy - src_rect->Y) * src_rect->Width - src_rect->X;
+        topleft = row[leftx];
+
+        if (leftx == rightx && topy == bottomy)
+        {
+            *color = topleft;
+            return TRUE;
+        }
+
+        topright = row[rightx];
+        row += (bottomy - topy) * src_rect->Width;
+        bottomleft = row[leftx];
+        bottomright = row[rightx];
+
+        if (premult)
+        {
+            top = blend_colors_premult(topleft, topright, point->X - (REAL)leftx);
+            bottom = blend_colors_premult(bottomleft, bottomright, point->X - (REAL)leftx);
+            *color = blend_colors_premult(top, bottom, point->Y - (REAL)topy);
+        }
+        else
+        {
+            top = blend_colors(topleft, topright, point->X - (REAL)leftx);
+            bottom = blend_colors(bottomleft, bottomright, point->X - (REAL)leftx);
+            *color = blend_colors(top, bottom, point->Y - (REAL)topy);
+        }
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 static REAL intersect_line_scanline(const GpPointF *p1, const GpPointF *p2, REAL y)
 {
     return (p1->X - p2->X) * (p2->Y - y) / (p2->Y - p1->Y) + p2->X;
@@ -3095,8 +3165,38 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
 
             if (do_resampling)
             {
-                get_bitmap_sample_size(interpolation, imageAttributes->wrap,
-                    bitmap, srcx, srcy, srcwidth, srcheight, &src_area);
+                GpPointF corners[4];
+                REAL left, top, right, bottom;
+
+                /* Only convert the part of the source the visible destination
+                 * area maps to, plus a pixel of margin for the filter. */
+                corners[0].X = corners[2].X = dst_area.left;
+                corners[1].X = corners[3].X = dst_area.right;
+                corners[0].Y = corners[1].Y = dst_area.top;
+                corners[2].Y = corners[3].Y = dst_area.bottom;
+                GdipTransformMatrixPoints(&dst_to_src, corners, 4);
+
+                left = right = corners[0].X;
+                top = bottom = corners[0].Y;
+                for (i=1; i<4; i++)
+                {
+                    if (left > corners[i].X) left = corners[i].X;
+                    if (right < corners[i].X) right = corners[i].X;
+                    if (top > corners[i].Y) top = corners[i].Y;
+                    if (bottom < corners[i].Y) bottom = corners[i].Y;
+                }
+
+                left = max(srcx, floorf(left) - 1.0f);
+                top = max(srcy, floorf(top) - 1.0f);
+                right = min(srcx + srcwidth, ceilf(right) + 1.0f);
+                bottom = min(srcy + srcheight, ceilf(bottom) + 1.0f);
+
+                if (left < right && top < bottom)
+                    get_bitmap_sample_size(interpolation, imageAttributes->wrap,
+                        bitmap, left, top, right - left, bottom - top, &src_area);
+                else
+                    get_bitmap_sample_size(interpolation, imageAttributes->wrap,
+                        bitmap, srcx, srcy, srcwidth, srcheight, &src_area);
             }
             else
             {
@@ -3144,7 +3244,8 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
 
             if (do_resampling)
             {
-                REAL delta_xx, delta_xy, delta_yx, delta_yy;
+                BOOL premult = lockeddata.PixelFormat == PixelFormat32bppPARGB;
+                REAL pixel_offset;
 
                 /* Transform the bits as needed to the destination. */
                 dst_data = dst_dyn_data = heap_alloc_zero(sizeof(ARGB) * (dst_area.right - dst_area.left) * (dst_area.bottom - dst_area.top));
@@ -3163,42 +3264,42 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
                 y_dx = dst_to_src_points[2].X - dst_to_src_points[0].X;
                 y_dy = dst_to_src_points[2].Y - dst_to_src_points[0].Y;
 
-                delta_yy = dst_area.top * y_dy;
-                delta_yx = dst_area.top * y_dx;
+                if (offset_mode == PixelOffsetModeHalf || offset_mode == PixelOffsetModeHighQuality)
+                    pixel_offset = 0.0;
+                else
+                    pixel_offset = 0.5;
 
+                /* Map the start of each scanline once, then step along it. */
                 for (y=dst_area.top; y<dst_area.bottom; y++)
                 {
-                    delta_xx = dst_area.left * x_dx;
-                    delta_xy = dst_area.left * x_dy;
+                    ARGB *dst_color = (ARGB*)(dst_data + dst_stride * (y - dst_area.top));
+                    GpPointF row;
+
+                    row.X = dst_to_src_points[0].X + dst_area.left * x_dx + y * y_dx;
+                    row.Y = dst_to_src_points[0].Y + dst_area.left * x_dy + y * y_dy;
 
-                    for (x=dst_area.left; x<dst_area.right; x++)
+                    for (x=dst_area.left; x<dst_area.right; x++, dst_color++)
                     {
                         GpPointF src_pointf;
-                        ARGB *dst_color;
 
-                        src_pointf.X = dst_to_src_points[0].X + delta_xx + delta_yx;
-                        src_pointf.Y = dst_to_src_points[0].Y + delta_xy + delta_yy;
+                        src_pointf.X = row.X + (x - dst_area.left) * x_dx;
+                        src_pointf.Y = row.Y + (x - dst_area.left) * x_dy;
 
-                        dst_color = (ARGB*)(dst_data + dst_stride * (y - dst_area.top) + sizeof(ARGB) * (x - dst_area.left));
+                        if (src_pointf.X < srcx || src_pointf.X >= srcx + srcwidth ||
+                            src_pointf.Y < srcy || src_pointf.Y >= srcy + srcheight)
+                            continue;
 
-                        if (src_pointf.X >= srcx && src_pointf.X < srcx + srcwidth && src_pointf.Y >= srcy && src_pointf.Y < srcy+srcheight)
-                        {
-                            if (lockeddata.PixelFormat != PixelFormat32bppPARGB)
-                                *dst_color = resample_bitmap_pixel(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
-                                                                   imageAttributes, interpolation, offset_mode);
-                            else
-                                *dst_color = resample_bitmap_pixel_premult(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
-                                                                           imageAttributes, interpolation, offset_mode);
-                        }
-                        else
-                            *dst_color = 0;
+                        if (resample_bitmap_pixel_fast(&src_area, src_data, &src_pointf,
+                                interpolation, pixel_offset, premult, dst_color))
+                            continue;
 
-                        delta_xx += x_dx;
-                        delta_yx += y_dx;
+                        if (!premult)
+                            *dst_color = resample_bitmap_pixel(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
+                                                               imageAttributes, interpolation, offset_mode);
+                        else
+                            *dst_color = resample_bitmap_pixel_premult(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
+                                                                       imageAttributes, interpolation, offset_mode);
                     }
-
-                    delta_xy += x_dy;
-                    delta_yy += y_dy;
                 }
             }
             else
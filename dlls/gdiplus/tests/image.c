@@ -4340,6 +4340,65 @@ static void test_DrawImage_scale(void)
     expect(Ok, status);
 }
 
+static void test_DrawImage_rotate(void)
+{
+    static const ARGB src_colors[2][2] = {{ 0xffff0000, 0xff00ff00 }, { 0xff0000ff, 0xffffff00 }};
+    GpBitmap *src, *dst;
+    GpGraphics *graphics;
+    GpMatrix *matrix;
+    GpStatus status;
+    ARGB color;
+    int x, y;
+
+    status = GdipCreateBitmapFromScan0(2, 2, 0, PixelFormat32bppARGB, NULL, &src);
+    expect(Ok, status);
+    status = GdipBitmapSetResolution(src, 100.0, 100.0);
+    expect(Ok, status);
+    for (y = 0; y < 2; y++)
+        for (x = 0; x < 2; x++)
+        {
+            status = GdipBitmapSetPixel(src, x, y, src_colors[y][x]);
+            expect(Ok, status);
+        }
+
+    status = GdipCreateBitmapFromScan0(8, 8, 0, PixelFormat32bppARGB, NULL, &dst);
+    expect(Ok, status);
+    status = GdipBitmapSetResolution(dst, 100.0, 100.0);
+    expect(Ok, status);
+    status = GdipGetImageGraphicsContext((GpImage *)dst, &graphics);
+    expect(Ok, status);
+    status = GdipSetInterpolationMode(graphics, InterpolationModeNearestNeighbor);
+    expect(Ok, status);
+    status = GdipSetPixelOffsetMode(graphics, PixelOffsetModeHalf);
+    expect(Ok, status);
+
+    /* scale by 4 and rotate by 90 degrees: (x, y) -> (8 - 4y, 4x) */
+    status = GdipCreateMatrix2(0.0, 4.0, -4.0, 0.0, 8.0, 0.0, &matrix);
+    expect(Ok, status);
+    status = GdipSetWorldTransform(graphics, matrix);
+    expect(Ok, status);
+    GdipDeleteMatrix(matrix);
+
+    status = GdipDrawImageI(graphics, (GpImage *)src, 0, 0);
+    expect(Ok, status);
+
+    /* check a pixel away from the edges of each 4x4 block */
+    for (y = 0; y < 2; y++)
+        for (x = 0; x < 2; x++)
+        {
+            status = GdipBitmapGetPixel(dst, 4 * (1 - y) + 1, 4 * x + 1, &color);
+            expect(Ok, status);
+            ok(color == src_colors[y][x], "%d,%d: expected %08x, got %08x\n", x, y, src_colors[y][x], color);
+        }
+
+    status = GdipDeleteGraphics(graphics);
+    expect(Ok, status);
+    status = GdipDisposeImage((GpImage *)src);
+    expect(Ok, status);
+    status = GdipDisposeImage((GpImage *)dst);
+    expect(Ok, status);
+}
+
 static const BYTE animatedgif[] = {
 'G','I','F','8','9','a',0x01,0x00,0x01,0x00,0xA1,0x02,0x00,
 0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,
@@ -5382,6 +5441,7 @@ START_TEST(image)
     test_CloneBitmapArea();
     test_ARGB_conversion();
     test_DrawImage_scale();
+    test_DrawImage_rotate();
     test_image_format();
     test_DrawImage();
     test_DrawImage_SourceCopy();
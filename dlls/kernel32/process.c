@@ -1905,6 +1905,19 @@ static int get_process_cpu( const WCHAR *filename, const struct binary_info *bin
     return -1;
 }
 
+/* Forking new processes from a per-prefix template instead of exec'ing the
+ * loader is experimental, so it has to be enabled explicitly. */
+static inline BOOL experimental_PROCESS_TEMPLATE( void )
+{
+    static int enabled = -1;
+    if (enabled == -1)
+    {
+        const char *str = getenv( "STAGING_PROCESS_TEMPLATE" );
+        enabled = str && (atoi(str) != 0);
+    }
+    return enabled;
+}
+
 /***********************************************************************
  *           exec_loader
  */
@@ -1916,12 +1929,16 @@ static pid_t exec_loader( LPCWSTR cmd_line, unsigned int flags, int socketfd,
     char *wineloader = NULL;
     const char *loader = NULL;
     char **argv;
+    BOOL use_template;
 
     argv = build_argv( cmd_line, 1 );
 
     if (!is_win64 ^ !(binary_info->flags & BINARY_FLAG_64BIT))
         loader = get_alternate_loader( &wineloader );
 
+    /* the template can only start processes of our own architecture, as a child */
+    use_template = !loader && !exec_only && experimental_PROCESS_TEMPLATE();
+
     if (exec_only || !(pid = fork()))  /* child */
     {
         if (exec_only || !(pid = fork()))  /* grandchild */
@@ -1964,6 +1981,7 @@ static pid_t exec_loader( LPCWSTR cmd_line, unsigned int flags, int socketfd,
 
             if (argv)
             {
+                if (use_template) wine_exec_process_template( argv );
                 do
                 {
                     wine_exec_wine_binary( loader, argv, getenv("WINELOADER") );
@@ -1887,6 +1887,92 @@ static void test_typelib_section(void)
     pReleaseActCtx(handle);
 }
 
+static void test_many_entries_section(void)
+{
+    static const char header[] =
+        "<assembly xmlns=\"urn:schemas-microsoft-com:asm.v1\" manifestVersion=\"1.0\">"
+        "<assemblyIdentity version=\"1.2.3.4\" name=\"Wine.Test\" type=\"win32\" />"
+        "<file name=\"testlib.dll\">";
+    static const char footer[] = "</file></assembly>";
+    static const GUID clsid_base = {0, 0x1234, 0x5678, {0x12,0x34,0x11,0x11,0x22,0x22,0x33,0x33}};
+    struct comclassredirect_data *comclass;
+    struct wndclass_redirect_data *classdata;
+    ACTCTX_SECTION_KEYED_DATA data;
+    char *manifest, *ptr, name[32];
+    ULONG_PTR cookie;
+    HANDLE handle;
+    WCHAR nameW[32], *ptrW;
+    GUID clsid;
+    BOOL ret;
+    int i, count = 300;
+
+    /* enough entries for lookups to go through more than a handful of hash values */
+    manifest = HeapAlloc(GetProcessHeap(), 0, sizeof(header) + sizeof(footer) + count * 160);
+    ptr = manifest + sprintf(manifest, "%s", header);
+    for (i = 0; i < count; i++)
+    {
+        ptr += sprintf(ptr, "<windowClass versioned=\"no\">manyClass%d</windowClass>", i);
+        ptr += sprintf(ptr, "<comClass clsid=\"{%08x-1234-5678-1234-111122223333}\" threadingModel=\"Neutral\" />",
+                       0x1000 * (count - i));
+    }
+    strcpy(ptr, footer);
+
+    create_manifest_file("many.manifest", manifest, -1, NULL, NULL);
+    HeapFree(GetProcessHeap(), 0, manifest);
+    handle = test_create("many.manifest");
+    ok(handle != INVALID_HANDLE_VALUE, "handle == INVALID_HANDLE_VALUE, error %u\n", GetLastError());
+    DeleteFileA("many.manifest");
+    if (handle == INVALID_HANDLE_VALUE) return;
+
+    ret = pActivateActCtx(handle, &cookie);
+    ok(ret, "ActivateActCtx failed: %u\n", GetLastError());
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "MANYCLASS%d", i);
+        MultiByteToWideChar(CP_ACP, 0, name, -1, nameW, sizeof(nameW)/sizeof(WCHAR));
+        memset(&data, 0, sizeof(data));
+        data.cbSize = sizeof(data);
+        ret = pFindActCtxSectionStringW(0, NULL, ACTIVATION_CONTEXT_SECTION_WINDOW_CLASS_REDIRECTION,
+                                        nameW, &data);
+        ok(ret, "%s: got %d\n", name, ret);
+        if (ret)
+        {
+            classdata = (struct wndclass_redirect_data*)data.lpData;
+            ptrW = (WCHAR*)((BYTE*)data.lpData + classdata->name_offset);
+            ok(!lstrcmpiW(ptrW, nameW), "%s: got %s\n", name, wine_dbgstr_w(ptrW));
+        }
+
+        clsid = clsid_base;
+        clsid.Data1 = 0x1000 * (count - i);
+        sprintf(name, "%s", wine_dbgstr_guid(&clsid));
+        memset(&data, 0, sizeof(data));
+        data.cbSize = sizeof(data);
+        ret = pFindActCtxSectionGuid(0, NULL, ACTIVATION_CONTEXT_SECTION_COM_SERVER_REDIRECTION,
+                                     &clsid, &data);
+        ok(ret, "%s: got %d\n", name, ret);
+        if (ret)
+        {
+            comclass = (struct comclassredirect_data*)data.lpData;
+            ok(IsEqualGUID(&comclass->clsid, &clsid), "%s: got clsid %s\n", name,
+               wine_dbgstr_guid(&comclass->clsid));
+        }
+    }
+
+    memset(&data, 0, sizeof(data));
+    data.cbSize = sizeof(data);
+    clsid = clsid_base;
+    clsid.Data1 = 0x1001;
+    ret = pFindActCtxSectionGuid(0, NULL, ACTIVATION_CONTEXT_SECTION_COM_SERVER_REDIRECTION,
+                                 &clsid, &data);
+    ok(!ret, "got %d\n", ret);
+
+    ret = pDeactivateActCtx(0, cookie);
+    ok(ret, "DeactivateActCtx failed: %u\n", GetLastError());
+
+    pReleaseActCtx(handle);
+}
+
 static void test_allowDelayedBinding(void)
 {
     HANDLE handle;
@@ -2240,6 +2326,7 @@ static void test_actctx(void)
     test_wndclass_section();
     test_dllredirect_section();
     test_typelib_section();
+    test_many_entries_section();
     test_allowDelayedBinding();
 }
 
@@ -38,6 +38,7 @@ static BOOL (WINAPI *pProcess32First)(HANDLE, LPPROCESSENTRY32);
 static BOOL (WINAPI *pProcess32Next)(HANDLE, LPPROCESSENTRY32);
 static BOOL (WINAPI *pThread32First)(HANDLE, LPTHREADENTRY32);
 static BOOL (WINAPI *pThread32Next)(HANDLE, LPTHREADENTRY32);
+static BOOL (WINAPI *pK32EnumProcessModules)(HANDLE, HMODULE *, DWORD, DWORD *);
 
 /* 1 minute should be more than enough */
 #define WAIT_TIME       (60 * 1000)
@@ -281,6 +282,43 @@ static void test_module(DWORD pid, const char* expected[], unsigned num_expected
     ok(!pModule32First( hSnapshot, &me ), "shouldn't return a module\n");
 }
 
+static void test_module_order(void)
+{
+    HANDLE              hSnapshot;
+    MODULEENTRY32       me;
+    HMODULE             modules[256];
+    DWORD               needed, count, i = 0;
+
+    if (!pK32EnumProcessModules)
+    {
+        win_skip("K32EnumProcessModules is not available\n");
+        return;
+    }
+
+    ok(pK32EnumProcessModules( GetCurrentProcess(), modules, sizeof(modules), &needed ),
+       "EnumProcessModules failed with %u\n", GetLastError());
+    count = min( needed, sizeof(modules) ) / sizeof(HMODULE);
+    ok(count > 0, "no modules enumerated\n");
+
+    hSnapshot = pCreateToolhelp32Snapshot( TH32CS_SNAPMODULE, GetCurrentProcessId() );
+    ok(hSnapshot != NULL, "Cannot create snapshot\n");
+
+    me.dwSize = sizeof(me);
+    ok(pModule32First( hSnapshot, &me ), "Module32First failed\n");
+    ok(me.hModule == GetModuleHandleA( NULL ), "first module is %s (%p), expected the exe\n",
+       me.szModule, me.hModule);
+    do
+    {
+        if (i < count)
+            ok(me.hModule == modules[i], "module %u: got %s (%p), expected %p\n",
+               i, me.szModule, me.hModule, modules[i]);
+        i++;
+    } while (pModule32Next( hSnapshot, &me ));
+    ok(i == count, "got %u toolhelp modules, expected %u\n", i, count);
+
+    CloseHandle(hSnapshot);
+}
+
 START_TEST(toolhelp)
 {
     DWORD               pid = GetCurrentProcessId();
@@ -301,6 +339,7 @@ START_TEST(toolhelp)
     pProcess32Next = (VOID *) GetProcAddress(hkernel32, "Process32Next");
     pThread32First = (VOID *) GetProcAddress(hkernel32, "Thread32First");
     pThread32Next = (VOID *) GetProcAddress(hkernel32, "Thread32Next");
+    pK32EnumProcessModules = (VOID *) GetProcAddress(hkernel32, "K32EnumProcessModules");
 
     if (!pCreateToolhelp32Snapshot || 
         !pModule32First || !pModule32Next ||
@@ -343,6 +382,7 @@ START_TEST(toolhelp)
     test_thread(pid, info.dwProcessId);
     test_module(pid, curr_expected_modules, NUM_OF(curr_expected_modules));
     test_module(info.dwProcessId, sub_expected_modules, NUM_OF(sub_expected_modules));
+    test_module_order();
 
     SetEvent(ev2);
     winetest_wait_child_process( info.hProcess );
@@ -27,6 +27,7 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -36,6 +37,7 @@
 #include "ntdll_misc.h"
 #include "wine/exception.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "wine/unicode.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(actctx);
@@ -673,6 +675,31 @@ static const WCHAR wildcardW[] = {'*',0};
 static ACTIVATION_CONTEXT system_actctx = { ACTCTX_MAGIC, 1 };
 static ACTIVATION_CONTEXT *process_actctx = &system_actctx;
 
+/* winsxs lookups and parsed shared manifests are cached in the registry, under
+ * HKLM\Software\Wine\SxsCache, so that all the processes of the prefix can use them.
+ * Lookups are stored under the requested identity and are valid as long as the
+ * manifests directory doesn't change; manifests are stored under their file name
+ * and are valid as long as the file keeps the same last write time and size. */
+#define WINSXS_CACHE_VERSION     1
+#define WINSXS_MAX_MANIFEST_SIZE (256 * 1024)
+
+struct winsxs_cache_header
+{
+    LARGE_INTEGER mtime;     /* last write time of the manifests directory or the manifest file */
+    LARGE_INTEGER size;      /* size of the manifest file */
+    DWORD         version;
+    DWORD         reserved;
+};
+
+struct winsxs_buffer
+{
+    BYTE         *data;
+    DWORD         size;
+    DWORD         alloc;
+    DWORD         pos;
+    BOOL          failed;
+};
+
 static WCHAR *strdupW(const WCHAR* str)
 {
     WCHAR*      ptr;
@@ -2817,7 +2844,8 @@ static NTSTATUS get_manifest_in_associated_manifest( struct actctx_loader* acl,
     return status;
 }
 
-static WCHAR *lookup_manifest_file( HANDLE dir, struct assembly_identity *ai )
+/* search the winsxs manifests directory for the best match of an assembly */
+static WCHAR *find_manifest_file( HANDLE dir, struct assembly_identity *ai )
 {
     static const WCHAR lookup_fmtW[] =
         {'%','s','_','%','s','_','%','s','_','%','u','.','%','u','.','*','.','*','_',
@@ -2902,6 +2930,596 @@ static WCHAR *lookup_manifest_file( HANDLE dir, struct assembly_identity *ai )
     return ret;
 }
 
+static HANDLE open_winsxs_cache_key(void)
+{
+    static const WCHAR keyW[] = {'\\','R','e','g','i','s','t','r','y','\\','M','a','c','h','i','n','e','\\',
+                                 'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\',
+                                 'S','x','s','C','a','c','h','e',0};
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING nameW;
+    HANDLE key;
+
+    attr.Length = sizeof(attr);
+    attr.RootDirectory = 0;
+    attr.ObjectName = &nameW;
+    attr.Attributes = 0;
+    attr.SecurityDescriptor = NULL;
+    attr.SecurityQualityOfService = NULL;
+    RtlInitUnicodeString( &nameW, keyW );
+
+    /* @@ Wine registry key: HKLM\Software\Wine\SxsCache */
+    if (NtCreateKey( &key, KEY_QUERY_VALUE | KEY_SET_VALUE, &attr, 0, NULL, 0, NULL )) return 0;
+    return key;
+}
+
+static void winsxs_put_data( struct winsxs_buffer *buffer, const void *data, DWORD len )
+{
+    DWORD aligned = (len + 3) & ~3;  /* keep everything DWORD aligned */
+
+    if (buffer->failed) return;
+    if (buffer->alloc - buffer->size < aligned)
+    {
+        DWORD alloc = max( max( buffer->alloc * 2, buffer->size + aligned ), 1024 );
+        BYTE *ptr;
+
+        if (buffer->data) ptr = RtlReAllocateHeap( GetProcessHeap(), 0, buffer->data, alloc );
+        else ptr = RtlAllocateHeap( GetProcessHeap(), 0, alloc );
+        if (!ptr)
+        {
+            buffer->failed = TRUE;
+            return;
+        }
+        buffer->data = ptr;
+        buffer->alloc = alloc;
+    }
+    memcpy( buffer->data + buffer->size, data, len );
+    memset( buffer->data + buffer->size + len, 0, aligned - len );
+    buffer->size += aligned;
+}
+
+static void winsxs_put_dword( struct winsxs_buffer *buffer, DWORD value )
+{
+    winsxs_put_data( buffer, &value, sizeof(value) );
+}
+
+/* strings are stored with their length including the null terminator, 0 for a NULL string */
+static void winsxs_put_string( struct winsxs_buffer *buffer, const WCHAR *str )
+{
+    DWORD len = str ? strlenW( str ) + 1 : 0;
+
+    winsxs_put_dword( buffer, len );
+    if (len) winsxs_put_data( buffer, str, len * sizeof(WCHAR) );
+}
+
+static const void *winsxs_get_data( struct winsxs_buffer *buffer, DWORD len )
+{
+    DWORD aligned = (len + 3) & ~3;
+    const void *ret;
+
+    if (buffer->failed || aligned < len || buffer->size - buffer->pos < aligned)
+    {
+        buffer->failed = TRUE;
+        return NULL;
+    }
+    ret = buffer->data + buffer->pos;
+    buffer->pos += aligned;
+    return ret;
+}
+
+static DWORD winsxs_get_dword( struct winsxs_buffer *buffer )
+{
+    const DWORD *value = winsxs_get_data( buffer, sizeof(*value) );
+    return value ? *value : 0;
+}
+
+static WCHAR *winsxs_get_string( struct winsxs_buffer *buffer )
+{
+    DWORD len = winsxs_get_dword( buffer );
+    const WCHAR *str;
+    WCHAR *ret;
+
+    if (!len) return NULL;
+    if (len > buffer->size / sizeof(WCHAR) || !(str = winsxs_get_data( buffer, len * sizeof(WCHAR) )) ||
+        str[len - 1] || !(ret = RtlAllocateHeap( GetProcessHeap(), 0, len * sizeof(WCHAR) )))
+    {
+        buffer->failed = TRUE;
+        return NULL;
+    }
+    memcpy( ret, str, len * sizeof(WCHAR) );
+    return ret;
+}
+
+/* returns the value to free once the buffer has been read, or NULL if there's no valid entry */
+static KEY_VALUE_PARTIAL_INFORMATION *get_winsxs_cache_value( HANDLE key, const WCHAR *name,
+                                                              const LARGE_INTEGER *mtime,
+                                                              const LARGE_INTEGER *size,
+                                                              struct winsxs_buffer *buffer )
+{
+    const struct winsxs_cache_header *header;
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    UNICODE_STRING nameW;
+    DWORD count = 4096;
+    NTSTATUS status;
+
+    RtlInitUnicodeString( &nameW, name );
+    if (!(info = RtlAllocateHeap( GetProcessHeap(), 0, count ))) return NULL;
+    status = NtQueryValueKey( key, &nameW, KeyValuePartialInformation, info, count, &count );
+    if (status == STATUS_BUFFER_OVERFLOW)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, info );
+        if (!(info = RtlAllocateHeap( GetProcessHeap(), 0, count ))) return NULL;
+        status = NtQueryValueKey( key, &nameW, KeyValuePartialInformation, info, count, &count );
+    }
+    if (status || info->Type != REG_BINARY || info->DataLength < sizeof(*header))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, info );
+        return NULL;
+    }
+
+    header = (const struct winsxs_cache_header *)info->Data;
+    if (header->version != WINSXS_CACHE_VERSION || header->mtime.QuadPart != mtime->QuadPart ||
+        header->size.QuadPart != size->QuadPart)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, info );
+        return NULL;
+    }
+
+    buffer->data = info->Data;
+    buffer->size = info->DataLength;
+    buffer->alloc = 0;
+    buffer->pos = sizeof(*header);
+    buffer->failed = FALSE;
+    return info;
+}
+
+static void init_winsxs_cache_value( struct winsxs_buffer *buffer, const LARGE_INTEGER *mtime,
+                                     const LARGE_INTEGER *size )
+{
+    struct winsxs_cache_header header;
+
+    header.mtime = *mtime;
+    header.size = *size;
+    header.version = WINSXS_CACHE_VERSION;
+    header.reserved = 0;
+
+    memset( buffer, 0, sizeof(*buffer) );
+    winsxs_put_data( buffer, &header, sizeof(header) );
+}
+
+static void set_winsxs_cache_value( HANDLE key, const WCHAR *name, struct winsxs_buffer *buffer )
+{
+    UNICODE_STRING nameW;
+
+    RtlInitUnicodeString( &nameW, name );
+    if (!buffer->failed) NtSetValueKey( key, &nameW, 0, REG_BINARY, buffer->data, buffer->size );
+    RtlFreeHeap( GetProcessHeap(), 0, buffer->data );
+}
+
+/* same as find_manifest_file, with the results cached until the directory changes */
+static WCHAR *lookup_manifest_file( HANDLE dir, HANDLE key, struct assembly_identity *ai )
+{
+    static const WCHAR key_fmtW[] =
+        {'%','s','_','%','s','_','%','s','_','%','u','.','%','u','.','%','u','.','%','u','_','%','s',0};
+    static const LARGE_INTEGER zero;
+    KEY_VALUE_PARTIAL_INFORMATION *value;
+    const WCHAR *lang = ai->language;
+    struct winsxs_buffer buffer;
+    FILE_BASIC_INFORMATION info;
+    IO_STATUS_BLOCK io;
+    WCHAR *name, *ret;
+    DWORD build, revision;
+
+    if (!key || NtQueryInformationFile( dir, &io, &info, sizeof(info), FileBasicInformation ))
+        return find_manifest_file( dir, ai );
+
+    if (!lang || !strcmpiW( lang, neutralW )) lang = wildcardW;
+    if (!(name = RtlAllocateHeap( GetProcessHeap(), 0, (strlenW(ai->arch) + strlenW(ai->name)
+                                  + strlenW(ai->public_key) + strlenW(lang) + 48) * sizeof(WCHAR) )))
+        return NULL;
+    sprintfW( name, key_fmtW, ai->arch, ai->name, ai->public_key, ai->version.major,
+              ai->version.minor, ai->version.build, ai->version.revision, lang );
+
+    if ((value = get_winsxs_cache_value( key, name, &info.LastWriteTime, &zero, &buffer )))
+    {
+        build = winsxs_get_dword( &buffer );
+        revision = winsxs_get_dword( &buffer );
+        ret = winsxs_get_string( &buffer );
+        RtlFreeHeap( GetProcessHeap(), 0, value );
+        if (!buffer.failed)
+        {
+            TRACE( "using cached lookup of %s\n", debugstr_w(name) );
+            if (ret)
+            {
+                ai->version.build = build;
+                ai->version.revision = revision;
+            }
+            RtlFreeHeap( GetProcessHeap(), 0, name );
+            return ret;
+        }
+        RtlFreeHeap( GetProcessHeap(), 0, ret );
+    }
+
+    /* a miss is cached as well, with a NULL file name */
+    ret = find_manifest_file( dir, ai );
+    init_winsxs_cache_value( &buffer, &info.LastWriteTime, &zero );
+    winsxs_put_dword( &buffer, ai->version.build );
+    winsxs_put_dword( &buffer, ai->version.revision );
+    winsxs_put_string( &buffer, ret );
+    set_winsxs_cache_value( key, name, &buffer );
+
+    RtlFreeHeap( GetProcessHeap(), 0, name );
+    return ret;
+}
+
+static void write_assembly_identity( struct winsxs_buffer *buffer, const struct assembly_identity *ai )
+{
+    winsxs_put_string( buffer, ai->name );
+    winsxs_put_string( buffer, ai->arch );
+    winsxs_put_string( buffer, ai->public_key );
+    winsxs_put_string( buffer, ai->language );
+    winsxs_put_string( buffer, ai->type );
+    winsxs_put_dword( buffer, MAKELONG( ai->version.major, ai->version.minor ) );
+    winsxs_put_dword( buffer, MAKELONG( ai->version.build, ai->version.revision ) );
+    winsxs_put_dword( buffer, ai->optional );
+    winsxs_put_dword( buffer, ai->delayed );
+}
+
+static void read_assembly_identity( struct winsxs_buffer *buffer, struct assembly_identity *ai )
+{
+    DWORD version;
+
+    ai->name       = winsxs_get_string( buffer );
+    ai->arch       = winsxs_get_string( buffer );
+    ai->public_key = winsxs_get_string( buffer );
+    ai->language   = winsxs_get_string( buffer );
+    ai->type       = winsxs_get_string( buffer );
+    version = winsxs_get_dword( buffer );
+    ai->version.major    = LOWORD(version);
+    ai->version.minor    = HIWORD(version);
+    version = winsxs_get_dword( buffer );
+    ai->version.build    = LOWORD(version);
+    ai->version.revision = HIWORD(version);
+    ai->optional = winsxs_get_dword( buffer );
+    ai->delayed  = winsxs_get_dword( buffer );
+}
+
+static void write_entity_array( struct winsxs_buffer *buffer, const struct entity_array *array )
+{
+    unsigned int i, j;
+
+    winsxs_put_dword( buffer, array->num );
+    for (i = 0; i < array->num; i++)
+    {
+        const struct entity *entity = &array->base[i];
+
+        winsxs_put_dword( buffer, entity->kind );
+        switch (entity->kind)
+        {
+        case ACTIVATION_CONTEXT_SECTION_COM_SERVER_REDIRECTION:
+            winsxs_put_string( buffer, entity->u.comclass.clsid );
+            winsxs_put_string( buffer, entity->u.comclass.tlbid );
+            winsxs_put_string( buffer, entity->u.comclass.progid );
+            winsxs_put_string( buffer, entity->u.comclass.name );
+            winsxs_put_string( buffer, entity->u.comclass.version );
+            winsxs_put_dword( buffer, entity->u.comclass.model );
+            winsxs_put_dword( buffer, entity->u.comclass.miscstatus );
+            winsxs_put_dword( buffer, entity->u.comclass.miscstatuscontent );
+            winsxs_put_dword( buffer, entity->u.comclass.miscstatusthumbnail );
+            winsxs_put_dword( buffer, entity->u.comclass.miscstatusicon );
+            winsxs_put_dword( buffer, entity->u.comclass.miscstatusdocprint );
+            winsxs_put_dword( buffer, entity->u.comclass.progids.num );
+            for (j = 0; j < entity->u.comclass.progids.num; j++)
+                winsxs_put_string( buffer, entity->u.comclass.progids.progids[j] );
+            break;
+        case ACTIVATION_CONTEXT_SECTION_COM_INTERFACE_REDIRECTION:
+            winsxs_put_string( buffer, entity->u.ifaceps.iid );
+            winsxs_put_string( buffer, entity->u.ifaceps.base );
+            winsxs_put_string( buffer, entity->u.ifaceps.tlib );
+            winsxs_put_string( buffer, entity->u.ifaceps.name );
+            winsxs_put_string( buffer, entity->u.ifaceps.ps32 );
+            winsxs_put_dword( buffer, entity->u.ifaceps.mask );
+            winsxs_put_dword( buffer, entity->u.ifaceps.nummethods );
+            break;
+        case ACTIVATION_CONTEXT_SECTION_COM_TYPE_LIBRARY_REDIRECTION:
+            winsxs_put_string( buffer, entity->u.typelib.tlbid );
+            winsxs_put_string( buffer, entity->u.typelib.helpdir );
+            winsxs_put_dword( buffer, entity->u.typelib.flags );
+            winsxs_put_dword( buffer, MAKELONG( entity->u.typelib.major, entity->u.typelib.minor ) );
+            break;
+        case ACTIVATION_CONTEXT_SECTION_WINDOW_CLASS_REDIRECTION:
+            winsxs_put_string( buffer, entity->u.class.name );
+            winsxs_put_dword( buffer, entity->u.class.versioned );
+            break;
+        case ACTIVATION_CONTEXT_SECTION_CLR_SURROGATES:
+            winsxs_put_string( buffer, entity->u.clrsurrogate.name );
+            winsxs_put_string( buffer, entity->u.clrsurrogate.clsid );
+            winsxs_put_string( buffer, entity->u.clrsurrogate.version );
+            break;
+        default:
+            FIXME( "Unknown entity kind %d\n", entity->kind );
+            buffer->failed = TRUE;
+        }
+    }
+}
+
+static void read_entity_array( struct winsxs_buffer *buffer, struct entity_array *array )
+{
+    struct entity *entity;
+    DWORD i, j, count, kind, version;
+
+    count = winsxs_get_dword( buffer );
+    if (count > buffer->size / sizeof(DWORD)) buffer->failed = TRUE;
+
+    for (i = 0; i < count && !buffer->failed; i++)
+    {
+        kind = winsxs_get_dword( buffer );
+        if (buffer->failed || !(entity = add_entity( array, kind )))
+        {
+            buffer->failed = TRUE;
+            break;
+        }
+        switch (kind)
+        {
+        case ACTIVATION_CONTEXT_SECTION_COM_SERVER_REDIRECTION:
+            entity->u.comclass.clsid               = winsxs_get_string( buffer );
+            entity->u.comclass.tlbid               = winsxs_get_string( buffer );
+            entity->u.comclass.progid              = winsxs_get_string( buffer );
+            entity->u.comclass.name                = winsxs_get_string( buffer );
+            entity->u.comclass.version             = winsxs_get_string( buffer );
+            entity->u.comclass.model               = winsxs_get_dword( buffer );
+            entity->u.comclass.miscstatus          = winsxs_get_dword( buffer );
+            entity->u.comclass.miscstatuscontent   = winsxs_get_dword( buffer );
+            entity->u.comclass.miscstatusthumbnail = winsxs_get_dword( buffer );
+            entity->u.comclass.miscstatusicon      = winsxs_get_dword( buffer );
+            entity->u.comclass.miscstatusdocprint  = winsxs_get_dword( buffer );
+            j = winsxs_get_dword( buffer );
+            if (!j) break;
+            if (j > buffer->size / sizeof(DWORD) ||
+                !(entity->u.comclass.progids.progids = RtlAllocateHeap( GetProcessHeap(), 0, j * sizeof(WCHAR *) )))
+            {
+                buffer->failed = TRUE;
+                break;
+            }
+            entity->u.comclass.progids.allocated = j;
+            while (entity->u.comclass.progids.num < j && !buffer->failed)
+                entity->u.comclass.progids.progids[entity->u.comclass.progids.num++] = winsxs_get_string( buffer );
+            break;
+        case ACTIVATION_CONTEXT_SECTION_COM_INTERFACE_REDIRECTION:
+            entity->u.ifaceps.iid        = winsxs_get_string( buffer );
+            entity->u.ifaceps.base       = winsxs_get_string( buffer );
+            entity->u.ifaceps.tlib       = winsxs_get_string( buffer );
+            entity->u.ifaceps.name       = winsxs_get_string( buffer );
+            entity->u.ifaceps.ps32       = winsxs_get_string( buffer );
+            entity->u.ifaceps.mask       = winsxs_get_dword( buffer );
+            entity->u.ifaceps.nummethods = winsxs_get_dword( buffer );
+            break;
+        case ACTIVATION_CONTEXT_SECTION_COM_TYPE_LIBRARY_REDIRECTION:
+            entity->u.typelib.tlbid   = winsxs_get_string( buffer );
+            entity->u.typelib.helpdir = winsxs_get_string( buffer );
+            entity->u.typelib.flags   = winsxs_get_dword( buffer );
+            version = winsxs_get_dword( buffer );
+            entity->u.typelib.major   = LOWORD(version);
+            entity->u.typelib.minor   = HIWORD(version);
+            break;
+        case ACTIVATION_CONTEXT_SECTION_WINDOW_CLASS_REDIRECTION:
+            entity->u.class.name      = winsxs_get_string( buffer );
+            entity->u.class.versioned = winsxs_get_dword( buffer );
+            break;
+        case ACTIVATION_CONTEXT_SECTION_CLR_SURROGATES:
+            entity->u.clrsurrogate.name    = winsxs_get_string( buffer );
+            entity->u.clrsurrogate.clsid   = winsxs_get_string( buffer );
+            entity->u.clrsurrogate.version = winsxs_get_string( buffer );
+            break;
+        default:
+            array->num--;
+            buffer->failed = TRUE;
+        }
+    }
+}
+
+/* the loader holds a single assembly, along with the dependencies and sections it adds */
+static void write_winsxs_manifest( struct winsxs_buffer *buffer, const struct actctx_loader *acl )
+{
+    const struct assembly *assembly = &acl->actctx->assemblies[0];
+    unsigned int i;
+
+    write_assembly_identity( buffer, &assembly->id );
+    winsxs_put_dword( buffer, assembly->no_inherit );
+    winsxs_put_dword( buffer, assembly->rel_found );
+    winsxs_put_dword( buffer, assembly->run_level );
+    winsxs_put_dword( buffer, assembly->ui_access );
+    winsxs_put_dword( buffer, acl->actctx->sections );
+    winsxs_put_dword( buffer, assembly->num_dlls );
+    for (i = 0; i < assembly->num_dlls; i++)
+    {
+        winsxs_put_string( buffer, assembly->dlls[i].name );
+        winsxs_put_string( buffer, assembly->dlls[i].hash );
+        write_entity_array( buffer, &assembly->dlls[i].entities );
+    }
+    write_entity_array( buffer, &assembly->entities );
+    winsxs_put_dword( buffer, acl->num_dependencies );
+    for (i = 0; i < acl->num_dependencies; i++)
+        write_assembly_identity( buffer, &acl->dependencies[i] );
+}
+
+static void read_winsxs_manifest( struct winsxs_buffer *buffer, struct actctx_loader *acl )
+{
+    struct assembly_identity ai;
+    struct dll_redirect *dll;
+    struct assembly *assembly;
+    DWORD i, count, dependencies;
+
+    if (!(assembly = add_assembly( acl->actctx, ASSEMBLY_SHARED_MANIFEST )))
+    {
+        buffer->failed = TRUE;
+        return;
+    }
+    read_assembly_identity( buffer, &assembly->id );
+    assembly->no_inherit = winsxs_get_dword( buffer );
+    assembly->rel_found  = winsxs_get_dword( buffer );
+    assembly->run_level  = winsxs_get_dword( buffer );
+    assembly->ui_access  = winsxs_get_dword( buffer );
+    acl->actctx->sections = winsxs_get_dword( buffer );
+
+    count = winsxs_get_dword( buffer );
+    if (count > buffer->size / sizeof(DWORD)) buffer->failed = TRUE;
+    for (i = 0; i < count && !buffer->failed; i++)
+    {
+        if (!(dll = add_dll_redirect( assembly )))
+        {
+            buffer->failed = TRUE;
+            break;
+        }
+        dll->name = winsxs_get_string( buffer );
+        dll->hash = winsxs_get_string( buffer );
+        read_entity_array( buffer, &dll->entities );
+    }
+    read_entity_array( buffer, &assembly->entities );
+
+    count = winsxs_get_dword( buffer );
+    if (count > buffer->size / sizeof(DWORD)) buffer->failed = TRUE;
+    for (i = 0; i < count && !buffer->failed; i++)
+    {
+        memset( &ai, 0, sizeof(ai) );
+        read_assembly_identity( buffer, &ai );
+        dependencies = acl->num_dependencies;
+        if (buffer->failed || !add_dependent_assembly_id( acl, &ai ))
+        {
+            free_assembly_identity( &ai );
+            buffer->failed = TRUE;
+        }
+        else if (acl->num_dependencies == dependencies) free_assembly_identity( &ai );
+    }
+}
+
+static BOOL init_winsxs_loader( struct actctx_loader *acl )
+{
+    memset( acl, 0, sizeof(*acl) );
+    if (!(acl->actctx = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*acl->actctx) )))
+        return FALSE;
+    acl->actctx->magic = ACTCTX_MAGIC;
+    acl->actctx->ref_count = 1;
+    return TRUE;
+}
+
+static void free_winsxs_loader( struct actctx_loader *acl )
+{
+    free_depend_manifests( acl );
+    actctx_release( acl->actctx );
+}
+
+/* move a parsed winsxs manifest to the activation context being built */
+static NTSTATUS add_winsxs_manifest( struct actctx_loader *acl, struct assembly_identity *ai,
+                                     struct actctx_loader *parsed, const WCHAR *filename,
+                                     const WCHAR *directory )
+{
+    struct assembly *assembly, *src = &parsed->actctx->assemblies[0];
+    unsigned int i, count;
+
+    if (src->id.version.major != ai->version.major ||
+        src->id.version.minor != ai->version.minor ||
+        src->id.version.build < ai->version.build ||
+        (src->id.version.build == ai->version.build &&
+         src->id.version.revision < ai->version.revision))
+    {
+        FIXME("wrong version for shared assembly manifest\n");
+        return STATUS_SXS_CANT_GEN_ACTCTX;
+    }
+
+    if (!(assembly = add_assembly( acl->actctx, ASSEMBLY_SHARED_MANIFEST )))
+        return STATUS_SXS_CANT_GEN_ACTCTX;
+
+    RtlFreeHeap( GetProcessHeap(), 0, src->directory );
+    RtlFreeHeap( GetProcessHeap(), 0, src->manifest.info );
+    *assembly = *src;
+    memset( src, 0, sizeof(*src) );
+    parsed->actctx->num_assemblies = 0;
+
+    if (!(assembly->directory = strdupW( directory ))) return STATUS_NO_MEMORY;
+    assembly->manifest.info = strdupW( filename + 4 /* skip \??\ prefix */ );
+    assembly->manifest.type = assembly->manifest.info ? ACTIVATION_CONTEXT_PATH_TYPE_WIN32_FILE
+                                                      : ACTIVATION_CONTEXT_PATH_TYPE_NONE;
+    acl->actctx->sections |= parsed->actctx->sections;
+
+    for (i = 0; i < parsed->num_dependencies; i++)
+    {
+        count = acl->num_dependencies;
+        if (!add_dependent_assembly_id( acl, &parsed->dependencies[i] )) return STATUS_NO_MEMORY;
+        if (acl->num_dependencies == count) free_assembly_identity( &parsed->dependencies[i] );
+        memset( &parsed->dependencies[i], 0, sizeof(parsed->dependencies[i]) );
+    }
+    return STATUS_SUCCESS;
+}
+
+/* parse a winsxs manifest, or use the cached result of a previous parse if the file didn't change */
+static NTSTATUS get_winsxs_manifest( struct actctx_loader *acl, struct assembly_identity *ai,
+                                     UNICODE_STRING *path, const WCHAR *directory, HANDLE key )
+{
+    FILE_NETWORK_OPEN_INFORMATION info, new_info;
+    KEY_VALUE_PARTIAL_INFORMATION *value;
+    struct actctx_loader parsed;
+    struct winsxs_buffer buffer;
+    OBJECT_ATTRIBUTES attr;
+    const WCHAR *name;
+    NTSTATUS status;
+    HANDLE handle;
+
+    attr.Length = sizeof(attr);
+    attr.RootDirectory = 0;
+    attr.Attributes = OBJ_CASE_INSENSITIVE;
+    attr.ObjectName = path;
+    attr.SecurityDescriptor = NULL;
+    attr.SecurityQualityOfService = NULL;
+    if (!key || NtQueryFullAttributesFile( &attr, &info ) || info.EndOfFile.QuadPart > WINSXS_MAX_MANIFEST_SIZE)
+    {
+        if (open_nt_file( &handle, path )) return STATUS_NO_SUCH_FILE;
+        status = get_manifest_in_manifest_file( acl, ai, path->Buffer, directory, TRUE, handle );
+        NtClose( handle );
+        return status;
+    }
+
+    name = strrchrW( path->Buffer, '\\' ) + 1;
+    if (!init_winsxs_loader( &parsed )) return STATUS_NO_MEMORY;
+
+    if ((value = get_winsxs_cache_value( key, name, &info.LastWriteTime, &info.EndOfFile, &buffer )))
+    {
+        TRACE( "using cached manifest %s\n", debugstr_w(path->Buffer) );
+        read_winsxs_manifest( &buffer, &parsed );
+        RtlFreeHeap( GetProcessHeap(), 0, value );
+        if (buffer.failed)
+        {
+            free_winsxs_loader( &parsed );
+            if (!init_winsxs_loader( &parsed )) return STATUS_NO_MEMORY;
+        }
+    }
+
+    if (!value || buffer.failed)
+    {
+        if (open_nt_file( &handle, path ))
+        {
+            free_winsxs_loader( &parsed );
+            return STATUS_NO_SUCH_FILE;
+        }
+        status = get_manifest_in_manifest_file( &parsed, NULL, path->Buffer, directory, TRUE, handle );
+        NtClose( handle );
+
+        /* don't cache the result if the file was modified while it was parsed */
+        if (!status && !NtQueryFullAttributesFile( &attr, &new_info ) &&
+            new_info.LastWriteTime.QuadPart == info.LastWriteTime.QuadPart &&
+            new_info.EndOfFile.QuadPart == info.EndOfFile.QuadPart)
+        {
+            init_winsxs_cache_value( &buffer, &info.LastWriteTime, &info.EndOfFile );
+            write_winsxs_manifest( &buffer, &parsed );
+            set_winsxs_cache_value( key, name, &buffer );
+        }
+    }
+    else status = STATUS_SUCCESS;
+
+    if (!status) status = add_winsxs_manifest( acl, ai, &parsed, path->Buffer, directory );
+    free_winsxs_loader( &parsed );
+    return status;
+}
+
 static NTSTATUS lookup_winsxs(struct actctx_loader* acl, struct assembly_identity* ai)
 {
     struct assembly_identity    sxs_ai;
@@ -2909,7 +3527,7 @@ static NTSTATUS lookup_winsxs(struct actctx_loader* acl, struct assembly_identit
     OBJECT_ATTRIBUTES           attr;
     IO_STATUS_BLOCK             io;
     WCHAR *path, *file = NULL;
-    HANDLE handle;
+    HANDLE handle, key;
 
     static const WCHAR manifest_dirW[] =
         {'\\','w','i','n','s','x','s','\\','m','a','n','i','f','e','s','t','s',0};
@@ -2937,15 +3555,18 @@ static NTSTATUS lookup_winsxs(struct actctx_loader* acl, struct assembly_identit
     attr.SecurityDescriptor = NULL;
     attr.SecurityQualityOfService = NULL;
 
+    key = open_winsxs_cache_key();
+
     if (!NtOpenFile( &handle, GENERIC_READ | SYNCHRONIZE, &attr, &io, FILE_SHARE_READ | FILE_SHARE_WRITE,
                      FILE_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT ))
     {
         sxs_ai = *ai;
-        file = lookup_manifest_file( handle, &sxs_ai );
+        file = lookup_manifest_file( handle, key, &sxs_ai );
         NtClose( handle );
     }
     if (!file)
     {
+        if (key) NtClose( key );
         RtlFreeUnicodeString( &path_us );
         return STATUS_NO_SUCH_FILE;
     }
@@ -2954,6 +3575,7 @@ static NTSTATUS lookup_winsxs(struct actctx_loader* acl, struct assembly_identit
     if (!(path = RtlReAllocateHeap( GetProcessHeap(), 0, path_us.Buffer,
                                     path_us.Length + (strlenW(file) + 2) * sizeof(WCHAR) )))
     {
+        if (key) NtClose( key );
         RtlFreeHeap( GetProcessHeap(), 0, file );
         RtlFreeUnicodeString( &path_us );
         return STATUS_NO_MEMORY;
@@ -2964,13 +3586,9 @@ static NTSTATUS lookup_winsxs(struct actctx_loader* acl, struct assembly_identit
     RtlInitUnicodeString( &path_us, path );
     *strrchrW(file, '.') = 0;  /* remove .manifest extension */
 
-    if (!open_nt_file( &handle, &path_us ))
-    {
-        io.u.Status = get_manifest_in_manifest_file(acl, &sxs_ai, path_us.Buffer, file, TRUE, handle);
-        NtClose( handle );
-    }
-    else io.u.Status = STATUS_NO_SUCH_FILE;
+    io.u.Status = get_winsxs_manifest( acl, &sxs_ai, &path_us, file, key );
 
+    if (key) NtClose( key );
     RtlFreeHeap( GetProcessHeap(), 0, file );
     RtlFreeUnicodeString( &path_us );
     return io.u.Status;
@@ -3123,6 +3741,40 @@ static NTSTATUS find_query_actctx( HANDLE *handle, DWORD flags, ULONG class )
     return status;
 }
 
+/* String section index entries are sorted by key hash, and guid section entries by
+   guid, so that lookups can do a binary search. Entries with equal keys keep the
+   order they were built in, the first one is returned by lookups. */
+static int string_index_cmp(const void *p1, const void *p2)
+{
+    const struct string_index *index1 = p1, *index2 = p2;
+
+    if (index1->hash != index2->hash) return index1->hash < index2->hash ? -1 : 1;
+    if (index1->name_offset != index2->name_offset) return index1->name_offset < index2->name_offset ? -1 : 1;
+    return 0;
+}
+
+static void sort_string_index(struct strsection_header *section)
+{
+    qsort((BYTE*)section + section->index_offset, section->count, sizeof(struct string_index),
+          string_index_cmp);
+}
+
+static int guid_index_cmp(const void *p1, const void *p2)
+{
+    const struct guid_index *index1 = p1, *index2 = p2;
+    int ret;
+
+    if ((ret = memcmp(&index1->guid, &index2->guid, sizeof(GUID)))) return ret;
+    if (index1->data_offset != index2->data_offset) return index1->data_offset < index2->data_offset ? -1 : 1;
+    return 0;
+}
+
+static void sort_guid_index(struct guidsection_header *section)
+{
+    qsort((BYTE*)section + section->index_offset, section->count, sizeof(struct guid_index),
+          guid_index_cmp);
+}
+
 static NTSTATUS build_dllredirect_section(ACTIVATION_CONTEXT* actctx, struct strsection_header **section)
 {
     unsigned int i, j, total_len = 0, dll_count = 0;
@@ -3200,6 +3852,7 @@ static NTSTATUS build_dllredirect_section(ACTIVATION_CONTEXT* actctx, struct str
         }
     }
 
+    sort_string_index(header);
     *section = header;
 
     return STATUS_SUCCESS;
@@ -3208,26 +3861,32 @@ static NTSTATUS build_dllredirect_section(ACTIVATION_CONTEXT* actctx, struct str
 static struct string_index *find_string_index(const struct strsection_header *section, const UNICODE_STRING *name)
 {
     struct string_index *iter, *index = NULL;
-    ULONG hash = 0, i;
+    ULONG hash = 0, min, max, pos;
 
     RtlHashUnicodeString(name, TRUE, HASH_STRING_ALGORITHM_X65599, &hash);
     iter = (struct string_index*)((BYTE*)section + section->index_offset);
 
-    for (i = 0; i < section->count; i++)
+    /* look for the first entry with a matching hash */
+    min = 0;
+    max = section->count;
+    while (min < max)
     {
-        if (iter->hash == hash)
-        {
-            const WCHAR *nameW = (WCHAR*)((BYTE*)section + iter->name_offset);
+        pos = (min + max) / 2;
+        if (iter[pos].hash < hash) min = pos + 1;
+        else max = pos;
+    }
 
-            if (!strcmpiW(nameW, name->Buffer))
-            {
-                index = iter;
-                break;
-            }
-            else
-                WARN("hash collision 0x%08x, %s, %s\n", hash, debugstr_us(name), debugstr_w(nameW));
+    for (iter += min; min < section->count && iter->hash == hash; min++, iter++)
+    {
+        const WCHAR *nameW = (WCHAR*)((BYTE*)section + iter->name_offset);
+
+        if (!strcmpiW(nameW, name->Buffer))
+        {
+            index = iter;
+            break;
         }
-        iter++;
+        else
+            WARN("hash collision 0x%08x, %s, %s\n", hash, debugstr_us(name), debugstr_w(nameW));
     }
 
     return index;
@@ -3235,22 +3894,24 @@ static struct string_index *find_string_index(const struct strsection_header *se
 
 static struct guid_index *find_guid_index(const struct guidsection_header *section, const GUID *guid)
 {
-    struct guid_index *iter, *index = NULL;
-    ULONG i;
+    struct guid_index *iter;
+    ULONG min, max, pos;
 
     iter = (struct guid_index*)((BYTE*)section + section->index_offset);
 
-    for (i = 0; i < section->count; i++)
+    min = 0;
+    max = section->count;
+    while (min < max)
     {
-        if (!memcmp(guid, &iter->guid, sizeof(*guid)))
-        {
-            index = iter;
-            break;
-        }
-        iter++;
+        pos = (min + max) / 2;
+        if (memcmp(&iter[pos].guid, guid, sizeof(*guid)) < 0) min = pos + 1;
+        else max = pos;
     }
 
-    return index;
+    if (min < section->count && !memcmp(guid, &iter[min].guid, sizeof(*guid)))
+        return &iter[min];
+
+    return NULL;
 }
 
 static inline struct dllredirect_data *get_dllredirect_data(ACTIVATION_CONTEXT *ctxt, struct string_index *index)
@@ -3300,11 +3961,6 @@ static NTSTATUS find_dll_redirection(ACTIVATION_CONTEXT* actctx, const UNICODE_S
     return STATUS_SUCCESS;
 }
 
-static inline struct string_index *get_wndclass_first_index(ACTIVATION_CONTEXT *actctx)
-{
-    return (struct string_index*)((BYTE*)actctx->wndclass_section + actctx->wndclass_section->index_offset);
-}
-
 static inline struct wndclass_redirect_data *get_wndclass_data(ACTIVATION_CONTEXT *ctxt, struct string_index *index)
 {
     return (struct wndclass_redirect_data*)((BYTE*)ctxt->wndclass_section + index->data_offset);
@@ -3443,6 +4099,7 @@ static NTSTATUS build_wndclass_section(ACTIVATION_CONTEXT* actctx, struct strsec
         }
     }
 
+    sort_string_index(header);
     *section = header;
 
     return STATUS_SUCCESS;
@@ -3451,10 +4108,8 @@ static NTSTATUS build_wndclass_section(ACTIVATION_CONTEXT* actctx, struct strsec
 static NTSTATUS find_window_class(ACTIVATION_CONTEXT* actctx, const UNICODE_STRING *name,
                                   PACTCTX_SECTION_KEYED_DATA data)
 {
-    struct string_index *iter, *index = NULL;
     struct wndclass_redirect_data *class;
-    ULONG hash;
-    int i;
+    struct string_index *index;
 
     if (!(actctx->sections & WINDOWCLASS_SECTION)) return STATUS_SXS_KEY_NOT_FOUND;
 
@@ -3469,27 +4124,7 @@ static NTSTATUS find_window_class(ACTIVATION_CONTEXT* actctx, const UNICODE_STRI
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    hash = 0;
-    RtlHashUnicodeString(name, TRUE, HASH_STRING_ALGORITHM_X65599, &hash);
-    iter = get_wndclass_first_index(actctx);
-
-    for (i = 0; i < actctx->wndclass_section->count; i++)
-    {
-        if (iter->hash == hash)
-        {
-            const WCHAR *nameW = (WCHAR*)((BYTE*)actctx->wndclass_section + iter->name_offset);
-
-            if (!strcmpiW(nameW, name->Buffer))
-            {
-                index = iter;
-                break;
-            }
-            else
-                WARN("hash collision 0x%08x, %s, %s\n", hash, debugstr_us(name), debugstr_w(nameW));
-        }
-        iter++;
-    }
-
+    index = find_string_index(actctx->wndclass_section, name);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     if (data)
@@ -3632,6 +4267,7 @@ static NTSTATUS build_tlib_section(ACTIVATION_CONTEXT* actctx, struct guidsectio
         }
     }
 
+    sort_guid_index(header);
     *section = header;
 
     return STATUS_SUCCESS;
@@ -3967,6 +4603,7 @@ static NTSTATUS build_comserver_section(ACTIVATION_CONTEXT* actctx, struct guids
         }
     }
 
+    sort_guid_index(header);
     *section = header;
 
     return STATUS_SUCCESS;
@@ -4157,6 +4794,7 @@ static NTSTATUS build_ifaceps_section(ACTIVATION_CONTEXT* actctx, struct guidsec
         }
     }
 
+    sort_guid_index(header);
     *section = header;
 
     return STATUS_SUCCESS;
@@ -4305,6 +4943,7 @@ static NTSTATUS build_clr_surrogate_section(ACTIVATION_CONTEXT* actctx, struct g
         }
     }
 
+    sort_guid_index(header);
     *section = header;
 
     return STATUS_SUCCESS;
@@ -4507,6 +5146,7 @@ static NTSTATUS build_progid_section(ACTIVATION_CONTEXT* actctx, struct strsecti
         }
     }
 
+    sort_string_index(header);
     *section = header;
 
     return STATUS_SUCCESS;
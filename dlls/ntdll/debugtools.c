@@ -44,6 +44,17 @@ WINE_DECLARE_DEBUG_CHANNEL(timestamp);
 
 static struct __wine_debug_functions default_funcs;
 
+/* buffered output, configured in HKCU\Software\Wine\Debug */
+static unsigned int output_buffer_size;  /* per-thread buffer flush threshold, 0 if unbuffered */
+static ULONGLONG output_flush_interval;  /* max time a line stays buffered, in 100ns units */
+
+/* in-memory ring buffer that replaces stderr when enabled */
+static char *ring_buffer;
+static unsigned int ring_size;           /* always a power of two */
+static int ring_pos;
+static BOOL ring_wrapped;
+static int ring_dumped;
+
 /* ---------------------------------------------------------------------- */
 
 /* get the debug info pointer for the current thread */
@@ -116,6 +127,57 @@ static const char *NTDLL_dbgstr_wn( const WCHAR *src, int n )
      return res;
 }
 
+/* append some data to the ring buffer, overwriting the oldest output */
+static void write_ring_buffer( const char *data, unsigned int len )
+{
+    unsigned int pos = interlocked_xchg_add( &ring_pos, len );
+    unsigned int count;
+
+    if (pos + len >= ring_size) ring_wrapped = TRUE;
+    pos &= ring_size - 1;
+    count = min( len, ring_size - pos );
+
+    memcpy( ring_buffer + pos, data, count );
+    memcpy( ring_buffer, data + count, len - count );
+}
+
+/* write the buffered lines of a thread to stderr */
+static void flush_output( struct debug_info *info )
+{
+    if (info->buf_pos == info->buffer) return;
+    write( 2, info->buffer, info->buf_pos - info->buffer );
+    info->buf_pos = info->buffer;
+}
+
+/* send complete lines to the configured output */
+static void write_output( struct debug_info *info, const char *data, unsigned int len )
+{
+    ULONGLONG now;
+
+    if (ring_buffer)
+    {
+        write_ring_buffer( data, len );
+        return;
+    }
+    if (!output_buffer_size)
+    {
+        write( 2, data, len );
+        return;
+    }
+
+    now = monotonic_counter();
+    if (info->buf_pos + len > info->buffer + output_buffer_size) flush_output( info );
+    if (len >= output_buffer_size)
+    {
+        write( 2, data, len );
+        return;
+    }
+    if (info->buf_pos == info->buffer) info->buf_time = now;
+    memcpy( info->buf_pos, data, len );
+    info->buf_pos += len;
+    if (now - info->buf_time >= output_flush_interval) flush_output( info );
+}
+
 /***********************************************************************
  *		NTDLL_dbg_vprintf
  */
@@ -145,7 +207,7 @@ static int NTDLL_dbg_vprintf( const char *format, va_list args )
     else
     {
         char *pos = info->output;
-        write( 2, pos, info->out_pos + end - pos );
+        write_output( info, pos, info->out_pos + end - pos );
         /* move beginning of next line to start of buffer */
         memmove( pos, info->out_pos + end, ret - end );
         info->out_pos = pos + ret - end;
@@ -168,8 +230,18 @@ static int NTDLL_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_chan
     {
         if (TRACE_ON(timestamp))
         {
-            ULONG ticks = NtGetTickCount();
-            ret = wine_dbg_printf( "%3u.%03u:", ticks / 1000, ticks % 1000 );
+            if (output_buffer_size || ring_buffer)
+            {
+                /* buffered lines of different threads are not written in order,
+                 * use a finer resolution so that they can be sorted afterwards */
+                ULONGLONG usecs = monotonic_counter() / 10;
+                ret = wine_dbg_printf( "%3u.%06u:", (UINT)(usecs / 1000000), (UINT)(usecs % 1000000) );
+            }
+            else
+            {
+                ULONG ticks = NtGetTickCount();
+                ret = wine_dbg_printf( "%3u.%03u:", ticks / 1000, ticks % 1000 );
+            }
         }
         if (TRACE_ON(pid))
             ret += wine_dbg_printf( "%04x:", GetCurrentProcessId() );
@@ -180,6 +252,8 @@ static int NTDLL_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_chan
     }
     if (format)
         ret += NTDLL_dbg_vprintf( format, args );
+    /* errors are often followed by a crash, don't keep them buffered */
+    if (cls == __WINE_DBCL_ERR) flush_output( info );
     return ret;
 }
 
@@ -201,3 +275,123 @@ void debug_init(void)
 {
     __wine_dbg_set_functions( &funcs, &default_funcs, sizeof(funcs) );
 }
+
+/* read a numeric option, stored either as a DWORD or as a string */
+static BOOL get_debug_option( HANDLE hkey, const WCHAR *name, DWORD *value )
+{
+    char tmp[64];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (KEY_VALUE_PARTIAL_INFORMATION *)tmp;
+    UNICODE_STRING nameW;
+    DWORD count;
+
+    RtlInitUnicodeString( &nameW, name );
+    if (NtQueryValueKey( hkey, &nameW, KeyValuePartialInformation, tmp, sizeof(tmp) - sizeof(WCHAR), &count ))
+        return FALSE;
+    if (info->Type == REG_DWORD && info->DataLength == sizeof(DWORD))
+        memcpy( value, info->Data, sizeof(DWORD) );
+    else if (info->Type == REG_SZ)
+    {
+        ((WCHAR *)info->Data)[info->DataLength / sizeof(WCHAR)] = 0;
+        *value = strtoulW( (WCHAR *)info->Data, NULL, 0 );
+    }
+    else return FALSE;
+    return TRUE;
+}
+
+/***********************************************************************
+ *		debug_init_options
+ *
+ * Set up buffered output once the registry is available.
+ */
+void debug_init_options(void)
+{
+    static const WCHAR configW[] = {'S','o','f','t','w','a','r','e','\\',
+                                    'W','i','n','e','\\',
+                                    'D','e','b','u','g',0};
+    static const WCHAR OutputBufferW[] = {'O','u','t','p','u','t','B','u','f','f','e','r',0};
+    static const WCHAR OutputFlushIntervalW[] = {'O','u','t','p','u','t','F','l','u','s','h',
+                                                 'I','n','t','e','r','v','a','l',0};
+    static const WCHAR RingBufferW[] = {'R','i','n','g','B','u','f','f','e','r',0};
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    HANDLE root, hkey;
+    DWORD value;
+
+    RtlOpenCurrentUser( KEY_ALL_ACCESS, &root );
+    attr.Length = sizeof(attr);
+    attr.RootDirectory = root;
+    attr.ObjectName = &name;
+    attr.Attributes = 0;
+    attr.SecurityDescriptor = NULL;
+    attr.SecurityQualityOfService = NULL;
+    RtlInitUnicodeString( &name, configW );
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Debug */
+    if (NtOpenKey( &hkey, KEY_QUERY_VALUE, &attr )) hkey = 0;
+    NtClose( root );
+    if (!hkey) return;
+
+    /* size in kilobytes of a process-wide ring buffer that keeps the most recent
+     * output in memory instead of writing it, dumped to stderr on a crash */
+    if (get_debug_option( hkey, RingBufferW, &value ) && value)
+    {
+        SIZE_T size = 64 * 1024;
+        void *ptr = NULL;
+
+        while (size < 256 * 1024 * 1024 && size / 1024 < value) size *= 2;
+        if (!NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+        {
+            ring_size = size;
+            ring_buffer = ptr;
+        }
+    }
+
+    /* number of bytes each thread collects before writing them out at once,
+     * and number of milliseconds after which they are written in any case */
+    if (get_debug_option( hkey, OutputBufferW, &value ) && value)
+    {
+        output_buffer_size = min( value, sizeof(((struct debug_info *)0)->buffer) );
+        if (!get_debug_option( hkey, OutputFlushIntervalW, &value )) value = 100;
+        output_flush_interval = (ULONGLONG)value * 10000;
+    }
+
+    NtClose( hkey );
+}
+
+/***********************************************************************
+ *		debug_flush_output
+ *
+ * Write out the buffered output of the current thread before it blocks
+ * or exits, so that lines don't stay buffered while it is idle.
+ */
+void debug_flush_output(void)
+{
+    flush_output( get_info() );
+}
+
+/***********************************************************************
+ *		debug_dump_ring_buffer
+ *
+ * Write the contents of the ring buffer to stderr, starting at the oldest
+ * complete line.
+ */
+void debug_dump_ring_buffer(void)
+{
+    static const char header[] = "--- debug ring buffer ---\n";
+    static const char footer[] = "--- end of debug ring buffer ---\n";
+    unsigned int pos, start;
+
+    if (!ring_buffer || interlocked_xchg( &ring_dumped, 1 )) return;
+
+    pos = interlocked_xchg_add( &ring_pos, 0 );
+    write( 2, header, sizeof(header) - 1 );
+    if (!ring_wrapped) write( 2, ring_buffer, pos );
+    else
+    {
+        pos &= ring_size - 1;
+        for (start = pos; start < ring_size; start++) if (ring_buffer[start] == '\n') break;
+        if (++start < ring_size) write( 2, ring_buffer + start, ring_size - start );
+        write( 2, ring_buffer, pos );
+    }
+    write( 2, footer, sizeof(footer) - 1 );
+}
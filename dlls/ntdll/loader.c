@@ -24,6 +24,11 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 #ifdef HAVE_SYS_MMAN_H
 # include <sys/mman.h>
 #endif
@@ -2204,6 +2209,153 @@ static NTSTATUS perform_relocations( void *module, SIZE_T len )
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *           perf map support
+ *
+ * When WINEPERFMAP is set, describe the native PE modules and their exports
+ * in /tmp/perf-<pid>.map, so that the Linux perf tool can symbolize them.
+ * perf resolves samples after the fact, so entries are only ever appended,
+ * unloaded modules included.
+ */
+struct perf_map_symbol
+{
+    DWORD       rva;
+    const char *name;
+    DWORD       ordinal;
+};
+
+static int perf_map_enabled = -1;
+static BOOL perf_map_truncated;
+
+static BOOL perf_map_init(void)
+{
+    if (perf_map_enabled == -1)
+    {
+        const char *env = getenv( "WINEPERFMAP" );
+        perf_map_enabled = env && *env && strcmp( env, "0" );
+    }
+    return perf_map_enabled;
+}
+
+static int perf_map_symbol_cmp( const void *p1, const void *p2 )
+{
+    const struct perf_map_symbol *s1 = p1, *s2 = p2;
+
+    if (s1->rva != s2->rva) return s1->rva < s2->rva ? -1 : 1;
+    return 0;
+}
+
+static DWORD perf_map_section_end( const IMAGE_NT_HEADERS *nt, DWORD rva )
+{
+    const IMAGE_SECTION_HEADER *sec = IMAGE_FIRST_SECTION( nt );
+    unsigned int i;
+
+    for (i = 0; i < nt->FileHeader.NumberOfSections; i++, sec++)
+        if (rva >= sec->VirtualAddress && rva < sec->VirtualAddress + sec->Misc.VirtualSize)
+            return sec->VirtualAddress + sec->Misc.VirtualSize;
+    return nt->OptionalHeader.SizeOfImage;
+}
+
+static void perf_map_write_module( FILE *file, const WINE_MODREF *wm )
+{
+    char *base = wm->ldr.BaseAddress;
+    const IMAGE_NT_HEADERS *nt = RtlImageNtHeader( wm->ldr.BaseAddress );
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *functions, *names;
+    const WORD *ordinals;
+    struct perf_map_symbol *symbols;
+    char dllname[MAX_PATH];
+    DWORD size, end, i, count = 0;
+    int len;
+
+    if (!nt) return;
+    len = ntdll_wcstoumbs( 0, wm->ldr.BaseDllName.Buffer, wm->ldr.BaseDllName.Length / sizeof(WCHAR),
+                           dllname, sizeof(dllname) - 1, NULL, NULL );
+    dllname[max( len, 0 )] = 0;
+
+    exports = RtlImageDirectoryEntryToData( wm->ldr.BaseAddress, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+    if (!exports || !exports->NumberOfFunctions ||
+        !(symbols = RtlAllocateHeap( GetProcessHeap(), 0, exports->NumberOfFunctions * sizeof(*symbols) )))
+    {
+        fprintf( file, "%lx %x %s\n", (ULONG_PTR)base, nt->OptionalHeader.SizeOfImage, dllname );
+        return;
+    }
+
+    functions = (const DWORD *)(base + exports->AddressOfFunctions);
+    names = (const DWORD *)(base + exports->AddressOfNames);
+    ordinals = (const WORD *)(base + exports->AddressOfNameOrdinals);
+
+    for (i = 0; i < exports->NumberOfFunctions; i++)
+    {
+        DWORD rva = functions[i];
+
+        if (!rva || rva >= nt->OptionalHeader.SizeOfImage) continue;
+        /* skip forwarded entries */
+        if (rva >= (const char *)exports - base && rva < (const char *)exports - base + size) continue;
+        symbols[count].rva = rva;
+        symbols[count].name = NULL;
+        symbols[count].ordinal = exports->Base + i;
+        count++;
+    }
+    qsort( symbols, count, sizeof(*symbols), perf_map_symbol_cmp );
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        struct perf_map_symbol key, *sym;
+
+        if (ordinals[i] >= exports->NumberOfFunctions) continue;
+        key.rva = functions[ordinals[i]];
+        if ((sym = bsearch( &key, symbols, count, sizeof(*symbols), perf_map_symbol_cmp )))
+        {
+            /* aliases share an address, name them all after the same symbol */
+            while (sym > symbols && sym[-1].rva == key.rva) sym--;
+            if (!sym->name) sym->name = base + names[i];
+        }
+    }
+
+    /* everything before the first export is attributed to the module itself */
+    end = count ? symbols[0].rva : nt->OptionalHeader.SizeOfImage;
+    fprintf( file, "%lx %x %s\n", (ULONG_PTR)base, end, dllname );
+
+    for (i = 0; i < count; i++)
+    {
+        if (i && symbols[i].rva == symbols[i - 1].rva) continue;
+        end = perf_map_section_end( nt, symbols[i].rva );
+        if (i + 1 < count && symbols[i + 1].rva < end) end = symbols[i + 1].rva;
+
+        if (symbols[i].name)
+            fprintf( file, "%lx %x %s!%s\n", (ULONG_PTR)base + symbols[i].rva,
+                     end - symbols[i].rva, dllname, symbols[i].name );
+        else
+            fprintf( file, "%lx %x %s!#%u\n", (ULONG_PTR)base + symbols[i].rva,
+                     end - symbols[i].rva, dllname, symbols[i].ordinal );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, symbols );
+}
+
+/* the first write truncates what a previous process with the same pid left behind */
+static FILE *perf_map_open(void)
+{
+    char path[64];
+    FILE *file;
+
+    sprintf( path, "/tmp/perf-%d.map", (int)getpid() );
+    if ((file = fopen( path, perf_map_truncated ? "a" : "w" ))) perf_map_truncated = TRUE;
+    return file;
+}
+
+/* append a newly loaded module; must be called with the loader lock held */
+static void perf_map_add_module( const WINE_MODREF *wm )
+{
+    FILE *file;
+
+    if (!perf_map_init()) return;
+    if (!(file = perf_map_open())) return;
+    perf_map_write_module( file, wm );
+    fclose( file );
+}
+
+
 /******************************************************************************
  *	load_native_dll  (internal)
  */
@@ -2294,6 +2446,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, LPCWSTR fakemo
     if ((wm->ldr.Flags & LDR_IMAGE_IS_DLL) && TRACE_ON(snoop)) SNOOP_SetupDLL( module );
 
     TRACE_(loaddll)( "Loaded %s at %p: native\n", debugstr_w(wm->ldr.FullDllName.Buffer), module );
+    perf_map_add_module( wm );
 
     wm->ldr.LoadCount = 1;
 
@@ -3320,6 +3473,7 @@ void WINAPI LdrShutdownProcess(void)
     TRACE("()\n");
     process_detaching = TRUE;
     process_detach();
+    RELAY_FlushLog( TRUE );
 }
 
 
@@ -3380,6 +3534,7 @@ void WINAPI LdrShutdownThread(void)
     RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->FlsSlots );
     RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->TlsExpansionSlots );
     RtlLeaveCriticalSection( &loader_section );
+    RELAY_FlushLog( FALSE );
 }
 
 
@@ -3741,11 +3896,14 @@ void WINAPI LdrInitializeThunk( void *kernel_start, ULONG_PTR unknown2,
     RemoveEntryList( &wm->ldr.InMemoryOrderModuleList );
     InsertHeadList( &peb->LdrData->InMemoryOrderModuleList, &wm->ldr.InMemoryOrderModuleList );
 
+    if (!(wm->ldr.Flags & LDR_WINE_INTERNAL)) perf_map_add_module( wm );
+
     /* the windows version was not set yet when ntdll and kernel32 were loaded */
     recompute_hash_map();
 
     if ((status = virtual_alloc_thread_stack( NtCurrentTeb(), 0, 0 )) != STATUS_SUCCESS) goto error;
     if ((status = server_init_process_done()) != STATUS_SUCCESS) goto error;
+    debug_init_options();
 
     actctx_init();
     load_path = NtCurrentTeb()->Peb->ProcessParameters->DllPath.Buffer;
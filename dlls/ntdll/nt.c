@@ -1970,6 +1970,86 @@ static NTSTATUS create_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **
 }
 #endif
 
+/* process list returned by the last list_processes request */
+static char *process_list;
+static data_size_t process_list_size;
+static int process_list_count;
+static unsigned int process_list_version;
+
+static RTL_CRITICAL_SECTION process_list_section;
+static RTL_CRITICAL_SECTION_DEBUG process_list_section_debug =
+{
+    0, 0, &process_list_section,
+    { &process_list_section_debug.ProcessLocksList, &process_list_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": process_list_section") }
+};
+static RTL_CRITICAL_SECTION process_list_section = { &process_list_section_debug, -1, 0, 0, 0, 0 };
+
+/* refresh the cached process list; the server only sends the handle counts if
+ * no process, thread or module was added or removed since the previous call */
+/* must be called with process_list_section held */
+static NTSTATUS update_process_list(void)
+{
+    data_size_t size = max( process_list_size, 4096 ), info_size;
+    unsigned int version;
+    NTSTATUS ret;
+    char *buffer;
+    int i, count;
+
+    for (;;)
+    {
+        if (!(buffer = RtlAllocateHeap( GetProcessHeap(), 0, size ))) return STATUS_NO_MEMORY;
+
+        SERVER_START_REQ( list_processes )
+        {
+            req->flags   = LIST_PROCESS_THREADS;
+            req->pid     = 0;
+            req->version = process_list ? process_list_version : 0;
+            wine_server_set_reply( req, buffer, size );
+            ret = wine_server_call( req );
+            version   = reply->version;
+            count     = reply->process_count;
+            info_size = reply->info_size;
+        }
+        SERVER_END_REQ;
+
+        if (ret != STATUS_INFO_LENGTH_MISMATCH) break;
+        RtlFreeHeap( GetProcessHeap(), 0, buffer );
+        size = info_size;
+    }
+
+    if (ret)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, buffer );
+        return ret;
+    }
+
+    if (process_list && version == process_list_version)
+    {
+        const int *handles = (const int *)buffer;
+        char *pos = process_list;
+
+        for (i = 0; i < count; i++)
+        {
+            struct process_info *info = (struct process_info *)pos;
+
+            info->handle_count = handles[i];
+            pos += sizeof(*info) + ((info->name_len + 7) & ~7);
+            pos += info->thread_count * sizeof(struct thread_info);
+        }
+        RtlFreeHeap( GetProcessHeap(), 0, buffer );
+    }
+    else
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, process_list );
+        process_list         = buffer;
+        process_list_size    = info_size;
+        process_list_count   = count;
+        process_list_version = version;
+    }
+    return STATUS_SUCCESS;
+}
+
 /******************************************************************************
  * NtQuerySystemInformation [NTDLL.@]
  * ZwQuerySystemInformation [NTDLL.@]
@@ -2147,121 +2227,82 @@ NTSTATUS WINAPI NtQuerySystemInformation(
             SYSTEM_PROCESS_INFORMATION* spi = SystemInformation;
             SYSTEM_PROCESS_INFORMATION* last = NULL;
             unsigned long clk_tck = sysconf(_SC_CLK_TCK);
-            HANDLE hSnap = 0;
             WCHAR procname[1024];
             WCHAR* exename;
             DWORD wlen = 0;
             DWORD procstructlen = 0;
-            int unix_pid = -1;
+            char *pos;
+            int i, j;
 
-            SERVER_START_REQ( create_snapshot )
+            RtlEnterCriticalSection( &process_list_section );
+            if (!(ret = update_process_list()))
             {
-                req->flags      = SNAP_PROCESS | SNAP_THREAD;
-                req->attributes = 0;
-                if (!(ret = wine_server_call( req )))
-                    hSnap = wine_server_ptr_handle( reply->handle );
-            }
-            SERVER_END_REQ;
-            len = 0;
-            while (ret == STATUS_SUCCESS)
-            {
-                SERVER_START_REQ( next_process )
+                len = 0;
+                pos = process_list;
+                for (i = 0; i < process_list_count; i++)
                 {
-                    req->handle = wine_server_obj_handle( hSnap );
-                    req->reset = (len == 0);
-                    wine_server_set_reply( req, procname, sizeof(procname)-sizeof(WCHAR) );
-                    if (!(ret = wine_server_call( req )))
-                    {
-                        /* Make sure procname is 0 terminated */
-                        procname[wine_server_reply_size(reply) / sizeof(WCHAR)] = 0;
+                    struct process_info *info = (struct process_info *)pos;
+                    struct thread_info *thread_info;
+                    data_size_t name_len = min( info->name_len, sizeof(procname) - sizeof(WCHAR) );
 
-                        /* Get only the executable name, not the path */
-                        if ((exename = strrchrW(procname, '\\')) != NULL) exename++;
-                        else exename = procname;
+                    memcpy( procname, info + 1, name_len );
+                    procname[name_len / sizeof(WCHAR)] = 0;
+                    pos += sizeof(*info) + ((info->name_len + 7) & ~7);
+                    thread_info = (struct thread_info *)pos;
+                    pos += info->thread_count * sizeof(*thread_info);
 
-                        wlen = (strlenW(exename) + 1) * sizeof(WCHAR);
+                    /* Get only the executable name, not the path */
+                    if ((exename = strrchrW(procname, '\\')) != NULL) exename++;
+                    else exename = procname;
 
-                        procstructlen = sizeof(*spi) + wlen + ((reply->threads - 1) * sizeof(SYSTEM_THREAD_INFORMATION));
+                    wlen = (strlenW(exename) + 1) * sizeof(WCHAR);
 
-                        if (Length >= len + procstructlen)
-                        {
-                            /* ftCreationTime;
-                             * vmCounters, ioCounters
-                             */
- 
-                            memset(spi, 0, sizeof(*spi));
-
-                            spi->NextEntryOffset = procstructlen - wlen;
-                            spi->dwThreadCount = reply->threads;
-
-                            /* spi->pszProcessName will be set later on */
-
-                            spi->dwBasePriority = reply->priority;
-                            spi->UniqueProcessId = UlongToHandle(reply->pid);
-                            spi->ParentProcessId = UlongToHandle(reply->ppid);
-                            spi->HandleCount = reply->handles;
-                            spi->CreationTime.QuadPart = reply->start_time;
-
-                            /* spi->ti will be set later on */
-
-                            if (reply->unix_pid != -1)
-                            {
-                                read_process_time(reply->unix_pid, -1, clk_tck,
-                                                  &spi->KernelTime, &spi->UserTime);
-                                read_process_memory_stats(reply->unix_pid, &spi->vmCounters);
-                            }
-                            unix_pid = reply->unix_pid;
-                        }
-                        len += procstructlen;
-                    }
-                }
-                SERVER_END_REQ;
- 
-                if (ret != STATUS_SUCCESS)
-                {
-                    if (ret == STATUS_NO_MORE_FILES) ret = STATUS_SUCCESS;
-                    break;
-                }
+                    procstructlen = sizeof(*spi) + wlen +
+                        (max( info->thread_count, 1 ) - 1) * sizeof(SYSTEM_THREAD_INFORMATION);
+                    len += procstructlen;
+                    if (Length < len) continue;
 
-                if (Length >= len)
-                {
-                    int     i, j;
+                    /* ftCreationTime;
+                     * vmCounters, ioCounters
+                     */
+
+                    memset(spi, 0, sizeof(*spi));
+
+                    spi->NextEntryOffset = procstructlen - wlen;
+                    spi->dwThreadCount = info->thread_count;
+
+                    spi->dwBasePriority = info->priority;
+                    spi->UniqueProcessId = UlongToHandle(info->pid);
+                    spi->ParentProcessId = UlongToHandle(info->parent_pid);
+                    spi->HandleCount = info->handle_count;
+                    spi->CreationTime.QuadPart = info->start_time;
+
+                    if (info->unix_pid != -1)
+                    {
+                        read_process_time(info->unix_pid, -1, clk_tck,
+                                          &spi->KernelTime, &spi->UserTime);
+                        read_process_memory_stats(info->unix_pid, &spi->vmCounters);
+                    }
 
                     /* set thread info */
-                    i = j = 0;
-                    while (ret == STATUS_SUCCESS)
+                    for (j = 0; j < info->thread_count; j++)
                     {
-                        SERVER_START_REQ( next_thread )
-                        {
-                            req->handle = wine_server_obj_handle( hSnap );
-                            req->reset = (j == 0);
-                            if (!(ret = wine_server_call( req )))
-                            {
-                                j++;
-                                if (UlongToHandle(reply->pid) == spi->UniqueProcessId)
-                                {
-                                    /* ftKernelTime, ftUserTime, ftCreateTime;
-                                     * dwTickCount, dwStartAddress
-                                     */
-
-                                    memset(&spi->ti[i], 0, sizeof(spi->ti));
-
-                                    spi->ti[i].CreateTime.QuadPart = reply->creation_time;
-                                    spi->ti[i].ClientId.UniqueProcess = UlongToHandle(reply->pid);
-                                    spi->ti[i].ClientId.UniqueThread  = UlongToHandle(reply->tid);
-                                    spi->ti[i].dwCurrentPriority = reply->base_pri + reply->delta_pri;
-                                    spi->ti[i].dwBasePriority = reply->base_pri;
-
-                                    if (unix_pid != -1 && reply->unix_tid != -1)
-                                        read_process_time(unix_pid, reply->unix_tid, clk_tck,
-                                                          &spi->ti[i].KernelTime, &spi->ti[i].UserTime);
-                                    i++;
-                                }
-                            }
-                        }
-                        SERVER_END_REQ;
+                        /* ftKernelTime, ftUserTime, ftCreateTime;
+                         * dwTickCount, dwStartAddress
+                         */
+
+                        memset(&spi->ti[j], 0, sizeof(spi->ti));
+
+                        spi->ti[j].CreateTime.QuadPart = thread_info[j].start_time;
+                        spi->ti[j].ClientId.UniqueProcess = UlongToHandle(info->pid);
+                        spi->ti[j].ClientId.UniqueThread  = UlongToHandle(thread_info[j].tid);
+                        spi->ti[j].dwCurrentPriority = thread_info[j].current_priority;
+                        spi->ti[j].dwBasePriority = thread_info[j].base_priority;
+
+                        if (info->unix_pid != -1 && thread_info[j].unix_tid != -1)
+                            read_process_time(info->unix_pid, thread_info[j].unix_tid, clk_tck,
+                                              &spi->ti[j].KernelTime, &spi->ti[j].UserTime);
                     }
-                    if (ret == STATUS_NO_MORE_FILES) ret = STATUS_SUCCESS;
 
                     /* now append process name */
                     spi->ProcessName.Buffer = (WCHAR*)((char*)spi + spi->NextEntryOffset);
@@ -2273,10 +2314,10 @@ NTSTATUS WINAPI NtQuerySystemInformation(
                     last = spi;
                     spi = (SYSTEM_PROCESS_INFORMATION*)((char*)spi + spi->NextEntryOffset);
                 }
+                if (last) last->NextEntryOffset = 0;
+                if (len > Length) ret = STATUS_INFO_LENGTH_MISMATCH;
             }
-            if (ret == STATUS_SUCCESS && last) last->NextEntryOffset = 0;
-            if (len > Length) ret = STATUS_INFO_LENGTH_MISMATCH;
-            if (hSnap) NtClose(hSnap);
+            RtlLeaveCriticalSection( &process_list_section );
         }
         break;
     case SystemProcessorPerformanceInformation:
@@ -69,7 +69,11 @@ NTSTATUS WINAPI NtTerminateProcess( HANDLE handle, LONG exit_code )
         self = !ret && reply->self;
     }
     SERVER_END_REQ;
-    if (self && handle) _exit( exit_code );
+    if (self && handle)
+    {
+        debug_flush_output();
+        _exit( exit_code );
+    }
     return ret;
 }
 
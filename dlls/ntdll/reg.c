@@ -31,6 +31,7 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ntstatus.h"
@@ -38,6 +39,7 @@
 #include "wine/library.h"
 #include "ntdll_misc.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "wine/unicode.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(reg);
@@ -45,6 +47,290 @@ WINE_DEFAULT_DEBUG_CHANNEL(reg);
 /* maximum length of a value name in bytes (without terminating null) */
 #define MAX_VALUE_LENGTH (16383 * sizeof(WCHAR))
 
+/* Per-process cache of NtQueryValueKey results. Values are keyed by the server id of
+ * the key and the value name, and stay valid as long as the change counter of that key
+ * in the server shared memory doesn't move. Handles are mapped to key ids separately,
+ * the mapping is dropped when the handle is closed by this or by another process. */
+#define VALUE_CACHE_BUCKETS     256
+#define VALUE_CACHE_MAX_ENTRIES 4096
+#define VALUE_CACHE_MAX_DATA    2048
+
+struct cached_handle
+{
+    struct list  entry;
+    HANDLE       handle;
+    unsigned int key_id;
+};
+
+struct cached_value
+{
+    struct list  entry;
+    unsigned int key_id;
+    unsigned int key_seq;   /* key change counter at the time the value was read */
+    NTSTATUS     status;    /* STATUS_SUCCESS or STATUS_OBJECT_NAME_NOT_FOUND */
+    ULONG        type;
+    DWORD        data_len;
+    USHORT       name_len;  /* in bytes */
+    WCHAR        name[1];   /* followed by the value data */
+};
+
+struct value_cache_stamp
+{
+    unsigned int epoch;     /* handles closed by other processes before the server request */
+    unsigned int closed;    /* handles closed by this process before the server request */
+};
+
+static struct list handle_cache[VALUE_CACHE_BUCKETS];
+static struct list value_cache[VALUE_CACHE_BUCKETS];
+static unsigned int handle_cache_count;
+static unsigned int value_cache_count;
+static unsigned int value_cache_epoch;
+static unsigned int value_cache_closed;
+static unsigned int value_cache_hits;
+static unsigned int value_cache_misses;
+static const shmglobal_t *value_cache_shm;
+static int value_cache_enabled = -1;
+
+static RTL_CRITICAL_SECTION value_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG value_cache_section_debug =
+{
+    0, 0, &value_cache_section,
+    { &value_cache_section_debug.ProcessLocksList, &value_cache_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": value_cache_section") }
+};
+static RTL_CRITICAL_SECTION value_cache_section = { &value_cache_section_debug, -1, 0, 0, 0, 0 };
+
+/* the cache needs the key change counters from the server shared memory, and is opt-in */
+static BOOL value_cache_active(void)
+{
+    if (value_cache_enabled == -1)
+    {
+        const char *str = getenv( "STAGING_REGISTRY_CACHE" );
+        unsigned int i;
+
+        RtlEnterCriticalSection( &value_cache_section );
+        if (value_cache_enabled == -1)
+        {
+            for (i = 0; i < VALUE_CACHE_BUCKETS; i++)
+            {
+                list_init( &handle_cache[i] );
+                list_init( &value_cache[i] );
+            }
+            if (str && atoi( str ) && (value_cache_shm = server_get_shared_memory( 0 )))
+                value_cache_epoch = value_cache_shm->handle_close_epoch;
+            value_cache_enabled = value_cache_shm != NULL;
+            TRACE( "registry value cache %s\n", value_cache_enabled ? "enabled" : "disabled" );
+        }
+        RtlLeaveCriticalSection( &value_cache_section );
+    }
+    return value_cache_enabled > 0;
+}
+
+static inline struct list *handle_cache_bucket( HANDLE handle )
+{
+    return &handle_cache[((ULONG_PTR)handle >> 2) % VALUE_CACHE_BUCKETS];
+}
+
+static inline struct list *value_cache_bucket( unsigned int key_id )
+{
+    return &value_cache[key_id % VALUE_CACHE_BUCKETS];
+}
+
+static inline unsigned int get_key_seq( unsigned int key_id )
+{
+    return value_cache_shm->registry_seq[key_id % REGISTRY_SEQ_SLOTS];
+}
+
+/* must be called with the value cache section held */
+static void flush_handle_cache(void)
+{
+    struct cached_handle *cached, *next;
+    unsigned int i;
+
+    for (i = 0; i < VALUE_CACHE_BUCKETS; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( cached, next, &handle_cache[i], struct cached_handle, entry )
+        {
+            list_remove( &cached->entry );
+            RtlFreeHeap( GetProcessHeap(), 0, cached );
+        }
+    }
+    handle_cache_count = 0;
+}
+
+/* must be called with the value cache section held */
+static void flush_value_cache(void)
+{
+    struct cached_value *value, *next;
+    unsigned int i;
+
+    TRACE( "flushing %u values, %u hits, %u misses\n", value_cache_count, value_cache_hits, value_cache_misses );
+
+    for (i = 0; i < VALUE_CACHE_BUCKETS; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( value, next, &value_cache[i], struct cached_value, entry )
+        {
+            list_remove( &value->entry );
+            RtlFreeHeap( GetProcessHeap(), 0, value );
+        }
+    }
+    value_cache_count = 0;
+}
+
+/* handle values may have been reused if another process closed some of our handles;
+ * must be called with the value cache section held */
+static void check_value_cache_epoch(void)
+{
+    unsigned int epoch = value_cache_shm->handle_close_epoch;
+
+    if (epoch == value_cache_epoch) return;
+    if (handle_cache_count) flush_handle_cache();
+    value_cache_epoch = epoch;
+}
+
+static struct cached_handle *find_cached_handle( HANDLE handle )
+{
+    struct cached_handle *cached;
+
+    LIST_FOR_EACH_ENTRY( cached, handle_cache_bucket( handle ), struct cached_handle, entry )
+        if (cached->handle == handle) return cached;
+    return NULL;
+}
+
+static struct cached_value *find_cached_value( unsigned int key_id, const UNICODE_STRING *name )
+{
+    struct cached_value *value;
+
+    LIST_FOR_EACH_ENTRY( value, value_cache_bucket( key_id ), struct cached_value, entry )
+    {
+        if (value->key_id == key_id && value->name_len == name->Length &&
+            !memcmp( value->name, name->Buffer, name->Length ))
+            return value;
+    }
+    return NULL;
+}
+
+/* look up a value in the cache; on a miss, stamp is filled for add_cached_value */
+static BOOL get_cached_value( HANDLE handle, const UNICODE_STRING *name, void *data, DWORD data_size,
+                              ULONG *type, DWORD *total, NTSTATUS *status, struct value_cache_stamp *stamp )
+{
+    struct cached_handle *cached;
+    struct cached_value *value = NULL;
+    BOOL ret = FALSE;
+
+    RtlEnterCriticalSection( &value_cache_section );
+
+    check_value_cache_epoch();
+    if ((cached = find_cached_handle( handle )) && (value = find_cached_value( cached->key_id, name )) &&
+        value->key_seq != get_key_seq( value->key_id ))
+    {
+        list_remove( &value->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, value );
+        value_cache_count--;
+        value = NULL;
+    }
+
+    if (value)
+    {
+        *status = value->status;
+        *type   = value->type;
+        *total  = value->data_len;
+        if (data) memcpy( data, (char *)value->name + value->name_len, min( data_size, value->data_len ) );
+        value_cache_hits++;
+        ret = TRUE;
+    }
+    else
+    {
+        stamp->epoch  = value_cache_epoch;
+        stamp->closed = value_cache_closed;
+        value_cache_misses++;
+    }
+
+    RtlLeaveCriticalSection( &value_cache_section );
+    return ret;
+}
+
+static void add_cached_value( HANDLE handle, const UNICODE_STRING *name, NTSTATUS status, ULONG type,
+                              const void *data, DWORD data_size, DWORD total, unsigned int key_id,
+                              unsigned int key_seq, const struct value_cache_stamp *stamp )
+{
+    struct cached_handle *cached;
+    struct cached_value *value;
+
+    if (status == STATUS_OBJECT_NAME_NOT_FOUND) total = 0;
+    else if (status || total > data_size || total > VALUE_CACHE_MAX_DATA || (total && !data)) return;
+
+    RtlEnterCriticalSection( &value_cache_section );
+
+    /* the handle may have been closed and reused during the request */
+    check_value_cache_epoch();
+    if (value_cache_epoch == stamp->epoch && value_cache_closed == stamp->closed &&
+        !find_cached_handle( handle ))
+    {
+        if (handle_cache_count >= VALUE_CACHE_MAX_ENTRIES) flush_handle_cache();
+        if ((cached = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*cached) )))
+        {
+            cached->handle = handle;
+            cached->key_id = key_id;
+            list_add_head( handle_cache_bucket( handle ), &cached->entry );
+            handle_cache_count++;
+        }
+    }
+
+    /* the value may have changed since the server replied */
+    if (key_seq != get_key_seq( key_id )) goto done;
+
+    if ((value = find_cached_value( key_id, name )))
+    {
+        list_remove( &value->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, value );
+        value_cache_count--;
+    }
+
+    if (value_cache_count >= VALUE_CACHE_MAX_ENTRIES) flush_value_cache();
+    if (!(value = RtlAllocateHeap( GetProcessHeap(), 0,
+                                   FIELD_OFFSET( struct cached_value, name ) + name->Length + total )))
+        goto done;
+
+    value->key_id   = key_id;
+    value->key_seq  = key_seq;
+    value->status   = status;
+    value->type     = type;
+    value->data_len = total;
+    value->name_len = name->Length;
+    memcpy( value->name, name->Buffer, name->Length );
+    if (total) memcpy( (char *)value->name + name->Length, data, total );
+    list_add_head( value_cache_bucket( key_id ), &value->entry );
+    value_cache_count++;
+
+done:
+    RtlLeaveCriticalSection( &value_cache_section );
+}
+
+/***********************************************************************
+ *           invalidate_value_cache
+ *
+ * Drop the key id cached for a handle that is being closed.
+ */
+void invalidate_value_cache( HANDLE handle )
+{
+    struct cached_handle *cached;
+
+    if (value_cache_enabled <= 0) return;
+
+    RtlEnterCriticalSection( &value_cache_section );
+
+    value_cache_closed++;
+    if ((cached = find_cached_handle( handle )))
+    {
+        list_remove( &cached->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, cached );
+        handle_cache_count--;
+    }
+
+    RtlLeaveCriticalSection( &value_cache_section );
+}
+
 /******************************************************************************
  * NtCreateKey [NTDLL.@]
  * ZwCreateKey [NTDLL.@]
@@ -537,6 +823,11 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
     NTSTATUS ret;
     UCHAR *data_ptr;
     unsigned int fixed_size, min_size;
+    struct value_cache_stamp stamp = { 0, 0 };
+    unsigned int key_id = 0, key_seq = 0;
+    DWORD data_size, total = 0;
+    ULONG type = 0;
+    BOOL use_cache;
 
     TRACE( "(%p,%s,%d,%p,%d)\n", handle, debugstr_us(name), info_class, info, length );
 
@@ -574,21 +865,38 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
-    SERVER_START_REQ( get_key_value )
+    data_size = (length > fixed_size && data_ptr) ? length - fixed_size : 0;
+
+    use_cache = value_cache_active();
+    if (!use_cache ||
+        !get_cached_value( handle, name, data_ptr, data_size, &type, &total, &ret, &stamp ))
     {
-        req->hkey = wine_server_obj_handle( handle );
-        wine_server_add_data( req, name->Buffer, name->Length );
-        if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
-        if (!(ret = wine_server_call( req )))
+        SERVER_START_REQ( get_key_value )
         {
-            copy_key_value_info( info_class, info, length, reply->type,
-                                 name->Length, reply->total );
-            *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : reply->total);
-            if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
-            else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
+            req->hkey = wine_server_obj_handle( handle );
+            wine_server_add_data( req, name->Buffer, name->Length );
+            if (data_size) wine_server_set_reply( req, data_ptr, data_size );
+            if (!(ret = wine_server_call( req )))
+            {
+                type  = reply->type;
+                total = reply->total;
+            }
+            key_id  = reply->key_id;
+            key_seq = reply->key_seq;
         }
+        SERVER_END_REQ;
+
+        if (use_cache && key_id)
+            add_cached_value( handle, name, ret, type, data_ptr, data_size, total, key_id, key_seq, &stamp );
+    }
+
+    if (!ret)
+    {
+        copy_key_value_info( info_class, info, length, type, name->Length, total );
+        *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : total);
+        if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
+        else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
     }
-    SERVER_END_REQ;
     return ret;
 }
 
@@ -34,6 +34,8 @@
 #include "wine/exception.h"
 #include "ntdll_misc.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
+#include "wine/relay_log.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(relay);
@@ -70,6 +72,7 @@ struct relay_private_data
     HMODULE                  module;            /* module handle of this dll */
     unsigned int             base;              /* ordinal base */
     char                     dllname[40];       /* dll name (without .dll extension) */
+    unsigned short           log_id;            /* module id in the binary relay log */
     struct relay_entry_point entry_points[1];   /* list of dll entry points */
 };
 
@@ -84,6 +87,32 @@ static const WCHAR **debug_from_snoop_includelist;
 
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
+/* binary relay log, see include/wine/relay_log.h for the format */
+
+#define RELAY_LOG_BUFFER_SIZE 0x10000
+
+struct relay_log_buffer
+{
+    struct list   entry;
+    volatile LONG busy;  /* set while the owning thread is writing a record */
+    unsigned int  pos;
+    char          data[RELAY_LOG_BUFFER_SIZE];
+};
+
+static HANDLE relay_log_file;
+static unsigned short relay_log_modules;
+static struct list relay_log_buffers = LIST_INIT( relay_log_buffers );
+static volatile LONG relay_log_exiting;
+
+static RTL_CRITICAL_SECTION relay_log_section;
+static RTL_CRITICAL_SECTION_DEBUG relay_log_section_debug =
+{
+    0, 0, &relay_log_section,
+    { &relay_log_section_debug.ProcessLocksList, &relay_log_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": relay_log_section") }
+};
+static RTL_CRITICAL_SECTION relay_log_section = { &relay_log_section_debug, -1, 0, 0, 0, 0 };
+
 /* compare an ASCII and a Unicode string without depending on the current codepage */
 static inline int strcmpAW( const char *strA, const WCHAR *strW )
 {
@@ -168,6 +197,53 @@ static const WCHAR **load_list( HKEY hkey, const WCHAR *value )
     return list;
 }
 
+/***********************************************************************
+ *           open_relay_log
+ *
+ * Open the binary relay log. The process id is appended to the file name.
+ */
+static void open_relay_log( const WCHAR *prefix )
+{
+    static const WCHAR fmtW[] = {'%','s','.','%','0','4','x',0};
+    WCHAR path[MAX_PATH];
+    UNICODE_STRING nt_name;
+    OBJECT_ATTRIBUTES attr;
+    IO_STATUS_BLOCK io;
+    LARGE_INTEGER counter, frequency;
+    struct relay_log_header header;
+    HANDLE file;
+    NTSTATUS status;
+
+    if (strlenW( prefix ) >= MAX_PATH - 10) return;
+    sprintfW( path, fmtW, prefix, GetCurrentProcessId() );
+    if (!RtlDosPathNameToNtPathName_U( path, &nt_name, NULL, NULL )) return;
+
+    attr.Length = sizeof(attr);
+    attr.RootDirectory = 0;
+    attr.ObjectName = &nt_name;
+    attr.Attributes = OBJ_CASE_INSENSITIVE;
+    attr.SecurityDescriptor = NULL;
+    attr.SecurityQualityOfService = NULL;
+    status = NtCreateFile( &file, FILE_APPEND_DATA | SYNCHRONIZE, &attr, &io, NULL, FILE_ATTRIBUTE_NORMAL,
+                           FILE_SHARE_READ, FILE_OVERWRITE_IF, FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE,
+                           NULL, 0 );
+    RtlFreeUnicodeString( &nt_name );
+    if (status)
+    {
+        ERR( "cannot create relay log %s, status %x\n", debugstr_w(path), status );
+        return;
+    }
+
+    NtQueryPerformanceCounter( &counter, &frequency );
+    header.magic        = RELAY_LOG_MAGIC;
+    header.version      = RELAY_LOG_VERSION;
+    header.pid          = GetCurrentProcessId();
+    header.pointer_size = sizeof(void *);
+    header.frequency    = frequency.QuadPart;
+    NtWriteFile( file, 0, NULL, NULL, &io, &header, sizeof(header), NULL, NULL );
+    relay_log_file = file;
+}
+
 /***********************************************************************
  *           init_debug_lists
  *
@@ -189,6 +265,8 @@ static DWORD WINAPI init_debug_lists( RTL_RUN_ONCE *once, void *param, void **co
     static const WCHAR RelayFromExcludeW[] = {'R','e','l','a','y','F','r','o','m','E','x','c','l','u','d','e',0};
     static const WCHAR SnoopFromIncludeW[] = {'S','n','o','o','p','F','r','o','m','I','n','c','l','u','d','e',0};
     static const WCHAR SnoopFromExcludeW[] = {'S','n','o','o','p','F','r','o','m','E','x','c','l','u','d','e',0};
+    static const WCHAR RelayLogW[] = {'R','e','l','a','y','L','o','g',0};
+    const WCHAR **relay_log;
 
     RtlOpenCurrentUser( KEY_ALL_ACCESS, &root );
     attr.Length = sizeof(attr);
@@ -213,6 +291,12 @@ static DWORD WINAPI init_debug_lists( RTL_RUN_ONCE *once, void *param, void **co
     debug_from_snoop_includelist = load_list( hkey, SnoopFromIncludeW );
     debug_from_snoop_excludelist = load_list( hkey, SnoopFromExcludeW );
 
+    if ((relay_log = load_list( hkey, RelayLogW )))
+    {
+        open_relay_log( relay_log[0] );
+        RtlFreeHeap( GetProcessHeap(), 0, relay_log );
+    }
+
     NtClose( hkey );
     return TRUE;
 }
@@ -298,6 +382,210 @@ static BOOL check_from_module( const WCHAR **includelist, const WCHAR **excludel
     return show;
 }
 
+/***********************************************************************
+ *           get_relay_log_buffer
+ *
+ * Get the binary relay log buffer of the current thread.
+ */
+static struct relay_log_buffer *get_relay_log_buffer(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct relay_log_buffer *buffer = thread_data->relay_log;
+
+    if (!buffer && (buffer = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*buffer) )))
+    {
+        buffer->busy = 0;
+        buffer->pos = 0;
+        RtlEnterCriticalSection( &relay_log_section );
+        list_add_tail( &relay_log_buffers, &buffer->entry );
+        RtlLeaveCriticalSection( &relay_log_section );
+        thread_data->relay_log = buffer;
+    }
+    return buffer;
+}
+
+static void flush_relay_log_buffer( struct relay_log_buffer *buffer )
+{
+    IO_STATUS_BLOCK io;
+
+    if (buffer->pos) NtWriteFile( relay_log_file, 0, NULL, NULL, &io, buffer->data, buffer->pos, NULL, NULL );
+    buffer->pos = 0;
+}
+
+/***********************************************************************
+ *           begin_relay_log_record
+ *
+ * Mark the buffer as being written to. Once the process has started exiting,
+ * buffers are flushed by another thread, so the record is written under the
+ * lock and flushed right away instead; returns TRUE in that case.
+ */
+static BOOL begin_relay_log_record( struct relay_log_buffer *buffer )
+{
+    InterlockedExchange( &buffer->busy, 1 );
+    if (!relay_log_exiting) return FALSE;
+    InterlockedExchange( &buffer->busy, 0 );
+    RtlEnterCriticalSection( &relay_log_section );
+    return TRUE;
+}
+
+static void end_relay_log_record( struct relay_log_buffer *buffer, BOOL locked )
+{
+    if (!locked)
+    {
+        InterlockedExchange( &buffer->busy, 0 );
+        return;
+    }
+    flush_relay_log_buffer( buffer );
+    RtlLeaveCriticalSection( &relay_log_section );
+}
+
+/***********************************************************************
+ *           alloc_relay_log_record
+ *
+ * Reserve space for a record in the buffer, flushing it to the file if full.
+ */
+static void *alloc_relay_log_record( struct relay_log_buffer *buffer, unsigned short type, unsigned int size )
+{
+    struct relay_log_record *record;
+    LARGE_INTEGER now;
+
+    size = (size + 7) & ~7;
+    if (buffer->pos + size > sizeof(buffer->data)) flush_relay_log_buffer( buffer );
+
+    record = (struct relay_log_record *)(buffer->data + buffer->pos);
+    buffer->pos += size;
+
+    NtQueryPerformanceCounter( &now, NULL );
+    record->type = type;
+    record->size = size;
+    record->tid  = GetCurrentThreadId();
+    record->time = now.QuadPart;
+    return record;
+}
+
+/***********************************************************************
+ *           RELAY_FlushLog
+ *
+ * Write out and free the buffered binary relay records of the current thread.
+ * When the process is exiting, the buffers of the other threads are written
+ * out too; they are still in use until the process is terminated, so they are
+ * not freed, and the records logged from then on are written out directly.
+ */
+void RELAY_FlushLog( BOOL process_exit )
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct relay_log_buffer *buffer;
+
+    if (!relay_log_file) return;
+
+    if (process_exit) InterlockedExchange( &relay_log_exiting, TRUE );
+
+    RtlEnterCriticalSection( &relay_log_section );
+    if (process_exit)
+    {
+        LIST_FOR_EACH_ENTRY( buffer, &relay_log_buffers, struct relay_log_buffer, entry )
+        {
+            /* wait for the record being written by the owning thread */
+            while (buffer->busy) NtYieldExecution();
+            flush_relay_log_buffer( buffer );
+        }
+    }
+    if ((buffer = thread_data->relay_log))
+    {
+        flush_relay_log_buffer( buffer );
+        list_remove( &buffer->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, buffer );
+        thread_data->relay_log = NULL;
+    }
+    RtlLeaveCriticalSection( &relay_log_section );
+}
+
+/***********************************************************************
+ *           log_relay_module
+ *
+ * Write the module and function name records for a newly relayed dll.
+ */
+static void log_relay_module( struct relay_private_data *data, unsigned int nb_entry_points )
+{
+    struct relay_log_buffer *buffer;
+    struct relay_log_module *module;
+    struct relay_log_name *name;
+    unsigned int i, len;
+
+    if (!(buffer = get_relay_log_buffer())) return;
+
+    RtlEnterCriticalSection( &relay_log_section );
+    data->log_id = relay_log_modules++;
+
+    len = strlen( data->dllname );
+    module = alloc_relay_log_record( buffer, RELAY_LOG_MODULE, offsetof( struct relay_log_module, name[len + 1] ));
+    module->module = data->log_id;
+    module->pad    = 0;
+    module->base   = data->base;
+    memcpy( module->name, data->dllname, len + 1 );
+
+    for (i = 0; i < nb_entry_points; i++)
+    {
+        if (!data->entry_points[i].orig_func || !data->entry_points[i].name) continue;
+        len = min( strlen( data->entry_points[i].name ), 1024 );
+        name = alloc_relay_log_record( buffer, RELAY_LOG_NAME, offsetof( struct relay_log_name, name[len + 1] ));
+        name->module  = data->log_id;
+        name->ordinal = i;
+        name->pad     = 0;
+        memcpy( name->name, data->entry_points[i].name, len );
+        name->name[len] = 0;
+    }
+
+    /* names have to be in the file before any call record referencing them */
+    flush_relay_log_buffer( buffer );
+    RtlLeaveCriticalSection( &relay_log_section );
+}
+
+/***********************************************************************
+ *           log_relay_call
+ */
+static void log_relay_call( const struct relay_private_data *data, WORD ordinal,
+                            BYTE nb_args, const INT_PTR *stack )
+{
+    struct relay_log_buffer *buffer;
+    struct relay_log_call *call;
+    unsigned int i;
+    BOOL locked;
+
+    if (!(buffer = get_relay_log_buffer())) return;
+
+    locked = begin_relay_log_record( buffer );
+    call = alloc_relay_log_record( buffer, RELAY_LOG_CALL, offsetof( struct relay_log_call, args[nb_args] ));
+    call->module   = data->log_id;
+    call->ordinal  = ordinal;
+    call->nb_args  = nb_args;
+    call->ret_addr = (ULONG_PTR)stack[0];
+    for (i = 0; i < nb_args; i++) call->args[i] = (ULONG_PTR)stack[i + 1];
+    end_relay_log_record( buffer, locked );
+}
+
+/***********************************************************************
+ *           log_relay_ret
+ */
+static void log_relay_ret( const struct relay_private_data *data, WORD ordinal, BYTE flags,
+                           const INT_PTR *stack, LONGLONG retval )
+{
+    struct relay_log_buffer *buffer;
+    struct relay_log_ret *ret;
+    BOOL locked;
+
+    if (!(buffer = get_relay_log_buffer())) return;
+
+    locked = begin_relay_log_record( buffer );
+    ret = alloc_relay_log_record( buffer, RELAY_LOG_RET, sizeof(*ret) );
+    ret->module   = data->log_id;
+    ret->ordinal  = ordinal;
+    ret->pad      = 0;
+    ret->ret_addr = (ULONG_PTR)stack[0];
+    ret->retval   = (flags & 1) ? retval : (UINT_PTR)retval;
+    end_relay_log_record( buffer, locked );
+}
+
 /***********************************************************************
  *           RELAY_PrintArgs
  */
@@ -338,7 +626,9 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr,
     struct relay_private_data *data = descr->private;
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
 
-    if (TRACE_ON(relay))
+    if (relay_log_file)
+        log_relay_call( data, ordinal, nb_args, stack );
+    else if (TRACE_ON(relay))
     {
         if (TRACE_ON(timestamp)) print_timestamp();
 
@@ -366,6 +656,11 @@ DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigne
     struct relay_private_data *data = descr->private;
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
 
+    if (relay_log_file)
+    {
+        log_relay_ret( data, ordinal, flags, stack, retval );
+        return;
+    }
     if (!TRACE_ON(relay)) return;
 
     if (TRACE_ON(timestamp)) print_timestamp();
@@ -730,6 +1025,8 @@ void RELAY_SetupDLL( HMODULE module )
         data->entry_points[i].orig_func = (char *)module + *funcs;
         *funcs = entry_point_rva + descr->entry_point_offsets[i];
     }
+
+    if (relay_log_file) log_relay_module( data, exports->NumberOfFunctions );
 }
 
 #else  /* __i386__ || __x86_64__ || __arm__ || __aarch64__ */
@@ -744,6 +1041,10 @@ void RELAY_SetupDLL( HMODULE module )
 {
 }
 
+void RELAY_FlushLog( BOOL process_exit )
+{
+}
+
 #endif  /* __i386__ || __x86_64__ || __arm__ || __aarch64__ */
 
 
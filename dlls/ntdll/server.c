@@ -42,6 +42,9 @@
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_IOCTL_H
+# include <sys/ioctl.h>
+#endif
 #ifdef HAVE_SYS_WAIT_H
 #include <sys/wait.h>
 #endif
@@ -635,6 +638,7 @@ unsigned int server_select( const select_op_t *select_op, data_size_t size, UINT
         SERVER_END_REQ;
         if (ret == STATUS_PENDING)
         {
+            debug_flush_output();
             pthread_sigmask( SIG_SETMASK, &old_set, NULL );
             ret = wait_select_reply( &cookie );
             pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
@@ -1250,6 +1254,96 @@ static void start_server(void)
 }
 
 
+#if defined(__linux__) && defined(HAVE_SYS_IOCTL_H) && !defined(FICLONE)
+# define FICLONE _IOW(0x94, 9, int)
+#endif
+
+/***********************************************************************
+ *           clone_file
+ *
+ * Copy a file of the prefix template, sharing the data blocks with the
+ * original when the filesystem supports it.
+ */
+static int clone_file( const char *src, const char *dst, mode_t mode )
+{
+    char buffer[65536];
+    ssize_t count, written, pos;
+    int in, out, ret = -1;
+
+    if ((in = open( src, O_RDONLY )) == -1) return -1;
+    if ((out = open( dst, O_WRONLY | O_CREAT | O_EXCL, mode )) == -1)
+    {
+        close( in );
+        return -1;
+    }
+#ifdef FICLONE
+    if (!ioctl( out, FICLONE, in )) ret = 0;
+    else
+#endif
+    {
+        while ((count = read( in, buffer, sizeof(buffer) )) > 0)
+        {
+            for (pos = 0; pos < count; pos += written)
+                if ((written = write( out, buffer + pos, count - pos )) <= 0) break;
+            if (pos < count) break;
+        }
+        if (!count) ret = 0;
+    }
+    close( in );
+    close( out );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           clone_dir
+ *
+ * Recursively copy a directory of the prefix template.
+ */
+static int clone_dir( const char *src, const char *dst )
+{
+    DIR *dir;
+    struct dirent *de;
+    struct stat st;
+    char *src_name, *dst_name, link[1024];
+    ssize_t len;
+    int ret = 0;
+
+    if (!(dir = opendir( src ))) return -1;
+    while (!ret && (de = readdir( dir )))
+    {
+        if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
+        src_name = malloc( strlen(src) + strlen(de->d_name) + 2 );
+        dst_name = malloc( strlen(dst) + strlen(de->d_name) + 2 );
+        if (!src_name || !dst_name) fatal_error( "out of memory\n" );
+        sprintf( src_name, "%s/%s", src, de->d_name );
+        sprintf( dst_name, "%s/%s", dst, de->d_name );
+
+        if (lstat( src_name, &st ) == -1) ret = -1;
+        else if (S_ISDIR( st.st_mode ))
+        {
+            if (mkdir( dst_name, st.st_mode & 07777 ) == -1) ret = -1;
+            else ret = clone_dir( src_name, dst_name );
+        }
+        else if (S_ISLNK( st.st_mode ))
+        {
+            if ((len = readlink( src_name, link, sizeof(link) - 1 )) == -1) ret = -1;
+            else
+            {
+                link[len] = 0;
+                ret = symlink( link, dst_name );
+            }
+        }
+        else if (S_ISREG( st.st_mode )) ret = clone_file( src_name, dst_name, st.st_mode & 07777 );
+
+        free( src_name );
+        free( dst_name );
+    }
+    closedir( dir );
+    return ret;
+}
+
+
 /***********************************************************************
  *           setup_config_dir
  *
@@ -1280,7 +1374,22 @@ static void setup_config_dir(void)
         mkdir( config_dir, 0777 );
         if (chdir( config_dir ) == -1) fatal_perror( "chdir to %s\n", config_dir );
 
-        MESSAGE( "wine: created the configuration directory '%s'\n", config_dir );
+        /* start from a copy of a pristine prefix if one is provided; the copy is made
+         * before the server is started so that it loads the template registry */
+        if ((p = getenv( "WINEPREFIX_TEMPLATE" )) && *p)
+        {
+            if (!clone_dir( p, config_dir ))
+            {
+                MESSAGE( "wine: created the configuration directory '%s' from '%s'\n", config_dir, p );
+            }
+            else
+            {
+                /* make sure wineboot completes a partial copy */
+                MESSAGE( "wine: failed to copy '%s', updating the configuration directory\n", p );
+                unlink( ".update-timestamp" );
+            }
+        }
+        else MESSAGE( "wine: created the configuration directory '%s'\n", config_dir );
     }
 
     if (mkdir( "dosdevices", 0777 ) == -1)
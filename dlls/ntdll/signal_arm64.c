@@ -953,7 +953,7 @@ void call_thread_entry_point( LPTHREAD_START_ROUTINE entry, void *arg )
     {
         exit_thread( entry( arg ));
     }
-    __EXCEPT(unhandled_exception_filter)
+    __EXCEPT(call_unhandled_exception_filter)
     {
         NtTerminateThread( GetCurrentThread(), GetExceptionCode() );
     }
@@ -624,7 +624,7 @@ static NTSTATUS call_stack_handlers( EXCEPTION_RECORD *rec, CONTEXT *context )
     /* hack: call unhandled exception filter directly */
     ptrs.ExceptionRecord = rec;
     ptrs.ContextRecord = context;
-    unhandled_exception_filter( &ptrs );
+    call_unhandled_exception_filter( &ptrs );
     return STATUS_UNHANDLED_EXCEPTION;
 }
 
@@ -1155,7 +1155,7 @@ void call_thread_entry_point( LPTHREAD_START_ROUTINE entry, void *arg )
     {
         exit_thread( entry( arg ));
     }
-    __EXCEPT(unhandled_exception_filter)
+    __EXCEPT(call_unhandled_exception_filter)
     {
         NtTerminateThread( GetCurrentThread(), GetExceptionCode() );
     }
@@ -1096,6 +1096,7 @@ NTSTATUS WINAPI NtDelayExecution( BOOLEAN alertable, const LARGE_INTEGER *timeou
 
     if (!timeout || timeout->QuadPart == TIMEOUT_INFINITE)  /* sleep forever */
     {
+        debug_flush_output();
         for (;;) select( 0, NULL, NULL, NULL, NULL );
     }
     else
@@ -1112,6 +1113,7 @@ NTSTATUS WINAPI NtDelayExecution( BOOLEAN alertable, const LARGE_INTEGER *timeou
         /* Note that we yield after establishing the desired timeout */
         NtYieldExecution();
         if (!when) return STATUS_SUCCESS;
+        debug_flush_output();
 
         for (;;)
         {
@@ -383,6 +383,84 @@ static void test_query_process(void)
     HeapFree( GetProcessHeap(), 0, spi_buf);
 }
 
+/* look up the current process in the process list; returns the entry in a buffer that must be freed */
+static SYSTEM_PROCESS_INFORMATION *get_current_process_info( void **buffer )
+{
+    SYSTEM_PROCESS_INFORMATION *spi;
+    ULONG size = 0x4000, offset = 0;
+    NTSTATUS status;
+
+    *buffer = HeapAlloc( GetProcessHeap(), 0, size );
+    while ((status = pNtQuerySystemInformation( SystemProcessInformation, *buffer, size, NULL ))
+           == STATUS_INFO_LENGTH_MISMATCH)
+        *buffer = HeapReAlloc( GetProcessHeap(), 0, *buffer, size *= 2 );
+    ok( status == STATUS_SUCCESS, "got %08x\n", status );
+    if (status) return NULL;
+
+    for (;;)
+    {
+        spi = (SYSTEM_PROCESS_INFORMATION *)((char *)*buffer + offset);
+        if (HandleToUlong( spi->UniqueProcessId ) == GetCurrentProcessId()) return spi;
+        if (!spi->NextEntryOffset) return NULL;
+        offset += spi->NextEntryOffset;
+    }
+}
+
+static BOOL is_thread_listed( DWORD tid, ULONG *handles )
+{
+    SYSTEM_PROCESS_INFORMATION *spi;
+    BOOL found = FALSE;
+    void *buffer;
+    DWORD i;
+
+    if ((spi = get_current_process_info( &buffer )))
+    {
+        for (i = 0; i < spi->dwThreadCount; i++)
+            if (HandleToUlong( spi->ti[i].ClientId.UniqueThread ) == tid) found = TRUE;
+        if (handles) *handles = spi->HandleCount;
+    }
+    else ok( 0, "current process not found\n" );
+    HeapFree( GetProcessHeap(), 0, buffer );
+    return found;
+}
+
+static DWORD WINAPI wait_thread_proc( void *arg )
+{
+    WaitForSingleObject( arg, INFINITE );
+    return 0;
+}
+
+static void test_query_process_changes(void)
+{
+    HANDLE event, thread, handles[32];
+    ULONG count_before, count_after;
+    DWORD tid, i;
+
+    ok( is_thread_listed( GetCurrentThreadId(), &count_before ), "current thread not listed\n" );
+    ok( is_thread_listed( GetCurrentThreadId(), NULL ), "current thread not listed\n" );
+
+    /* the handle count is updated even if no thread was added or removed */
+    for (i = 0; i < sizeof(handles)/sizeof(handles[0]); i++) handles[i] = CreateEventA( NULL, FALSE, FALSE, NULL );
+    ok( is_thread_listed( GetCurrentThreadId(), &count_after ), "current thread not listed\n" );
+    ok( count_after >= count_before + sizeof(handles)/sizeof(handles[0]),
+        "handle count went from %u to %u\n", count_before, count_after );
+    for (i = 0; i < sizeof(handles)/sizeof(handles[0]); i++) CloseHandle( handles[i] );
+
+    event = CreateEventA( NULL, TRUE, FALSE, NULL );
+    thread = CreateThread( NULL, 0, wait_thread_proc, event, 0, &tid );
+    ok( thread != NULL, "CreateThread failed %u\n", GetLastError() );
+    ok( is_thread_listed( tid, NULL ), "new thread not listed\n" );
+    ok( is_thread_listed( tid, NULL ), "new thread not listed\n" );
+
+    SetEvent( event );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+    ok( !is_thread_listed( tid, NULL ), "terminated thread still listed\n" );
+    ok( is_thread_listed( GetCurrentThreadId(), NULL ), "current thread not listed\n" );
+
+    CloseHandle( event );
+}
+
 static void test_query_procperf(void)
 {
     NTSTATUS status;
@@ -2280,6 +2358,7 @@ START_TEST(info)
     /* 0x5 SystemProcessInformation */
     trace("Starting test_query_process()\n");
     test_query_process();
+    test_query_process_changes();
 
     /* 0x8 SystemProcessorPerformanceInformation */
     trace("Starting test_query_procperf()\n");
@@ -508,6 +508,7 @@ HANDLE thread_init(void)
 
     debug_info.str_pos = debug_info.strings;
     debug_info.out_pos = debug_info.output;
+    debug_info.buf_pos = debug_info.buffer;
     debug_init();
 
     /* setup the server connection */
@@ -548,11 +549,22 @@ HANDLE thread_init(void)
 }
 
 
+/***********************************************************************
+ *           call_unhandled_exception_filter
+ */
+LONG WINAPI call_unhandled_exception_filter( PEXCEPTION_POINTERS eptr )
+{
+    debug_dump_ring_buffer();
+    return unhandled_exception_filter( eptr );
+}
+
+
 /***********************************************************************
  *           terminate_thread
  */
 void terminate_thread( int status )
 {
+    debug_flush_output();
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
     if (interlocked_xchg_add( &nb_threads, -1 ) <= 1) _exit( status );
 
@@ -588,6 +600,7 @@ void exit_thread( int status )
     if (interlocked_xchg_add( &nb_threads, 0 ) <= 1)
     {
         LdrShutdownProcess();
+        debug_flush_output();
         exit( status );
     }
 
@@ -616,6 +629,7 @@ void exit_thread( int status )
         }
     }
 
+    debug_flush_output();
     sigemptyset( &sigset );
     sigaddset( &sigset, SIGQUIT );
     pthread_sigmask( SIG_BLOCK, &sigset, NULL );
@@ -644,6 +658,7 @@ static void start_thread( struct startup_info *info )
 
     debug_info.str_pos = debug_info.strings;
     debug_info.out_pos = debug_info.output;
+    debug_info.buf_pos = debug_info.buffer;
     thread_data->debug_info = &debug_info;
     thread_data->pthread_id = pthread_self();
 
@@ -97,7 +97,7 @@ static inline BOOL IsLeapYear(int Year)
 }
 
 /* return a monotonic time counter, in Win32 ticks */
-static ULONGLONG monotonic_counter(void)
+ULONGLONG monotonic_counter(void)
 {
     struct timeval now;
 
@@ -66,6 +66,7 @@
 #include "moniker.h"
 
 #include "wine/unicode.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ole);
@@ -150,6 +151,13 @@ struct progidredirect_data
     ULONG clsid_offset;
 };
 
+enum class_reg_data_origin
+{
+    CLASS_REG_ACTCTX,
+    CLASS_REG_REGISTRY,
+    CLASS_REG_CACHE,
+};
+
 struct class_reg_data
 {
     union
@@ -161,8 +169,13 @@ struct class_reg_data
             HANDLE hactctx;
         } actctx;
         HKEY hkey;
+        struct
+        {
+            enum comclass_threadingmodel model;
+            WCHAR dllpath[MAX_PATH+1];
+        } cache;
     } u;
-    BOOL hkey;
+    enum class_reg_data_origin origin;
 };
 
 struct registered_psclsid
@@ -1387,7 +1400,7 @@ static DWORD COM_RegReadPath(const struct class_reg_data *regdata, WCHAR *dst, D
 {
     DWORD ret;
 
-    if (regdata->hkey)
+    if (regdata->origin == CLASS_REG_REGISTRY)
     {
 	DWORD keytype;
 	WCHAR src[MAX_PATH];
@@ -1412,6 +1425,12 @@ static DWORD COM_RegReadPath(const struct class_reg_data *regdata, WCHAR *dst, D
         }
 	return ret;
     }
+    else if (regdata->origin == CLASS_REG_CACHE)
+    {
+        if (!regdata->u.cache.dllpath[0]) return ERROR_FILE_NOT_FOUND;
+        lstrcpynW(dst, regdata->u.cache.dllpath, dstlen);
+        return ERROR_SUCCESS;
+    }
     else
     {
         ULONG_PTR cookie;
@@ -2853,7 +2872,7 @@ HRESULT WINAPI CoRegisterClassObject(
 
 static enum comclass_threadingmodel get_threading_model(const struct class_reg_data *data)
 {
-    if (data->hkey)
+    if (data->origin == CLASS_REG_REGISTRY)
     {
         static const WCHAR wszThreadingModel[] = {'T','h','r','e','a','d','i','n','g','M','o','d','e','l',0};
         static const WCHAR wszApartment[] = {'A','p','a','r','t','m','e','n','t',0};
@@ -2876,10 +2895,182 @@ static enum comclass_threadingmodel get_threading_model(const struct class_reg_d
         if (threading_model[0]) return ThreadingModel_Neutral;
         return ThreadingModel_No;
     }
+    else if (data->origin == CLASS_REG_CACHE)
+        return data->u.cache.model;
     else
         return data->u.actctx.data->model;
 }
 
+/*
+ * Cache of the per-class registry data looked up on every CoCreateInstance call
+ * (InprocServer32 and TreatAs keys) and by OleGetAutoConvert(). The whole cache
+ * is dropped as soon as anything below HKCR\CLSID changes.
+ */
+struct clsid_cache_entry
+{
+    struct wine_rb_entry entry;
+    CLSID clsid;
+    BOOL has_inproc;
+    HRESULT inproc_hr;
+    enum comclass_threadingmodel model;
+    WCHAR dllpath[MAX_PATH+1];
+    BOOL has_treatas;
+    HRESULT treatas_hr;
+    CLSID treatas;
+    BOOL has_autoconvert;
+    HRESULT autoconvert_hr;
+    CLSID autoconvert;
+};
+
+#define CLSID_CACHE_MAX_ENTRIES 512
+
+static int clsid_cache_compare(const void *key, const struct wine_rb_entry *entry)
+{
+    return memcmp(key, &WINE_RB_ENTRY_VALUE(entry, const struct clsid_cache_entry, entry)->clsid, sizeof(CLSID));
+}
+
+static struct wine_rb_tree clsid_cache = { clsid_cache_compare };
+static unsigned int clsid_cache_count;
+static HKEY clsid_cache_key;
+static HANDLE clsid_cache_event;
+
+static CRITICAL_SECTION csClsidCache;
+static CRITICAL_SECTION_DEBUG clsid_cache_cs_debug =
+{
+    0, 0, &csClsidCache,
+    { &clsid_cache_cs_debug.ProcessLocksList, &clsid_cache_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": csClsidCache") }
+};
+static CRITICAL_SECTION csClsidCache = { &clsid_cache_cs_debug, -1, 0, 0, 0, 0 };
+
+static void clsid_cache_free_entry(struct wine_rb_entry *entry, void *context)
+{
+    HeapFree(GetProcessHeap(), 0, WINE_RB_ENTRY_VALUE(entry, struct clsid_cache_entry, entry));
+}
+
+static void clsid_cache_flush(void)
+{
+    wine_rb_clear(&clsid_cache, clsid_cache_free_entry, NULL);
+    clsid_cache_count = 0;
+}
+
+/* flushes the cache if HKCR\CLSID changed since the last call and rearms
+ * the change notification; must be called with csClsidCache held */
+static BOOL clsid_cache_validate(void)
+{
+    static const WCHAR clsidW[] = {'C','L','S','I','D',0};
+
+    if (clsid_cache_key && WaitForSingleObject(clsid_cache_event, 0) == WAIT_TIMEOUT)
+        return TRUE;
+
+    if (clsid_cache_count) TRACE("flushing %u entries\n", clsid_cache_count);
+    clsid_cache_flush();
+
+    if (clsid_cache_key)
+    {
+        RegCloseKey(clsid_cache_key);
+        clsid_cache_key = NULL;
+    }
+    if (!clsid_cache_event && !(clsid_cache_event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        return FALSE;
+    if (open_classes_key(HKEY_CLASSES_ROOT, clsidW, KEY_NOTIFY, &clsid_cache_key))
+    {
+        clsid_cache_key = NULL;
+        return FALSE;
+    }
+    if (RegNotifyChangeKeyValue(clsid_cache_key, TRUE, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET,
+                                clsid_cache_event, TRUE))
+    {
+        WARN("failed to watch HKCR\\CLSID, not caching class registrations\n");
+        RegCloseKey(clsid_cache_key);
+        clsid_cache_key = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* must be called with csClsidCache held */
+static struct clsid_cache_entry *clsid_cache_get_entry(REFCLSID clsid)
+{
+    struct clsid_cache_entry *entry;
+    struct wine_rb_entry *rb_entry;
+
+    if (!clsid_cache_validate()) return NULL;
+
+    if ((rb_entry = wine_rb_get(&clsid_cache, clsid)))
+        return WINE_RB_ENTRY_VALUE(rb_entry, struct clsid_cache_entry, entry);
+
+    if (clsid_cache_count >= CLSID_CACHE_MAX_ENTRIES) clsid_cache_flush();
+
+    if (!(entry = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*entry))))
+        return NULL;
+    entry->clsid = *clsid;
+    wine_rb_put(&clsid_cache, &entry->clsid, &entry->entry);
+    clsid_cache_count++;
+    return entry;
+}
+
+static void clsid_cache_free(void)
+{
+    clsid_cache_flush();
+    if (clsid_cache_key) RegCloseKey(clsid_cache_key);
+    if (clsid_cache_event) CloseHandle(clsid_cache_event);
+    DeleteCriticalSection(&csClsidCache);
+}
+
+/* Returns the InprocServer32 data of a class. On success, regdata either
+ * holds a copy of the cached data or an open key the caller must close. */
+static HRESULT get_inproc_server_regdata(REFCLSID rclsid, struct class_reg_data *regdata)
+{
+    static const WCHAR wszInprocServer32[] = {'I','n','p','r','o','c','S','e','r','v','e','r','3','2',0};
+    struct clsid_cache_entry *entry;
+    HRESULT hr;
+    HKEY hkey;
+
+    EnterCriticalSection(&csClsidCache);
+
+    if ((entry = clsid_cache_get_entry(rclsid)) && entry->has_inproc)
+    {
+        hr = entry->inproc_hr;
+        if (SUCCEEDED(hr))
+        {
+            regdata->u.cache.model = entry->model;
+            strcpyW(regdata->u.cache.dllpath, entry->dllpath);
+            regdata->origin = CLASS_REG_CACHE;
+        }
+        LeaveCriticalSection(&csClsidCache);
+        return hr;
+    }
+
+    hr = COM_OpenKeyForCLSID(rclsid, wszInprocServer32, KEY_READ, &hkey);
+    if (SUCCEEDED(hr))
+    {
+        regdata->u.hkey = hkey;
+        regdata->origin = CLASS_REG_REGISTRY;
+        if (entry)
+        {
+            entry->model = get_threading_model(regdata);
+            if (COM_RegReadPath(regdata, entry->dllpath, ARRAYSIZE(entry->dllpath)) != ERROR_SUCCESS)
+                entry->dllpath[0] = 0;
+            entry->inproc_hr = hr;
+            entry->has_inproc = TRUE;
+            RegCloseKey(hkey);
+
+            regdata->u.cache.model = entry->model;
+            strcpyW(regdata->u.cache.dllpath, entry->dllpath);
+            regdata->origin = CLASS_REG_CACHE;
+        }
+    }
+    else if (entry && (hr == REGDB_E_CLASSNOTREG || hr == REGDB_E_KEYMISSING))
+    {
+        entry->inproc_hr = hr;
+        entry->has_inproc = TRUE;
+    }
+
+    LeaveCriticalSection(&csClsidCache);
+    return hr;
+}
+
 static HRESULT get_inproc_class_object(APARTMENT *apt, const struct class_reg_data *regdata,
                                        REFCLSID rclsid, REFIID riid,
                                        BOOL hostifnecessary, void **ppv)
@@ -3015,7 +3206,7 @@ HRESULT WINAPI DECLSPEC_HOTPATCH CoGetClassObject(
             clsreg.u.actctx.hactctx = data.hActCtx;
             clsreg.u.actctx.data = data.lpData;
             clsreg.u.actctx.section = data.lpSectionBase;
-            clsreg.hkey = FALSE;
+            clsreg.origin = CLASS_REG_ACTCTX;
 
             hres = get_inproc_class_object(apt, &clsreg, &comclass->clsid, iid, !(dwClsContext & WINE_CLSCTX_DONT_HOST), ppv);
             ReleaseActCtx(data.hActCtx);
@@ -3047,10 +3238,7 @@ HRESULT WINAPI DECLSPEC_HOTPATCH CoGetClassObject(
     /* First try in-process server */
     if (CLSCTX_INPROC_SERVER & dwClsContext)
     {
-        static const WCHAR wszInprocServer32[] = {'I','n','p','r','o','c','S','e','r','v','e','r','3','2',0};
-        HKEY hkey;
-
-        hres = COM_OpenKeyForCLSID(rclsid, wszInprocServer32, KEY_READ, &hkey);
+        hres = get_inproc_server_regdata(rclsid, &clsreg);
         if (FAILED(hres))
         {
             if (hres == REGDB_E_CLASSNOTREG)
@@ -3064,11 +3252,9 @@ HRESULT WINAPI DECLSPEC_HOTPATCH CoGetClassObject(
 
         if (SUCCEEDED(hres))
         {
-            clsreg.u.hkey = hkey;
-            clsreg.hkey = TRUE;
-
             hres = get_inproc_class_object(apt, &clsreg, rclsid, iid, !(dwClsContext & WINE_CLSCTX_DONT_HOST), ppv);
-            RegCloseKey(hkey);
+            if (clsreg.origin == CLASS_REG_REGISTRY)
+                RegCloseKey(clsreg.u.hkey);
         }
 
         /* return if we got a class, otherwise fall through to one of the
@@ -3101,7 +3287,7 @@ HRESULT WINAPI DECLSPEC_HOTPATCH CoGetClassObject(
         if (SUCCEEDED(hres))
         {
             clsreg.u.hkey = hkey;
-            clsreg.hkey = TRUE;
+            clsreg.origin = CLASS_REG_REGISTRY;
 
             hres = get_inproc_class_object(apt, &clsreg, rclsid, iid, !(dwClsContext & WINE_CLSCTX_DONT_HOST), ppv);
             RegCloseKey(hkey);
@@ -3819,6 +4005,7 @@ done:
 HRESULT WINAPI CoGetTreatAsClass(REFCLSID clsidOld, LPCLSID clsidNew)
 {
     static const WCHAR wszTreatAs[] = {'T','r','e','a','t','A','s',0};
+    struct clsid_cache_entry *entry;
     HKEY hkey = NULL;
     WCHAR szClsidNew[CHARS_IN_GUID];
     HRESULT res = S_OK;
@@ -3831,6 +4018,15 @@ HRESULT WINAPI CoGetTreatAsClass(REFCLSID clsidOld, LPCLSID clsidNew)
 
     *clsidNew = *clsidOld; /* copy over old value */
 
+    EnterCriticalSection(&csClsidCache);
+    if ((entry = clsid_cache_get_entry(clsidOld)) && entry->has_treatas)
+    {
+        *clsidNew = entry->treatas;
+        res = entry->treatas_hr;
+        LeaveCriticalSection(&csClsidCache);
+        return res;
+    }
+
     res = COM_OpenKeyForCLSID(clsidOld, wszTreatAs, KEY_READ, &hkey);
     if (FAILED(res))
     {
@@ -3847,6 +4043,57 @@ HRESULT WINAPI CoGetTreatAsClass(REFCLSID clsidOld, LPCLSID clsidNew)
         ERR("Failed CLSIDFromStringA(%s), hres 0x%08x\n", debugstr_w(szClsidNew), res);
 done:
     if (hkey) RegCloseKey(hkey);
+    if (entry && SUCCEEDED(res))
+    {
+        entry->treatas = *clsidNew;
+        entry->treatas_hr = res;
+        entry->has_treatas = TRUE;
+    }
+    LeaveCriticalSection(&csClsidCache);
+    return res;
+}
+
+/* AutoConvertTo lookup for OleGetAutoConvert(), clsidNew is left untouched on failure */
+HRESULT COM_GetAutoConvertClass(REFCLSID clsidOld, CLSID *clsidNew)
+{
+    static const WCHAR wszAutoConvertTo[] = {'A','u','t','o','C','o','n','v','e','r','t','T','o',0};
+    struct clsid_cache_entry *entry;
+    HKEY hkey = NULL;
+    WCHAR buf[CHARS_IN_GUID];
+    LONG len;
+    HRESULT res = S_OK;
+
+    EnterCriticalSection(&csClsidCache);
+    if ((entry = clsid_cache_get_entry(clsidOld)) && entry->has_autoconvert)
+    {
+        res = entry->autoconvert_hr;
+        if (SUCCEEDED(res))
+            *clsidNew = entry->autoconvert;
+        LeaveCriticalSection(&csClsidCache);
+        return res;
+    }
+
+    res = COM_OpenKeyForCLSID(clsidOld, wszAutoConvertTo, KEY_READ, &hkey);
+    if (FAILED(res))
+        goto done;
+
+    len = sizeof(buf);
+    if (RegQueryValueW(hkey, NULL, buf, &len))
+    {
+        res = REGDB_E_KEYMISSING;
+        goto done;
+    }
+    res = CLSIDFromString(buf, clsidNew);
+done:
+    if (hkey) RegCloseKey(hkey);
+    if (entry && (SUCCEEDED(res) || res == REGDB_E_CLASSNOTREG || res == REGDB_E_KEYMISSING))
+    {
+        if (SUCCEEDED(res))
+            entry->autoconvert = *clsidNew;
+        entry->autoconvert_hr = res;
+        entry->has_autoconvert = TRUE;
+    }
+    LeaveCriticalSection(&csClsidCache);
     return res;
 }
 
@@ -5030,7 +5277,7 @@ HRESULT Handler_DllGetClassObject(REFCLSID rclsid, REFIID riid, LPVOID *ppv)
         WCHAR dllpath[MAX_PATH+1];
 
         regdata.u.hkey = hkey;
-        regdata.hkey = TRUE;
+        regdata.origin = CLASS_REG_REGISTRY;
 
         if (COM_RegReadPath(&regdata, dllpath, ARRAYSIZE(dllpath)) == ERROR_SUCCESS)
         {
@@ -5212,6 +5459,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID reserved)
         UnregisterClassW( wszAptWinClass, hProxyDll );
         RPC_UnregisterAllChannelHooks();
         COMPOBJ_DllList_Free();
+        clsid_cache_free();
         DeleteCriticalSection(&csRegisteredClassList);
         DeleteCriticalSection(&csApartment);
 	break;
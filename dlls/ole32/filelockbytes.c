@@ -45,6 +45,9 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(storage);
 
+/* size of the file mapping views used to read from read-only files */
+#define MAPPED_VIEW_SIZE (16 * 1024 * 1024)
+
 typedef struct FileLockBytesImpl
 {
     ILockBytes ILockBytes_iface;
@@ -52,6 +55,15 @@ typedef struct FileLockBytesImpl
     HANDLE hfile;
     DWORD flProtect;
     LPWSTR pwcsName;
+
+    /* files that can't change under us are read through a window into a file mapping */
+    BOOL use_mapping;
+    CRITICAL_SECTION cs;
+    HANDLE mapping;
+    ULONGLONG mapping_size;
+    BYTE *view;
+    ULONGLONG view_offset;
+    SIZE_T view_size;
 } FileLockBytesImpl;
 
 static const ILockBytesVtbl FileLockBytesImpl_Vtbl;
@@ -104,6 +116,15 @@ HRESULT FileLockBytesImpl_Construct(HANDLE hFile, DWORD openFlags, LPCWSTR pwcsN
   This->ref = 1;
   This->hfile = hFile;
   This->flProtect = GetProtectMode(openFlags);
+  /* the file could be resized by other writers while a mapping exists */
+  This->use_mapping = This->flProtect == PAGE_READONLY &&
+                      (STGM_SHARE_MODE(openFlags) == STGM_SHARE_DENY_WRITE ||
+                       STGM_SHARE_MODE(openFlags) == STGM_SHARE_EXCLUSIVE);
+  This->mapping = NULL;
+  This->mapping_size = 0;
+  This->view = NULL;
+  This->view_offset = 0;
+  This->view_size = 0;
 
   if(pwcsName) {
     if (!GetFullPathNameW(pwcsName, MAX_PATH, fullpath, NULL))
@@ -122,6 +143,9 @@ HRESULT FileLockBytesImpl_Construct(HANDLE hFile, DWORD openFlags, LPCWSTR pwcsN
   else
     This->pwcsName = NULL;
 
+  InitializeCriticalSection(&This->cs);
+  This->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": FileLockBytesImpl.cs");
+
   *pLockBytes = &This->ILockBytes_iface;
 
   return S_OK;
@@ -160,6 +184,10 @@ static ULONG WINAPI FileLockBytesImpl_Release(ILockBytes *iface)
 
     if (ref == 0)
     {
+        if (This->view) UnmapViewOfFile(This->view);
+        if (This->mapping) CloseHandle(This->mapping);
+        This->cs.DebugInfo->Spare[0] = 0;
+        DeleteCriticalSection(&This->cs);
         CloseHandle(This->hfile);
         HeapFree(GetProcessHeap(), 0, This->pwcsName);
         HeapFree(GetProcessHeap(), 0, This);
@@ -168,6 +196,67 @@ static ULONG WINAPI FileLockBytesImpl_Release(ILockBytes *iface)
     return ref;
 }
 
+/******************************************************************************
+ *      FileLockBytesImpl_ReadMapped
+ *
+ * Reads from a file opened read-only and denying writes through a file
+ * mapping, which saves a system call for every sector. Returns FALSE if
+ * the range is not covered by the mapping, in which case the caller falls
+ * back to ReadFile.
+ */
+static BOOL FileLockBytesImpl_ReadMapped(FileLockBytesImpl *This, ULONGLONG offset, BYTE *buffer, ULONG cb)
+{
+    BOOL ret = TRUE;
+
+    EnterCriticalSection(&This->cs);
+
+    if (!This->mapping)
+    {
+        LARGE_INTEGER size;
+
+        if (GetFileSizeEx(This->hfile, &size) && size.QuadPart)
+        {
+            This->mapping = CreateFileMappingW(This->hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (This->mapping) This->mapping_size = size.QuadPart;
+        }
+        /* don't try again for this file */
+        if (!This->mapping) This->mapping = INVALID_HANDLE_VALUE;
+    }
+
+    if (This->mapping == INVALID_HANDLE_VALUE || offset + cb > This->mapping_size)
+        ret = FALSE;
+
+    while (ret && cb)
+    {
+        ULONG count;
+
+        if (!This->view || offset < This->view_offset || offset >= This->view_offset + This->view_size)
+        {
+            if (This->view) UnmapViewOfFile(This->view);
+            This->view_offset = offset & ~(ULONGLONG)(MAPPED_VIEW_SIZE - 1);
+            This->view_size = min(MAPPED_VIEW_SIZE, This->mapping_size - This->view_offset);
+            This->view = MapViewOfFile(This->mapping, FILE_MAP_READ, This->view_offset >> 32,
+                                       (DWORD)This->view_offset, This->view_size);
+            if (!This->view)
+            {
+                WARN("failed to map view at %s, error %u\n", wine_dbgstr_longlong(This->view_offset),
+                     GetLastError());
+                ret = FALSE;
+                break;
+            }
+        }
+
+        count = min(cb, This->view_offset + This->view_size - offset);
+        memcpy(buffer, This->view + (offset - This->view_offset), count);
+        buffer += count;
+        offset += count;
+        cb -= count;
+    }
+
+    LeaveCriticalSection(&This->cs);
+    return ret;
+}
+
 /******************************************************************************
  * This method is part of the ILockBytes interface.
  *
@@ -188,6 +277,7 @@ static HRESULT WINAPI FileLockBytesImpl_ReadAt(
     LPBYTE readPtr = pv;
     BOOL ret;
     LARGE_INTEGER offset;
+    OVERLAPPED ol;
     ULONG cbRead;
 
     TRACE("(%p)-> %i %p %i %p\n",This, ulOffset.u.LowPart, pv, cb, pcbRead);
@@ -198,16 +288,23 @@ static HRESULT WINAPI FileLockBytesImpl_ReadAt(
     if (pcbRead)
         *pcbRead = 0;
 
-    offset.QuadPart = ulOffset.QuadPart;
-
-    ret = SetFilePointerEx(This->hfile, offset, NULL, FILE_BEGIN);
+    if (This->use_mapping &&
+        FileLockBytesImpl_ReadMapped(This, ulOffset.QuadPart, readPtr, cb))
+    {
+        if (pcbRead)
+            *pcbRead = cb;
+        return S_OK;
+    }
 
-    if (!ret)
-        return STG_E_READFAULT;
+    offset.QuadPart = ulOffset.QuadPart;
 
     while (bytes_left)
     {
-        ret = ReadFile(This->hfile, readPtr, bytes_left, &cbRead, NULL);
+        /* positional reads, no need to move the file pointer first */
+        ol.hEvent = 0;
+        ol.u.s.Offset = offset.u.LowPart;
+        ol.u.s.OffsetHigh = offset.u.HighPart;
+        ret = ReadFile(This->hfile, readPtr, bytes_left, &cbRead, &ol);
 
         if (!ret || cbRead == 0)
             return STG_E_READFAULT;
@@ -217,6 +314,7 @@ static HRESULT WINAPI FileLockBytesImpl_ReadAt(
 
         bytes_left -= cbRead;
         readPtr += cbRead;
+        offset.QuadPart += cbRead;
     }
 
     TRACE("finished\n");
@@ -243,6 +341,7 @@ static HRESULT WINAPI FileLockBytesImpl_WriteAt(
     const BYTE *writePtr = pv;
     BOOL ret;
     LARGE_INTEGER offset;
+    OVERLAPPED ol;
     ULONG cbWritten;
 
     TRACE("(%p)-> %i %p %i %p\n",This, ulOffset.u.LowPart, pv, cb, pcbWritten);
@@ -258,14 +357,12 @@ static HRESULT WINAPI FileLockBytesImpl_WriteAt(
 
     offset.QuadPart = ulOffset.QuadPart;
 
-    ret = SetFilePointerEx(This->hfile, offset, NULL, FILE_BEGIN);
-
-    if (!ret)
-        return STG_E_WRITEFAULT;
-
     while (bytes_left)
     {
-        ret = WriteFile(This->hfile, writePtr, bytes_left, &cbWritten, NULL);
+        ol.hEvent = 0;
+        ol.u.s.Offset = offset.u.LowPart;
+        ol.u.s.OffsetHigh = offset.u.HighPart;
+        ret = WriteFile(This->hfile, writePtr, bytes_left, &cbWritten, &ol);
 
         if (!ret)
             return STG_E_WRITEFAULT;
@@ -275,6 +372,7 @@ static HRESULT WINAPI FileLockBytesImpl_WriteAt(
 
         bytes_left -= cbWritten;
         writePtr += cbWritten;
+        offset.QuadPart += cbWritten;
     }
 
     TRACE("finished\n");
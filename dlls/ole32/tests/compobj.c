@@ -2168,7 +2168,8 @@ static void test_TreatAsClass(void)
     static GUID deadbeef = {0xdeadbeef,0xdead,0xbeef,{0xde,0xad,0xbe,0xef,0xde,0xad,0xbe,0xef}};
     static const char deadbeefA[] = "{DEADBEEF-DEAD-BEEF-DEAD-BEEFDEADBEEF}";
     IInternetProtocol *pIP = NULL;
-    HKEY clsidkey, deadbeefkey;
+    IClassFactory *cf;
+    HKEY clsidkey, deadbeefkey, inprockey;
     LONG lr;
 
     if (!pCoGetTreatAsClass)
@@ -2243,6 +2244,26 @@ static void test_TreatAsClass(void)
     if(pIP)
         IInternetProtocol_Release(pIP);
 
+    /* registration changes have to be picked up by later lookups */
+    lr = RegCreateKeyExA(deadbeefkey, "InprocServer32", 0, NULL, 0, KEY_WRITE, NULL, &inprockey, NULL);
+    ok(!lr, "Couldn't create InprocServer32 key, error %d\n", lr);
+    lr = RegSetValueExA(inprockey, NULL, 0, REG_SZ, (const BYTE *)"ole32.dll", sizeof("ole32.dll"));
+    ok(!lr, "Couldn't set InprocServer32 value, error %d\n", lr);
+    RegCloseKey(inprockey);
+    Sleep(200);
+
+    hr = CoGetClassObject(&deadbeef, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&cf);
+    ok(hr != REGDB_E_CLASSNOTREG, "CoGetClassObject gave wrong error: %08x\n", hr);
+    if (SUCCEEDED(hr))
+        IClassFactory_Release(cf);
+
+    lr = RegDeleteKeyA(deadbeefkey, "InprocServer32");
+    ok(!lr, "Couldn't delete InprocServer32 key, error %d\n", lr);
+    Sleep(200);
+
+    hr = CoGetClassObject(&deadbeef, CLSCTX_INPROC_SERVER, NULL, &IID_IClassFactory, (void **)&cf);
+    ok(hr == REGDB_E_CLASSNOTREG, "CoGetClassObject gave wrong error: %08x\n", hr);
+
 exit:
     OleUninitialize();
     RegCloseKey(deadbeefkey);
@@ -3919,6 +3919,56 @@ static void test_custom_lockbytes(void)
     DeleteTestLockBytes(lockbytes);
 }
 
+static void test_readonly_stream_data(void)
+{
+    static const WCHAR streamW[] = {'s','t','r','e','a','m',0};
+    IStorage *stg;
+    IStream *stream;
+    BYTE *buffer;
+    ULONG size = 0x100000, count, i, pos;
+    HRESULT hr;
+
+    buffer = HeapAlloc(GetProcessHeap(), 0, size);
+    for (i = 0; i < size; i++) buffer[i] = i * 7 + i / 4096;
+
+    hr = StgCreateDocfile(filename, STGM_CREATE | STGM_SHARE_EXCLUSIVE | STGM_READWRITE, 0, &stg);
+    ok(hr == S_OK, "StgCreateDocfile failed: %08x\n", hr);
+    hr = IStorage_CreateStream(stg, streamW, STGM_CREATE | STGM_SHARE_EXCLUSIVE | STGM_READWRITE, 0, 0, &stream);
+    ok(hr == S_OK, "CreateStream failed: %08x\n", hr);
+    hr = IStream_Write(stream, buffer, size, &count);
+    ok(hr == S_OK, "Write failed: %08x\n", hr);
+    ok(count == size, "wrote %u bytes\n", count);
+    IStream_Release(stream);
+    IStorage_Release(stg);
+
+    /* files opened read-only and denying writes are read through a mapping */
+    hr = StgOpenStorage(filename, NULL, STGM_SHARE_DENY_WRITE | STGM_READ, NULL, 0, &stg);
+    ok(hr == S_OK, "StgOpenStorage failed: %08x\n", hr);
+    hr = IStorage_OpenStream(stg, streamW, NULL, STGM_SHARE_EXCLUSIVE | STGM_READ, 0, &stream);
+    ok(hr == S_OK, "OpenStream failed: %08x\n", hr);
+
+    for (pos = 0; pos < size; pos += count)
+    {
+        BYTE data[3000];
+
+        hr = IStream_Read(stream, data, sizeof(data), &count);
+        ok(hr == S_OK, "Read failed: %08x\n", hr);
+        if (hr != S_OK || !count) break;
+        ok(count == min(sizeof(data), size - pos), "read %u bytes at %u\n", count, pos);
+        if (memcmp(data, buffer + pos, count))
+        {
+            ok(0, "wrong data at %u\n", pos);
+            break;
+        }
+    }
+    ok(pos == size, "read %u bytes\n", pos);
+
+    IStream_Release(stream);
+    IStorage_Release(stg);
+    HeapFree(GetProcessHeap(), 0, buffer);
+    DeleteFileA(filenameA);
+}
+
 START_TEST(storage32)
 {
     CHAR temp[MAX_PATH];
@@ -3968,4 +4018,5 @@ START_TEST(storage32)
     test_transacted_shared();
     test_overwrite();
     test_custom_lockbytes();
+    test_readonly_stream_data();
 }
@@ -2944,6 +2944,9 @@ ME_TextEditor *ME_MakeEditor(ITextHost *texthost, BOOL bEmulateVersion10, DWORD
   ed->nUndoLimit = STACK_SIZE_DEFAULT;
   ed->nUndoMode = umAddToUndo;
   ed->nParagraphs = 1;
+  ed->para_index = NULL;
+  ed->para_index_count = ed->para_index_size = 0;
+  ed->para_index_valid = FALSE;
   ed->nLastSelStart = ed->nLastSelEnd = 0;
   ed->pLastSelStartPara = ed->pLastSelEndPara = ed->pCursors[0].pPara;
   ed->bHideSelection = FALSE;
@@ -3058,6 +3061,7 @@ void ME_DestroyEditor(ME_TextEditor *editor)
 
   FREE_OBJ(editor->pBuffer);
   FREE_OBJ(editor->pCursors);
+  heap_free(editor->para_index);
 
   FREE_OBJ(editor);
 }
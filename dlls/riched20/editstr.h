@@ -401,6 +401,9 @@ typedef struct tagME_TextEditor
   int nUndoLimit;
   ME_UndoMode nUndoMode;
   int nParagraphs;
+  ME_DisplayItem **para_index; /* paragraphs in document order, see para.c */
+  int para_index_count, para_index_size;
+  BOOL para_index_valid;
   int nLastSelStart, nLastSelEnd;
   ME_DisplayItem *pLastSelStartPara, *pLastSelEndPara;
   ME_FontCacheItem pFontCache[HFONT_CACHE_SIZE];
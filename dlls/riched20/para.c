@@ -32,6 +32,131 @@ static ME_DisplayItem *make_para(ME_TextEditor *editor)
     return item;
 }
 
+/* The paragraph index is an array of all paragraphs in document order. Paragraph
+ * offsets are absolute and strictly increasing, so it lets character offsets be
+ * mapped to paragraphs with a binary search instead of walking the list. Splits
+ * and joins update it in place; when that's not possible it's marked invalid and
+ * rebuilt on next lookup. */
+static int para_index_search(const ME_TextEditor *editor, int nCharOfs)
+{
+  int min = 0, max = editor->para_index_count - 1;
+
+  while (min < max)
+  {
+    int mid = (min + max + 1) / 2;
+
+    if (editor->para_index[mid]->member.para.nCharOfs <= nCharOfs)
+      min = mid;
+    else
+      max = mid - 1;
+  }
+  return min;
+}
+
+static BOOL para_index_reserve(ME_TextEditor *editor, int count)
+{
+  ME_DisplayItem **new_index;
+  int new_size;
+
+  if (count <= editor->para_index_size)
+    return TRUE;
+
+  new_size = max(editor->para_index_size * 2, max(count, 16));
+  if (editor->para_index)
+    new_index = heap_realloc(editor->para_index, new_size * sizeof(*new_index));
+  else
+    new_index = heap_alloc(new_size * sizeof(*new_index));
+  if (!new_index)
+    return FALSE;
+
+  editor->para_index = new_index;
+  editor->para_index_size = new_size;
+  return TRUE;
+}
+
+/* Returns position of the paragraph in the index, or -1 if it can't be found. */
+static int para_index_get_pos(const ME_TextEditor *editor, const ME_DisplayItem *para)
+{
+  int pos;
+
+  if (!editor->para_index_valid || !editor->para_index_count)
+    return -1;
+
+  pos = para_index_search(editor, para->member.para.nCharOfs);
+  return editor->para_index[pos] == para ? pos : -1;
+}
+
+static void para_index_insert_after(ME_TextEditor *editor, const ME_DisplayItem *para, ME_DisplayItem *new_para)
+{
+  int pos = para_index_get_pos(editor, para);
+
+  if (pos == -1 || !para_index_reserve(editor, editor->para_index_count + 1))
+  {
+    editor->para_index_valid = FALSE;
+    return;
+  }
+
+  pos++;
+  memmove(editor->para_index + pos + 1, editor->para_index + pos,
+          (editor->para_index_count - pos) * sizeof(*editor->para_index));
+  editor->para_index[pos] = new_para;
+  editor->para_index_count++;
+}
+
+static void para_index_remove_after(ME_TextEditor *editor, const ME_DisplayItem *para, const ME_DisplayItem *next)
+{
+  int pos = para_index_get_pos(editor, para);
+
+  if (pos == -1 || pos + 1 >= editor->para_index_count || editor->para_index[pos + 1] != next)
+  {
+    editor->para_index_valid = FALSE;
+    return;
+  }
+
+  pos++;
+  editor->para_index_count--;
+  memmove(editor->para_index + pos, editor->para_index + pos + 1,
+          (editor->para_index_count - pos) * sizeof(*editor->para_index));
+}
+
+/******************************************************************************
+ * para_index_find
+ *
+ * Returns the paragraph containing the given absolute character offset.
+ */
+ME_DisplayItem *para_index_find(ME_TextEditor *editor, int nCharOfs)
+{
+  ME_DisplayItem *para;
+
+  if (!editor->para_index_valid)
+  {
+    editor->para_index_count = 0;
+    for (para = editor->pBuffer->pFirst->member.para.next_para;
+         para != editor->pBuffer->pLast; para = para->member.para.next_para)
+    {
+      if (!para_index_reserve(editor, editor->para_index_count + 1))
+      {
+        editor->para_index_count = 0;
+        break;
+      }
+      editor->para_index[editor->para_index_count++] = para;
+    }
+    editor->para_index_valid = editor->para_index_count != 0;
+    TRACE("rebuilt index of %d paragraphs\n", editor->para_index_count);
+  }
+
+  if (!editor->para_index_valid)
+  {
+    /* out of memory, fall back to walking the list */
+    para = editor->pBuffer->pFirst->member.para.next_para;
+    while (para->member.para.next_para->member.para.nCharOfs <= nCharOfs)
+      para = para->member.para.next_para;
+    return para;
+  }
+
+  return editor->para_index[para_index_search(editor, nCharOfs)];
+}
+
 void ME_MakeFirstParagraph(ME_TextEditor *editor)
 {
   ME_Context c;
@@ -94,6 +219,7 @@ void ME_MakeFirstParagraph(ME_TextEditor *editor)
   text->pLast->member.para.prev_para = para;
 
   text->pLast->member.para.nCharOfs = editor->bEmulateVersion10 ? 2 : 1;
+  editor->para_index_valid = FALSE;
 
   ME_DestroyContext(&c);
 }
@@ -489,6 +615,7 @@ ME_DisplayItem *ME_SplitParagraph(ME_TextEditor *editor, ME_DisplayItem *run,
   new_para->member.para.next_para = next_para;
   run_para->member.para.next_para = new_para;
   next_para->member.para.prev_para = new_para;
+  para_index_insert_after(editor, run_para, new_para);
 
   /* insert end run of the old paragraph, and new paragraph, into DI double linked list */
   ME_InsertBefore(run, new_para);
@@ -672,6 +799,7 @@ ME_DisplayItem *ME_JoinParagraphs(ME_TextEditor *editor, ME_DisplayItem *tp,
 
   tp->member.para.next_para = pNext->member.para.next_para;
   pNext->member.para.next_para->member.para.prev_para = tp;
+  para_index_remove_after(editor, tp, pNext);
   ME_Remove(pNext);
   ME_DestroyDisplayItem(pNext);
 
@@ -4994,6 +4994,66 @@ static void test_EM_SETSEL(void)
     DestroyWindow(hwndRichEdit);
 }
 
+static void check_line_at_(int line, HWND hwnd, int ofs, const char *expect)
+{
+    TEXTRANGEA range;
+    char buffer[32];
+    LRESULT result;
+
+    memset(buffer, 0, sizeof(buffer));
+    range.chrg.cpMin = ofs;
+    range.chrg.cpMax = ofs + strlen(expect);
+    range.lpstrText = buffer;
+    result = SendMessageA(hwnd, EM_GETTEXTRANGE, 0, (LPARAM)&range);
+    ok_(__FILE__,line)(result == strlen(expect), "%d: EM_GETTEXTRANGE returned %ld\n", ofs, result);
+    ok_(__FILE__,line)(!strcmp(buffer, expect), "%d: got %s, expected %s\n", ofs, buffer, expect);
+
+    result = SendMessageA(hwnd, EM_LINELENGTH, ofs, 0);
+    ok_(__FILE__,line)(result == strlen(expect), "%d: EM_LINELENGTH returned %ld\n", ofs, result);
+}
+#define check_line_at(hwnd, ofs, expect) check_line_at_(__LINE__, hwnd, ofs, expect)
+
+static void test_EM_REPLACESEL_append(void)
+{
+    HWND hwndRichEdit = new_richedit(NULL);
+    char line[16];
+    int i, len;
+
+    /* append lines one by one, each line is 8 characters followed by '\r' */
+    for (i = 0; i < 200; i++)
+    {
+        len = GetWindowTextLengthA(hwndRichEdit);
+        SendMessageA(hwndRichEdit, EM_SETSEL, len, len);
+        sprintf(line, "line %03d\r", i);
+        SendMessageA(hwndRichEdit, EM_REPLACESEL, 0, (LPARAM)line);
+    }
+    len = GetWindowTextLengthA(hwndRichEdit);
+    ok(len == 200 * 9, "got length %d\n", len);
+
+    check_line_at(hwndRichEdit, 0, "line 000");
+    check_line_at(hwndRichEdit, 50 * 9, "line 050");
+    check_line_at(hwndRichEdit, 199 * 9, "line 199");
+
+    /* new paragraph in the middle moves all following ones */
+    SendMessageA(hwndRichEdit, EM_SETSEL, 50 * 9, 50 * 9);
+    SendMessageA(hwndRichEdit, EM_REPLACESEL, 0, (LPARAM)"new\r");
+    check_line_at(hwndRichEdit, 49 * 9, "line 049");
+    check_line_at(hwndRichEdit, 50 * 9, "new");
+    check_line_at(hwndRichEdit, 50 * 9 + 4, "line 050");
+    check_line_at(hwndRichEdit, 199 * 9 + 4, "line 199");
+
+    /* joining paragraphs moves them back */
+    SendMessageA(hwndRichEdit, EM_SETSEL, 50 * 9, 50 * 9 + 4);
+    SendMessageA(hwndRichEdit, EM_REPLACESEL, 0, (LPARAM)"");
+    SendMessageA(hwndRichEdit, EM_SETSEL, 100 * 9 + 8, 100 * 9 + 9);
+    SendMessageA(hwndRichEdit, EM_REPLACESEL, 0, (LPARAM)"");
+    check_line_at(hwndRichEdit, 50 * 9, "line 050");
+    check_line_at(hwndRichEdit, 100 * 9, "line 100line 101");
+    check_line_at(hwndRichEdit, 198 * 9 + 8, "line 199");
+
+    DestroyWindow(hwndRichEdit);
+}
+
 static void test_EM_REPLACESEL(int redraw)
 {
     HWND hwndRichEdit = new_richedit(NULL);
@@ -8796,6 +8856,7 @@ START_TEST( editor )
   test_WM_GETTEXTLENGTH();
   test_EM_REPLACESEL(1);
   test_EM_REPLACESEL(0);
+  test_EM_REPLACESEL_append();
   test_WM_NOTIFY();
   test_EN_LINK();
   test_EM_AUTOURLDETECT();
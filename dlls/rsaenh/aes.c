@@ -30,6 +30,13 @@
 
 #include "tomcrypt.h"
 
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define USE_AESNI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
 static const ulong32 TE0[256] = {
     0xc66363a5UL, 0xf87c7c84UL, 0xee777799UL, 0xf67b7b8dUL,
     0xfff2f20dUL, 0xd66b6bbdUL, 0xde6f6fb1UL, 0x91c5c554UL,
@@ -926,6 +933,46 @@ static const ulong32 rcon[] = {
     0x1B000000UL, 0x36000000UL
 };
 
+#ifdef USE_AESNI
+
+static int have_aesni(void)
+{
+    static int aesni = -1;
+    unsigned int eax, ebx, ecx, edx;
+
+    if (aesni == -1)
+        aesni = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) && (ecx & bit_SSE2);
+    return aesni;
+}
+
+static void __attribute__((target("aes,sse2"))) aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct,
+                                                                  const aes_key *skey)
+{
+    const __m128i *rk = (const __m128i *)skey->niK[0];
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pt), _mm_loadu_si128(rk));
+    int r;
+
+    for (r = 1; r < skey->Nr; r++)
+        s = _mm_aesenc_si128(s, _mm_loadu_si128(rk + r));
+    s = _mm_aesenclast_si128(s, _mm_loadu_si128(rk + r));
+    _mm_storeu_si128((__m128i *)ct, s);
+}
+
+static void __attribute__((target("aes,sse2"))) aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt,
+                                                                  const aes_key *skey)
+{
+    const __m128i *rk = (const __m128i *)skey->niK[1];
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)ct), _mm_loadu_si128(rk));
+    int r;
+
+    for (r = 1; r < skey->Nr; r++)
+        s = _mm_aesdec_si128(s, _mm_loadu_si128(rk + r));
+    s = _mm_aesdeclast_si128(s, _mm_loadu_si128(rk + r));
+    _mm_storeu_si128((__m128i *)pt, s);
+}
+
+#endif  /* USE_AESNI */
+
 static ulong32 setup_mix(ulong32 temp)
 {
    return (Te4_3[byte(temp, 2)]) ^
@@ -1058,6 +1105,21 @@ int aes_setup(const unsigned char *key, int keylen, int rounds, aes_key *skey)
     *rk++ = *rrk++;
     *rk   = *rrk;
 
+#ifdef USE_AESNI
+    /* The table based decryption schedule already has InvMixColumns applied
+     * to the inner round keys, which is exactly what AESDEC expects. */
+    if ((skey->ni = have_aesni()))
+    {
+        for (i = 0; i < 4 * (skey->Nr + 1); i++)
+        {
+            STORE32H(skey->eK[i], skey->niK[0] + 4 * i);
+            STORE32H(skey->dK[i], skey->niK[1] + 4 * i);
+        }
+    }
+#else
+    skey->ni = 0;
+#endif
+
     return CRYPT_OK;
 }
 
@@ -1066,6 +1128,14 @@ void aes_ecb_encrypt(const unsigned char *pt, unsigned char *ct, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef USE_AESNI
+    if (skey->ni)
+    {
+        aesni_ecb_encrypt(pt, ct, skey);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->eK;
 
@@ -1167,6 +1237,14 @@ void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef USE_AESNI
+    if (skey->ni)
+    {
+        aesni_ecb_decrypt(ct, pt, skey);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->dK;
 
@@ -132,6 +132,8 @@ typedef struct tag_des3_key {
 typedef struct tag_aes_key {
    ulong32 eK[64], dK[64];
    int Nr;
+   int ni;                           /* use the AES-NI round keys below */
+   unsigned char niK[2][15 * 16];    /* encryption/decryption round keys, in byte order */
 } aes_key;
 
 int rc2_setup(const unsigned char *key, int keylen, int bits, int num_rounds, rc2_key *skey);
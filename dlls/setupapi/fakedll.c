@@ -57,13 +57,49 @@ static const unsigned int file_alignment = 512;
 static const unsigned int section_alignment = 4096;
 static const unsigned int max_dll_name_len = 64;
 
-static void *file_buffer;
-static SIZE_T file_buffer_size;
+/* buffer used to read the fake dll files, one per thread */
+struct file_buffer
+{
+    void  *ptr;
+    SIZE_T size;
+};
+
+/* a fake dll found in a lib directory, installed by one of the worker threads */
+struct lib_dir_entry
+{
+    char   *file;       /* unix path of the fake dll, including the extension */
+    size_t  name_len;   /* length of the dll name, without the extension */
+    WCHAR  *dest;       /* destination file if it needs to be registered */
+    void   *data;       /* copy of the file contents if it needs to be registered */
+    SIZE_T  size;
+};
+
+struct lib_dir
+{
+    const WCHAR          *dest;     /* destination directory, with trailing backslash */
+    const char           *ext;      /* extension to add to the file names */
+    struct lib_dir_entry *entries;
+    unsigned int          count;
+    LONG                  next;     /* next entry to install */
+};
+
+#define MAX_INSTALL_THREADS 8
+
+static struct file_buffer file_buffer;
 static unsigned int handled_count;
 static unsigned int handled_total;
 static char **handled_dlls;
 static IRegistrar *registrar;
 
+static CRITICAL_SECTION handled_dlls_section;
+static CRITICAL_SECTION_DEBUG handled_dlls_section_debug =
+{
+    0, 0, &handled_dlls_section,
+    { &handled_dlls_section_debug.ProcessLocksList, &handled_dlls_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": handled_dlls_section") }
+};
+static CRITICAL_SECTION handled_dlls_section = { &handled_dlls_section_debug, -1, 0, 0, 0, 0 };
+
 struct dll_info
 {
     HANDLE            handle;
@@ -155,13 +191,14 @@ static BOOL add_handled_dll( const WCHAR *name )
     if (!(nameA = HeapAlloc( GetProcessHeap(), 0, len + 1 ))) return FALSE;
     if (!dll_name_WtoA( nameA, name, len )) goto failed;
 
+    EnterCriticalSection( &handled_dlls_section );
     min = 0;
     max = handled_count - 1;
     while (min <= max)
     {
         pos = (min + max) / 2;
         res = strcmp( handled_dlls[pos], nameA );
-        if (!res) goto failed;  /* already in the list */
+        if (!res) goto failed_locked;  /* already in the list */
         if (res < 0) min = pos + 1;
         else max = pos - 1;
     }
@@ -174,7 +211,7 @@ static BOOL add_handled_dll( const WCHAR *name )
         if (handled_dlls) new_dlls = HeapReAlloc( GetProcessHeap(), 0, handled_dlls,
                                                   new_count * sizeof(*handled_dlls) );
         else new_dlls = HeapAlloc( GetProcessHeap(), 0, new_count * sizeof(*handled_dlls) );
-        if (!new_dlls) goto failed;
+        if (!new_dlls) goto failed_locked;
         handled_dlls = new_dlls;
         handled_total = new_count;
     }
@@ -182,16 +219,19 @@ static BOOL add_handled_dll( const WCHAR *name )
     for (i = handled_count; i > min; i--) handled_dlls[i] = handled_dlls[i - 1];
     handled_dlls[i] = nameA;
     handled_count++;
+    LeaveCriticalSection( &handled_dlls_section );
     return TRUE;
 
+failed_locked:
+    LeaveCriticalSection( &handled_dlls_section );
 failed:
     HeapFree( GetProcessHeap(), 0, nameA );
     return FALSE;
 }
 
-/* read in the contents of a file into the global file buffer */
+/* read in the contents of a file into the given file buffer */
 /* return 1 on success, 0 on nonexistent file, -1 on other error */
-static int read_file( const char *name, void **data, SIZE_T *size )
+static int read_file( const char *name, struct file_buffer *buffer, void **data, SIZE_T *size )
 {
     struct stat st;
     int fd, ret = -1;
@@ -204,12 +244,12 @@ static int read_file( const char *name, void **data, SIZE_T *size )
     if ((fd = open( name, O_RDONLY | O_BINARY )) == -1) return 0;
     if (fstat( fd, &st ) == -1) goto done;
     *size = st.st_size;
-    if (!file_buffer || st.st_size > file_buffer_size)
+    if (!buffer->ptr || st.st_size > buffer->size)
     {
-        VirtualFree( file_buffer, 0, MEM_RELEASE );
-        file_buffer = NULL;
-        file_buffer_size = st.st_size;
-        if (NtAllocateVirtualMemory( GetCurrentProcess(), &file_buffer, 0, &file_buffer_size,
+        VirtualFree( buffer->ptr, 0, MEM_RELEASE );
+        buffer->ptr = NULL;
+        buffer->size = st.st_size;
+        if (NtAllocateVirtualMemory( GetCurrentProcess(), &buffer->ptr, 0, &buffer->size,
                                      MEM_COMMIT, PAGE_READWRITE )) goto done;
     }
 
@@ -217,14 +257,14 @@ static int read_file( const char *name, void **data, SIZE_T *size )
 
     if (st.st_size < min_size) goto done;
     header_size = min( st.st_size, 4096 );
-    if (pread( fd, file_buffer, header_size, 0 ) != header_size) goto done;
-    dos = file_buffer;
+    if (pread( fd, buffer->ptr, header_size, 0 ) != header_size) goto done;
+    dos = buffer->ptr;
     if (dos->e_magic != IMAGE_DOS_SIGNATURE) goto done;
     if (dos->e_lfanew < sizeof(fakedll_signature)) goto done;
     if (memcmp( dos + 1, fakedll_signature, sizeof(fakedll_signature) )) goto done;
     if (dos->e_lfanew + FIELD_OFFSET(IMAGE_NT_HEADERS,OptionalHeader.MajorLinkerVersion) > header_size)
         goto done;
-    nt = (IMAGE_NT_HEADERS *)((char *)file_buffer + dos->e_lfanew);
+    nt = (IMAGE_NT_HEADERS *)((char *)buffer->ptr + dos->e_lfanew);
     if (nt->Signature == IMAGE_NT_SIGNATURE && nt->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR_MAGIC)
     {
         /* wrong 32/64 type, pretend it doesn't exist */
@@ -232,10 +272,10 @@ static int read_file( const char *name, void **data, SIZE_T *size )
         goto done;
     }
     if (st.st_size == header_size ||
-        pread( fd, (char *)file_buffer + header_size,
+        pread( fd, (char *)buffer->ptr + header_size,
                st.st_size - header_size, header_size ) == st.st_size - header_size)
     {
-        *data = file_buffer;
+        *data = buffer->ptr;
         ret = 1;
     }
 done:
@@ -364,6 +404,27 @@ static BOOL is_fake_dll( HANDLE h )
     return !memcmp( dos + 1, fakedll_signature, sizeof(fakedll_signature) );
 }
 
+/* check if an existing file already has the contents of the fake dll */
+static BOOL is_same_fake_dll( const WCHAR *name, const void *data, SIZE_T size )
+{
+    BYTE buffer[4096];
+    DWORD count;
+    SIZE_T pos = 0;
+    HANDLE h = CreateFileW( name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL );
+
+    if (h == INVALID_HANDLE_VALUE) return FALSE;
+    if (GetFileSize( h, NULL ) == size)
+    {
+        while (pos < size && ReadFile( h, buffer, min( sizeof(buffer), size - pos ), &count, NULL ) && count)
+        {
+            if (memcmp( buffer, (const char *)data + pos, count )) break;
+            pos += count;
+        }
+    }
+    CloseHandle( h );
+    return pos == size;
+}
+
 /* create directories leading to a given file */
 static void create_directories( const WCHAR *name )
 {
@@ -426,7 +487,7 @@ static void *load_fake_dll( const WCHAR *name, SIZE_T *size )
         ptr = prepend( ptr, ptr, namelen );
         ptr = prepend( ptr, "/dlls", sizeof("/dlls") - 1 );
         ptr = prepend( ptr, build_dir, strlen(build_dir) );
-        if ((res = read_file( ptr, &data, size ))) goto done;
+        if ((res = read_file( ptr, &file_buffer, &data, size ))) goto done;
 
         /* now as a program */
         ptr = file + pos;
@@ -435,7 +496,7 @@ static void *load_fake_dll( const WCHAR *name, SIZE_T *size )
         ptr = prepend( ptr, ptr, namelen );
         ptr = prepend( ptr, "/programs", sizeof("/programs") - 1 );
         ptr = prepend( ptr, build_dir, strlen(build_dir) );
-        if ((res = read_file( ptr, &data, size ))) goto done;
+        if ((res = read_file( ptr, &file_buffer, &data, size ))) goto done;
     }
 
     file[pos + len + 1] = 0;
@@ -443,7 +504,7 @@ static void *load_fake_dll( const WCHAR *name, SIZE_T *size )
     {
         ptr = prepend( file + pos, "/fakedlls", sizeof("/fakedlls") - 1 );
         ptr = prepend( ptr, path, strlen(path) );
-        if ((res = read_file( ptr, &data, size ))) break;
+        if ((res = read_file( ptr, &file_buffer, &data, size ))) break;
     }
 
 done:
@@ -837,19 +898,33 @@ static void register_fake_dll( const WCHAR *name, const void *data, size_t size
     if (FAILED(hr)) ERR( "failed to register %s: %x\n", debugstr_w(name), hr );
 }
 
+/* check whether a fake dll contains manifests or registry scripts */
+static BOOL needs_registration( const void *data )
+{
+    static const WCHAR regtypeW[] = {'W','I','N','E','_','R','E','G','I','S','T','R','Y',0};
+    const IMAGE_RESOURCE_DIRECTORY *resdir;
+    LDR_RESOURCE_INFO info;
+    HMODULE module = (HMODULE)((ULONG_PTR)data | 1);
+
+    info.Type = (ULONG_PTR)RT_MANIFEST;
+    if (!LdrFindResourceDirectory_U( module, &info, 1, &resdir )) return TRUE;
+    info.Type = (ULONG_PTR)regtypeW;
+    return !LdrFindResourceDirectory_U( module, &info, 1, &resdir );
+}
+
 /* copy a fake dll file to the dest directory */
-static void install_fake_dll( WCHAR *dest, char *file, const char *ext )
+/* registration is left to the caller since it has to happen in order on the main thread */
+static void install_fake_dll( WCHAR *dest, struct lib_dir_entry *entry, struct file_buffer *buffer )
 {
     int ret;
     SIZE_T size;
     void *data;
     DWORD written;
     WCHAR *destname = dest + strlenW(dest);
-    char *name = strrchr( file, '/' ) + 1;
-    char *end = name + strlen(name);
+    char *name = strrchr( entry->file, '/' ) + 1;
+    char *end = entry->file + entry->name_len;
 
-    if (ext) strcpy( end, ext );
-    if (!(ret = read_file( file, &data, &size ))) return;
+    if (!(ret = read_file( entry->file, buffer, &data, &size ))) return;
 
     if (end > name + 2 && !strncmp( end - 2, "16", 2 )) end -= 2;  /* remove "16" suffix */
     dll_name_AtoW( destname, name, end - name );
@@ -857,30 +932,116 @@ static void install_fake_dll( WCHAR *dest, char *file, const char *ext )
 
     if (ret != -1)
     {
-        HANDLE h = create_dest_file( dest );
-
-        if (h && h != INVALID_HANDLE_VALUE)
+        if (is_same_fake_dll( dest, data, size ))
+            TRACE( "%s is up to date\n", debugstr_w(dest) );
+        else
         {
-            TRACE( "%s -> %s\n", debugstr_a(file), debugstr_w(dest) );
+            HANDLE h = create_dest_file( dest );
 
-            ret = (WriteFile( h, data, size, &written, NULL ) && written == size);
-            if (!ret) ERR( "failed to write to %s (error=%u)\n", debugstr_w(dest), GetLastError() );
-            CloseHandle( h );
-            if (ret) register_fake_dll( dest, data, size );
-            else DeleteFileW( dest );
+            if (!h || h == INVALID_HANDLE_VALUE) ret = -1;
+            else
+            {
+                TRACE( "%s -> %s\n", debugstr_a(entry->file), debugstr_w(dest) );
+
+                ret = (WriteFile( h, data, size, &written, NULL ) && written == size);
+                if (!ret) ERR( "failed to write to %s (error=%u)\n", debugstr_w(dest), GetLastError() );
+                CloseHandle( h );
+                if (!ret) DeleteFileW( dest );
+            }
+        }
+        if (ret == 1 && needs_registration( data ))
+        {
+            entry->dest = HeapAlloc( GetProcessHeap(), 0, (strlenW(dest) + 1) * sizeof(WCHAR) );
+            entry->data = HeapAlloc( GetProcessHeap(), 0, size );
+            if (entry->dest && entry->data)
+            {
+                strcpyW( entry->dest, dest );
+                memcpy( entry->data, data, size );
+                entry->size = size;
+            }
+            else
+            {
+                ERR( "out of memory, not registering %s\n", debugstr_w(dest) );
+                HeapFree( GetProcessHeap(), 0, entry->dest );
+                HeapFree( GetProcessHeap(), 0, entry->data );
+                entry->dest = NULL;
+                entry->data = NULL;
+            }
         }
     }
     *destname = 0;  /* restore it for next file */
 }
 
+/* worker thread installing the fake dlls of a lib directory */
+static DWORD WINAPI install_lib_dir_thread( void *arg )
+{
+    struct lib_dir *dir = arg;
+    struct file_buffer buffer = { NULL, 0 };
+    unsigned int i;
+    WCHAR *dest;
+
+    if (!(dest = HeapAlloc( GetProcessHeap(), 0, (strlenW(dir->dest) + max_dll_name_len) * sizeof(WCHAR) )))
+        return 1;
+    strcpyW( dest, dir->dest );
+    while ((i = InterlockedIncrement( &dir->next ) - 1) < dir->count)
+        install_fake_dll( dest, &dir->entries[i], &buffer );
+
+    VirtualFree( buffer.ptr, 0, MEM_RELEASE );
+    HeapFree( GetProcessHeap(), 0, dest );
+    return 0;
+}
+
+/* add a file of a lib directory to the list of dlls to install */
+static BOOL add_lib_dir_entry( struct lib_dir *dir, unsigned int *total, const char *file, size_t len )
+{
+    struct lib_dir_entry *entry;
+    size_t ext_len = dir->ext ? strlen( dir->ext ) : 0;
+
+    if (dir->count >= *total)
+    {
+        struct lib_dir_entry *new_entries;
+        unsigned int new_total = max( 64, *total * 2 );
+
+        if (dir->entries) new_entries = HeapReAlloc( GetProcessHeap(), 0, dir->entries,
+                                                     new_total * sizeof(*new_entries) );
+        else new_entries = HeapAlloc( GetProcessHeap(), 0, new_total * sizeof(*new_entries) );
+        if (!new_entries) return FALSE;
+        dir->entries = new_entries;
+        *total = new_total;
+    }
+    entry = &dir->entries[dir->count];
+    if (!(entry->file = HeapAlloc( GetProcessHeap(), 0, len + ext_len + 1 ))) return FALSE;
+    memcpy( entry->file, file, len );
+    if (dir->ext) memcpy( entry->file + len, dir->ext, ext_len );
+    entry->file[len + ext_len] = 0;
+    entry->name_len = len;
+    entry->dest = NULL;
+    entry->data = NULL;
+    entry->size = 0;
+    dir->count++;
+    return TRUE;
+}
+
 /* find and install all fake dlls in a given lib directory */
+/* the files are written by a few worker threads, which mostly wait on I/O */
 static void install_lib_dir( WCHAR *dest, char *file, const char *default_ext )
 {
+    struct lib_dir lib_dir;
+    HANDLE threads[MAX_INSTALL_THREADS];
+    unsigned int i, total = 0, nb_threads = 0;
+    SYSTEM_INFO si;
     DIR *dir;
     struct dirent *de;
     char *name;
 
     if (!(dir = opendir( file ))) return;
+
+    lib_dir.dest    = dest;
+    lib_dir.ext     = default_ext ? ".fake" : NULL;
+    lib_dir.entries = NULL;
+    lib_dir.count   = 0;
+    lib_dir.next    = 0;
+
     name = file + strlen(file);
     *name++ = '/';
     while ((de = readdir( dir )))
@@ -894,11 +1055,34 @@ static void install_lib_dir( WCHAR *dest, char *file, const char *default_ext )
             strcat( name, "/" );
             strcat( name, de->d_name );
             if (!strchr( de->d_name, '.' )) strcat( name, default_ext );
-            install_fake_dll( dest, file, ".fake" );
         }
-        else install_fake_dll( dest, file, NULL );
+        if (!add_lib_dir_entry( &lib_dir, &total, file, strlen(file) )) break;
     }
     closedir( dir );
+
+    GetSystemInfo( &si );
+    while (nb_threads < min( si.dwNumberOfProcessors, MAX_INSTALL_THREADS ) &&
+           nb_threads * 16 < lib_dir.count)
+    {
+        if (!(threads[nb_threads] = CreateThread( NULL, 0, install_lib_dir_thread, &lib_dir, 0, NULL )))
+            break;
+        nb_threads++;
+    }
+    /* the current thread always takes part, so that this works even if no thread could be created */
+    install_lib_dir_thread( &lib_dir );
+    if (nb_threads) WaitForMultipleObjects( nb_threads, threads, TRUE, INFINITE );
+    for (i = 0; i < nb_threads; i++) CloseHandle( threads[i] );
+
+    for (i = 0; i < lib_dir.count; i++)
+    {
+        struct lib_dir_entry *entry = &lib_dir.entries[i];
+
+        if (entry->data) register_fake_dll( entry->dest, entry->data, entry->size );
+        HeapFree( GetProcessHeap(), 0, entry->file );
+        HeapFree( GetProcessHeap(), 0, entry->dest );
+        HeapFree( GetProcessHeap(), 0, entry->data );
+    }
+    HeapFree( GetProcessHeap(), 0, lib_dir.entries );
 }
 
 /* create fake dlls in dirname for all the files we can find */
@@ -967,6 +1151,14 @@ BOOL create_fake_dll( const WCHAR *name, const WCHAR *source )
 
     add_handled_dll( filename );
 
+    if (source[0] == '-' && !source[1]) buffer = NULL;
+    else if ((buffer = load_fake_dll( source, &size )) && is_same_fake_dll( name, buffer, size ))
+    {
+        TRACE( "%s is up to date\n", debugstr_w(name) );
+        register_fake_dll( name, buffer, size );
+        return TRUE;
+    }
+
     if (!(h = create_dest_file( name ))) return TRUE;  /* not a fake dll */
     if (h == INVALID_HANDLE_VALUE) return FALSE;
 
@@ -976,7 +1168,7 @@ BOOL create_fake_dll( const WCHAR *name, const WCHAR *source )
         TRACE( "deleting %s\n", debugstr_w(name) );
         ret = FALSE;
     }
-    else if ((buffer = load_fake_dll( source, &size )))
+    else if (buffer)
     {
         DWORD written;
 
@@ -1001,8 +1193,9 @@ BOOL create_fake_dll( const WCHAR *name, const WCHAR *source )
  */
 void cleanup_fake_dlls(void)
 {
-    if (file_buffer) VirtualFree( file_buffer, 0, MEM_RELEASE );
-    file_buffer = NULL;
+    if (file_buffer.ptr) VirtualFree( file_buffer.ptr, 0, MEM_RELEASE );
+    file_buffer.ptr = NULL;
+    file_buffer.size = 0;
     HeapFree( GetProcessHeap(), 0, handled_dlls );
     handled_dlls = NULL;
     handled_count = handled_total = 0;
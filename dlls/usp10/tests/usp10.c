@@ -2073,6 +2073,66 @@ static void test_ScriptPlace(HDC hdc)
     ScriptFreeCache(&sc);
 }
 
+static void test_ScriptShape_repeated(HDC hdc)
+{
+    static const WCHAR test1[] = {'t', 'e', 's', 't',0};
+    SCRIPT_CACHE sc = NULL, sc2 = NULL;
+    WORD glyphs[4], glyphs2[4], logclust[4], logclust2[4];
+    SCRIPT_VISATTR attrs[4], attrs2[4];
+    int nb, nb2, widths[4], widths2[4], i;
+    GOFFSET offset[4], offset2[4];
+    SCRIPT_ITEM items[2];
+    ABC abc, abc2;
+    HRESULT hr;
+
+    hr = ScriptItemize(test1, 4, 2, NULL, NULL, items, NULL);
+    ok(hr == S_OK, "ScriptItemize should return S_OK not %08x\n", hr);
+
+    /* same run shaped with separate caches gives same results */
+    hr = ScriptShape(hdc, &sc, test1, 4, 4, &items[0].a, glyphs, logclust, attrs, &nb);
+    ok(hr == S_OK, "ScriptShape should return S_OK not %08x\n", hr);
+    hr = ScriptPlace(hdc, &sc, glyphs, nb, attrs, &items[0].a, widths, offset, &abc);
+    ok(hr == S_OK, "ScriptPlace should return S_OK not %08x\n", hr);
+
+    hr = ScriptShape(hdc, &sc2, test1, 4, 4, &items[0].a, glyphs2, logclust2, attrs2, &nb2);
+    ok(hr == S_OK, "ScriptShape should return S_OK not %08x\n", hr);
+    ok(nb == nb2, "got %d glyphs, expected %d\n", nb2, nb);
+    ok(!memcmp(glyphs, glyphs2, nb * sizeof(*glyphs)), "glyphs differ\n");
+    ok(!memcmp(logclust, logclust2, sizeof(logclust)), "clusters differ\n");
+    ok(!memcmp(attrs, attrs2, nb * sizeof(*attrs)), "attributes differ\n");
+
+    hr = ScriptPlace(hdc, &sc2, glyphs2, nb2, attrs2, &items[0].a, widths2, offset2, &abc2);
+    ok(hr == S_OK, "ScriptPlace should return S_OK not %08x\n", hr);
+    ok(!memcmp(widths, widths2, nb * sizeof(*widths)), "advances differ\n");
+    ok(!memcmp(offset, offset2, nb * sizeof(*offset)), "offsets differ\n");
+    ok(abc.abcA == abc2.abcA && abc.abcB == abc2.abcB && abc.abcC == abc2.abcC,
+       "got abc %d,%u,%d, expected %d,%u,%d\n", abc2.abcA, abc2.abcB, abc2.abcC, abc.abcA, abc.abcB, abc.abcC);
+
+    /* analysis is taken into account */
+    items[0].a.fRTL = 1;
+    hr = ScriptShape(hdc, &sc2, test1, 4, 4, &items[0].a, glyphs2, logclust2, attrs2, &nb2);
+    ok(hr == S_OK, "ScriptShape should return S_OK not %08x\n", hr);
+    ok(nb2 == 4, "got %d glyphs\n", nb2);
+    for (i = 0; i < 4; i++)
+        ok(logclust2[i] == 3 - i, "%d: got cluster %u\n", i, logclust2[i]);
+    items[0].a.fRTL = 0;
+
+    /* so are visual attributes */
+    if (widths[0])
+    {
+        attrs2[0] = attrs[0];
+        attrs2[0].fZeroWidth = 1;
+        for (i = 1; i < nb; i++)
+            attrs2[i] = attrs[i];
+        hr = ScriptPlace(hdc, &sc2, glyphs, nb, attrs2, &items[0].a, widths2, offset2, &abc2);
+        ok(hr == S_OK, "ScriptPlace should return S_OK not %08x\n", hr);
+        ok(widths2[0] == 0, "got width %d\n", widths2[0]);
+    }
+
+    ScriptFreeCache(&sc);
+    ScriptFreeCache(&sc2);
+}
+
 static void test_ScriptItemIzeShapePlace(HDC hdc, unsigned short pwOutGlyphs[256])
 {
     HRESULT         hr;
@@ -4010,6 +4070,7 @@ START_TEST(usp10)
     test_ScriptShape(hdc);
     test_ScriptShapeOpenType(hdc);
     test_ScriptPlace(hdc);
+    test_ScriptShape_repeated(hdc);
 
     test_ScriptGetFontProperties(hdc);
     test_ScriptTextOut(hdc);
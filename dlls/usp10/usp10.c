@@ -39,6 +39,8 @@
 #include "usp10_internal.h"
 
 #include "wine/debug.h"
+#include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/unicode.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(uniscribe);
@@ -874,6 +876,16 @@ static HRESULT init_script_cache(const HDC hdc, SCRIPT_CACHE *psc)
         return E_INVALIDARG;
     }
     sc->sfnt = (GetFontData(hdc, MS_MAKE_TAG('h','e','a','d'), 0, NULL, 0)!=GDI_ERROR);
+    /* identify the realized font, the same LOGFONT may select another one later */
+    if (sc->otm)
+        lstrcpynW(sc->full_name, (WCHAR *)((char *)sc->otm + (UINT_PTR)sc->otm->otmpFullName), LF_FULLFACESIZE);
+    else
+        GetTextFaceW(hdc, LF_FULLFACESIZE, sc->full_name);
+    if (sc->sfnt)
+    {
+        sc->font_size = GetFontData(hdc, 0, 0, NULL, 0);
+        GetFontData(hdc, MS_MAKE_TAG('h','e','a','d'), 8, &sc->font_checksum, sizeof(sc->font_checksum));
+    }
     if (!set_cache_font_properties(hdc, sc))
     {
         heap_free(sc);
@@ -884,6 +896,189 @@ static HRESULT init_script_cache(const HDC hdc, SCRIPT_CACHE *psc)
     return S_OK;
 }
 
+/* Shaped and placed runs are kept in a process wide cache, because callers like
+ * ScriptStringAnalyse() start with a new SCRIPT_CACHE every time. Entries are keyed by
+ * requested and realized font, analysis, OpenType tags and run contents and indexed by
+ * key hash, the list is only used to discard least recently used ones once total size
+ * goes over the limit. */
+#define SHAPING_CACHE_MAX_SIZE (1024 * 1024)
+#define SHAPING_CACHE_MAX_KEY  4096
+
+enum shaping_cache_type
+{
+    SHAPING_CACHE_SHAPE,
+    SHAPING_CACHE_PLACE,
+};
+
+struct shaping_cache_key
+{
+    DWORD type;
+    LOGFONTW lf;
+    TEXTMETRICW tm;
+    BOOL sfnt;
+    WCHAR full_name[LF_FULLFACESIZE];
+    DWORD font_size;
+    DWORD font_checksum;
+    BOOL has_analysis;
+    SCRIPT_ANALYSIS sa;
+    OPENTYPE_TAG script_tag;
+    OPENTYPE_TAG lang_tag;
+    int count;
+    int max_glyphs;
+};
+
+struct shaping_cache_entry
+{
+    struct list entry;
+    struct wine_rb_entry index;
+    unsigned int hash;
+    unsigned int key_size;
+    unsigned int value_size;
+    BYTE data[1];
+};
+
+struct shaping_cache_lookup
+{
+    unsigned int hash;
+    unsigned int key_size;
+    const void *key;
+};
+
+static int shaping_cache_compare(const void *key, const struct wine_rb_entry *entry)
+{
+    const struct shaping_cache_entry *cached = WINE_RB_ENTRY_VALUE(entry, const struct shaping_cache_entry, index);
+    const struct shaping_cache_lookup *lookup = key;
+
+    if (lookup->hash != cached->hash)
+        return lookup->hash < cached->hash ? -1 : 1;
+    if (lookup->key_size != cached->key_size)
+        return lookup->key_size < cached->key_size ? -1 : 1;
+    return memcmp(lookup->key, cached->data, lookup->key_size);
+}
+
+static struct list shaping_cache = LIST_INIT(shaping_cache);
+static struct wine_rb_tree shaping_cache_index = { shaping_cache_compare };
+static SIZE_T shaping_cache_size;
+
+static CRITICAL_SECTION shaping_cache_cs;
+static CRITICAL_SECTION_DEBUG shaping_cache_cs_debug =
+{
+    0, 0, &shaping_cache_cs,
+    { &shaping_cache_cs_debug.ProcessLocksList, &shaping_cache_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": shaping_cache_cs") }
+};
+static CRITICAL_SECTION shaping_cache_cs = { &shaping_cache_cs_debug, -1, 0, 0, 0, 0 };
+
+/* Returns size of the key header, or 0 if run is too long to be cached. */
+static unsigned int shaping_cache_init_key(struct shaping_cache_key *key, enum shaping_cache_type type,
+        const ScriptCache *sc, const SCRIPT_ANALYSIS *sa, OPENTYPE_TAG script_tag, OPENTYPE_TAG lang_tag,
+        int count, int max_glyphs, unsigned int data_size)
+{
+    if (data_size > SHAPING_CACHE_MAX_KEY - sizeof(*key))
+        return 0;
+
+    /* zero padding too, keys are compared as raw bytes */
+    memset(key, 0, sizeof(*key));
+    key->type = type;
+    key->lf = sc->lf;
+    key->tm = sc->tm;
+    key->sfnt = sc->sfnt;
+    memcpy(key->full_name, sc->full_name, sizeof(key->full_name));
+    key->font_size = sc->font_size;
+    key->font_checksum = sc->font_checksum;
+    if ((key->has_analysis = !!sa))
+        key->sa = *sa;
+    key->script_tag = script_tag;
+    key->lang_tag = lang_tag;
+    key->count = count;
+    key->max_glyphs = max_glyphs;
+    return sizeof(*key);
+}
+
+static unsigned int shaping_cache_hash(const BYTE *data, unsigned int size)
+{
+    unsigned int hash = 2166136261u, i;
+
+    for (i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+
+    return hash;
+}
+
+/* Returns a copy of cached value, to be freed by caller. */
+static void *shaping_cache_get(const void *key, unsigned int key_size, unsigned int *value_size)
+{
+    struct shaping_cache_entry *entry;
+    struct shaping_cache_lookup lookup;
+    struct wine_rb_entry *found;
+    void *value = NULL;
+
+    lookup.hash = shaping_cache_hash(key, key_size);
+    lookup.key_size = key_size;
+    lookup.key = key;
+
+    EnterCriticalSection(&shaping_cache_cs);
+    if ((found = wine_rb_get(&shaping_cache_index, &lookup)))
+    {
+        entry = WINE_RB_ENTRY_VALUE(found, struct shaping_cache_entry, index);
+        if ((value = heap_alloc(entry->value_size)))
+        {
+            memcpy(value, entry->data + key_size, entry->value_size);
+            *value_size = entry->value_size;
+            list_remove(&entry->entry);
+            list_add_head(&shaping_cache, &entry->entry);
+        }
+    }
+    LeaveCriticalSection(&shaping_cache_cs);
+
+    return value;
+}
+
+static void shaping_cache_add(const void *key, unsigned int key_size, const void *value, unsigned int value_size)
+{
+    struct shaping_cache_entry *entry;
+    struct shaping_cache_lookup lookup;
+    SIZE_T size;
+
+    size = FIELD_OFFSET(struct shaping_cache_entry, data[key_size + value_size]);
+    if (size > SHAPING_CACHE_MAX_SIZE / 16)
+        return;
+
+    if (!(entry = heap_alloc(size)))
+        return;
+    entry->hash = shaping_cache_hash(key, key_size);
+    entry->key_size = key_size;
+    entry->value_size = value_size;
+    memcpy(entry->data, key, key_size);
+    memcpy(entry->data + key_size, value, value_size);
+
+    lookup.hash = entry->hash;
+    lookup.key_size = key_size;
+    lookup.key = entry->data;
+
+    EnterCriticalSection(&shaping_cache_cs);
+    /* another thread could have added the same run meanwhile */
+    if (wine_rb_get(&shaping_cache_index, &lookup))
+    {
+        LeaveCriticalSection(&shaping_cache_cs);
+        heap_free(entry);
+        return;
+    }
+    while (shaping_cache_size + size > SHAPING_CACHE_MAX_SIZE)
+    {
+        struct shaping_cache_entry *lru = LIST_ENTRY(list_tail(&shaping_cache), struct shaping_cache_entry, entry);
+
+        list_remove(&lru->entry);
+        wine_rb_remove(&shaping_cache_index, &lru->index);
+        shaping_cache_size -= FIELD_OFFSET(struct shaping_cache_entry, data[lru->key_size + lru->value_size]);
+        heap_free(lru);
+    }
+    wine_rb_put(&shaping_cache_index, &lookup, &entry->index);
+    list_add_head(&shaping_cache, &entry->entry);
+    shaping_cache_size += size;
+    LeaveCriticalSection(&shaping_cache_cs);
+}
+
 static WCHAR mirror_char( WCHAR ch )
 {
     extern const WCHAR wine_mirror_map[] DECLSPEC_HIDDEN;
@@ -3079,11 +3274,14 @@ HRESULT WINAPI ScriptShapeOpenType( HDC hdc, SCRIPT_CACHE *psc,
                                     SCRIPT_CHARPROP *pCharProps, WORD *pwOutGlyphs,
                                     SCRIPT_GLYPHPROP *pOutGlyphProps, int *pcGlyphs)
 {
+    DWORD key_buffer[SHAPING_CACHE_MAX_KEY / sizeof(DWORD)];
+    unsigned int key_size = 0, value_size;
     HRESULT hr;
     int i;
     unsigned int g;
     BOOL rtl;
     int cluster;
+    BYTE *value, *ptr;
     static int once = 0;
 
     TRACE("(%p, %p, %p, %s, %s, %p, %p, %d, %s, %d, %d, %p, %p, %p, %p, %p )\n",
@@ -3110,6 +3308,31 @@ HRESULT WINAPI ScriptShapeOpenType( HDC hdc, SCRIPT_CACHE *psc,
     ((ScriptCache *)*psc)->userScript = tagScript;
     ((ScriptCache *)*psc)->userLang = tagLangSys;
 
+    /* without a DC, only what this SCRIPT_CACHE already knows may be used */
+    if (hdc && !cRanges && cChars > 0 && (key_size = shaping_cache_init_key((struct shaping_cache_key *)key_buffer,
+            SHAPING_CACHE_SHAPE, *psc, psa, tagScript, tagLangSys, cChars, cMaxGlyphs, cChars * sizeof(WCHAR))))
+    {
+        memcpy((BYTE *)key_buffer + key_size, pwcChars, cChars * sizeof(WCHAR));
+        key_size += cChars * sizeof(WCHAR);
+
+        if ((value = shaping_cache_get(key_buffer, key_size, &value_size)))
+        {
+            TRACE("using cached run\n");
+            ptr = value;
+            memcpy(pcGlyphs, ptr, sizeof(int));
+            ptr += sizeof(int);
+            memcpy(pwLogClust, ptr, cChars * sizeof(WORD));
+            ptr += cChars * sizeof(WORD);
+            memcpy(pCharProps, ptr, cChars * sizeof(SCRIPT_CHARPROP));
+            ptr += cChars * sizeof(SCRIPT_CHARPROP);
+            memcpy(pwOutGlyphs, ptr, *pcGlyphs * sizeof(WORD));
+            ptr += *pcGlyphs * sizeof(WORD);
+            memcpy(pOutGlyphProps, ptr, *pcGlyphs * sizeof(SCRIPT_GLYPHPROP));
+            heap_free(value);
+            return S_OK;
+        }
+    }
+
     /* Initialize a SCRIPT_VISATTR and LogClust for each char in this run */
     for (i = 0; i < cChars; i++)
     {
@@ -3241,6 +3464,27 @@ HRESULT WINAPI ScriptShapeOpenType( HDC hdc, SCRIPT_CACHE *psc,
         }
     }
 
+    if (key_size)
+    {
+        value_size = sizeof(int) + cChars * (sizeof(WORD) + sizeof(SCRIPT_CHARPROP))
+                + *pcGlyphs * (sizeof(WORD) + sizeof(SCRIPT_GLYPHPROP));
+        if ((value = heap_alloc(value_size)))
+        {
+            ptr = value;
+            memcpy(ptr, pcGlyphs, sizeof(int));
+            ptr += sizeof(int);
+            memcpy(ptr, pwLogClust, cChars * sizeof(WORD));
+            ptr += cChars * sizeof(WORD);
+            memcpy(ptr, pCharProps, cChars * sizeof(SCRIPT_CHARPROP));
+            ptr += cChars * sizeof(SCRIPT_CHARPROP);
+            memcpy(ptr, pwOutGlyphs, *pcGlyphs * sizeof(WORD));
+            ptr += *pcGlyphs * sizeof(WORD);
+            memcpy(ptr, pOutGlyphProps, *pcGlyphs * sizeof(SCRIPT_GLYPHPROP));
+            shaping_cache_add(key_buffer, key_size, value, value_size);
+            heap_free(value);
+        }
+    }
+
     return S_OK;
 }
 
@@ -3342,8 +3586,11 @@ HRESULT WINAPI ScriptPlaceOpenType( HDC hdc, SCRIPT_CACHE *psc, SCRIPT_ANALYSIS
                                     GOFFSET *pGoffset, ABC *pABC
 )
 {
+    DWORD key_buffer[SHAPING_CACHE_MAX_KEY / sizeof(DWORD)];
+    unsigned int key_size = 0, value_size;
     HRESULT hr;
     int i;
+    BYTE *value, *ptr;
     static int once = 0;
 
     TRACE("(%p, %p, %p, %s, %s, %p, %p, %d, %s, %p, %p, %d, %p, %p, %d, %p %p %p)\n",
@@ -3363,6 +3610,30 @@ HRESULT WINAPI ScriptPlaceOpenType( HDC hdc, SCRIPT_CACHE *psc, SCRIPT_ANALYSIS
     ((ScriptCache *)*psc)->userScript = tagScript;
     ((ScriptCache *)*psc)->userLang = tagLangSys;
 
+    /* only complete results are stored, so both advances and ABC width are needed */
+    if (hdc && !cRanges && cGlyphs > 0 && piAdvance && pABC && (key_size = shaping_cache_init_key(
+            (struct shaping_cache_key *)key_buffer, SHAPING_CACHE_PLACE, *psc, psa, tagScript, tagLangSys,
+            cGlyphs, 0, cGlyphs * (sizeof(WORD) + sizeof(SCRIPT_GLYPHPROP)))))
+    {
+        ptr = (BYTE *)key_buffer + key_size;
+        memcpy(ptr, pwGlyphs, cGlyphs * sizeof(WORD));
+        memcpy(ptr + cGlyphs * sizeof(WORD), pGlyphProps, cGlyphs * sizeof(SCRIPT_GLYPHPROP));
+        key_size += cGlyphs * (sizeof(WORD) + sizeof(SCRIPT_GLYPHPROP));
+
+        if ((value = shaping_cache_get(key_buffer, key_size, &value_size)))
+        {
+            TRACE("using cached placement\n");
+            ptr = value;
+            memcpy(pABC, ptr, sizeof(ABC));
+            ptr += sizeof(ABC);
+            memcpy(piAdvance, ptr, cGlyphs * sizeof(int));
+            ptr += cGlyphs * sizeof(int);
+            memcpy(pGoffset, ptr, cGlyphs * sizeof(GOFFSET));
+            heap_free(value);
+            return S_OK;
+        }
+    }
+
     if (pABC) memset(pABC, 0, sizeof(ABC));
     for (i = 0; i < cGlyphs; i++)
     {
@@ -3409,6 +3680,22 @@ HRESULT WINAPI ScriptPlaceOpenType( HDC hdc, SCRIPT_CACHE *psc, SCRIPT_ANALYSIS
 
     SHAPE_ApplyOpenTypePositions(hdc, (ScriptCache *)*psc, psa, pwGlyphs, cGlyphs, piAdvance, pGoffset);
 
+    if (key_size)
+    {
+        value_size = sizeof(ABC) + cGlyphs * (sizeof(int) + sizeof(GOFFSET));
+        if ((value = heap_alloc(value_size)))
+        {
+            ptr = value;
+            memcpy(ptr, pABC, sizeof(ABC));
+            ptr += sizeof(ABC);
+            memcpy(ptr, piAdvance, cGlyphs * sizeof(int));
+            ptr += cGlyphs * sizeof(int);
+            memcpy(ptr, pGoffset, cGlyphs * sizeof(GOFFSET));
+            shaping_cache_add(key_buffer, key_size, value, value_size);
+            heap_free(value);
+        }
+    }
+
     if (pABC) TRACE("Total for run: abcA=%d, abcB=%d, abcC=%d\n", pABC->abcA, pABC->abcB, pABC->abcC);
     return S_OK;
 }
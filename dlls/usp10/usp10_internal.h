@@ -179,6 +179,9 @@ typedef struct {
     OUTLINETEXTMETRICW *otm;
     SCRIPT_FONTPROPERTIES sfp;
     BOOL sfnt;
+    WCHAR full_name[LF_FULLFACESIZE];
+    DWORD font_size;
+    DWORD font_checksum;
     CacheGlyphPage *page[NUM_PAGES];
     ABC *widths[GLYPH_MAX / GLYPH_BLOCK_SIZE];
     void *GSUB_Table;
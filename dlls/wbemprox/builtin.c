@@ -1756,6 +1756,7 @@ static enum fill_status fill_datafile( struct table *table, const struct expr *c
     HANDLE handle;
     struct dirstack *dirstack;
     enum fill_status status = FILL_STATUS_UNFILTERED;
+    BOOL need_version = is_column_needed( table, prop_versionW );
 
     if (!resize_table( table, 8, sizeof(*rec) )) return FILL_STATUS_FAILED;
 
@@ -1804,7 +1805,7 @@ static enum fill_status fill_datafile( struct table *table, const struct expr *c
                     }
                     rec = (struct record_datafile *)(table->data + offset);
                     rec->name    = build_name( root[0], new_path );
-                    rec->version = get_file_version( rec->name );
+                    rec->version = need_version ? get_file_version( rec->name ) : NULL;
                     if (!match_row( table, row, cond, &status ))
                     {
                         free_row_values( table, row );
@@ -2545,6 +2546,7 @@ static enum fill_status fill_process( struct table *table, const struct expr *co
     HANDLE snap;
     enum fill_status status = FILL_STATUS_FAILED;
     UINT row = 0, offset = 0;
+    BOOL need_cmdline = is_column_needed( table, prop_commandlineW );
 
     snap = CreateToolhelp32Snapshot( TH32CS_SNAPPROCESS, 0 );
     if (snap == INVALID_HANDLE_VALUE) return FILL_STATUS_FAILED;
@@ -2559,7 +2561,7 @@ static enum fill_status fill_process( struct table *table, const struct expr *co
 
         rec = (struct record_process *)(table->data + offset);
         rec->caption        = heap_strdupW( entry.szExeFile );
-        rec->commandline    = get_cmdline( entry.th32ProcessID );
+        rec->commandline    = need_cmdline ? get_cmdline( entry.th32ProcessID ) : NULL;
         rec->description    = heap_strdupW( entry.szExeFile );
         sprintfW( handle, fmtW, entry.th32ProcessID );
         rec->handle         = heap_strdupW( handle );
@@ -3045,7 +3047,7 @@ static enum fill_status fill_service( struct table *table, const struct expr *co
     DWORD len = sizeof(sysnameW) / sizeof(sysnameW[0]);
     UINT i, row = 0, offset = 0, size = 256, needed, count;
     enum fill_status fill_status = FILL_STATUS_FAILED;
-    BOOL ret;
+    BOOL ret, need_config = is_column_needed( table, prop_startmodeW );
 
     if (!(manager = OpenSCManagerW( NULL, NULL, SC_MANAGER_ENUMERATE_SERVICE ))) return FILL_STATUS_FAILED;
     if (!(services = heap_alloc( size ))) goto done;
@@ -3071,9 +3073,11 @@ static enum fill_status fill_service( struct table *table, const struct expr *co
 
     for (i = 0; i < count; i++)
     {
-        QUERY_SERVICE_CONFIGW *config;
+        QUERY_SERVICE_CONFIGW *config = NULL;
 
-        if (!(config = query_service_config( manager, services[i].lpServiceName ))) continue;
+        /* rows must not depend on the columns that are needed, so services
+         * whose config can't be queried are listed without a start mode */
+        if (need_config) config = query_service_config( manager, services[i].lpServiceName );
 
         status = &services[i].ServiceStatusProcess;
         rec = (struct record_service *)(table->data + offset);
@@ -3083,7 +3087,7 @@ static enum fill_status fill_service( struct table *table, const struct expr *co
         rec->name           = heap_strdupW( services[i].lpServiceName );
         rec->process_id     = status->dwProcessId;
         rec->servicetype    = get_service_type( status->dwServiceType );
-        rec->startmode      = get_service_startmode( config->dwStartType );
+        rec->startmode      = config ? get_service_startmode( config->dwStartType ) : NULL;
         rec->state          = get_service_state( status->dwCurrentState );
         rec->systemname     = heap_strdupW( sysnameW );
         rec->pause_service  = service_pause_service;
@@ -3339,11 +3343,11 @@ static struct table builtin_classes[] =
     { class_physicalmediaW, SIZEOF(col_physicalmedia), col_physicalmedia, SIZEOF(data_physicalmedia), 0, (BYTE *)data_physicalmedia },
     { class_physicalmemoryW, SIZEOF(col_physicalmemory), col_physicalmemory, 0, 0, NULL, fill_physicalmemory },
     { class_printerW, SIZEOF(col_printer), col_printer, 0, 0, NULL, fill_printer },
-    { class_processW, SIZEOF(col_process), col_process, 0, 0, NULL, fill_process },
+    { class_processW, SIZEOF(col_process), col_process, 0, 0, NULL, fill_process, TABLE_FLAG_CACHEABLE },
     { class_processorW, SIZEOF(col_processor), col_processor, 0, 0, NULL, fill_processor },
     { class_processor2W, SIZEOF(col_processor), col_processor, 0, 0, NULL, fill_processor },
     { class_qualifiersW, SIZEOF(col_qualifier), col_qualifier, SIZEOF(data_qualifier), 0, (BYTE *)data_qualifier },
-    { class_serviceW, SIZEOF(col_service), col_service, 0, 0, NULL, fill_service },
+    { class_serviceW, SIZEOF(col_service), col_service, 0, 0, NULL, fill_service, TABLE_FLAG_CACHEABLE },
     { class_sidW, SIZEOF(col_sid), col_sid, 0, 0, NULL, fill_sid },
     { class_sounddeviceW, SIZEOF(col_sounddevice), col_sounddevice, SIZEOF(data_sounddevice), 0, (BYTE *)data_sounddevice },
     { class_stdregprovW, SIZEOF(col_stdregprov), col_stdregprov, SIZEOF(data_stdregprov), 0, (BYTE *)data_stdregprov },
@@ -23,6 +23,7 @@
 
 #include "windef.h"
 #include "winbase.h"
+#include "winreg.h"
 #include "wbemcli.h"
 
 #include "wine/debug.h"
@@ -402,16 +403,104 @@ HRESULT eval_cond( const struct table *table, UINT row, const struct expr *cond,
     return WBEM_E_INVALID_QUERY;
 }
 
+static UINT64 get_cond_columns( const struct table *table, const struct expr *expr )
+{
+    UINT column;
+
+    if (!expr) return 0;
+    switch (expr->type)
+    {
+    case EXPR_COMPLEX:
+    case EXPR_UNARY:
+        return get_cond_columns( table, expr->u.expr.left ) | get_cond_columns( table, expr->u.expr.right );
+    case EXPR_PROPVAL:
+        if (get_column_index( table, expr->u.propval->name, &column ) == S_OK && column < 64)
+            return (UINT64)1 << column;
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/* columns that are either selected or referenced by the condition */
+static UINT64 get_needed_columns( const struct view *view )
+{
+    const struct property *prop;
+    UINT64 ret;
+    UINT column;
+
+    if (!view->proplist || view->table->num_cols > 64) return ~(UINT64)0;
+
+    ret = get_cond_columns( view->table, view->cond );
+    for (prop = view->proplist; prop; prop = prop->next)
+    {
+        if (get_column_index( view->table, prop->name, &column ) == S_OK) ret |= (UINT64)1 << column;
+    }
+    return ret;
+}
+
+/* HKCU\Software\Wine\Wbemprox\CacheTimeout, in milliseconds */
+static DWORD get_cache_timeout(void)
+{
+    static const WCHAR keyW[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\',
+                                 'W','b','e','m','p','r','o','x',0};
+    static const WCHAR timeoutW[] = {'C','a','c','h','e','T','i','m','e','o','u','t',0};
+    static LONG timeout = -1;
+    DWORD value = 0, size = sizeof(value);
+    HKEY key;
+
+    if (timeout != -1) return timeout;
+    if (!RegOpenKeyExW( HKEY_CURRENT_USER, keyW, 0, KEY_READ, &key ))
+    {
+        if (RegQueryValueExW( key, timeoutW, NULL, NULL, (BYTE *)&value, &size ) || size != sizeof(value))
+            value = 0;
+        RegCloseKey( key );
+    }
+    if (value) TRACE("caching rows for %u ms\n", value);
+    InterlockedExchange( &timeout, min( value, 0x7fffffff ) );
+    return timeout;
+}
+
+static void fill_table( struct table *table, const struct view *view )
+{
+    UINT64 needed = get_needed_columns( view );
+    DWORD timeout, now;
+
+    /* cacheable tables are filled without a condition, so that rows can be
+     * reused by any query within the timeout, as long as they have all the
+     * columns it needs; a refill keeps the columns of the previous fill */
+    if ((table->flags & TABLE_FLAG_CACHEABLE) && (timeout = get_cache_timeout()))
+    {
+        now = GetTickCount();
+        if ((table->flags & TABLE_FLAG_CACHED) && now - table->fill_time < timeout &&
+            !(needed & ~table->columns_needed))
+        {
+            TRACE("reusing %u cached rows of %s\n", table->num_rows, debugstr_w(table->name));
+            return;
+        }
+        if (table->flags & TABLE_FLAG_CACHED) needed |= table->columns_needed;
+        clear_table( table );
+        table->columns_needed = needed;
+        if (table->fill( table, NULL ) == FILL_STATUS_FAILED) table->flags &= ~TABLE_FLAG_CACHED;
+        else
+        {
+            table->flags |= TABLE_FLAG_CACHED;
+            table->fill_time = now;
+        }
+        return;
+    }
+
+    clear_table( table );
+    table->columns_needed = needed;
+    table->fill( table, view->cond );
+}
+
 HRESULT execute_view( struct view *view )
 {
     UINT i, j = 0, len;
 
     if (!view->table) return S_OK;
-    if (view->table->fill)
-    {
-        clear_table( view->table );
-        view->table->fill( view->table, view->cond );
-    }
+    if (view->table->fill) fill_table( view->table, view );
     if (!view->table->num_rows) return S_OK;
 
     len = min( view->table->num_rows, 16 );
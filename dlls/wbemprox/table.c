@@ -44,6 +44,15 @@ HRESULT get_column_index( const struct table *table, const WCHAR *name, UINT *co
     return WBEM_E_INVALID_QUERY;
 }
 
+/* used by fill functions to skip computing values that the query doesn't need */
+BOOL is_column_needed( const struct table *table, const WCHAR *name )
+{
+    UINT column;
+
+    if (get_column_index( table, name, &column ) != S_OK || column >= 64) return TRUE;
+    return (table->columns_needed >> column) & 1;
+}
+
 UINT get_type_size( CIMTYPE type )
 {
     if (type & CIM_FLAG_ARRAY) return sizeof(void *);
@@ -480,6 +480,63 @@ static void test_Win32_Process( IWbemServices *services )
     IWbemClassObject_Release( out );
 }
 
+static void test_Win32_Process_select( IWbemServices *services )
+{
+    static const WCHAR fmtW[] = {'S','E','L','E','C','T',' ','%','s',' ','F','R','O','M',' ',
+        'W','i','n','3','2','_','P','r','o','c','e','s','s',' ','W','H','E','R','E',' ',
+        'P','r','o','c','e','s','s','I','d','=','%','u',0};
+    static const WCHAR processidW[] = {'P','r','o','c','e','s','s','I','d',0};
+    static const WCHAR commandlineW[] = {'C','o','m','m','a','n','d','L','i','n','e',0};
+    static const WCHAR *props[] = { processidW, commandlineW };
+    LONG flags = WBEM_FLAG_RETURN_IMMEDIATELY | WBEM_FLAG_FORWARD_ONLY;
+    BSTR wql = SysAllocString( wqlW ), query;
+    IEnumWbemClassObject *result;
+    IWbemClassObject *obj;
+    WCHAR buf[128];
+    VARIANT val;
+    ULONG count;
+    HRESULT hr;
+    UINT i;
+
+    for (i = 0; i < sizeof(props)/sizeof(props[0]); i++)
+    {
+        wsprintfW( buf, fmtW, props[i], GetCurrentProcessId() );
+        query = SysAllocString( buf );
+        hr = IWbemServices_ExecQuery( services, wql, query, flags, NULL, &result );
+        SysFreeString( query );
+        if (hr != S_OK)
+        {
+            win_skip( "Win32_Process not available\n" );
+            break;
+        }
+
+        obj = NULL;
+        count = 0;
+        IEnumWbemClassObject_Next( result, 10000, 1, &obj, &count );
+        ok( count == 1, "got %u objects\n", count );
+        if (count)
+        {
+            VariantInit( &val );
+            hr = IWbemClassObject_Get( obj, props[i], 0, &val, NULL, NULL );
+            ok( hr == S_OK, "failed to get %s %08x\n", wine_dbgstr_w(props[i]), hr );
+            if (props[i] == processidW)
+                ok( V_VT( &val ) == VT_I4 && V_I4( &val ) == GetCurrentProcessId(),
+                    "unexpected type %u\n", V_VT( &val ) );
+            else
+                ok( V_VT( &val ) == VT_BSTR && SysStringLen( V_BSTR( &val ) ),
+                    "unexpected type %u\n", V_VT( &val ) );
+            VariantClear( &val );
+
+            /* properties that are not selected are not available */
+            hr = IWbemClassObject_Get( obj, props[!i], 0, &val, NULL, NULL );
+            ok( hr == WBEM_E_NOT_FOUND, "got %08x\n", hr );
+            IWbemClassObject_Release( obj );
+        }
+        IEnumWbemClassObject_Release( result );
+    }
+    SysFreeString( wql );
+}
+
 static void test_Win32_ComputerSystem( IWbemServices *services )
 {
     static const WCHAR backslashW[] = {'\\',0};
@@ -1392,6 +1449,7 @@ START_TEST(query)
     test_associators( services );
     test_Win32_Bios( services );
     test_Win32_Process( services );
+    test_Win32_Process_select( services );
     test_Win32_Service( services );
     test_Win32_ComputerSystem( services );
     test_Win32_SystemEnclosure( services );
@@ -101,7 +101,9 @@ enum fill_status
     FILL_STATUS_FILTERED
 };
 
-#define TABLE_FLAG_DYNAMIC 0x00000001
+#define TABLE_FLAG_DYNAMIC   0x00000001
+#define TABLE_FLAG_CACHEABLE 0x00000002 /* rows may be reused for a short time, see execute_view() */
+#define TABLE_FLAG_CACHED    0x00000004
 
 struct table
 {
@@ -115,6 +117,8 @@ struct table
     UINT flags;
     struct list entry;
     LONG refs;
+    UINT64 columns_needed; /* columns the fill function has to compute */
+    DWORD fill_time;       /* tick count of the last fill, for cached tables */
 };
 
 struct property
@@ -189,6 +193,7 @@ void free_table( struct table * ) DECLSPEC_HIDDEN;
 UINT get_type_size( CIMTYPE ) DECLSPEC_HIDDEN;
 HRESULT eval_cond( const struct table *, UINT, const struct expr *, LONGLONG *, UINT * ) DECLSPEC_HIDDEN;
 HRESULT get_column_index( const struct table *, const WCHAR *, UINT * ) DECLSPEC_HIDDEN;
+BOOL is_column_needed( const struct table *, const WCHAR * ) DECLSPEC_HIDDEN;
 HRESULT get_value( const struct table *, UINT, UINT, LONGLONG * ) DECLSPEC_HIDDEN;
 BSTR get_value_bstr( const struct table *, UINT, UINT ) DECLSPEC_HIDDEN;
 HRESULT set_value( const struct table *, UINT, UINT, LONGLONG, CIMTYPE ) DECLSPEC_HIDDEN;
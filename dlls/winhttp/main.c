@@ -34,6 +34,45 @@ HINSTANCE winhttp_instance;
 
 WINE_DEFAULT_DEBUG_CHANNEL(winhttp);
 
+static TP_POOL *pools[POOL_COUNT];
+
+/******************************************************************
+ *              submit_pool_callback
+ *
+ * Run a callback on one of our private thread pools, creating it on first use.
+ */
+BOOL submit_pool_callback( enum winhttp_pool type, PTP_SIMPLE_CALLBACK callback, void *ctx )
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_POOL *pool;
+
+    if (!(pool = pools[type]))
+    {
+        if (!(pool = CreateThreadpool( NULL ))) return FALSE;
+        if (InterlockedCompareExchangePointer( (void **)&pools[type], pool, NULL ))
+        {
+            CloseThreadpool( pool );
+            pool = pools[type];
+        }
+    }
+
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.Pool    = pool;
+    return TrySubmitThreadpoolCallback( callback, ctx, &environment );
+}
+
+void release_pools( void )
+{
+    unsigned int i;
+
+    for (i = 0; i < POOL_COUNT; i++)
+    {
+        if (pools[i]) CloseThreadpool( pools[i] );
+        pools[i] = NULL;
+    }
+}
+
 /******************************************************************
  *              DllMain (winhttp.@)
  */
@@ -49,6 +88,7 @@ BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID lpv)
         if (lpv) break;
         netconn_unload();
         release_typelib();
+        release_pools();
         break;
     }
     return TRUE;
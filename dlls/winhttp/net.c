@@ -873,15 +873,32 @@ static DWORD resolve_hostname( const WCHAR *hostnameW, INTERNET_PORT port, struc
 
 struct resolve_args
 {
-    const WCHAR             *hostname;
+    LONG                     refs;
+    HANDLE                   done;
+    WCHAR                   *hostname;
     INTERNET_PORT            port;
-    struct sockaddr_storage *sa;
+    struct sockaddr_storage  sa;
+    DWORD                    ret;
 };
 
-static DWORD CALLBACK resolve_proc( LPVOID arg )
+static void release_resolve_args( struct resolve_args *ra )
+{
+    if (InterlockedDecrement( &ra->refs )) return;
+    CloseHandle( ra->done );
+    heap_free( ra->hostname );
+    heap_free( ra );
+}
+
+/* The arguments are reference counted because the caller stops waiting
+ * when the resolve timeout expires, while the lookup itself cannot be
+ * interrupted. */
+static void CALLBACK resolve_proc( TP_CALLBACK_INSTANCE *instance, void *arg )
 {
     struct resolve_args *ra = arg;
-    return resolve_hostname( ra->hostname, ra->port, ra->sa );
+
+    ra->ret = resolve_hostname( ra->hostname, ra->port, &ra->sa );
+    SetEvent( ra->done );
+    release_resolve_args( ra );
 }
 
 BOOL netconn_resolve( WCHAR *hostname, INTERNET_PORT port, struct sockaddr_storage *sa, int timeout )
@@ -890,21 +907,31 @@ BOOL netconn_resolve( WCHAR *hostname, INTERNET_PORT port, struct sockaddr_stora
 
     if (timeout)
     {
-        DWORD status;
-        HANDLE thread;
-        struct resolve_args ra;
+        struct resolve_args *ra;
 
-        ra.hostname = hostname;
-        ra.port     = port;
-        ra.sa       = sa;
-
-        thread = CreateThread( NULL, 0, resolve_proc, &ra, 0, NULL );
-        if (!thread) return FALSE;
+        if (!(ra = heap_alloc_zero( sizeof(*ra) ))) return FALSE;
+        ra->refs     = 2;
+        ra->port     = port;
+        if (!(ra->hostname = strdupW( hostname )) || !(ra->done = CreateEventW( NULL, TRUE, FALSE, NULL )))
+        {
+            heap_free( ra->hostname );
+            heap_free( ra );
+            return FALSE;
+        }
+        if (!submit_pool_callback( POOL_RESOLVE, resolve_proc, ra ))
+        {
+            CloseHandle( ra->done );
+            heap_free( ra->hostname );
+            heap_free( ra );
+            return FALSE;
+        }
 
-        status = WaitForSingleObject( thread, timeout );
-        if (status == WAIT_OBJECT_0) GetExitCodeThread( thread, &ret );
+        if (WaitForSingleObject( ra->done, timeout ) == WAIT_OBJECT_0)
+        {
+            if (!(ret = ra->ret)) *sa = ra->sa;
+        }
         else ret = ERROR_WINHTTP_TIMEOUT;
-        CloseHandle( thread );
+        release_resolve_args( ra );
     }
     else ret = resolve_hostname( hostname, port, sa );
 
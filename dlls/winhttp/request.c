@@ -25,6 +25,9 @@
 
 #include <stdarg.h>
 #include <assert.h>
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
 #ifdef HAVE_ARPA_INET_H
 # include <arpa/inet.h>
 #endif
@@ -189,84 +192,49 @@ static task_header_t *dequeue_task( request_t *request )
     TRACE("%u tasks queued\n", list_count( &request->task_queue ));
     task = LIST_ENTRY( list_head( &request->task_queue ), task_header_t, entry );
     if (task) list_remove( &task->entry );
+    else request->task_running = FALSE;
     LeaveCriticalSection( &request->task_cs );
 
     TRACE("returning task %p\n", task);
     return task;
 }
 
-static DWORD CALLBACK task_proc( LPVOID param )
+/* Runs on the task pool. At most one instance is active per request,
+ * so tasks for the same request are still processed in order. */
+static void CALLBACK task_proc( TP_CALLBACK_INSTANCE *instance, void *param )
 {
     request_t *request = param;
-    HANDLE handles[2];
+    task_header_t *task;
 
-    handles[0] = request->task_wait;
-    handles[1] = request->task_cancel;
-    for (;;)
+    while ((task = dequeue_task( request )))
     {
-        DWORD err = WaitForMultipleObjects( 2, handles, FALSE, INFINITE );
-        switch (err)
-        {
-        case WAIT_OBJECT_0:
-        {
-            task_header_t *task;
-            while ((task = dequeue_task( request )))
-            {
-                task->proc( task );
-                release_object( &task->request->hdr );
-                heap_free( task );
-            }
-            break;
-        }
-        case WAIT_OBJECT_0 + 1:
-            TRACE("exiting\n");
-            CloseHandle( request->task_cancel );
-            CloseHandle( request->task_wait );
-            request->task_cs.DebugInfo->Spare[0] = 0;
-            DeleteCriticalSection( &request->task_cs );
-            request->hdr.vtbl->destroy( &request->hdr );
-            return 0;
-
-        default:
-            ERR("wait failed %u (%u)\n", err, GetLastError());
-            break;
-        }
+        task->proc( task );
+        release_object( &task->request->hdr );
+        heap_free( task );
     }
-    return 0;
+    release_object( &request->hdr );
 }
 
 static BOOL queue_task( task_header_t *task )
 {
     request_t *request = task->request;
+    BOOL ret = TRUE;
 
-    if (!request->task_thread)
+    EnterCriticalSection( &request->task_cs );
+    TRACE("queueing task %p\n", task );
+    list_add_tail( &request->task_queue, &task->entry );
+    if (!request->task_running)
     {
-        if (!(request->task_wait = CreateEventW( NULL, FALSE, FALSE, NULL ))) return FALSE;
-        if (!(request->task_cancel = CreateEventW( NULL, FALSE, FALSE, NULL )))
-        {
-            CloseHandle( request->task_wait );
-            request->task_wait = NULL;
-            return FALSE;
-        }
-        if (!(request->task_thread = CreateThread( NULL, 0, task_proc, request, 0, NULL )))
+        addref_object( &request->hdr );
+        if ((ret = submit_pool_callback( POOL_TASK, task_proc, request ))) request->task_running = TRUE;
+        else
         {
-            CloseHandle( request->task_wait );
-            request->task_wait = NULL;
-            CloseHandle( request->task_cancel );
-            request->task_cancel = NULL;
-            return FALSE;
+            list_remove( &task->entry );
+            release_object( &request->hdr );
         }
-        InitializeCriticalSection( &request->task_cs );
-        request->task_cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": request.task_cs");
     }
-
-    EnterCriticalSection( &request->task_cs );
-    TRACE("queueing task %p\n", task );
-    list_add_tail( &request->task_queue, &task->entry );
     LeaveCriticalSection( &request->task_cs );
-
-    SetEvent( request->task_wait );
-    return TRUE;
+    return ret;
 }
 
 static void free_header( header_t *header )
@@ -1447,7 +1415,7 @@ static DWORD get_available_data( request_t *request )
 }
 
 /* check if we have reached the end of the data to read */
-static BOOL end_of_read_data( request_t *request )
+static BOOL end_of_raw_data( request_t *request )
 {
     if (!request->content_length) return TRUE;
     if (request->read_chunked) return request->read_chunked_eof;
@@ -1455,31 +1423,240 @@ static BOOL end_of_read_data( request_t *request )
     return (request->content_length == request->content_read);
 }
 
-static BOOL read_data( request_t *request, void *buffer, DWORD size, DWORD *read, BOOL async )
+/* account for count bytes taken from the connection */
+static void consume_data( request_t *request, DWORD count, BOOL buffered )
 {
-    int count, bytes_read = 0;
+    if (buffered) remove_data( request, count );
+    if (request->read_chunked) request->read_chunked_size -= count;
+    request->content_read += count;
+}
 
-    if (end_of_read_data( request )) goto done;
+/* read the message body as it is sent by the server */
+static DWORD read_raw_data( request_t *request, char *buffer, DWORD size, BOOL notify )
+{
+    int count, len;
+    DWORD bytes_read = 0;
+
+    while (size && !end_of_raw_data( request ))
+    {
+        if ((count = get_available_data( request )))
+        {
+            count = min( count, size );
+            memcpy( buffer + bytes_read, request->read_buf + request->read_pos, count );
+            consume_data( request, count, TRUE );
+        }
+        else if (size >= sizeof(request->read_buf) && !request->read_size && request->netconn &&
+                 (!request->read_chunked || (request->read_chunked_size && request->read_chunked_size != ~0u)))
+        {
+            /* nothing buffered and a large read: receive straight into the caller's buffer */
+            len = size;
+            if (request->read_chunked) len = min( len, request->read_chunked_size );
+            else if (request->content_length != ~0u) len = min( len, request->content_length - request->content_read );
+
+            if (notify) send_callback( &request->hdr, WINHTTP_CALLBACK_STATUS_RECEIVING_RESPONSE, NULL, 0 );
+            if (!netconn_recv( request->netconn, buffer + bytes_read, len, 0, &count )) count = 0;
+            if (notify) send_callback( &request->hdr, WINHTTP_CALLBACK_STATUS_RESPONSE_RECEIVED, &count, sizeof(count) );
+            if (!count)
+            {
+                request->content_length = request->content_read = 0;
+                break;
+            }
+            consume_data( request, count, FALSE );
+        }
+        else
+        {
+            if (!refill_buffer( request, notify )) break;
+            if (!get_available_data( request )) break;
+            continue;
+        }
+        size -= count;
+        bytes_read += count;
+    }
+    if (request->read_chunked && !request->read_chunked_size) refill_buffer( request, notify );
+    return bytes_read;
+}
+
+#ifdef HAVE_ZLIB
+
+struct decoder
+{
+    z_stream stream;
+    BOOL     deflate;  /* may need to fall back to a raw deflate stream */
+    BOOL     eof;
+    DWORD    pos;
+    DWORD    size;
+    char     buf[8192];
+};
+
+static voidpf decoder_alloc( voidpf opaque, uInt items, uInt size )
+{
+    return heap_alloc( items * size );
+}
+
+static void decoder_free( voidpf opaque, voidpf address )
+{
+    heap_free( address );
+}
+
+void destroy_decoder( request_t *request )
+{
+    if (!request->decoder) return;
+    inflateEnd( &request->decoder->stream );
+    heap_free( request->decoder );
+    request->decoder = NULL;
+}
+
+/* set up decoding of the message body, based on the Content-Encoding header */
+static void init_decoder( request_t *request )
+{
+    static const WCHAR gzipW[] = {'g','z','i','p',0};
+    static const WCHAR deflateW[] = {'d','e','f','l','a','t','e',0};
+    struct decoder *decoder;
+    WCHAR encoding[20];
+    DWORD size = sizeof(encoding);
+    int window_bits;
+
+    destroy_decoder( request );
+    if (!request->decompression || !request->content_length) return;
+    if (!query_headers( request, WINHTTP_QUERY_CONTENT_ENCODING, NULL, encoding, &size, NULL )) return;
+
+    if ((request->decompression & WINHTTP_DECOMPRESSION_FLAG_GZIP) && !strcmpiW( encoding, gzipW ))
+        window_bits = MAX_WBITS + 16;
+    else if ((request->decompression & WINHTTP_DECOMPRESSION_FLAG_DEFLATE) && !strcmpiW( encoding, deflateW ))
+        window_bits = MAX_WBITS;
+    else return;
+
+    if (!(decoder = heap_alloc_zero( sizeof(*decoder) ))) return;
+    decoder->stream.zalloc = decoder_alloc;
+    decoder->stream.zfree = decoder_free;
+    decoder->deflate = (window_bits == MAX_WBITS);
+    if (inflateInit2( &decoder->stream, window_bits ) != Z_OK)
+    {
+        ERR("inflateInit2 failed\n");
+        heap_free( decoder );
+        return;
+    }
+    TRACE("decoding %s content\n", debugstr_w(encoding));
+    request->decoder = decoder;
+}
+
+/* inflate into buffer, returns zero only at the end of the stream */
+static DWORD decode_data( request_t *request, char *buffer, DWORD size, BOOL notify )
+{
+    struct decoder *decoder = request->decoder;
+    z_stream *stream = &decoder->stream;
+    DWORD avail, consumed;
+    char discard[2048];
+    int ret;
+
+    stream->next_out = (Bytef *)buffer;
+    stream->avail_out = size;
+    while (stream->avail_out == size && !decoder->eof)
+    {
+        if (!(avail = get_available_data( request )))
+        {
+            if (end_of_raw_data( request ) || !refill_buffer( request, notify ) ||
+                !(avail = get_available_data( request )))
+            {
+                decoder->eof = TRUE;
+                break;
+            }
+        }
+        stream->next_in = (Bytef *)request->read_buf + request->read_pos;
+        stream->avail_in = avail;
+        ret = inflate( stream, Z_SYNC_FLUSH );
+        consumed = avail - stream->avail_in;
+
+        if (ret == Z_DATA_ERROR && decoder->deflate && !stream->total_out)
+        {
+            /* some servers send raw deflate data without the zlib header */
+            TRACE("retrying as raw deflate stream\n");
+            decoder->deflate = FALSE;
+            inflateReset2( stream, -MAX_WBITS );
+            continue;
+        }
+        decoder->deflate = FALSE;
+        consume_data( request, consumed, TRUE );
+
+        if (ret == Z_STREAM_END)
+        {
+            decoder->eof = TRUE;
+            /* skip anything following the stream so that the connection can be reused */
+            while (read_raw_data( request, discard, sizeof(discard), notify ));
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            WARN("inflate failed %d: %s\n", ret, debugstr_a(stream->msg));
+            decoder->eof = TRUE;
+            close_connection( request );
+        }
+    }
+    return size - stream->avail_out;
+}
+
+static DWORD read_decoded_data( request_t *request, char *buffer, DWORD size, BOOL notify )
+{
+    struct decoder *decoder = request->decoder;
+    DWORD count, bytes_read = 0;
 
     while (size)
     {
-        if (!(count = get_available_data( request )))
+        if (decoder->size)
+        {
+            count = min( size, decoder->size );
+            memcpy( buffer + bytes_read, decoder->buf + decoder->pos, count );
+            decoder->pos += count;
+            decoder->size -= count;
+        }
+        else if (size >= sizeof(decoder->buf))
+        {
+            /* large read: inflate straight into the caller's buffer */
+            if (!(count = decode_data( request, buffer + bytes_read, size, notify ))) break;
+        }
+        else
         {
-            if (!refill_buffer( request, async )) goto done;
-            if (!(count = get_available_data( request ))) goto done;
+            decoder->pos = 0;
+            if (!(decoder->size = decode_data( request, decoder->buf, sizeof(decoder->buf), notify ))) break;
+            continue;
         }
-        count = min( count, size );
-        memcpy( (char *)buffer + bytes_read, request->read_buf + request->read_pos, count );
-        remove_data( request, count );
-        if (request->read_chunked) request->read_chunked_size -= count;
         size -= count;
         bytes_read += count;
-        request->content_read += count;
-        if (end_of_read_data( request )) goto done;
     }
-    if (request->read_chunked && !request->read_chunked_size) refill_buffer( request, async );
+    return bytes_read;
+}
+
+#else  /* HAVE_ZLIB */
+
+void destroy_decoder( request_t *request )
+{
+}
+
+static void init_decoder( request_t *request )
+{
+    if (request->decompression) FIXME("zlib support not compiled in\n");
+}
+
+#endif  /* HAVE_ZLIB */
+
+/* check if we have reached the end of the data to read */
+static BOOL end_of_read_data( request_t *request )
+{
+#ifdef HAVE_ZLIB
+    if (request->decoder) return request->decoder->eof && !request->decoder->size;
+#endif
+    return end_of_raw_data( request );
+}
+
+static BOOL read_data( request_t *request, void *buffer, DWORD size, DWORD *read, BOOL async )
+{
+    DWORD bytes_read;
+
+#ifdef HAVE_ZLIB
+    if (request->decoder) bytes_read = read_decoded_data( request, buffer, size, async );
+    else
+#endif
+    bytes_read = read_raw_data( request, buffer, size, async );
 
-done:
     TRACE( "retrieved %u bytes (%u/%u)\n", bytes_read, request->content_read, request->content_length );
 
     if (async) send_callback( &request->hdr, WINHTTP_CALLBACK_STATUS_READ_COMPLETE, buffer, bytes_read );
@@ -1500,12 +1677,13 @@ static void drain_content( request_t *request )
         if (request->read_chunked) size = sizeof(buffer);
         else
         {
-            if (bytes_total >= bytes_left) return;
+            if (bytes_total >= bytes_left) break;
             size = min( sizeof(buffer), bytes_left - bytes_total );
         }
-        if (!read_data( request, buffer, size, &bytes_read, FALSE ) || !bytes_read) return;
+        if (!(bytes_read = read_raw_data( request, buffer, size, FALSE ))) break;
         bytes_total += bytes_read;
     }
+    if (end_of_raw_data( request )) finished_reading( request );
 }
 
 static BOOL send_request( request_t *request, LPCWSTR headers, DWORD headers_len, LPVOID optional,
@@ -1525,6 +1703,7 @@ static BOOL send_request( request_t *request, LPCWSTR headers, DWORD headers_len
 
     clear_response_headers( request );
     drain_content( request );
+    destroy_decoder( request );
 
     if (session->agent)
         process_header( request, attr_user_agent, session->agent, WINHTTP_ADDREQ_FLAG_ADD_IF_NEW, TRUE );
@@ -1542,6 +1721,21 @@ static BOOL send_request( request_t *request, LPCWSTR headers, DWORD headers_len
     {
         process_header( request, attr_connection, keep_alive, WINHTTP_ADDREQ_FLAG_ADD_IF_NEW, TRUE );
     }
+#ifdef HAVE_ZLIB
+    if (request->decompression)
+    {
+        static const WCHAR gzip_deflateW[] = {'g','z','i','p',',',' ','d','e','f','l','a','t','e',0};
+        static const WCHAR gzipW[] = {'g','z','i','p',0};
+        static const WCHAR deflateW[] = {'d','e','f','l','a','t','e',0};
+        const WCHAR *encoding;
+
+        if ((request->decompression & WINHTTP_DECOMPRESSION_FLAG_ALL) == WINHTTP_DECOMPRESSION_FLAG_ALL)
+            encoding = gzip_deflateW;
+        else if (request->decompression & WINHTTP_DECOMPRESSION_FLAG_GZIP) encoding = gzipW;
+        else encoding = deflateW;
+        process_header( request, attr_accept_encoding, encoding, WINHTTP_ADDREQ_FLAG_ADD_IF_NEW, TRUE );
+    }
+#endif
     if (request->hdr.flags & WINHTTP_FLAG_REFRESH)
     {
         process_header( request, attr_pragma, no_cache, WINHTTP_ADDREQ_FLAG_ADD_IF_NEW, TRUE );
@@ -2619,6 +2813,7 @@ static BOOL receive_response( request_t *request, BOOL async )
         break;
     }
 
+    if (ret) init_decoder( request );
     if (request->content_length) refill_buffer( request, FALSE );
 
     if (async)
@@ -2688,6 +2883,20 @@ static BOOL query_data_available( request_t *request, DWORD *available, BOOL asy
 
     if (end_of_read_data( request )) goto done;
 
+#ifdef HAVE_ZLIB
+    if (request->decoder)
+    {
+        struct decoder *decoder = request->decoder;
+
+        if (!decoder->size)
+        {
+            decoder->pos = 0;
+            decoder->size = decode_data( request, decoder->buf, sizeof(decoder->buf), async );
+        }
+        count = decoder->size;
+        goto done;
+    }
+#endif
     count = get_available_data( request );
     if (!request->read_chunked && request->netconn)
         count += netconn_query_data_available( request->netconn );
@@ -2897,7 +3106,7 @@ struct winhttp_request
     HINTERNET hrequest;
     VARIANT data;
     WCHAR *verb;
-    HANDLE thread;
+    HANDLE done;
     HANDLE wait;
     HANDLE cancel;
     char *buffer;
@@ -2935,13 +3144,13 @@ static void cancel_request( struct winhttp_request *request )
 
     SetEvent( request->cancel );
     LeaveCriticalSection( &request->cs );
-    WaitForSingleObject( request->thread, INFINITE );
+    WaitForSingleObject( request->done, INFINITE );
     EnterCriticalSection( &request->cs );
 
     request->state = REQUEST_STATE_CANCELLED;
 
-    CloseHandle( request->thread );
-    request->thread = NULL;
+    CloseHandle( request->done );
+    request->done = NULL;
     CloseHandle( request->wait );
     request->wait = NULL;
     CloseHandle( request->cancel );
@@ -2955,7 +3164,7 @@ static void free_request( struct winhttp_request *request )
     WinHttpCloseHandle( request->hrequest );
     WinHttpCloseHandle( request->hconnect );
     WinHttpCloseHandle( request->hsession );
-    CloseHandle( request->thread );
+    CloseHandle( request->done );
     CloseHandle( request->wait );
     CloseHandle( request->cancel );
     heap_free( request->proxy.lpszProxy );
@@ -3285,7 +3494,7 @@ static void initialize_request( struct winhttp_request *request )
     request->hrequest = NULL;
     request->hconnect = NULL;
     request->hsession = NULL;
-    request->thread   = NULL;
+    request->done     = NULL;
     request->wait     = NULL;
     request->cancel   = NULL;
     request->buffer   = NULL;
@@ -3767,20 +3976,23 @@ static HRESULT request_send_and_receive( struct winhttp_request *request )
     return hr;
 }
 
-static DWORD CALLBACK send_and_receive_proc( void *arg )
+static void CALLBACK send_and_receive_proc( TP_CALLBACK_INSTANCE *instance, void *arg )
 {
     struct winhttp_request *request = (struct winhttp_request *)arg;
-    return request_send_and_receive( request );
+    HANDLE done = request->done;
+
+    request_send_and_receive( request );
+    SetEvent( done );
 }
 
 /* critical section must be held */
 static DWORD request_wait( struct winhttp_request *request, DWORD timeout )
 {
-    HANDLE thread = request->thread;
+    HANDLE done = request->done;
     DWORD err, ret;
 
     LeaveCriticalSection( &request->cs );
-    while ((err = MsgWaitForMultipleObjects( 1, &thread, FALSE, timeout, QS_ALLINPUT )) == WAIT_OBJECT_0 + 1)
+    while ((err = MsgWaitForMultipleObjects( 1, &done, FALSE, timeout, QS_ALLINPUT )) == WAIT_OBJECT_0 + 1)
     {
         MSG msg;
         while (PeekMessageW( &msg, NULL, 0, 0, PM_REMOVE ))
@@ -3832,13 +4044,17 @@ static HRESULT WINAPI winhttp_request_Send(
         LeaveCriticalSection( &request->cs );
         return hr;
     }
-    if (!(request->thread = CreateThread( NULL, 0, send_and_receive_proc, request, 0, NULL )))
+    request->wait = CreateEventW( NULL, FALSE, FALSE, NULL );
+    request->cancel = CreateEventW( NULL, FALSE, FALSE, NULL );
+    if (!(request->done = CreateEventW( NULL, TRUE, FALSE, NULL )) ||
+        !submit_pool_callback( POOL_SEND, send_and_receive_proc, request ))
     {
+        hr = HRESULT_FROM_WIN32( get_last_error() );
+        CloseHandle( request->done );
+        request->done = NULL;
         LeaveCriticalSection( &request->cs );
-        return HRESULT_FROM_WIN32( get_last_error() );
+        return hr;
     }
-    request->wait = CreateEventW( NULL, FALSE, FALSE, NULL );
-    request->cancel = CreateEventW( NULL, FALSE, FALSE, NULL );
     if (!request->async)
     {
         hr = HRESULT_FROM_WIN32( request_wait( request, INFINITE ) );
@@ -211,6 +211,15 @@ static BOOL session_set_option( object_header_t *hdr, DWORD option, LPVOID buffe
     case WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER:
         FIXME("WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER: %d\n", *(DWORD *)buffer);
         return TRUE;
+    case WINHTTP_OPTION_DECOMPRESSION:
+        if (buflen != sizeof(DWORD))
+        {
+            set_last_error( ERROR_INSUFFICIENT_BUFFER );
+            return FALSE;
+        }
+        TRACE("WINHTTP_OPTION_DECOMPRESSION: 0x%x\n", *(DWORD *)buffer);
+        session->decompression = *(DWORD *)buffer & WINHTTP_DECOMPRESSION_FLAG_ALL;
+        return TRUE;
     default:
         FIXME("unimplemented option %u\n", option);
         set_last_error( ERROR_INVALID_PARAMETER );
@@ -573,16 +582,9 @@ static void request_destroy( object_header_t *hdr )
 
     TRACE("%p\n", request);
 
-    if (request->task_thread)
-    {
-        /* Signal to the task proc to quit.  It will call
-           this again when it does. */
-        HANDLE thread = request->task_thread;
-        request->task_thread = 0;
-        SetEvent( request->task_cancel );
-        CloseHandle( thread );
-        return;
-    }
+    request->task_cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &request->task_cs );
+    destroy_decoder( request );
     release_object( &request->connect->hdr );
 
     destroy_authinfo( request->authinfo );
@@ -967,6 +969,15 @@ static BOOL request_set_option( object_header_t *hdr, DWORD option, LPVOID buffe
     case WINHTTP_OPTION_RECEIVE_TIMEOUT:
         request->recv_timeout = *(DWORD *)buffer;
         return TRUE;
+    case WINHTTP_OPTION_DECOMPRESSION:
+        if (buflen != sizeof(DWORD))
+        {
+            set_last_error( ERROR_INSUFFICIENT_BUFFER );
+            return FALSE;
+        }
+        TRACE("WINHTTP_OPTION_DECOMPRESSION: 0x%x\n", *(DWORD *)buffer);
+        request->decompression = *(DWORD *)buffer & WINHTTP_DECOMPRESSION_FLAG_ALL;
+        return TRUE;
 
     case WINHTTP_OPTION_USERNAME:
     {
@@ -1084,12 +1095,15 @@ HINTERNET WINAPI WinHttpOpenRequest( HINTERNET hconnect, LPCWSTR verb, LPCWSTR o
     request->hdr.redirect_policy = connect->hdr.redirect_policy;
     list_init( &request->hdr.children );
     list_init( &request->task_queue );
+    InitializeCriticalSection( &request->task_cs );
+    request->task_cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": request.task_cs");
 
     addref_object( &connect->hdr );
     request->connect = connect;
     list_add_head( &connect->hdr.children, &request->hdr.entry );
 
     request->resolve_timeout = connect->session->resolve_timeout;
+    request->decompression = connect->session->decompression;
     request->connect_timeout = connect->session->connect_timeout;
     request->send_timeout = connect->session->send_timeout;
     request->recv_timeout = connect->session->recv_timeout;
@@ -2023,6 +2023,24 @@ static const char nocontentmsg[] =
 "Server: winetest\r\n"
 "\r\n";
 
+static const char gzipmsg[] =
+"HTTP/1.1 200 OK\r\n"
+"Server: winetest\r\n"
+"Content-Encoding: gzip\r\n"
+"Content-Length: 123\r\n"
+"\r\n";
+
+/* "abcdefghijklmnopqrstuvwxyz" repeated 1000 times */
+static const char gzip_data[] =
+"\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\xff\xed\xc9\xc7\x11\x80\x20"
+"\x00\x00\xb0\x59\xb1\x77\x11\xec\xd3\x3b\x87\x77\xc9\x37\xa1\x28"
+"\xab\xba\x69\xbb\x7e\x18\xa7\x79\x59\xe3\x96\xf2\x7e\x9c\xd7\xfd"
+"\xbc\xc1\x18\x63\x8c\x31\xc6\x18\x63\x8c\x31\xc6\x18\x63\x8c\x31"
+"\xc6\x18\x63\x8c\x31\xc6\x18\x63\x8c\x31\xc6\x18\x63\x8c\x31\xc6"
+"\x18\x63\x8c\x31\xc6\x18\x63\x8c\x31\xc6\x18\x63\x8c\x31\xc6\x18"
+"\x63\x8c\x31\xc6\x18\x63\x8c\x31\xc6\x18\x63\x8c\x31\xc6\x18\x63"
+"\x7e\x35\x1f\x5b\xec\xf4\x45\x90\x65\x00\x00";
+
 static const char notmodified[] =
 "HTTP/1.1 304 Not Modified\r\n"
 "\r\n";
@@ -2217,6 +2235,15 @@ static DWORD CALLBACK server_thread(LPVOID param)
             if (!strstr(buffer, "Cookie: name=value\r\n")) send(c, cookiemsg, sizeof(cookiemsg) - 1, 0);
             else send(c, notokmsg, sizeof(notokmsg) - 1, 0);
         }
+        if (strstr(buffer, "GET /gzip"))
+        {
+            if (strstr(buffer, "Accept-Encoding: gzip"))
+            {
+                send(c, gzipmsg, sizeof gzipmsg - 1, 0);
+                send(c, gzip_data, sizeof gzip_data - 1, 0);
+            }
+            else send(c, notokmsg, sizeof(notokmsg) - 1, 0);
+        }
         if (strstr(buffer, "GET /quit"))
         {
             send(c, okmsg, sizeof okmsg - 1, 0);
@@ -2745,6 +2772,76 @@ static void test_no_content(int port)
     WinHttpCloseHandle(ses);
 }
 
+static void test_decompression(int port)
+{
+    static const WCHAR gzipW[] = {'/','g','z','i','p',0};
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz";
+    HINTERNET ses, con, req;
+    DWORD flags, size, status, bytes_read, total = 0, i;
+    char *buf;
+    BOOL ret;
+
+    ses = WinHttpOpen(test_useragent, WINHTTP_ACCESS_TYPE_NO_PROXY, NULL, NULL, 0);
+    ok(ses != NULL, "failed to open session %u\n", GetLastError());
+
+    con = WinHttpConnect(ses, localhostW, port, 0);
+    ok(con != NULL, "failed to open a connection %u\n", GetLastError());
+
+    req = WinHttpOpenRequest(con, NULL, gzipW, NULL, NULL, NULL, 0);
+    ok(req != NULL, "failed to open a request %u\n", GetLastError());
+
+    flags = WINHTTP_DECOMPRESSION_FLAG_ALL;
+    ret = WinHttpSetOption(req, WINHTTP_OPTION_DECOMPRESSION, &flags, sizeof(flags));
+    if (!ret)
+    {
+        win_skip("WINHTTP_OPTION_DECOMPRESSION not supported\n");
+        WinHttpCloseHandle(req);
+        WinHttpCloseHandle(con);
+        WinHttpCloseHandle(ses);
+        return;
+    }
+
+    ret = WinHttpSendRequest(req, NULL, 0, NULL, 0, 0, 0);
+    ok(ret, "failed to send request %u\n", GetLastError());
+
+    ret = WinHttpReceiveResponse(req, NULL);
+    ok(ret, "failed to receive response %u\n", GetLastError());
+
+    status = 0xdeadbeef;
+    size = sizeof(status);
+    ret = WinHttpQueryHeaders(req, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                              NULL, &status, &size, NULL);
+    ok(ret, "failed to query status code %u\n", GetLastError());
+    ok(status == HTTP_STATUS_OK, "request failed unexpectedly %u\n", status);
+
+    /* small reads go through the internal buffer, large ones are decoded in place */
+    buf = HeapAlloc(GetProcessHeap(), 0, 32768);
+    ret = WinHttpReadData(req, buf, 100, &bytes_read);
+    ok(ret, "failed to read data %u\n", GetLastError());
+    ok(bytes_read == 100, "got %u\n", bytes_read);
+    for (i = 0; i < bytes_read; i++)
+        if (buf[i] != alphabet[i % 26]) break;
+    ok(i == bytes_read, "wrong data at offset %u\n", i);
+    total += bytes_read;
+
+    for (;;)
+    {
+        ret = WinHttpReadData(req, buf, 32768, &bytes_read);
+        ok(ret, "failed to read data %u\n", GetLastError());
+        if (!ret || !bytes_read) break;
+        for (i = 0; i < bytes_read; i++)
+            if (buf[i] != alphabet[(total + i) % 26]) break;
+        ok(i == bytes_read, "wrong data at offset %u\n", total + i);
+        total += bytes_read;
+    }
+    ok(total == 26000, "got %u bytes\n", total);
+
+    HeapFree(GetProcessHeap(), 0, buf);
+    WinHttpCloseHandle(req);
+    WinHttpCloseHandle(con);
+    WinHttpCloseHandle(ses);
+}
+
 static void test_head_request(int port)
 {
     static const WCHAR verbW[] = {'H','E','A','D',0};
@@ -4421,6 +4518,7 @@ START_TEST (winhttp)
     test_basic_request(si.port, NULL, basicW);
     test_no_headers(si.port);
     test_no_content(si.port);
+    test_decompression(si.port);
     test_head_request(si.port);
     test_not_modified(si.port);
     test_basic_authentication(si.port);
@@ -120,6 +120,7 @@ typedef struct
     LPWSTR proxy_password;
     struct list cookie_cache;
     HANDLE unload_event;
+    DWORD decompression;
 } session_t;
 
 typedef struct
@@ -218,13 +219,13 @@ typedef struct
     DWORD read_pos;       /* current read position in read_buf */
     DWORD read_size;      /* valid data size in read_buf */
     char  read_buf[8192]; /* buffer for already read but not returned data */
+    DWORD decompression;  /* WINHTTP_DECOMPRESSION_FLAG_* */
+    struct decoder *decoder; /* Content-Encoding decoder for the current response */
     header_t *headers;
     DWORD num_headers;
     struct authinfo *authinfo;
     struct authinfo *proxy_authinfo;
-    HANDLE task_wait;
-    HANDLE task_cancel;
-    HANDLE task_thread;
+    BOOL task_running;
     struct list task_queue;
     CRITICAL_SECTION task_cs;
     struct
@@ -289,8 +290,22 @@ BOOL free_handle( HINTERNET ) DECLSPEC_HIDDEN;
 
 void set_last_error( DWORD ) DECLSPEC_HIDDEN;
 DWORD get_last_error( void ) DECLSPEC_HIDDEN;
+
+/* Private thread pools, so that our callbacks never wait for work queued behind
+ * them on the same pool. Callbacks may only wait for work on a later pool. */
+enum winhttp_pool
+{
+    POOL_SEND,      /* IWinHttpRequest sends, wait for request tasks */
+    POOL_TASK,      /* request tasks, do blocking socket I/O and wait for name resolution */
+    POOL_RESOLVE,   /* name resolution, never waits for other work */
+    POOL_COUNT
+};
+
+BOOL submit_pool_callback( enum winhttp_pool, PTP_SIMPLE_CALLBACK, void * ) DECLSPEC_HIDDEN;
+void release_pools( void ) DECLSPEC_HIDDEN;
 void send_callback( object_header_t *, DWORD, LPVOID, DWORD ) DECLSPEC_HIDDEN;
 void close_connection( request_t * ) DECLSPEC_HIDDEN;
+void destroy_decoder( request_t * ) DECLSPEC_HIDDEN;
 
 BOOL netconn_close( netconn_t * ) DECLSPEC_HIDDEN;
 netconn_t *netconn_create( hostdata_t *, const struct sockaddr_storage *, int ) DECLSPEC_HIDDEN;
@@ -1009,6 +1009,66 @@ static void test_urlcacheW(void)
     }
 }
 
+static const char concurrent_url[] = "Visited: http://urlcachetest.winehq.org/concurrent.html";
+static LONG concurrent_failures;
+
+static DWORD CALLBACK concurrent_lookup_thread(void *arg)
+{
+    char buf[4096];
+    INTERNET_CACHE_ENTRY_INFOA *info = (INTERNET_CACHE_ENTRY_INFOA *)buf;
+    DWORD size;
+    int i;
+
+    for (i = 0; i < 500; i++)
+    {
+        size = sizeof(buf);
+        if (!GetUrlCacheEntryInfoA(concurrent_url, info, &size) ||
+            !info->lpszSourceUrlName || strcmp(info->lpszSourceUrlName, concurrent_url))
+            InterlockedIncrement(&concurrent_failures);
+    }
+    return 0;
+}
+
+static void test_concurrent_lookup(void)
+{
+    static const FILETIME filetime_zero;
+    HANDLE threads[4];
+    char url[64];
+    BOOL ret;
+    int i;
+
+    ret = CommitUrlCacheEntryA(concurrent_url, NULL, filetime_zero, filetime_zero,
+            NORMAL_CACHE_ENTRY, NULL, 0, "html", NULL);
+    ok(ret, "CommitUrlCacheEntry failed: %d\n", GetLastError());
+
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+        threads[i] = CreateThread(NULL, 0, concurrent_lookup_thread, NULL, 0, NULL);
+
+    /* modify the index while the lookups are running */
+    for (i = 0; i < 100; i++)
+    {
+        sprintf(url, "Visited: http://urlcachetest.winehq.org/concurrent%d.html", i);
+        ret = CommitUrlCacheEntryA(url, NULL, filetime_zero, filetime_zero,
+                NORMAL_CACHE_ENTRY, NULL, 0, "html", NULL);
+        ok(ret, "CommitUrlCacheEntry failed: %d\n", GetLastError());
+        if (pDeleteUrlCacheEntryA && i % 2) pDeleteUrlCacheEntryA(url);
+    }
+
+    WaitForMultipleObjects(sizeof(threads) / sizeof(threads[0]), threads, TRUE, INFINITE);
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) CloseHandle(threads[i]);
+    ok(!concurrent_failures, "%d lookups failed\n", concurrent_failures);
+
+    if (pDeleteUrlCacheEntryA)
+    {
+        for (i = 0; i < 100; i += 2)
+        {
+            sprintf(url, "Visited: http://urlcachetest.winehq.org/concurrent%d.html", i);
+            pDeleteUrlCacheEntryA(url);
+        }
+        pDeleteUrlCacheEntryA(concurrent_url);
+    }
+}
+
 static void test_FindCloseUrlCache(void)
 {
     BOOL r;
@@ -1124,4 +1184,5 @@ START_TEST(urlcache)
     test_FindCloseUrlCache();
     test_GetDiskInfoA();
     test_trailing_slash();
+    test_concurrent_lookup();
 }
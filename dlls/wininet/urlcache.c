@@ -153,6 +153,13 @@ typedef struct
     struct hash_entry hash_table[HASHTABLE_SIZE];
 } entry_hash_table;
 
+/* In indexes created by Wine, the high word of the unknown header field that
+ * follows blocks_in_use holds a tag, and the low word a change counter that is
+ * odd while the index is locked. Other implementations don't maintain the
+ * counter, so their indexes are only ever read with the mutex held. */
+#define URLCACHE_SEQUENCE_TAG  0x57490000
+#define URLCACHE_SEQUENCE_MASK 0xffff0000
+
 typedef struct
 {
     char signature[28];
@@ -160,7 +167,7 @@ typedef struct
     DWORD hash_table_off;
     DWORD capacity_in_blocks;
     DWORD blocks_in_use;
-    DWORD unk1;
+    DWORD sequence; /* unknown, see URLCACHE_SEQUENCE_TAG */
     ULARGE_INTEGER cache_limit;
     ULARGE_INTEGER cache_usage;
     ULARGE_INTEGER exempt_usage;
@@ -467,6 +474,7 @@ static DWORD cache_container_set_size(cache_container *container, HANDLE file, D
     memcpy(header->signature+sizeof(urlcache_ver_prefix)-1, urlcache_ver, sizeof(urlcache_ver)-1);
     header->size = file_size;
     header->capacity_in_blocks = blocks_no;
+    header->sequence = URLCACHE_SEQUENCE_TAG;
     /* 127MB - taken from default for Windows 2000 */
     header->cache_limit.QuadPart = 0x07ff5400;
     /* Copied from a Windows 2000 cache index */
@@ -886,6 +894,28 @@ static BOOL cache_containers_enum(char *search_pattern, DWORD index, cache_conta
     return FALSE;
 }
 
+/***********************************************************************
+ *           urlcache_update_sequence (Internal)
+ *
+ *  Lets lock-free readers know that the index may change under them while it
+ * is locked. An odd value left behind by a process that died with the lock
+ * held stays odd. Indexes without the Wine tag are left alone.
+ */
+static void urlcache_update_sequence(urlcache_header *header, BOOL lock)
+{
+    DWORD seq, next;
+
+    do
+    {
+        seq = *(volatile DWORD *)&header->sequence;
+        if ((seq & URLCACHE_SEQUENCE_MASK) != URLCACHE_SEQUENCE_TAG)
+            return;
+        next = seq + 1;
+        if (lock && !(next & 1)) next++;
+        next = URLCACHE_SEQUENCE_TAG | (next & ~URLCACHE_SEQUENCE_MASK);
+    } while ((DWORD)InterlockedCompareExchange((LONG *)&header->sequence, next, seq) != seq);
+}
+
 /***********************************************************************
  *           cache_container_lock_index (Internal)
  *
@@ -946,7 +976,8 @@ static urlcache_header* cache_container_lock_index(cache_container *pContainer)
     {
         TRACE("Directory[%d] = \"%.8s\"\n", index, pHeader->directory_data[index].name);
     }
-    
+
+    urlcache_update_sequence(pHeader, TRUE);
     return pHeader;
 }
 
@@ -956,6 +987,8 @@ static urlcache_header* cache_container_lock_index(cache_container *pContainer)
  */
 static BOOL cache_container_unlock_index(cache_container *pContainer, urlcache_header *pHeader)
 {
+    urlcache_update_sequence(pHeader, FALSE);
+
     /* release mutex */
     ReleaseMutex(pContainer->mutex);
     return UnmapViewOfFile(pHeader);
@@ -1497,7 +1530,10 @@ static inline entry_hash_table* urlcache_get_hash_table(const urlcache_header *p
     return (entry_hash_table*)((LPBYTE)pHeader + dwOffset);
 }
 
-static BOOL urlcache_find_hash_entry(const urlcache_header *pHeader, LPCSTR lpszUrl, struct hash_entry **ppHashEntry)
+/* view_size is the size of the mapped view, which must not be trusted from the
+ * header when the index is read without holding the mutex */
+static BOOL urlcache_find_hash_entry_in_view(const urlcache_header *pHeader, DWORD view_size,
+        LPCSTR lpszUrl, struct hash_entry **ppHashEntry)
 {
     /* structure of hash table:
      *  448 entries divided into 64 blocks
@@ -1513,15 +1549,23 @@ static BOOL urlcache_find_hash_entry(const urlcache_header *pHeader, LPCSTR lpsz
      */
     DWORD key = urlcache_hash_key(lpszUrl);
     DWORD offset = (key & (HASHTABLE_NUM_ENTRIES-1)) * HASHTABLE_BLOCKSIZE;
+    DWORD max_tables = view_size / sizeof(entry_hash_table);
     entry_hash_table* pHashEntry;
     DWORD id = 0;
 
     key >>= HASHTABLE_FLAG_BITS;
 
+    /* the index may be read while another process modifies it, so never follow
+     * an offset out of the file or walk more tables than the file can hold */
     for (pHashEntry = urlcache_get_hash_table(pHeader, pHeader->hash_table_off);
          pHashEntry; pHashEntry = urlcache_get_hash_table(pHeader, pHashEntry->next))
     {
         int i;
+        if ((BYTE *)pHashEntry - (BYTE *)pHeader > view_size - sizeof(entry_hash_table) || id >= max_tables)
+        {
+            ERR("Error: hash table %d out of range\n", id);
+            return FALSE;
+        }
         if (pHashEntry->id != id++)
         {
             ERR("Error: not right hash table number (%d) expected %d\n", pHashEntry->id, id);
@@ -1553,6 +1597,11 @@ static BOOL urlcache_find_hash_entry(const urlcache_header *pHeader, LPCSTR lpsz
     return FALSE;
 }
 
+static BOOL urlcache_find_hash_entry(const urlcache_header *pHeader, LPCSTR lpszUrl, struct hash_entry **ppHashEntry)
+{
+    return urlcache_find_hash_entry_in_view(pHeader, pHeader->size, lpszUrl, ppHashEntry);
+}
+
 /***********************************************************************
  *           urlcache_hash_entry_set_flags (Internal)
  *
@@ -1771,12 +1820,124 @@ static BOOL urlcache_hash_entry_is_locked(struct hash_entry *hash_entry, entry_u
     return TRUE;
 }
 
+static DWORD urlcache_copy_entry_info(cache_container *container, const urlcache_header *header,
+        const entry_url *url_entry, void *entry_info, DWORD *size, DWORD flags, BOOL unicode)
+{
+    DWORD error;
+
+    if(url_entry->header.signature != URL_SIGNATURE) {
+        FIXME("Trying to retrieve entry of unknown format %s\n",
+                debugstr_an((LPCSTR)&url_entry->header.signature, sizeof(DWORD)));
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    TRACE("Found URL: %s\n", debugstr_a((LPCSTR)url_entry + url_entry->url_off));
+    TRACE("Header info: %s\n", debugstr_an((LPCSTR)url_entry +
+                url_entry->header_info_off, url_entry->header_info_size));
+
+    if((flags & GET_INSTALLED_ENTRY) && !(url_entry->cache_entry_type & INSTALLED_CACHE_ENTRY))
+        return ERROR_FILE_NOT_FOUND;
+
+    if(size) {
+        if(!entry_info)
+            *size = 0;
+
+        error = urlcache_copy_entry(container, header, entry_info, size, url_entry, unicode);
+        if(error != ERROR_SUCCESS)
+            return error;
+        if(url_entry->local_name_off)
+            TRACE("Local File Name: %s\n", debugstr_a((LPCSTR)url_entry + url_entry->local_name_off));
+    }
+    return ERROR_SUCCESS;
+}
+
+static inline void urlcache_memory_barrier(void)
+{
+    LONG dummy = 0;
+    InterlockedCompareExchange(&dummy, 0, 0);
+}
+
+/***********************************************************************
+ *           urlcache_find_entry_unlocked (Internal)
+ *
+ *  Looks up an url entry without taking the index mutex. The entry and the
+ * directory table are copied out of a read-only view, and the copies are only
+ * used if no other thread or process locked the index in the meantime.
+ *
+ * RETURNS
+ *    ERROR_SUCCESS if the entry was found, *entry and *dirs must be freed
+ *    ERROR_FILE_NOT_FOUND if there is no such entry
+ *    ERROR_RETRY if the caller needs to look up the entry with the index locked
+ */
+static DWORD urlcache_find_entry_unlocked(cache_container *container, const char *url,
+        entry_url **entry, urlcache_header **dirs)
+{
+    const DWORD dirs_size = FIELD_OFFSET(urlcache_header, options);
+    const urlcache_header *header;
+    const entry_url *url_entry;
+    struct hash_entry *hash_entry;
+    MEMORY_BASIC_INFORMATION info;
+    DWORD seq, offset, size, view_size, ret = ERROR_RETRY;
+
+    /* only trust the size this process mapped, another process may be growing the file */
+    view_size = container->file_size;
+    if(!container->mapping || !(header = MapViewOfFile(container->mapping, FILE_MAP_READ, 0, 0, 0)))
+        return ERROR_RETRY;
+    if(!VirtualQuery(header, &info, sizeof(info)) || info.RegionSize < view_size)
+        goto done;
+
+    seq = *(volatile DWORD *)&header->sequence;
+    urlcache_memory_barrier();
+    if((seq & URLCACHE_SEQUENCE_MASK) != URLCACHE_SEQUENCE_TAG || (seq & 1) || header->size != view_size)
+        goto done;
+
+    if(!urlcache_find_hash_entry_in_view(header, view_size, url, &hash_entry)) {
+        ret = ERROR_FILE_NOT_FOUND;
+        goto validate;
+    }
+
+    offset = hash_entry->offset;
+    if(offset < ENTRY_START_OFFSET || offset > view_size - sizeof(entry_url))
+        goto done;
+    url_entry = (const entry_url*)((const BYTE*)header + offset);
+    size = url_entry->header.blocks_used * BLOCKSIZE;
+    if(size < sizeof(entry_url) || size > view_size - offset)
+        goto done;
+
+    /* keep the copy null terminated, in case a string was torn by a writer */
+    *entry = heap_alloc(size + 1);
+    *dirs = heap_alloc(dirs_size);
+    if(!*entry || !*dirs) {
+        heap_free(*entry);
+        heap_free(*dirs);
+        goto done;
+    }
+    memcpy(*entry, url_entry, size);
+    ((BYTE*)*entry)[size] = 0;
+    memcpy(*dirs, header, dirs_size);
+    ret = ERROR_SUCCESS;
+
+validate:
+    urlcache_memory_barrier();
+    if(*(volatile DWORD *)&header->sequence != seq) {
+        if(ret == ERROR_SUCCESS) {
+            heap_free(*entry);
+            heap_free(*dirs);
+        }
+        ret = ERROR_RETRY;
+    }
+
+done:
+    UnmapViewOfFile(header);
+    return ret;
+}
+
 static BOOL urlcache_get_entry_info(const char *url, void *entry_info,
         DWORD *size, DWORD flags, BOOL unicode)
 {
-    urlcache_header *header;
+    urlcache_header *header, *dirs;
     struct hash_entry *hash_entry;
-    const entry_url *url_entry;
+    entry_url *entry;
     cache_container *container;
     DWORD error;
 
@@ -1797,50 +1958,31 @@ static BOOL urlcache_get_entry_info(const char *url, void *entry_info,
         return FALSE;
     }
 
-    if(!(header = cache_container_lock_index(container)))
-        return FALSE;
-
-    if(!urlcache_find_hash_entry(header, url, &hash_entry)) {
-        cache_container_unlock_index(container, header);
-        WARN("entry %s not found!\n", debugstr_a(url));
-        SetLastError(ERROR_FILE_NOT_FOUND);
-        return FALSE;
-    }
-
-    url_entry = (const entry_url*)((LPBYTE)header + hash_entry->offset);
-    if(url_entry->header.signature != URL_SIGNATURE) {
-        cache_container_unlock_index(container, header);
-        FIXME("Trying to retrieve entry of unknown format %s\n",
-                debugstr_an((LPCSTR)&url_entry->header.signature, sizeof(DWORD)));
-        SetLastError(ERROR_FILE_NOT_FOUND);
-        return FALSE;
+    error = urlcache_find_entry_unlocked(container, url, &entry, &dirs);
+    if(error == ERROR_SUCCESS) {
+        error = urlcache_copy_entry_info(container, dirs, entry, entry_info, size, flags, unicode);
+        heap_free(entry);
+        heap_free(dirs);
     }
+    else if(error == ERROR_RETRY) {
+        if(!(header = cache_container_lock_index(container)))
+            return FALSE;
 
-    TRACE("Found URL: %s\n", debugstr_a((LPCSTR)url_entry + url_entry->url_off));
-    TRACE("Header info: %s\n", debugstr_an((LPCSTR)url_entry +
-                url_entry->header_info_off, url_entry->header_info_size));
+        if(urlcache_find_hash_entry(header, url, &hash_entry))
+            error = urlcache_copy_entry_info(container, header, (const entry_url*)((LPBYTE)header + hash_entry->offset),
+                    entry_info, size, flags, unicode);
+        else
+            error = ERROR_FILE_NOT_FOUND;
 
-    if((flags & GET_INSTALLED_ENTRY) && !(url_entry->cache_entry_type & INSTALLED_CACHE_ENTRY)) {
         cache_container_unlock_index(container, header);
-        SetLastError(ERROR_FILE_NOT_FOUND);
-        return FALSE;
     }
 
-    if(size) {
-        if(!entry_info)
-            *size = 0;
-
-        error = urlcache_copy_entry(container, header, entry_info, size, url_entry, unicode);
-        if(error != ERROR_SUCCESS) {
-            cache_container_unlock_index(container, header);
-            SetLastError(error);
-            return FALSE;
-        }
-        if(url_entry->local_name_off)
-            TRACE("Local File Name: %s\n", debugstr_a((LPCSTR)url_entry + url_entry->local_name_off));
+    if(error == ERROR_FILE_NOT_FOUND)
+        WARN("entry %s not found!\n", debugstr_a(url));
+    if(error != ERROR_SUCCESS) {
+        SetLastError(error);
+        return FALSE;
     }
-
-    cache_container_unlock_index(container, header);
     return TRUE;
 }
 
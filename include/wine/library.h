@@ -48,6 +48,7 @@ extern const void *wine_get_patches(void);
 extern const char *wine_get_build_id(void);
 extern void wine_init_argv0_path( const char *argv0 );
 extern void wine_exec_wine_binary( const char *name, char **argv, const char *env_var );
+extern void wine_exec_process_template( char **argv );
 
 /* dll loading */
 
@@ -0,0 +1,96 @@
+/*
+ * Binary relay log format
+ *
+ * Copyright 2017 Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_WINE_RELAY_LOG_H
+#define __WINE_WINE_RELAY_LOG_H
+
+/* The log starts with a relay_log_header, followed by a stream of records,
+ * each one starting with a relay_log_record. All records are 8-byte aligned.
+ * Module and function name records always precede the call records that
+ * reference them. Timestamps are in units of header.frequency per second.
+ */
+
+#define RELAY_LOG_MAGIC    0x594c5257  /* "WRLY" */
+#define RELAY_LOG_VERSION  1
+
+struct relay_log_header
+{
+    unsigned int       magic;
+    unsigned int       version;
+    unsigned int       pid;
+    unsigned int       pointer_size;  /* 4 or 8 */
+    unsigned long long frequency;     /* timestamp ticks per second */
+};
+
+enum relay_log_type
+{
+    RELAY_LOG_MODULE = 1,  /* struct relay_log_module */
+    RELAY_LOG_NAME,        /* struct relay_log_name */
+    RELAY_LOG_CALL,        /* struct relay_log_call */
+    RELAY_LOG_RET          /* struct relay_log_ret */
+};
+
+struct relay_log_record
+{
+    unsigned short     type;
+    unsigned short     size;      /* total size of the record, including this header */
+    unsigned int       tid;
+    unsigned long long time;
+};
+
+struct relay_log_module
+{
+    struct relay_log_record hdr;
+    unsigned short     module;    /* module id used by the other records */
+    unsigned short     pad;
+    unsigned int       base;      /* ordinal base */
+    char               name[1];   /* dll name, null-terminated */
+};
+
+struct relay_log_name
+{
+    struct relay_log_record hdr;
+    unsigned short     module;
+    unsigned short     ordinal;   /* zero-based entry point index */
+    unsigned int       pad;
+    char               name[1];   /* function name, null-terminated */
+};
+
+struct relay_log_call
+{
+    struct relay_log_record hdr;
+    unsigned short     module;
+    unsigned short     ordinal;
+    unsigned int       nb_args;
+    unsigned long long ret_addr;
+    unsigned long long args[1];
+};
+
+struct relay_log_ret
+{
+    struct relay_log_record hdr;
+    unsigned short     module;
+    unsigned short     ordinal;
+    unsigned int       pad;
+    unsigned long long ret_addr;
+    unsigned long long retval;
+};
+
+#endif  /* __WINE_WINE_RELAY_LOG_H */
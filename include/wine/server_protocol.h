@@ -53,11 +53,15 @@ struct request_max_size
 #define FIRST_USER_HANDLE 0x0020
 #define LAST_USER_HANDLE  0xffef
 
+#define REGISTRY_SEQ_SLOTS 1024
+
 
 typedef struct
 {
     unsigned int last_input_time;
     unsigned int foreground_wnd_epoch;
+    unsigned int handle_close_epoch;
+    unsigned int registry_seq[REGISTRY_SEQ_SLOTS];
 } shmglobal_t;
 
 
@@ -2416,6 +2420,60 @@ struct next_thread_reply
 };
 
 
+struct process_info
+{
+    timeout_t      start_time;
+    data_size_t    name_len;
+    int            thread_count;
+    int            module_count;
+    int            priority;
+    process_id_t   pid;
+    process_id_t   parent_pid;
+    int            handle_count;
+    int            unix_pid;
+
+
+
+};
+
+struct thread_info
+{
+    timeout_t      start_time;
+    thread_id_t    tid;
+    int            base_priority;
+    int            current_priority;
+    int            unix_tid;
+};
+
+struct module_info
+{
+    mod_handle_t   base;
+    data_size_t    size;
+    data_size_t    name_len;
+
+};
+
+#define LIST_PROCESS_THREADS  0x01
+#define LIST_PROCESS_MODULES  0x02
+
+struct list_processes_request
+{
+    struct request_header __header;
+    unsigned int   flags;
+    process_id_t   pid;
+    unsigned int   version;
+};
+struct list_processes_reply
+{
+    struct reply_header __header;
+    unsigned int   version;
+    int            process_count;
+    data_size_t    info_size;
+    /* VARARG(data,bytes); */
+    char __pad_20[4];
+};
+
+
 
 struct wait_debug_event_request
 {
@@ -2661,6 +2719,8 @@ struct get_key_value_reply
     struct reply_header __header;
     int          type;
     data_size_t  total;
+    unsigned int key_id;
+    unsigned int key_seq;
     /* VARARG(data,bytes); */
 };
 
@@ -5913,6 +5973,7 @@ enum request
     REQ_create_snapshot,
     REQ_next_process,
     REQ_next_thread,
+    REQ_list_processes,
     REQ_wait_debug_event,
     REQ_queue_exception_event,
     REQ_get_exception_status,
@@ -6221,6 +6282,7 @@ union generic_request
     struct create_snapshot_request create_snapshot_request;
     struct next_process_request next_process_request;
     struct next_thread_request next_thread_request;
+    struct list_processes_request list_processes_request;
     struct wait_debug_event_request wait_debug_event_request;
     struct queue_exception_event_request queue_exception_event_request;
     struct get_exception_status_request get_exception_status_request;
@@ -6527,6 +6589,7 @@ union generic_reply
     struct create_snapshot_reply create_snapshot_reply;
     struct next_process_reply next_process_reply;
     struct next_thread_reply next_thread_reply;
+    struct list_processes_reply list_processes_reply;
     struct wait_debug_event_reply wait_debug_event_reply;
     struct queue_exception_event_reply queue_exception_event_reply;
     struct get_exception_status_reply get_exception_status_reply;
@@ -6737,6 +6800,6 @@ union generic_reply
     struct resume_process_reply resume_process_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 536
+#define SERVER_PROTOCOL_VERSION 539
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
@@ -141,7 +141,8 @@ typedef int INTERNET_SCHEME, *LPINTERNET_SCHEME;
 #define WINHTTP_OPTION_UNLOAD_NOTIFY_EVENT           99
 #define WINHTTP_OPTION_REJECT_USERPWD_IN_URL         100
 #define WINHTTP_OPTION_USE_GLOBAL_SERVER_CREDENTIALS 101
-#define WINHTTP_LAST_OPTION                          WINHTTP_OPTION_USE_GLOBAL_SERVER_CREDENTIALS
+#define WINHTTP_OPTION_DECOMPRESSION                 118
+#define WINHTTP_LAST_OPTION                          WINHTTP_OPTION_DECOMPRESSION
 #define WINHTTP_OPTION_USERNAME                      0x1000
 #define WINHTTP_OPTION_PASSWORD                      0x1001
 #define WINHTTP_OPTION_PROXY_USERNAME                0x1002
@@ -149,6 +150,10 @@ typedef int INTERNET_SCHEME, *LPINTERNET_SCHEME;
 
 #define WINHTTP_CONNS_PER_SERVER_UNLIMITED 0xFFFFFFFF
 
+#define WINHTTP_DECOMPRESSION_FLAG_GZIP     0x00000001
+#define WINHTTP_DECOMPRESSION_FLAG_DEFLATE  0x00000002
+#define WINHTTP_DECOMPRESSION_FLAG_ALL      (WINHTTP_DECOMPRESSION_FLAG_GZIP | WINHTTP_DECOMPRESSION_FLAG_DEFLATE)
+
 #define WINHTTP_AUTOLOGON_SECURITY_LEVEL_MEDIUM   0
 #define WINHTTP_AUTOLOGON_SECURITY_LEVEL_LOW      1
 #define WINHTTP_AUTOLOGON_SECURITY_LEVEL_HIGH     2
@@ -23,9 +23,12 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -35,10 +38,26 @@
 #ifdef HAVE_SYS_RESOURCE_H
 # include <sys/resource.h>
 #endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+# include <sys/un.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+# include <sys/wait.h>
+#endif
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 
+#if defined(HAVE_SYS_UN_H) && defined(HAVE_POLL_H) && !defined(HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS) && !defined(__ANDROID__)
+#define USE_PROCESS_TEMPLATE
+#endif
+
 #ifdef __APPLE__
 #include <crt_externs.h>
 #define environ (*_NSGetEnviron())
@@ -941,6 +960,415 @@ jint JNI_OnLoad( JavaVM *vm, void *reserved )
 
 #endif  /* __ANDROID__ */
 
+#ifdef USE_PROCESS_TEMPLATE
+
+/* A process template is a copy of the wine loader that has loaded ntdll but not initialized
+ * it yet. New processes of the same prefix and architecture are forked from it instead of
+ * going through exec, the preloader and the dynamic linker again. Everything from the
+ * server connection onwards (handles, environment, token, console) is set up as usual.
+ * There is one template per unix session, and the new processes join the process group
+ * of the requester, so that they get the same terminal and signals as an exec'd process. */
+
+#define TEMPLATE_IDLE_TIMEOUT (5 * 60 * 1000)  /* exit after 5 minutes without requests */
+#define TEMPLATE_MAX_DATA     (1024 * 1024)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* request sent to the template, followed by the cwd, argv[1..] and the environment strings */
+struct template_request
+{
+    unsigned int size;   /* size of the strings that follow the request */
+    unsigned int argc;   /* number of arguments, not counting argv[0] */
+    unsigned int envc;   /* number of environment strings */
+    unsigned int umask;  /* file creation mask of the new process */
+    int          pgid;   /* process group of the requester, joined by the new process */
+};
+
+/* fds passed along with the request */
+enum { TEMPLATE_FD_STDIN, TEMPLATE_FD_STDOUT, TEMPLATE_FD_STDERR, TEMPLATE_FD_SERVER, TEMPLATE_FD_COUNT };
+
+/* variables that were already used by the template and have to match in the new process */
+static const char * const template_env_vars[] =
+{
+    "WINEDLLPATH", "WINELOADER", "LD_LIBRARY_PATH", "LD_PRELOAD"
+};
+
+/* get the name of the template socket, in the server directory */
+static char *get_template_socket_name(void)
+{
+    const char *dir = wine_get_server_dir();
+    char *name;
+
+    if (!dir || !(name = malloc( strlen(dir) + sizeof("/template-64-") + 10 ))) return NULL;
+    sprintf( name, "%s/template-%u-%d", dir, sizeof(void *) > 4 ? 64 : 32, (int)getsid( 0 ) );
+    return name;
+}
+
+static int init_template_addr( struct sockaddr_un *addr, const char *name )
+{
+    if (strlen( name ) >= sizeof(addr->sun_path)) return 0;
+    memset( addr, 0, sizeof(*addr) );
+    addr->sun_family = AF_UNIX;
+    strcpy( addr->sun_path, name );
+    return 1;
+}
+
+static int read_all( int fd, void *buffer, size_t size )
+{
+    char *ptr = buffer;
+    ssize_t ret;
+
+    while (size)
+    {
+        if ((ret = read( fd, ptr, size )) <= 0)
+        {
+            if (ret == -1 && errno == EINTR) continue;
+            return 0;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+    return 1;
+}
+
+static int write_all( int fd, const void *buffer, size_t size )
+{
+    const char *ptr = buffer;
+    ssize_t ret;
+
+    while (size)
+    {
+        if ((ret = send( fd, ptr, size, MSG_NOSIGNAL )) == -1)
+        {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+    return 1;
+}
+
+/* find a variable in an environment array */
+static char **find_env_var( char **env, const char *name )
+{
+    size_t len = strlen( name );
+
+    for ( ; *env; env++) if (!strncmp( *env, name, len ) && (*env)[len] == '=') return env;
+    return NULL;
+}
+
+/* close all the fds inherited from the process that started the template */
+static void close_inherited_fds(void)
+{
+    long i, max_fd = sysconf( _SC_OPEN_MAX );
+    int fd = open( "/dev/null", O_RDWR );
+
+    if (fd != -1)
+    {
+        dup2( fd, 0 );
+        dup2( fd, 1 );
+        dup2( fd, 2 );
+        if (fd > 2) close( fd );
+    }
+    if (max_fd <= 0 || max_fd > 65536) max_fd = 65536;
+    for (i = 3; i < max_fd; i++) close( i );
+}
+
+/* reserve the exe range that the preloader would have reserved for the new process */
+static int reserve_exe_range( char **env )
+{
+    char **var = find_env_var( env, "WINEPRELOADRESERVE" );
+    unsigned long page_mask = sysconf( _SC_PAGESIZE ) - 1;
+    unsigned long start, end;
+    void *ptr;
+
+    if (!var || sscanf( *var + sizeof("WINEPRELOADRESERVE"), "%lx-%lx", &start, &end ) != 2) return 1;
+    start &= ~page_mask;
+    end = (end + page_mask) & ~page_mask;
+    if (end <= start) return 1;
+
+    switch (wine_mmap_is_in_reserved_area( (void *)start, end - start ))
+    {
+    case 1: return 1;
+    case -1: return 0;
+    }
+    ptr = mmap( (void *)start, end - start, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0 );
+    if (ptr == MAP_FAILED) return 0;
+    if (ptr != (void *)start)
+    {
+        munmap( ptr, end - start );
+        return 0;
+    }
+    wine_mmap_add_reserved_area( ptr, end - start );
+    return 1;
+}
+
+/* turn a freshly forked template child into the requested process; exits on failure */
+static void init_template_child( int conn )
+{
+    struct template_request req;
+    struct msghdr msghdr;
+    struct iovec vec;
+    struct cmsghdr *cmsg;
+    char cmsg_buffer[CMSG_SPACE( TEMPLATE_FD_COUNT * sizeof(int) )];
+    char *data, *ptr, *end, **argv, **env, **var, *socket_env;
+    int fds[TEMPLATE_FD_COUNT];
+    unsigned int i;
+    char ack = 1;
+
+    vec.iov_base = &req;
+    vec.iov_len  = sizeof(req);
+    memset( &msghdr, 0, sizeof(msghdr) );
+    msghdr.msg_iov        = &vec;
+    msghdr.msg_iovlen     = 1;
+    msghdr.msg_control    = cmsg_buffer;
+    msghdr.msg_controllen = sizeof(cmsg_buffer);
+
+    if (recvmsg( conn, &msghdr, MSG_WAITALL ) != sizeof(req)) _exit(1);
+    if (!(cmsg = CMSG_FIRSTHDR( &msghdr ))) _exit(1);
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) _exit(1);
+    if (cmsg->cmsg_len != CMSG_LEN( sizeof(fds) )) _exit(1);
+    memcpy( fds, CMSG_DATA( cmsg ), sizeof(fds) );
+
+    if (!req.size || req.size > TEMPLATE_MAX_DATA || req.argc + req.envc >= req.size) _exit(1);
+    if (!(data = malloc( req.size )) || !read_all( conn, data, req.size )) _exit(1);
+    if (data[req.size - 1]) _exit(1);
+    if (!(argv = malloc( (req.argc + 2) * sizeof(*argv) ))) _exit(1);
+    if (!(env = malloc( (req.envc + 1) * sizeof(*env) ))) _exit(1);
+
+    /* split the strings */
+    ptr = data;
+    end = data + req.size;
+    ptr += strlen( ptr ) + 1;  /* cwd */
+    argv[0] = __wine_main_argv[0];
+    for (i = 0; i < req.argc && ptr < end; i++, ptr += strlen( ptr ) + 1) argv[i + 1] = ptr;
+    argv[i + 1] = NULL;
+    if (i < req.argc) _exit(1);
+    for (i = 0; i < req.envc && ptr < end; i++, ptr += strlen( ptr ) + 1) env[i] = ptr;
+    env[i] = NULL;
+    if (i < req.envc || ptr != end) _exit(1);
+
+    for (i = 0; i < sizeof(template_env_vars) / sizeof(template_env_vars[0]); i++)
+    {
+        const char *value = getenv( template_env_vars[i] );
+        var = find_env_var( env, template_env_vars[i] );
+        if (!value != !var) _exit(1);
+        if (value && strcmp( value, *var + strlen( template_env_vars[i] ) + 1 )) _exit(1);
+    }
+
+    /* the server socket keeps the fd number we received it on */
+    if (!(var = find_env_var( env, "WINESERVERSOCKET" ))) _exit(1);
+    if (!(socket_env = malloc( sizeof("WINESERVERSOCKET=") + 10 ))) _exit(1);
+    sprintf( socket_env, "WINESERVERSOCKET=%u", fds[TEMPLATE_FD_SERVER] );
+    *var = socket_env;
+
+    if (!reserve_exe_range( env )) _exit(1);
+
+    /* this fails if the requester is in another session, it then execs the process itself */
+    if (setpgid( 0, req.pgid ) == -1) _exit(1);
+
+    for (i = TEMPLATE_FD_STDIN; i <= TEMPLATE_FD_STDERR; i++)
+    {
+        dup2( fds[i], i );
+        close( fds[i] );
+    }
+    umask( req.umask );
+    chdir( data );
+    signal( SIGCHLD, SIG_DFL );
+
+    environ = env;
+    __wine_main_argc = req.argc + 1;
+    __wine_main_argv = argv;
+    __wine_main_environ = __wine_get_main_environment();
+
+    if (!write_all( conn, &ack, sizeof(ack) )) _exit(1);
+    close( conn );
+}
+
+/***********************************************************************
+ *           run_process_template
+ *
+ * Wait for process creation requests; only returns in the forked children.
+ */
+static void run_process_template( const char *name )
+{
+    struct sockaddr_un addr;
+    struct pollfd pfd;
+    int fd, probe, conn, ret;
+    pid_t pid;
+
+    /* stay in the session of the requester, but out of its process group */
+    setpgid( 0, 0 );
+    close_inherited_fds();
+    if (!init_template_addr( &addr, name )) exit(1);
+    if ((fd = socket( AF_UNIX, SOCK_STREAM, 0 )) == -1) exit(1);
+    fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+    if (bind( fd, (struct sockaddr *)&addr, sizeof(addr) ) == -1)
+    {
+        if (errno != EADDRINUSE) exit(1);
+        /* check whether the existing socket is still alive */
+        if ((probe = socket( AF_UNIX, SOCK_STREAM, 0 )) == -1) exit(1);
+        if (!connect( probe, (struct sockaddr *)&addr, sizeof(addr) )) exit(0);
+        close( probe );
+        unlink( name );
+        if (bind( fd, (struct sockaddr *)&addr, sizeof(addr) ) == -1) exit(1);
+    }
+    if (listen( fd, 16 ) == -1) exit(1);
+
+    signal( SIGCHLD, SIG_IGN );  /* let the system reap the children */
+
+    for (;;)
+    {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if ((ret = poll( &pfd, 1, TEMPLATE_IDLE_TIMEOUT )) == -1 && errno == EINTR) continue;
+        if (ret <= 0) break;
+        if ((conn = accept( fd, NULL, NULL )) == -1) continue;
+        if (!(pid = fork()))
+        {
+            close( fd );
+            init_template_child( conn );
+            return;
+        }
+        /* on failure the requester sees the connection closed and execs the process itself */
+        close( conn );
+    }
+    unlink( name );
+    exit(0);
+}
+
+/* start a template in the background, for use by the next process creations */
+static void start_process_template( const char *name )
+{
+    char *argv[2] = { NULL, NULL };
+    char *template_env;
+    pid_t pid;
+
+    if (!(template_env = malloc( sizeof("WINEPROCESSTEMPLATE=") + strlen( name ) ))) return;
+    strcpy( template_env, "WINEPROCESSTEMPLATE=" );
+    strcat( template_env, name );
+
+    if (!(pid = fork()))
+    {
+        if (fork()) _exit(0);
+        putenv( template_env );
+        unsetenv( "WINESERVERSOCKET" );
+        unsetenv( "WINEPRELOADRESERVE" );
+        wine_exec_wine_binary( NULL, argv, getenv("WINELOADER") );
+        _exit(1);
+    }
+    if (pid != -1) waitpid( pid, NULL, 0 );
+    free( template_env );
+}
+
+/***********************************************************************
+ *           wine_exec_process_template
+ *
+ * Start the process described by argv and the current environment through the
+ * prefix process template. Only returns if this isn't possible, in which case
+ * the caller should exec the loader as usual.
+ */
+void wine_exec_process_template( char **argv )
+{
+    struct template_request req;
+    struct sockaddr_un addr;
+    struct msghdr msghdr;
+    struct iovec vec;
+    struct cmsghdr *cmsg;
+    char cmsg_buffer[CMSG_SPACE( TEMPLATE_FD_COUNT * sizeof(int) )];
+    char *name, *cwd = NULL, *data, *ptr, **arg, **env = __wine_get_main_environment();
+    const char *socket_env;
+    int fds[TEMPLATE_FD_COUNT];
+    size_t size = PATH_MAX;
+    int fd, err;
+    char ack = 0;
+
+    if (!(socket_env = getenv( "WINESERVERSOCKET" ))) return;
+    /* a new session was requested, this can't be done from the session's template */
+    if (getsid( 0 ) == getpid()) return;
+    if (!(name = get_template_socket_name())) return;
+    if (!init_template_addr( &addr, name ) || (fd = socket( AF_UNIX, SOCK_STREAM, 0 )) == -1)
+    {
+        free( name );
+        return;
+    }
+    if (connect( fd, (struct sockaddr *)&addr, sizeof(addr) ) == -1)
+    {
+        err = errno;
+        close( fd );
+        if (err == ENOENT || err == ECONNREFUSED) start_process_template( name );
+        free( name );
+        return;
+    }
+    free( name );
+
+    for (;;)
+    {
+        if (!(ptr = realloc( cwd, size ))) goto done;
+        cwd = ptr;
+        if (getcwd( cwd, size )) break;
+        if (errno != ERANGE) goto done;
+        size *= 2;
+    }
+
+    req.argc = req.envc = 0;
+    size = strlen( cwd ) + 1;
+    for (arg = argv + 1; *arg; arg++, req.argc++) size += strlen( *arg ) + 1;
+    for (arg = env; *arg; arg++, req.envc++) size += strlen( *arg ) + 1;
+    if (size > TEMPLATE_MAX_DATA || !(data = malloc( size ))) goto done;
+
+    ptr = data;
+    strcpy( ptr, cwd );
+    ptr += strlen( ptr ) + 1;
+    for (arg = argv + 1; *arg; arg++, ptr += strlen( ptr ) + 1) strcpy( ptr, *arg );
+    for (arg = env; *arg; arg++, ptr += strlen( ptr ) + 1) strcpy( ptr, *arg );
+
+    req.size = size;
+    req.umask = umask( 0 );
+    umask( req.umask );
+    req.pgid = getpgrp();
+
+    fds[TEMPLATE_FD_STDIN]  = 0;
+    fds[TEMPLATE_FD_STDOUT] = 1;
+    fds[TEMPLATE_FD_STDERR] = 2;
+    fds[TEMPLATE_FD_SERVER] = atoi( socket_env );
+
+    vec.iov_base = &req;
+    vec.iov_len  = sizeof(req);
+    memset( &msghdr, 0, sizeof(msghdr) );
+    msghdr.msg_iov        = &vec;
+    msghdr.msg_iovlen     = 1;
+    msghdr.msg_control    = cmsg_buffer;
+    msghdr.msg_controllen = sizeof(cmsg_buffer);
+    cmsg = CMSG_FIRSTHDR( &msghdr );
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN( sizeof(fds) );
+    memcpy( CMSG_DATA( cmsg ), fds, sizeof(fds) );
+
+    if (sendmsg( fd, &msghdr, MSG_NOSIGNAL ) == sizeof(req) && write_all( fd, data, size ))
+    {
+        /* the connection is closed without an ack if the child failed before using the fds */
+        if (read_all( fd, &ack, sizeof(ack) ) && ack) _exit(0);
+    }
+    free( data );
+done:
+    free( cwd );
+    close( fd );
+}
+
+#else  /* USE_PROCESS_TEMPLATE */
+
+void wine_exec_process_template( char **argv )
+{
+}
+
+#endif  /* USE_PROCESS_TEMPLATE */
+
 /***********************************************************************
  *           wine_init
  *
@@ -951,6 +1379,9 @@ void wine_init( int argc, char *argv[], char *error, int error_size )
     struct dll_path_context context;
     char *path;
     void *ntdll = NULL;
+#ifdef USE_PROCESS_TEMPLATE
+    const char *template;
+#endif
     void (*init_func)(void);
 
     /* force a few limits that are set too low on some platforms */
@@ -981,6 +1412,9 @@ void wine_init( int argc, char *argv[], char *error, int error_size )
 
     if (!ntdll) return;
     if (!(init_func = wine_dlsym( ntdll, "__wine_process_init", error, error_size ))) return;
+#ifdef USE_PROCESS_TEMPLATE
+    if ((template = getenv( "WINEPROCESSTEMPLATE" ))) run_process_template( template );
+#endif
 #ifdef __APPLE__
     apple_main_thread( init_func );
 #else
@@ -26,6 +26,88 @@ extern struct env_stack *saved_environment;
 
 WINE_DEFAULT_DEBUG_CHANNEL(cmd);
 
+/* Size of the window of batch file data kept in memory; must hold at
+   least one maximum length line */
+#define BATCH_BUFFER_SIZE 0x10000
+
+struct batch_label
+{
+  WCHAR   *name;        /* Label name, as matched by goto */
+  LONGLONG offset;      /* Offset of the line following the label */
+};
+
+/* Cached view of a batch file, shared between all the contexts running
+   it through call :label. The cache is only valid for the size and last
+   write time it was read with, so edits to a running batch file are seen
+   on the next line read, as on Windows. */
+struct batch_file
+{
+  LONG                refcount;
+  LARGE_INTEGER       size;        /* Size the cached data is valid for */
+  FILETIME            write_time;  /* Last write time the cached data is valid for */
+  char               *data;        /* Buffered file contents */
+  LONGLONG            data_start;  /* File offset of the buffered contents */
+  DWORD               data_len;    /* Number of bytes buffered */
+  struct batch_label *labels;      /* Label index sorted by name, or NULL */
+  unsigned int        label_count;
+};
+
+static struct batch_file *batch_file_create(void)
+{
+  struct batch_file *file = heap_alloc_zero(sizeof(*file));
+
+  file->refcount = 1;
+  file->size.QuadPart = -1;
+  return file;
+}
+
+static void batch_file_invalidate(struct batch_file *file)
+{
+  unsigned int i;
+
+  for (i = 0; i < file->label_count; i++) heap_free(file->labels[i].name);
+  heap_free(file->labels);
+  file->labels = NULL;
+  file->label_count = 0;
+  heap_free(file->data);
+  file->data = NULL;
+  file->data_len = 0;
+}
+
+static void batch_file_release(struct batch_file *file)
+{
+  if (--file->refcount) return;
+  batch_file_invalidate(file);
+  heap_free(file);
+}
+
+/****************************************************************************
+ * batch_file_validate
+ *
+ * Drops the cached contents of the batch file if it has been modified
+ * since they were read.
+ */
+static void batch_file_validate(struct batch_file *file, HANDLE h)
+{
+  LARGE_INTEGER size;
+  FILETIME write_time;
+
+  if (!GetFileSizeEx(h, &size) || !GetFileTime(h, NULL, NULL, &write_time)) {
+      /* Don't trust the cache if we can't tell whether it is stale */
+      batch_file_invalidate(file);
+      file->size.QuadPart = -1;
+      return;
+  }
+  if (size.QuadPart == file->size.QuadPart &&
+      !CompareFileTime(&write_time, &file->write_time))
+      return;
+
+  WINE_TRACE("batch file changed, dropping cached contents\n");
+  batch_file_invalidate(file);
+  file->size = size;
+  file->write_time = write_time;
+}
+
 /****************************************************************************
  * WCMD_batch
  *
@@ -69,6 +151,14 @@ void WCMD_batch (WCHAR *file, WCHAR *command, BOOL called, WCHAR *startLabel, HA
   context = LocalAlloc (LMEM_FIXED, sizeof (BATCH_CONTEXT));
   context -> h = h;
   context->batchfileW = heap_strdupW(file);
+  /* A call :label runs the same file, so share its cached contents */
+  if (startLabel && prev_context) {
+    context->file = prev_context->file;
+    context->file->refcount++;
+  } else {
+    context->file = batch_file_create();
+  }
+  context->file_pos = 0;
   context -> command = command;
   memset(context -> shift_count, 0x00, sizeof(context -> shift_count));
   context -> prev_context = prev_context;
@@ -87,6 +177,9 @@ void WCMD_batch (WCHAR *file, WCHAR *command, BOOL called, WCHAR *startLabel, HA
 
   while (context -> skip_rest == FALSE) {
       CMD_LIST *toExecute = NULL;         /* Commands left to be executed */
+
+      /* The file may have been changed by the previous command */
+      batch_file_validate(context->file, h);
       if (!WCMD_ReadAndParseLine(NULL, &toExecute, h))
         break;
       /* Note: although this batch program itself may be called, we are not retrying
@@ -111,6 +204,7 @@ void WCMD_batch (WCHAR *file, WCHAR *command, BOOL called, WCHAR *startLabel, HA
  */
 
   heap_free(context->batchfileW);
+  batch_file_release(context->file);
   LocalFree (context);
   if ((prev_context != NULL) && (!called)) {
     WINE_TRACE("Batch completed, but was not 'called' so skipping outer batch too\n");
@@ -228,6 +322,168 @@ WCHAR *WCMD_parameter (WCHAR *s, int n, WCHAR **start, BOOL raw,
   return WCMD_parameter_with_delims (s, n, start, raw, wholecmdline, defaultDelims);
 }
 
+/****************************************************************************
+ * batch_file_read
+ *
+ * Makes up to count bytes of the batch file starting at offset pos available
+ * in memory, reading them from the file if they are not cached yet.
+ * Returns the number of bytes available at *data, 0 at EOF or on error.
+ */
+static DWORD batch_file_read(struct batch_file *file, HANDLE h, LONGLONG pos,
+                             DWORD count, const char **data)
+{
+  OVERLAPPED ovl;
+  DWORD avail;
+
+  /* Refill from pos unless the cached window holds the whole line or
+     everything up to EOF */
+  if (!file->data || pos < file->data_start ||
+      (pos + count > file->data_start + file->data_len &&
+       file->data_start + file->data_len < file->size.QuadPart)) {
+      if (!file->data) file->data = heap_alloc(BATCH_BUFFER_SIZE);
+      memset(&ovl, 0, sizeof(ovl));
+      ovl.Offset = (DWORD)pos;
+      ovl.OffsetHigh = (DWORD)(pos >> 32);
+      file->data_start = pos;
+      if (!ReadFile(h, file->data, BATCH_BUFFER_SIZE, &file->data_len, &ovl))
+          file->data_len = 0;
+  }
+  if (pos >= file->data_start + file->data_len) return 0;
+
+  avail = file->data_start + file->data_len - pos;
+  *data = file->data + (pos - file->data_start);
+  return min(avail, count);
+}
+
+/****************************************************************************
+ * batch_file_gets
+ *
+ * Reads the line at offset *pos of a batch file into buf, and advances *pos
+ * to the next line. Same semantics as WCMD_fgets otherwise.
+ */
+static WCHAR *batch_file_gets(struct batch_file *file, HANDLE h, LONGLONG *pos,
+                              WCHAR *buf, DWORD noChars)
+{
+  const char *bufA, *p, *end;
+  DWORD charsRead, i;
+  UINT cp;
+
+  if (!(charsRead = batch_file_read(file, h, *pos, noChars, &bufA)))
+      return NULL;
+
+  cp = GetConsoleCP();
+  end = bufA + charsRead;
+
+  /* Find first EOL */
+  for (p = bufA; p < end; p = CharNextExA(cp, p, 0)) {
+      if (*p == '\n' || *p == '\r')
+          break;
+  }
+  if (p > end) p = end;
+
+  /* Move to the start of the next line, if any */
+  *pos += p - bufA + 1 + (p < end && *p == '\r' ? 1 : 0);
+
+  i = MultiByteToWideChar(cp, 0, bufA, p - bufA, buf, noChars);
+
+  /* Truncate at EOL (or end of buffer) */
+  if (i == noChars)
+    i--;
+
+  buf[i] = '\0';
+
+  return buf;
+}
+
+static int label_cmp(const void *a, const void *b)
+{
+  const struct batch_label *l1 = a, *l2 = b;
+  int ret = lstrcmpiW(l1->name, l2->name);
+
+  if (ret) return ret;
+  /* Keep labels with the same name in file order */
+  return l1->offset < l2->offset ? -1 : l1->offset > l2->offset;
+}
+
+/****************************************************************************
+ * batch_file_index_labels
+ *
+ * Scans the whole batch file once and records the position of every label.
+ */
+static void batch_file_index_labels(struct batch_file *file, HANDLE h)
+{
+  static const WCHAR labelEndsW[] = {'>','<','|','&',' ',':','\t','\0'};
+  unsigned int size = 16;
+  LONGLONG pos = 0;
+  WCHAR *string, *str, *labelend;
+
+  string = heap_alloc(MAXSTRING * sizeof(WCHAR));
+  file->labels = heap_alloc(size * sizeof(*file->labels));
+  file->label_count = 0;
+
+  while (batch_file_gets(file, h, &pos, string, MAXSTRING)) {
+      str = string;
+
+      /* Ignore leading whitespace or no-echo character */
+      while (*str=='@' || isspaceW (*str)) str++;
+
+      /* If the first real character is a : then this is a label */
+      if (*str != ':') continue;
+      str++;
+
+      /* Skip spaces between : and label */
+      while (isspaceW (*str)) str++;
+
+      /* Label ends at whitespace or redirection characters */
+      labelend = strpbrkW(str, labelEndsW);
+      if (labelend) *labelend = 0x00;
+      if (!*str) continue;
+
+      if (file->label_count == size) {
+          struct batch_label *labels = heap_alloc(2 * size * sizeof(*labels));
+          memcpy(labels, file->labels, size * sizeof(*labels));
+          heap_free(file->labels);
+          file->labels = labels;
+          size *= 2;
+      }
+      file->labels[file->label_count].name = heap_strdupW(str);
+      file->labels[file->label_count].offset = pos;
+      file->label_count++;
+  }
+  heap_free(string);
+
+  qsort(file->labels, file->label_count, sizeof(*file->labels), label_cmp);
+  WINE_TRACE("indexed %u labels\n", file->label_count);
+}
+
+/****************************************************************************
+ * WCMD_find_label
+ *
+ * Finds the first occurrence of a label in the current batch file.
+ * On success, *pos receives the offset of the line following the label.
+ */
+BOOL WCMD_find_label(const WCHAR *label, LONGLONG *pos)
+{
+  struct batch_file *file = context->file;
+  unsigned int min = 0, max;
+
+  batch_file_validate(file, context->h);
+  if (!file->labels) batch_file_index_labels(file, context->h);
+
+  /* Find the first entry not sorting before the label */
+  max = file->label_count;
+  while (min < max) {
+      unsigned int mid = (min + max) / 2;
+      if (lstrcmpiW(file->labels[mid].name, label) < 0) min = mid + 1;
+      else max = mid;
+  }
+  if (min == file->label_count || lstrcmpiW(file->labels[min].name, label))
+      return FALSE;
+
+  *pos = file->labels[min].offset;
+  return TRUE;
+}
+
 /****************************************************************************
  * WCMD_fgets
  *
@@ -250,6 +506,9 @@ WCHAR *WCMD_fgets(WCHAR *buf, DWORD noChars, HANDLE h)
   /* We can't use the native f* functions because of the filename syntax differences
      between DOS and Unix. Also need to lose the LF (or CRLF) from the line. */
 
+  if (context && h == context->h)
+      return batch_file_gets(context->file, h, &context->file_pos, buf, noChars);
+
   if (!WCMD_is_console_handle(h)) {
       LARGE_INTEGER filepos;
       char *bufA;
@@ -706,7 +965,6 @@ void WCMD_call (WCHAR *command) {
 
     if (context) {
 
-      LARGE_INTEGER li;
       FOR_CONTEXT oldcontext;
 
       /* Save the for variable context, then start with an empty context
@@ -714,14 +972,9 @@ void WCMD_call (WCHAR *command) {
       oldcontext = forloopcontext;
       memset(&forloopcontext, 0, sizeof(forloopcontext));
 
-      /* Save the current file position, call the same file,
-         restore position                                    */
-      li.QuadPart = 0;
-      li.u.LowPart = SetFilePointer(context -> h, li.u.LowPart,
-                     &li.u.HighPart, FILE_CURRENT);
+      /* Call the same file; the called context keeps its own position
+         so ours is preserved                                          */
       WCMD_batch (param1, command, TRUE, gotoLabel, context->h);
-      SetFilePointer(context -> h, li.u.LowPart,
-                     &li.u.HighPart, FILE_BEGIN);
 
       /* Restore the for loop context */
       forloopcontext = oldcontext;
@@ -2539,15 +2539,15 @@ void WCMD_give_help (const WCHAR *args)
 /****************************************************************************
  * WCMD_go_to
  *
- * Batch file jump instruction. Not the most efficient algorithm ;-)
- * Prints error message if the specified label cannot be found - the file pointer is
- * then at EOF, effectively stopping the batch file.
+ * Batch file jump instruction. Labels are looked up in an index of the batch
+ * file, rebuilt whenever the file is modified.
+ * Prints error message if the specified label cannot be found, and stops the
+ * batch file.
  * FIXME: DOS is supposed to allow labels with spaces - we don't.
  */
 
 void WCMD_goto (CMD_LIST **cmdList) {
 
-  WCHAR string[MAX_PATH];
   WCHAR *labelend = NULL;
   const WCHAR labelEndsW[] = {'>','<','|','&',' ',':','\t','\0'};
 
@@ -2555,7 +2555,7 @@ void WCMD_goto (CMD_LIST **cmdList) {
   if (cmdList) *cmdList = NULL;
 
   if (context != NULL) {
-    WCHAR *paramStart = param1, *str;
+    WCHAR *paramStart = param1;
     static const WCHAR eofW[] = {':','e','o','f','\0'};
 
     if (param1[0] == 0x00) {
@@ -2575,30 +2575,7 @@ void WCMD_goto (CMD_LIST **cmdList) {
     if (labelend) *labelend = 0x00;
     WINE_TRACE("goto label: '%s'\n", wine_dbgstr_w(paramStart));
 
-    SetFilePointer (context -> h, 0, NULL, FILE_BEGIN);
-    while (*paramStart &&
-           WCMD_fgets (string, sizeof(string)/sizeof(WCHAR), context -> h)) {
-      str = string;
-
-      /* Ignore leading whitespace or no-echo character */
-      while (*str=='@' || isspaceW (*str)) str++;
-
-      /* If the first real character is a : then this is a label */
-      if (*str == ':') {
-        str++;
-
-        /* Skip spaces between : and label */
-        while (isspaceW (*str)) str++;
-        WINE_TRACE("str before brk %s\n", wine_dbgstr_w(str));
-
-        /* Label ends at whitespace or redirection characters */
-        labelend = strpbrkW(str, labelEndsW);
-        if (labelend) *labelend = 0x00;
-        WINE_TRACE("comparing found label %s\n", wine_dbgstr_w(str));
-
-        if (lstrcmpiW (str, paramStart) == 0) return;
-      }
-    }
+    if (*paramStart && WCMD_find_label(paramStart, &context->file_pos)) return;
     WCMD_output_stderr(WCMD_LoadMessage(WCMD_NOTARGET));
     context -> skip_rest = TRUE;
   }
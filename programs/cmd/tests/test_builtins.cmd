@@ -2967,6 +2967,17 @@ echo FAILURE at dest 10
 :dest10:this is also ignored
 echo Correctly ignored trailing information
 
+rem lines and labels appended to a running batch file are seen
+del testgoto.bat >nul 2>&1
+echo @echo off> testgoto.bat
+echo goto :start>> testgoto.bat
+echo :start>> testgoto.bat
+echo echo :appended^>^> testgoto.bat>> testgoto.bat
+echo echo echo Appended label was found^>^> testgoto.bat>> testgoto.bat
+echo goto :appended>> testgoto.bat
+call testgoto.bat
+del testgoto.bat >nul 2>&1
+
 echo ------------ Testing PATH ------------
 set WINE_backup_path=%path%
 set path=original
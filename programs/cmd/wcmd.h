@@ -107,6 +107,7 @@ static inline BOOL WCMD_is_console_handle(HANDLE h)
     return (((DWORD_PTR)h) & 3) == 3;
 }
 WCHAR *WCMD_fgets (WCHAR *buf, DWORD n, HANDLE stream);
+BOOL WCMD_find_label (const WCHAR *label, LONGLONG *pos);
 WCHAR *WCMD_parameter (WCHAR *s, int n, WCHAR **start, BOOL raw, BOOL wholecmdline);
 WCHAR *WCMD_parameter_with_delims (WCHAR *s, int n, WCHAR **start, BOOL raw,
                                    BOOL wholecmdline, const WCHAR *delims);
@@ -127,6 +128,7 @@ void      WCMD_execute (const WCHAR *orig_command, const WCHAR *redirects,
                         CMD_LIST **cmdList, BOOL retrycall);
 
 void *heap_alloc(size_t);
+void *heap_alloc_zero(size_t);
 
 static inline BOOL heap_free(void *mem)
 {
@@ -155,10 +157,14 @@ static inline BOOL ends_with_backslash( const WCHAR *path )
 
 /* Data structure to hold context when executing batch files */
 
+struct batch_file;
+
 typedef struct _BATCH_CONTEXT {
   WCHAR *command;	/* The command which invoked the batch file */
   HANDLE h;             /* Handle to the open batch file */
   WCHAR *batchfileW;    /* Name of same */
+  struct batch_file *file; /* Buffered contents and label index of same */
+  LONGLONG file_pos;    /* Offset of the next line to read */
   int shift_count[10];	/* Offset in terms of shifts for %0 - %9 */
   struct _BATCH_CONTEXT *prev_context; /* Pointer to the previous context block */
   BOOL  skip_rest;      /* Skip the rest of the batch program and exit */
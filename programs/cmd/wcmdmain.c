@@ -450,6 +450,19 @@ void *heap_alloc(size_t size)
     return ret;
 }
 
+void *heap_alloc_zero(size_t size)
+{
+    void *ret;
+
+    ret = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, size);
+    if(!ret) {
+        ERR("Out of memory\n");
+        ExitProcess(1);
+    }
+
+    return ret;
+}
+
 /*************************************************************************
  * WCMD_strsubstW
  *    Replaces a portion of a Unicode string with the specified string.
@@ -16,18 +16,1217 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#include <stdarg.h>
+#include <string.h>
+
+#include <windef.h>
+#include <winbase.h>
+#include <wincon.h>
+#include <winnls.h>
+#include <winuser.h>
+
+#include "wine/unicode.h"
 #include "wine/debug.h"
 
+#include "findstr.h"
+
 WINE_DEFAULT_DEBUG_CHANNEL(findstr);
 
-int wmain(int argc, WCHAR *argv[])
+/* Size of the buffer used for files that cannot be mapped and for stdin */
+#define READ_BUFFER_SIZE  (1024 * 1024)
+
+/* Regular expression elements */
+enum re_type
+{
+    RE_CHAR,
+    RE_ANY,
+    RE_CLASS,
+    RE_BOL,
+    RE_EOL,
+    RE_WORD_START,
+    RE_WORD_END
+};
+
+struct re_node
+{
+    BYTE type;
+    BYTE star;      /* element may be repeated any number of times */
+    BYTE c;         /* RE_CHAR: folded character */
+    BYTE set[32];   /* RE_CLASS: bitmap of folded characters */
+};
+
+struct regex
+{
+    struct re_node *nodes;
+    unsigned int    count;
+};
+
+/* Aho-Corasick automaton node, children are kept in a linked list */
+struct ac_node
+{
+    int  first_child;
+    int  next_sibling;
+    int  fail;
+    BYTE c;
+    BOOL terminal;  /* some pattern ends here or in a fail state */
+};
+
+struct pattern
+{
+    char *str;
+    int   len;
+    BOOL  regex;
+};
+
+enum engine
+{
+    ENGINE_BMH,    /* single literal, Boyer-Moore-Horspool */
+    ENGINE_AC,     /* several literals, Aho-Corasick */
+    ENGINE_REGEX   /* line by line regular expression matching */
+};
+
+struct search
+{
+    BOOL            regex;          /* /R, default unless /L */
+    BOOL            icase;          /* /I */
+    BOOL            begin;          /* /B */
+    BOOL            end;            /* /E */
+    BOOL            invert;         /* /V */
+    BOOL            line_numbers;   /* /N */
+    BOOL            offsets;        /* /O */
+    BOOL            files_only;     /* /M */
+    BOOL            recursive;      /* /S */
+    BOOL            print_names;
+    struct pattern *patterns;
+    unsigned int    count;
+    unsigned int    size;
+    enum engine     engine;
+    BYTE            fold[256];
+    unsigned int    skip[256];      /* ENGINE_BMH shift table */
+    struct ac_node *ac;             /* ENGINE_AC automaton */
+    unsigned int    ac_count;
+    unsigned int    ac_size;
+    struct regex   *regexes;        /* ENGINE_REGEX, one per pattern */
+};
+
+struct file_state
+{
+    const WCHAR *name;      /* name to print, NULL for stdin */
+    ULONGLONG    line;      /* number of the line starting at the current position */
+    ULONGLONG    offset;    /* file offset of the current position */
+    BOOL         matched;
+};
+
+static char output_buffer[65536];
+static DWORD output_len;
+
+static void *heap_alloc(SIZE_T size)
+{
+    return HeapAlloc(GetProcessHeap(), 0, size);
+}
+
+static void *heap_realloc(void *mem, SIZE_T size)
+{
+    if (!mem) return heap_alloc(size);
+    return HeapReAlloc(GetProcessHeap(), 0, mem, size);
+}
+
+static BOOL heap_free(void *mem)
+{
+    return HeapFree(GetProcessHeap(), 0, mem);
+}
+
+static void output_flush(void)
+{
+    DWORD count;
+
+    if (!output_len) return;
+    WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), output_buffer, output_len, &count, NULL);
+    output_len = 0;
+}
+
+static void output_bytes(const char *data, DWORD len)
+{
+    DWORD count;
+
+    if (output_len + len > sizeof(output_buffer))
+    {
+        output_flush();
+        if (len > sizeof(output_buffer))
+        {
+            WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data, len, &count, NULL);
+            return;
+        }
+    }
+    memcpy(output_buffer + output_len, data, len);
+    output_len += len;
+}
+
+static void output_name(const WCHAR *name)
+{
+    char buffer[MAX_PATH * 3];
+    int len;
+
+    len = WideCharToMultiByte(GetConsoleOutputCP(), 0, name, -1, buffer, sizeof(buffer), NULL, NULL);
+    if (len > 0) output_bytes(buffer, len - 1);
+}
+
+static void output_number(ULONGLONG number)
+{
+    char buffer[24], *p = buffer + sizeof(buffer);
+
+    *--p = ':';
+    do *--p = '0' + number % 10; while (number /= 10);
+    output_bytes(p, buffer + sizeof(buffer) - p);
+}
+
+static void __cdecl output_message(DWORD std_handle, UINT id, ...)
+{
+    WCHAR format[2048], *msg = NULL;
+    __ms_va_list va_args;
+    DWORD len, count;
+
+    if (!LoadStringW(GetModuleHandleW(NULL), id, format, sizeof(format)/sizeof(WCHAR)))
+    {
+        WINE_FIXME("LoadString failed with %d\n", GetLastError());
+        return;
+    }
+
+    __ms_va_start(va_args, id);
+    len = FormatMessageW(FORMAT_MESSAGE_FROM_STRING | FORMAT_MESSAGE_ALLOCATE_BUFFER,
+                         format, 0, 0, (WCHAR *)&msg, 0, &va_args);
+    __ms_va_end(va_args);
+    if (!len) return;
+
+    output_flush();
+    if (!WriteConsoleW(GetStdHandle(std_handle), msg, len, &count, NULL))
+    {
+        char *msgA;
+
+        /* WriteConsoleW() fails if the output is redirected, fall back to WriteFile() */
+        count = WideCharToMultiByte(GetConsoleOutputCP(), 0, msg, len, NULL, 0, NULL, NULL);
+        if ((msgA = heap_alloc(count)))
+        {
+            WideCharToMultiByte(GetConsoleOutputCP(), 0, msg, len, msgA, count, NULL, NULL);
+            WriteFile(GetStdHandle(std_handle), msgA, count, &count, NULL);
+            heap_free(msgA);
+        }
+    }
+    LocalFree(msg);
+}
+
+static inline BOOL is_word_char(BYTE c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c >= 0x80;
+}
+
+static inline void set_bit(BYTE *set, BYTE c)
+{
+    set[c / 8] |= 1 << (c % 8);
+}
+
+static inline BOOL test_bit(const BYTE *set, BYTE c)
+{
+    return set[c / 8] & (1 << (c % 8));
+}
+
+static BOOL is_regex(const char *str, int len)
 {
     int i;
 
-    WINE_FIXME("stub:");
-    for (i = 0; i < argc; i++)
-        WINE_FIXME(" %s", wine_dbgstr_w(argv[i]));
-    WINE_FIXME("\n");
+    for (i = 0; i < len; i++)
+        if (strchr(".*^$[\\", str[i])) return TRUE;
+    return FALSE;
+}
+
+/* compile a pattern into a list of elements, literal patterns are compiled
+ * as a plain sequence of characters */
+static BOOL compile_regex(const struct search *search, const struct pattern *pattern, struct regex *re)
+{
+    const BYTE *p = (const BYTE *)pattern->str, *end = p + pattern->len;
+    struct re_node *node;
+
+    /* worst case is one element per character plus the anchors */
+    re->nodes = heap_alloc((pattern->len + 2) * sizeof(*re->nodes));
+    re->count = 0;
+    if (!re->nodes) return FALSE;
+
+    if (search->begin)
+    {
+        node = &re->nodes[re->count++];
+        memset(node, 0, sizeof(*node));
+        node->type = RE_BOL;
+    }
+
+    while (p < end)
+    {
+        node = &re->nodes[re->count];
+        memset(node, 0, sizeof(*node));
+
+        if (!pattern->regex)
+        {
+            node->type = RE_CHAR;
+            node->c = search->fold[*p++];
+            re->count++;
+            continue;
+        }
+
+        switch (*p)
+        {
+        case '.':
+            node->type = RE_ANY;
+            p++;
+            break;
+        case '*':
+            /* repeats the previous element, literal at the start */
+            if (re->count && re->nodes[re->count - 1].type <= RE_CLASS &&
+                !re->nodes[re->count - 1].star)
+            {
+                re->nodes[re->count - 1].star = 1;
+                p++;
+                continue;
+            }
+            node->type = RE_CHAR;
+            node->c = '*';
+            p++;
+            break;
+        case '^':
+            if (p == (const BYTE *)pattern->str) node->type = RE_BOL;
+            else
+            {
+                node->type = RE_CHAR;
+                node->c = '^';
+            }
+            p++;
+            break;
+        case '$':
+            if (p + 1 == end) node->type = RE_EOL;
+            else
+            {
+                node->type = RE_CHAR;
+                node->c = '$';
+            }
+            p++;
+            break;
+        case '\\':
+            if (++p == end)
+            {
+                node->type = RE_CHAR;
+                node->c = '\\';
+            }
+            else if (*p == '<') node->type = RE_WORD_START;
+            else if (*p == '>') node->type = RE_WORD_END;
+            else
+            {
+                node->type = RE_CHAR;
+                node->c = search->fold[*p];
+            }
+            if (p < end) p++;
+            break;
+        case '[':
+        {
+            const BYTE *start;
+            BOOL negate = FALSE;
+            int i;
+
+            node->type = RE_CLASS;
+            if (++p < end && *p == '^')
+            {
+                negate = TRUE;
+                p++;
+            }
+            /* a closing bracket right after the opening one is literal */
+            for (start = p; p < end && (*p != ']' || p == start); )
+            {
+                BYTE first = *p++, last = first;
+
+                if (p + 1 < end && *p == '-' && p[1] != ']')
+                {
+                    last = p[1];
+                    p += 2;
+                }
+                if (last < first) return FALSE;
+                for (i = first; i <= last; i++) set_bit(node->set, search->fold[i]);
+            }
+            if (p == end) return FALSE;
+            p++;
+            if (negate)
+                for (i = 0; i < sizeof(node->set); i++) node->set[i] = ~node->set[i];
+            break;
+        }
+        default:
+            node->type = RE_CHAR;
+            node->c = search->fold[*p++];
+            break;
+        }
+        re->count++;
+    }
+
+    if (search->end)
+    {
+        node = &re->nodes[re->count++];
+        memset(node, 0, sizeof(*node));
+        node->type = RE_EOL;
+    }
+    return TRUE;
+}
+
+static inline BOOL re_match_char(const struct search *search, const struct re_node *node, BYTE c)
+{
+    switch (node->type)
+    {
+    case RE_CHAR:  return node->c == search->fold[c];
+    case RE_ANY:   return TRUE;
+    case RE_CLASS: return test_bit(node->set, search->fold[c]);
+    }
+    return FALSE;
+}
+
+static BOOL re_match_here(const struct search *search, const struct regex *re, unsigned int i,
+                          const BYTE *p, const BYTE *line, const BYTE *end)
+{
+    for (; i < re->count; i++)
+    {
+        const struct re_node *node = &re->nodes[i];
+
+        if (node->star)
+        {
+            const BYTE *q = p;
+
+            while (q < end && re_match_char(search, node, *q)) q++;
+            for (;;)
+            {
+                if (re_match_here(search, re, i + 1, q, line, end)) return TRUE;
+                if (q == p) return FALSE;
+                q--;
+            }
+        }
+
+        switch (node->type)
+        {
+        case RE_BOL:
+            if (p != line) return FALSE;
+            break;
+        case RE_EOL:
+            if (p != end) return FALSE;
+            break;
+        case RE_WORD_START:
+            if (p == end || !is_word_char(*p) || (p > line && is_word_char(p[-1]))) return FALSE;
+            break;
+        case RE_WORD_END:
+            if (p == line || !is_word_char(p[-1]) || (p < end && is_word_char(*p))) return FALSE;
+            break;
+        default:
+            if (p == end || !re_match_char(search, node, *p)) return FALSE;
+            p++;
+            break;
+        }
+    }
+    return TRUE;
+}
+
+static BOOL re_match_line(const struct search *search, const struct regex *re,
+                          const BYTE *line, const BYTE *end)
+{
+    const BYTE *p = line;
+
+    if (re->count && re->nodes[0].type == RE_BOL)
+        return re_match_here(search, re, 1, line, line, end);
+
+    do
+    {
+        if (re_match_here(search, re, 0, p, line, end)) return TRUE;
+    } while (p++ < end);
+    return FALSE;
+}
+
+static void build_bmh(struct search *search)
+{
+    const BYTE *pat = (const BYTE *)search->patterns[0].str;
+    int i, len = search->patterns[0].len;
+
+    for (i = 0; i < 256; i++) search->skip[i] = len;
+    for (i = 0; i < len - 1; i++) search->skip[search->fold[pat[i]]] = len - 1 - i;
+}
+
+/* returns the offset of the first occurrence at or after start, or -1 */
+static SIZE_T find_bmh(const struct search *search, const BYTE *data, SIZE_T start, SIZE_T size)
+{
+    const BYTE *pat = (const BYTE *)search->patterns[0].str;
+    const BYTE *fold = search->fold;
+    SIZE_T len = search->patterns[0].len, i, j, k;
+
+    if (len == 1 && !search->icase)
+    {
+        const BYTE *p = memchr(data + start, pat[0], size - start);
+        return p ? p - data : (SIZE_T)-1;
+    }
+
+    for (i = start + len - 1; i < size; i += search->skip[fold[data[i]]])
+    {
+        for (j = len - 1, k = i; fold[data[k]] == fold[pat[j]]; j--, k--)
+            if (!j) return k;
+    }
+    return -1;
+}
+
+static int ac_add_node(struct search *search, BYTE c)
+{
+    struct ac_node *node;
+
+    if (search->ac_count == search->ac_size)
+    {
+        unsigned int size = search->ac_size ? search->ac_size * 2 : 256;
+        struct ac_node *ac = heap_realloc(search->ac, size * sizeof(*ac));
+
+        if (!ac) return -1;
+        search->ac = ac;
+        search->ac_size = size;
+    }
+    node = &search->ac[search->ac_count];
+    node->first_child = node->next_sibling = -1;
+    node->fail = 0;
+    node->c = c;
+    node->terminal = FALSE;
+    return search->ac_count++;
+}
+
+static inline int ac_child(const struct ac_node *ac, int state, BYTE c)
+{
+    int child;
+
+    for (child = ac[state].first_child; child != -1; child = ac[child].next_sibling)
+        if (ac[child].c == c) return child;
+    return -1;
+}
+
+static BOOL build_ac(struct search *search)
+{
+    unsigned int i, head = 0, tail = 0;
+    int *queue, state, child;
+
+    if (ac_add_node(search, 0) == -1) return FALSE;
+
+    for (i = 0; i < search->count; i++)
+    {
+        const BYTE *p = (const BYTE *)search->patterns[i].str;
+        const BYTE *end = p + search->patterns[i].len;
+
+        for (state = 0; p < end; p++)
+        {
+            BYTE c = search->fold[*p];
+
+            if ((child = ac_child(search->ac, state, c)) == -1)
+            {
+                if ((child = ac_add_node(search, c)) == -1) return FALSE;
+                search->ac[child].next_sibling = search->ac[state].first_child;
+                search->ac[state].first_child = child;
+            }
+            state = child;
+        }
+        search->ac[state].terminal = TRUE;
+    }
+
+    /* breadth first computation of the fail links */
+    if (!(queue = heap_alloc(search->ac_count * sizeof(*queue)))) return FALSE;
+    for (child = search->ac[0].first_child; child != -1; child = search->ac[child].next_sibling)
+        queue[tail++] = child;
+    while (head < tail)
+    {
+        state = queue[head++];
+        for (child = search->ac[state].first_child; child != -1; child = search->ac[child].next_sibling)
+        {
+            int fail = search->ac[state].fail, next;
+
+            while ((next = ac_child(search->ac, fail, search->ac[child].c)) == -1 && fail)
+                fail = search->ac[fail].fail;
+            search->ac[child].fail = next == -1 ? 0 : next;
+            if (search->ac[search->ac[child].fail].terminal) search->ac[child].terminal = TRUE;
+            queue[tail++] = child;
+        }
+    }
+    heap_free(queue);
+    return TRUE;
+}
+
+/* returns the offset of the last character of the first occurrence of any
+ * pattern at or after start, or -1 */
+static SIZE_T find_ac(const struct search *search, const BYTE *data, SIZE_T start, SIZE_T size)
+{
+    const struct ac_node *ac = search->ac;
+    SIZE_T i;
+    int state = 0, next;
+
+    for (i = start; i < size; i++)
+    {
+        BYTE c = search->fold[data[i]];
+
+        while ((next = ac_child(ac, state, c)) == -1 && state) state = ac[state].fail;
+        state = next == -1 ? 0 : next;
+        if (ac[state].terminal) return i;
+    }
+    return -1;
+}
+
+static BOOL match_literal(const struct search *search, const struct pattern *pattern,
+                          const BYTE *str)
+{
+    int i;
+
+    for (i = 0; i < pattern->len; i++)
+        if (search->fold[str[i]] != search->fold[(BYTE)pattern->str[i]]) return FALSE;
+    return TRUE;
+}
+
+/* check the /B and /E constraints on a line known to contain a literal */
+static BOOL match_literal_line(const struct search *search, const BYTE *line, const BYTE *end)
+{
+    unsigned int i;
+
+    for (i = 0; i < search->count; i++)
+    {
+        const struct pattern *pattern = &search->patterns[i];
+
+        if (pattern->len > end - line) continue;
+        if (search->begin && !match_literal(search, pattern, line)) continue;
+        if (search->end && !match_literal(search, pattern, end - pattern->len)) continue;
+        if (search->begin && search->end && pattern->len != end - line) continue;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static inline const BYTE *line_content_end(const BYTE *line, const BYTE *end)
+{
+    if (end > line && end[-1] == '\r') end--;
+    return end;
+}
+
+/* finds the first matching line at or after start, which must be the start
+ * of a line; returns FALSE if there is none */
+static BOOL find_line(const struct search *search, const BYTE *data, SIZE_T start, SIZE_T size,
+                      SIZE_T *line_start, SIZE_T *line_end)
+{
+    const BYTE *p;
+    SIZE_T pos = start, ls, le;
+    unsigned int i;
+
+    while (pos < size)
+    {
+        if (search->engine == ENGINE_REGEX)
+        {
+            ls = pos;
+            p = memchr(data + ls, '\n', size - ls);
+            le = p ? p - data : size;
+            for (i = 0; i < search->count; i++)
+                if (re_match_line(search, &search->regexes[i], data + ls,
+                                  line_content_end(data + ls, data + le))) break;
+            if (i < search->count) goto found;
+        }
+        else
+        {
+            SIZE_T match;
+
+            if (search->engine == ENGINE_BMH) match = find_bmh(search, data, pos, size);
+            else match = find_ac(search, data, pos, size);
+            if (match == (SIZE_T)-1) return FALSE;
+
+            for (ls = match; ls > pos && data[ls - 1] != '\n'; ls--) ;
+            p = memchr(data + match, '\n', size - match);
+            le = p ? p - data : size;
+            if (!search->begin && !search->end) goto found;
+            if (match_literal_line(search, data + ls, line_content_end(data + ls, data + le)))
+                goto found;
+        }
+        pos = le + 1;
+    }
+    return FALSE;
+
+found:
+    *line_start = ls;
+    *line_end = le;
+    return TRUE;
+}
+
+static void output_line(const struct search *search, struct file_state *state,
+                        const BYTE *data, SIZE_T ls, SIZE_T le)
+{
+    static const char crlf[] = {'\r','\n'};
+    const BYTE *end = line_content_end(data + ls, data + le);
+
+    if (state->name && search->print_names)
+    {
+        output_name(state->name);
+        output_bytes(":", 1);
+    }
+    if (search->line_numbers) output_number(state->line);
+    if (search->offsets) output_number(state->offset + ls);
+    output_bytes((const char *)data + ls, end - (data + ls));
+    output_bytes(crlf, sizeof(crlf));
+}
+
+static SIZE_T count_lines(const BYTE *data, SIZE_T start, SIZE_T end)
+{
+    const BYTE *p = data + start;
+    SIZE_T count = 0;
+
+    while ((p = memchr(p, '\n', data + end - p)))
+    {
+        count++;
+        p++;
+    }
+    return count;
+}
+
+/* process all the complete lines in a buffer, and the trailing partial line
+ * if final is set; returns the number of bytes processed */
+static SIZE_T search_buffer(const struct search *search, struct file_state *state,
+                            const BYTE *data, SIZE_T size, BOOL final)
+{
+    SIZE_T pos = 0, ls, le;
+    const BYTE *p;
+
+    if (!final)
+    {
+        for (p = data + size; p > data && p[-1] != '\n'; p--) ;
+        size = p - data;
+    }
+
+    while (pos < size)
+    {
+        BOOL found = find_line(search, data, pos, size, &ls, &le);
+
+        if (!found) ls = le = size;
+
+        if (search->invert)
+        {
+            /* everything before the matching line is output */
+            while (pos < ls)
+            {
+                SIZE_T end;
+
+                p = memchr(data + pos, '\n', ls - pos);
+                end = p ? p - data : ls;
+                state->matched = TRUE;
+                if (search->files_only) goto done;
+                output_line(search, state, data, pos, end);
+                state->line++;
+                pos = end + 1;
+            }
+        }
+        else if (search->line_numbers && ls > pos)
+            state->line += count_lines(data, pos, ls);
+
+        if (!found) break;
+
+        if (!search->invert)
+        {
+            state->matched = TRUE;
+            if (search->files_only) goto done;
+            output_line(search, state, data, ls, le);
+        }
+        state->line++;
+        pos = le + 1;
+    }
+
+done:
+    state->offset += size;
+    return size;
+}
+
+static BOOL search_handle(const struct search *search, struct file_state *state, HANDLE handle)
+{
+    LARGE_INTEGER size;
+    HANDLE mapping;
+    BYTE *data;
+    DWORD len, count;
+    SIZE_T used;
+    BOOL ret = TRUE;
+
+    /* map regular files so that the whole file is searched in one go */
+    if (GetFileType(handle) == FILE_TYPE_DISK && GetFileSizeEx(handle, &size) &&
+        size.QuadPart == (SIZE_T)size.QuadPart)
+    {
+        if (!size.QuadPart) return TRUE;
+        if ((mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, 0, 0, NULL)))
+        {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (data)
+            {
+                search_buffer(search, state, data, size.QuadPart, TRUE);
+                UnmapViewOfFile(data);
+                return TRUE;
+            }
+        }
+        WARN("could not map file, reading it instead\n");
+    }
+
+    len = READ_BUFFER_SIZE;
+    if (!(data = heap_alloc(len))) return FALSE;
+    used = 0;
+    for (;;)
+    {
+        SIZE_T done;
+
+        if (!ReadFile(handle, data + used, len - used, &count, NULL) || !count)
+        {
+            if (used) search_buffer(search, state, data, used, TRUE);
+            break;
+        }
+        used += count;
+        done = search_buffer(search, state, data, used, FALSE);
+        if (search->files_only && state->matched) break;
+        memmove(data, data + done, used - done);
+        used -= done;
+        if (used == len)
+        {
+            /* a single line fills the buffer, make room for more */
+            BYTE *new_data = heap_realloc(data, len * 2);
+
+            if (!new_data)
+            {
+                ret = FALSE;
+                break;
+            }
+            data = new_data;
+            len *= 2;
+        }
+    }
+    heap_free(data);
+    return ret;
+}
+
+static BOOL search_file(const struct search *search, const WCHAR *path, BOOL *matched)
+{
+    struct file_state state;
+    HANDLE handle;
+
+    handle = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        output_message(STD_ERROR_HANDLE, STRING_CANNOT_OPEN, path);
+        return FALSE;
+    }
+
+    state.name = path;
+    state.line = 1;
+    state.offset = 0;
+    state.matched = FALSE;
+    search_handle(search, &state, handle);
+    CloseHandle(handle);
+
+    if (state.matched)
+    {
+        static const char crlf[] = {'\r','\n'};
+
+        *matched = TRUE;
+        if (search->files_only)
+        {
+            output_name(path);
+            output_bytes(crlf, sizeof(crlf));
+        }
+    }
+    return TRUE;
+}
+
+/* search the files matching a mask, in subdirectories too with /S */
+static BOOL search_files(const struct search *search, const WCHAR *dir, const WCHAR *mask,
+                         BOOL *matched)
+{
+    static const WCHAR starW[] = {'*',0};
+    static const WCHAR dotW[] = {'.',0};
+    static const WCHAR dotdotW[] = {'.','.',0};
+    WIN32_FIND_DATAW data;
+    WCHAR *path;
+    HANDLE find;
+    BOOL found = FALSE;
+    int dir_len = strlenW(dir);
+
+    if (!(path = heap_alloc((dir_len + MAX_PATH + 1) * sizeof(WCHAR)))) return FALSE;
+    memcpy(path, dir, dir_len * sizeof(WCHAR));
+
+    strcpyW(path + dir_len, mask);
+    if ((find = FindFirstFileW(path, &data)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+            strcpyW(path + dir_len, data.cFileName);
+            search_file(search, path, matched);
+            found = TRUE;
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+    }
+
+    if (search->recursive)
+    {
+        strcpyW(path + dir_len, starW);
+        if ((find = FindFirstFileW(path, &data)) != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                static const WCHAR slashW[] = {'\\',0};
+                WCHAR *subdir;
+
+                if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) continue;
+                if (!strcmpW(data.cFileName, dotW) || !strcmpW(data.cFileName, dotdotW)) continue;
+                if (!(subdir = heap_alloc((dir_len + strlenW(data.cFileName) + 2) * sizeof(WCHAR))))
+                    continue;
+                memcpy(subdir, dir, dir_len * sizeof(WCHAR));
+                strcpyW(subdir + dir_len, data.cFileName);
+                strcatW(subdir, slashW);
+                if (search_files(search, subdir, mask, matched)) found = TRUE;
+                heap_free(subdir);
+            } while (FindNextFileW(find, &data));
+            FindClose(find);
+        }
+    }
+    heap_free(path);
+    return found;
+}
+
+static const WCHAR wildcardsW[] = {'*','?',0};
+
+static BOOL search_path(const struct search *search, const WCHAR *path, BOOL *matched)
+{
+    const WCHAR *mask;
+    WCHAR *dir;
+    BOOL ret;
+
+    if (!search->recursive && !strpbrkW(path, wildcardsW))
+        return search_file(search, path, matched);
+
+    for (mask = path + strlenW(path); mask > path; mask--)
+        if (mask[-1] == '\\' || mask[-1] == '/' || mask[-1] == ':') break;
+    if (!(dir = heap_alloc((mask - path + 1) * sizeof(WCHAR)))) return FALSE;
+    memcpy(dir, path, (mask - path) * sizeof(WCHAR));
+    dir[mask - path] = 0;
+
+    if (!(ret = search_files(search, dir, mask, matched)))
+        output_message(STD_ERROR_HANDLE, STRING_CANNOT_OPEN, path);
+    heap_free(dir);
+    return ret;
+}
+
+static BOOL add_pattern(struct search *search, const WCHAR *str, int len, BOOL regex)
+{
+    struct pattern *pattern;
+    int lenA;
+
+    if (!len) return TRUE;
+    if (search->count == search->size)
+    {
+        unsigned int size = search->size ? search->size * 2 : 16;
+        struct pattern *patterns = heap_realloc(search->patterns, size * sizeof(*patterns));
+
+        if (!patterns) return FALSE;
+        search->patterns = patterns;
+        search->size = size;
+    }
+    pattern = &search->patterns[search->count];
+    lenA = WideCharToMultiByte(GetConsoleCP(), 0, str, len, NULL, 0, NULL, NULL);
+    if (!(pattern->str = heap_alloc(lenA + 1))) return FALSE;
+    WideCharToMultiByte(GetConsoleCP(), 0, str, len, pattern->str, lenA, NULL, NULL);
+    pattern->str[lenA] = 0;
+    pattern->len = lenA;
+    pattern->regex = regex && is_regex(pattern->str, lenA);
+    search->count++;
+    return TRUE;
+}
+
+/* add the space separated search strings */
+static BOOL add_patterns(struct search *search, const WCHAR *str, BOOL regex)
+{
+    const WCHAR *end;
+
+    for (;;)
+    {
+        while (*str == ' ') str++;
+        if (!*str) return TRUE;
+        for (end = str; *end && *end != ' '; end++) ;
+        if (!add_pattern(search, str, end - str, regex)) return FALSE;
+        str = end;
+    }
+}
+
+/* read a list of strings from a file, one per line */
+static WCHAR **read_list(const WCHAR *path, unsigned int *count)
+{
+    WCHAR **list = NULL, *dataW;
+    LARGE_INTEGER size;
+    unsigned int lines = 0;
+    HANDLE handle;
+    DWORD read;
+    char *data;
+    int len, i, start;
+
+    handle = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                         OPEN_EXISTING, 0, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        output_message(STD_ERROR_HANDLE, STRING_CANNOT_OPEN, path);
+        return NULL;
+    }
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart >= 0x10000000 ||
+        !(data = heap_alloc(size.QuadPart)))
+    {
+        CloseHandle(handle);
+        return NULL;
+    }
+    if (!ReadFile(handle, data, size.QuadPart, &read, NULL)) read = 0;
+    CloseHandle(handle);
+
+    len = MultiByteToWideChar(GetConsoleCP(), 0, data, read, NULL, 0);
+    dataW = heap_alloc((len + 1) * sizeof(WCHAR));
+    list = heap_alloc((len + 2) * sizeof(WCHAR *));
+    if (!dataW || !list)
+    {
+        heap_free(data);
+        heap_free(dataW);
+        heap_free(list);
+        return NULL;
+    }
+    MultiByteToWideChar(GetConsoleCP(), 0, data, read, dataW, len);
+    heap_free(data);
+    dataW[len] = 0;
+
+    for (i = start = 0; i <= len; i++)
+    {
+        if (i < len && dataW[i] != '\n' && dataW[i] != '\r') continue;
+        dataW[i] = 0;
+        if (i > start) list[lines++] = dataW + start;
+        start = i + 1;
+    }
+    /* the strings all point into the first buffer, which is freed with the list */
+    list[lines] = dataW;
+    *count = lines;
+    return list;
+}
+
+static void free_list(WCHAR **list, unsigned int count)
+{
+    heap_free(list[count]);
+    heap_free(list);
+}
+
+static BOOL prepare_search(struct search *search)
+{
+    unsigned int i;
+    BOOL regex = FALSE;
+
+    for (i = 0; i < 256; i++) search->fold[i] = i;
+    if (search->icase)
+    {
+        char lower[256];
+
+        for (i = 0; i < 256; i++) lower[i] = i;
+        CharLowerBuffA(lower + 1, 255);
+        for (i = 0; i < 256; i++) search->fold[i] = lower[i];
+    }
+
+    for (i = 0; i < search->count; i++)
+        if (search->patterns[i].regex) regex = TRUE;
+
+    if (regex)
+    {
+        search->engine = ENGINE_REGEX;
+        if (!(search->regexes = heap_alloc(search->count * sizeof(*search->regexes)))) return FALSE;
+        for (i = 0; i < search->count; i++)
+        {
+            if (!compile_regex(search, &search->patterns[i], &search->regexes[i]))
+            {
+                WCHAR *strW;
+                int len = MultiByteToWideChar(GetConsoleCP(), 0, search->patterns[i].str, -1, NULL, 0);
+
+                if ((strW = heap_alloc(len * sizeof(WCHAR))))
+                {
+                    MultiByteToWideChar(GetConsoleCP(), 0, search->patterns[i].str, -1, strW, len);
+                    output_message(STD_ERROR_HANDLE, STRING_BAD_REGEX, strW);
+                    heap_free(strW);
+                }
+                return FALSE;
+            }
+        }
+    }
+    else if (search->count == 1)
+    {
+        search->engine = ENGINE_BMH;
+        build_bmh(search);
+    }
+    else
+    {
+        search->engine = ENGINE_AC;
+        if (!build_ac(search)) return FALSE;
+    }
+    TRACE("%u patterns, engine %u\n", search->count, search->engine);
+    return TRUE;
+}
+
+static void free_search(struct search *search)
+{
+    unsigned int i;
+
+    for (i = 0; i < search->count; i++)
+    {
+        heap_free(search->patterns[i].str);
+        if (search->regexes) heap_free(search->regexes[i].nodes);
+    }
+    heap_free(search->patterns);
+    heap_free(search->regexes);
+    heap_free(search->ac);
+}
+
+int wmain(int argc, WCHAR *argv[])
+{
+    static const WCHAR offW[] = {'O','F','F',0};
+    static const WCHAR offlineW[] = {'O','F','F','L','I','N','E',0};
+    struct search search;
+    const WCHAR *strings = NULL, *strings_file = NULL, *list_file = NULL;
+    WCHAR **files = NULL, **list = NULL;
+    unsigned int file_count = 0, list_count = 0, i, j;
+    BOOL literal = FALSE, force_regex = FALSE, matched = FALSE, error = FALSE;
+    BOOL have_strings = FALSE;
+    int ret = RC_ERROR;
+
+    memset(&search, 0, sizeof(search));
+    if (!(files = heap_alloc(argc * sizeof(*files)))) return RC_ERROR;
+
+    for (i = 1; i < argc; i++)
+    {
+        WCHAR *arg = argv[i];
+
+        if (arg[0] != '/' && arg[0] != '-')
+        {
+            if (!have_strings && !strings)
+            {
+                strings = arg;
+                have_strings = TRUE;
+            }
+            else files[file_count++] = arg;
+            continue;
+        }
+
+        if (arg[1] == '?')
+        {
+            output_message(STD_OUTPUT_HANDLE, STRING_USAGE);
+            ret = RC_MATCH;
+            goto done;
+        }
+        if (!strcmpiW(arg + 1, offW) || !strcmpiW(arg + 1, offlineW)) continue;
+
+        if (arg[1] && arg[2] == ':')
+        {
+            switch (toupperW(arg[1]))
+            {
+            case 'C':
+                /* literal unless /R is given, resolved once all options are known */
+                if (!add_pattern(&search, arg + 3, strlenW(arg + 3), FALSE)) goto done;
+                have_strings = TRUE;
+                continue;
+            case 'G':
+                strings_file = arg + 3;
+                have_strings = TRUE;
+                continue;
+            case 'F':
+                list_file = arg + 3;
+                continue;
+            case 'D':
+            case 'A':
+                WINE_FIXME("option %s not supported\n", wine_dbgstr_w(arg));
+                continue;
+            }
+            output_message(STD_ERROR_HANDLE, STRING_BAD_COMMAND_LINE);
+            goto done;
+        }
+
+        for (j = 1; arg[j]; j++)
+        {
+            switch (toupperW(arg[j]))
+            {
+            case 'B': search.begin = TRUE; break;
+            case 'E': search.end = TRUE; break;
+            case 'L': literal = TRUE; break;
+            case 'R': force_regex = TRUE; break;
+            case 'S': search.recursive = TRUE; break;
+            case 'I': search.icase = TRUE; break;
+            case 'X': search.begin = search.end = TRUE; break;
+            case 'V': search.invert = TRUE; break;
+            case 'N': search.line_numbers = TRUE; break;
+            case 'M': search.files_only = TRUE; break;
+            case 'O': search.offsets = TRUE; break;
+            case 'P':
+                WINE_FIXME("option /P not supported\n");
+                break;
+            default:
+                output_message(STD_ERROR_HANDLE, STRING_BAD_COMMAND_LINE);
+                goto done;
+            }
+        }
+    }
+
+    /* /C: strings are literal unless /R is given */
+    if (force_regex)
+        for (i = 0; i < search.count; i++)
+            search.patterns[i].regex = is_regex(search.patterns[i].str, search.patterns[i].len);
+
+    if (strings && !add_patterns(&search, strings, !literal)) goto done;
+    if (strings_file)
+    {
+        if (!(list = read_list(strings_file, &list_count))) goto done;
+        for (i = 0; i < list_count; i++)
+            if (!add_pattern(&search, list[i], strlenW(list[i]), !literal)) goto done;
+        free_list(list, list_count);
+        list = NULL;
+    }
+    if (!search.count)
+    {
+        output_message(STD_ERROR_HANDLE, STRING_BAD_COMMAND_LINE);
+        goto done;
+    }
+    if (!prepare_search(&search)) goto done;
+
+    if (list_file)
+    {
+        WCHAR **new_files;
+
+        if (!(list = read_list(list_file, &list_count))) goto done;
+        if (!(new_files = heap_realloc(files, (file_count + list_count) * sizeof(*files)))) goto done;
+        files = new_files;
+        for (i = 0; i < list_count; i++) files[file_count++] = list[i];
+    }
+
+    search.print_names = file_count > 1 || search.recursive;
+    for (i = 0; i < file_count; i++)
+        if (strpbrkW(files[i], wildcardsW)) search.print_names = TRUE;
+
+    if (!file_count)
+    {
+        struct file_state state;
+
+        state.name = NULL;
+        state.line = 1;
+        state.offset = 0;
+        state.matched = FALSE;
+        if (!search_handle(&search, &state, GetStdHandle(STD_INPUT_HANDLE))) error = TRUE;
+        matched = state.matched;
+    }
+    else
+    {
+        for (i = 0; i < file_count; i++)
+            if (!search_path(&search, files[i], &matched)) error = TRUE;
+    }
+    output_flush();
+
+    if (error && !matched) ret = RC_ERROR;
+    else ret = matched ? RC_MATCH : RC_NOMATCH;
 
-    return 0;
+done:
+    output_flush();
+    if (list) free_list(list, list_count);
+    heap_free(files);
+    free_search(&search);
+    return ret;
 }
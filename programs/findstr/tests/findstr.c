@@ -0,0 +1,158 @@
+/*
+ * Copyright 2017 Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <windows.h>
+
+#include "wine/test.h"
+
+static char output[4096];
+
+static DWORD runcmd(const char *cmd)
+{
+    STARTUPINFOA si = {sizeof(STARTUPINFOA)};
+    SECURITY_ATTRIBUTES sa = {sizeof(sa), NULL, TRUE};
+    PROCESS_INFORMATION pi;
+    HANDLE read_pipe, write_pipe;
+    DWORD rc, size, len = 0;
+    char *wcmd;
+
+    output[0] = 0;
+    if (!CreatePipe(&read_pipe, &write_pipe, &sa, 0))
+        return 260;
+    SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = INVALID_HANDLE_VALUE;
+    si.hStdOutput = write_pipe;
+    si.hStdError = write_pipe;
+
+    /* Create a writable copy for CreateProcessA() */
+    wcmd = HeapAlloc(GetProcessHeap(), 0, strlen(cmd) + 1);
+    strcpy(wcmd, cmd);
+
+    rc = CreateProcessA(NULL, wcmd, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+    HeapFree(GetProcessHeap(), 0, wcmd);
+    CloseHandle(write_pipe);
+    if (!rc)
+    {
+        CloseHandle(read_pipe);
+        return 260;
+    }
+
+    while (len < sizeof(output) - 1 &&
+           ReadFile(read_pipe, output + len, sizeof(output) - 1 - len, &size, NULL) && size)
+        len += size;
+    output[len] = 0;
+    CloseHandle(read_pipe);
+
+    rc = WaitForSingleObject(pi.hProcess, 5000);
+    if (rc == WAIT_OBJECT_0)
+        GetExitCodeProcess(pi.hProcess, &rc);
+    else
+        TerminateProcess(pi.hProcess, 1);
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+
+    return rc;
+}
+
+static void create_file(const char *name, const char *data)
+{
+    HANDLE file;
+    DWORD size;
+
+    file = CreateFileA(name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create %s: %u\n", name, GetLastError());
+    WriteFile(file, data, strlen(data), &size, NULL);
+    CloseHandle(file);
+}
+
+static const struct
+{
+    const char *cmd;
+    DWORD rc;
+    const char *output;
+}
+tests[] =
+{
+    { "findstr abc test1.txt", 0, "abc\r\nxabcx\r\n" },
+    { "findstr ABC test1.txt", 0, "ABC def\r\n" },
+    { "findstr /I abc test1.txt", 0, "abc\r\nABC def\r\nxabcx\r\n" },
+    { "findstr nothere test1.txt", 1, "" },
+    { "findstr /N abc test1.txt", 0, "1:abc\r\n4:xabcx\r\n" },
+    { "findstr /V /N abc test1.txt", 0, "2:ABC def\r\n3:ghi\r\n5:\r\n6:last\r\n" },
+    { "findstr /B /I abc test1.txt", 0, "abc\r\nABC def\r\n" },
+    { "findstr /E /L def test1.txt", 0, "ABC def\r\n" },
+    { "findstr /X abc test1.txt", 0, "abc\r\n" },
+    { "findstr \"ghi last\" test1.txt", 0, "ghi\r\nlast\r\n" },
+    { "findstr /C:\"C def\" test1.txt", 0, "ABC def\r\n" },
+    { "findstr /C:\"C DEF\" test1.txt", 1, "" },
+    { "findstr /O ghi test1.txt", 0, "14:ghi\r\n" },
+    { "findstr /R \"^x.*x$\" test1.txt", 0, "xabcx\r\n" },
+    { "findstr /R \"[g-h]hi\" test1.txt", 0, "ghi\r\n" },
+    { "findstr /R \"[^a-z]\" test1.txt", 0, "ABC def\r\n" },
+    { "findstr /R \"\\<def\" test1.txt", 0, "ABC def\r\n" },
+    { "findstr /L \"^x\" test1.txt", 1, "" },
+    { "findstr /M abc test1.txt test2.txt", 0, "test1.txt\r\n" },
+    { "findstr one test1.txt test2.txt", 0, "test2.txt:one\r\n" },
+    { "findstr /N one test*.txt", 0, "test2.txt:1:one\r\n" },
+    { "findstr abc missing.txt", 2, NULL },
+};
+
+static void test_findstr(void)
+{
+    unsigned int i;
+    DWORD rc;
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        rc = runcmd(tests[i].cmd);
+        ok(rc == tests[i].rc, "%s: got rc=%u\n", tests[i].cmd, rc);
+        if (tests[i].output)
+            ok(!strcmp(output, tests[i].output), "%s: got output \"%s\"\n",
+               tests[i].cmd, output);
+    }
+}
+
+START_TEST(findstr)
+{
+    char tmpdir[MAX_PATH], curdir[MAX_PATH];
+
+    if (runcmd("findstr /?") == 260)
+    {
+        win_skip("findstr.exe not available\n");
+        return;
+    }
+
+    GetCurrentDirectoryA(sizeof(curdir), curdir);
+    GetTempPathA(sizeof(tmpdir), tmpdir);
+    SetCurrentDirectoryA(tmpdir);
+    CreateDirectoryA("findstrtest", NULL);
+    SetCurrentDirectoryA("findstrtest");
+
+    create_file("test1.txt", "abc\r\nABC def\r\nghi\r\nxabcx\r\n\r\nlast");
+    create_file("test2.txt", "one\ntwo\n");
+
+    test_findstr();
+
+    DeleteFileA("test1.txt");
+    DeleteFileA("test2.txt");
+    SetCurrentDirectoryA(tmpdir);
+    RemoveDirectoryA("findstrtest");
+    SetCurrentDirectoryA(curdir);
+}
@@ -117,11 +117,13 @@ static char *get_wine_inf_path(void)
 }
 
 /* update the timestamp if different from the reference time */
+/* the Wine build id is stored along with it, so that a different build updates the prefix too */
 static BOOL update_timestamp( const char *config_dir, unsigned long timestamp )
 {
     BOOL ret = FALSE;
     int fd, count;
-    char buffer[100];
+    char buffer[256], *end;
+    const char *build_id = wine_get_build_id();
     char *file = HeapAlloc( GetProcessHeap(), 0, strlen(config_dir) + sizeof("/.update-timestamp") );
 
     if (!file) return FALSE;
@@ -134,7 +136,8 @@ static BOOL update_timestamp( const char *config_dir, unsigned long timestamp )
         {
             buffer[count] = 0;
             if (!strncmp( buffer, "disable", sizeof("disable")-1 )) goto done;
-            if (timestamp == strtoul( buffer, NULL, 10 )) goto done;
+            if (timestamp == strtoul( buffer, &end, 10 ) && *end++ == '\n' &&
+                !strncmp( end, build_id, strlen(build_id) ) && end[strlen(build_id)] == '\n') goto done;
         }
         lseek( fd, 0, SEEK_SET );
         ftruncate( fd, 0 );
@@ -145,7 +148,8 @@ static BOOL update_timestamp( const char *config_dir, unsigned long timestamp )
         if ((fd = open( file, O_WRONLY | O_CREAT | O_TRUNC, 0666 )) == -1) goto done;
     }
 
-    count = sprintf( buffer, "%lu\n", timestamp );
+    count = snprintf( buffer, sizeof(buffer), "%lu\n%s\n", timestamp, build_id );
+    if (count < 0 || count >= sizeof(buffer)) count = sprintf( buffer, "%lu\n", timestamp );
     if (write( fd, buffer, count ) != count)
     {
         WINE_WARN( "failed to update timestamp in %s\n", file );
@@ -1185,7 +1189,7 @@ static void update_wineprefix( BOOL force )
     if (update_timestamp( config_dir, st.st_mtime ) || force)
     {
         HANDLE process;
-        DWORD count = 0;
+        DWORD count = 0, start = GetTickCount();
 
         if ((process = start_rundll32( inf_path, FALSE )))
         {
@@ -1206,6 +1210,7 @@ static void update_wineprefix( BOOL force )
 
         create_etc_stub_files();
 
+        WINE_TRACE( "update took %u ms\n", GetTickCount() - start );
         WINE_MESSAGE( "wine: configuration in '%s' has been updated.\n", config_dir );
     }
 
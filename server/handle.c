@@ -33,6 +33,7 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "process.h"
 #include "thread.h"
@@ -663,6 +664,9 @@ DECL_HANDLER(dup_handle)
         /* close the handle no matter what happened */
         if ((req->options & DUP_HANDLE_CLOSE_SOURCE) && (src != dst || req->src_handle != reply->handle))
             reply->closed = !close_handle( src, req->src_handle );
+        /* the owner doesn't know the handle value can be reused, let it drop its cached handles */
+        if (reply->closed && src != current->process && shmglobal)
+            interlocked_xchg_add( (int *)&shmglobal->handle_close_epoch, 1 );
         reply->self = (src == current->process);
         release_object( src );
     }
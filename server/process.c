@@ -54,6 +54,7 @@
 /* process structure */
 
 static struct list process_list = LIST_INIT(process_list);
+unsigned int process_list_version = 1;  /* changes whenever the process list info changes */
 static int running_processes, user_processes;
 static struct event *shutdown_event;           /* signaled when shutdown starts */
 static struct timeout_user *shutdown_timeout;  /* timeout for server shutdown */
@@ -813,6 +814,7 @@ static struct process_dll *process_load_dll( struct process *process, struct map
         }
         if (mapping) dll->mapping = grab_mapping_unless_removable( mapping );
         list_add_tail( &process->dlls, &dll->entry );
+        process_list_changed();
     }
     return dll;
 }
@@ -828,6 +830,7 @@ static void process_unload_dll( struct process *process, mod_handle_t base )
         free( dll->filename );
         list_remove( &dll->entry );
         free( dll );
+        process_list_changed();
         generate_debug_event( current, UNLOAD_DLL_DEBUG_EVENT, &base );
     }
     else set_error( STATUS_INVALID_PARAMETER );
@@ -932,9 +935,16 @@ static void process_killed( struct process *process )
     wake_up( &process->obj, 0 );
 }
 
+/* signal a change to the data returned by list_processes */
+void process_list_changed(void)
+{
+    if (!++process_list_version) process_list_version = 1;
+}
+
 /* add a thread to a process running threads list */
 void add_process_thread( struct process *process, struct thread *thread )
 {
+    process_list_changed();
     list_add_tail( &process->thread_list, &thread->proc_entry );
     if (!process->running_threads++)
     {
@@ -958,6 +968,7 @@ void remove_process_thread( struct process *process, struct thread *thread )
     assert( !list_empty( &process->thread_list ));
 
     list_remove( &thread->proc_entry );
+    process_list_changed();
 
     if (!--process->running_threads)
     {
@@ -1445,6 +1456,7 @@ DECL_HANDLER(init_process_done)
 
     process->ldt_copy = req->ldt_copy;
     process->start_time = current_time;
+    process_list_changed();
     current->entry_point = req->entry;
 
     generate_startup_debug_events( process, req->entry );
@@ -1572,7 +1584,11 @@ DECL_HANDLER(set_process_info)
 
     if ((process = get_process_from_handle( req->handle, PROCESS_SET_INFORMATION )))
     {
-        if (req->mask & SET_PROCESS_INFO_PRIORITY) process->priority = req->priority;
+        if (req->mask & SET_PROCESS_INFO_PRIORITY)
+        {
+            process->priority = req->priority;
+            process_list_changed();
+        }
         if (req->mask & SET_PROCESS_INFO_AFFINITY) set_process_affinity( process, req->affinity );
         release_object( process );
     }
@@ -1656,6 +1672,7 @@ DECL_HANDLER(init_system_dir)
         dll->namelen += (p - filename) * sizeof(WCHAR);
         dll->filename = filename;
     }
+    process_list_changed();
 }
 
 /* notify the server that a dll is being unloaded */
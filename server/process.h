@@ -136,6 +136,8 @@ extern void kill_debugged_processes( struct thread *debugger, int exit_code );
 extern void break_process( struct process *process );
 extern void detach_debugged_processes( struct thread *debugger );
 extern struct process_snapshot *process_snap( int *count );
+extern unsigned int process_list_version;
+extern void process_list_changed(void);
 extern void enum_processes( int (*cb)(struct process*, void*), void *user);
 extern void replace_process_token( struct process *process, struct token *token );
 
@@ -85,6 +85,7 @@ struct key
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    unsigned int      id;          /* unique id, selects the change counter in shared memory */
 };
 
 /* key flags */
@@ -495,9 +496,12 @@ static struct unicode_str *get_path_token( const struct unicode_str *path, struc
 /* allocate a key object */
 static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
 {
+    static unsigned int next_key_id;
     struct key *key;
     if ((key = alloc_object( &key_ops )))
     {
+        if (!++next_key_id) ++next_key_id;
+        key->id          = next_key_id;
         key->name        = NULL;
         key->class       = NULL;
         key->namelen     = name->len;
@@ -556,6 +560,21 @@ static void check_notify( struct key *key, unsigned int change, int not_subtree
     }
 }
 
+/* invalidate the values of a key cached by the clients */
+static void invalidate_client_cache( struct key *key )
+{
+    if (shmglobal) interlocked_xchg_add( (int *)&shmglobal->registry_seq[key->id % REGISTRY_SEQ_SLOTS], 1 );
+}
+
+/* invalidate the values of all keys cached by the clients */
+static void invalidate_all_client_caches(void)
+{
+    unsigned int i;
+
+    if (!shmglobal) return;
+    for (i = 0; i < REGISTRY_SEQ_SLOTS; i++) interlocked_xchg_add( (int *)&shmglobal->registry_seq[i], 1 );
+}
+
 /* update key modification time */
 static void touch_key( struct key *key, unsigned int change )
 {
@@ -563,6 +582,7 @@ static void touch_key( struct key *key, unsigned int change )
 
     key->modif = current_time;
     make_dirty( key );
+    invalidate_client_cache( key );
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -638,6 +658,7 @@ static void free_subkey( struct key *parent, int index )
     parent->last_subkey--;
     key->flags |= KEY_DELETED;
     key->parent = NULL;
+    invalidate_client_cache( key );
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
     release_object( key );
 
@@ -2184,6 +2205,8 @@ DECL_HANDLER(get_key_value)
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
         get_value( key, &name, &reply->type, &reply->total );
+        reply->key_id  = key->id;
+        reply->key_seq = shmglobal ? shmglobal->registry_seq[key->id % REGISTRY_SEQ_SLOTS] : 0;
         release_object( key );
     }
 }
@@ -2242,6 +2265,7 @@ DECL_HANDLER(load_registry)
         if ((key = create_key( parent, &name, NULL, 0, KEY_WOW64_64KEY, 0, sd, &dummy )))
         {
             load_registry( key, req->file );
+            invalidate_all_client_caches();
             release_object( key );
         }
         release_object( parent );
@@ -205,6 +205,7 @@ DECL_HANDLER(add_mapping_committed_range);
 DECL_HANDLER(create_snapshot);
 DECL_HANDLER(next_process);
 DECL_HANDLER(next_thread);
+DECL_HANDLER(list_processes);
 DECL_HANDLER(wait_debug_event);
 DECL_HANDLER(queue_exception_event);
 DECL_HANDLER(get_exception_status);
@@ -512,6 +513,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_create_snapshot,
     (req_handler)req_next_process,
     (req_handler)req_next_thread,
+    (req_handler)req_list_processes,
     (req_handler)req_wait_debug_event,
     (req_handler)req_queue_exception_event,
     (req_handler)req_get_exception_status,
@@ -1349,6 +1351,14 @@ C_ASSERT( FIELD_OFFSET(struct next_thread_reply, base_pri) == 32 );
 C_ASSERT( FIELD_OFFSET(struct next_thread_reply, delta_pri) == 36 );
 C_ASSERT( FIELD_OFFSET(struct next_thread_reply, unix_tid) == 40 );
 C_ASSERT( sizeof(struct next_thread_reply) == 48 );
+C_ASSERT( FIELD_OFFSET(struct list_processes_request, flags) == 12 );
+C_ASSERT( FIELD_OFFSET(struct list_processes_request, pid) == 16 );
+C_ASSERT( FIELD_OFFSET(struct list_processes_request, version) == 20 );
+C_ASSERT( sizeof(struct list_processes_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct list_processes_reply, version) == 8 );
+C_ASSERT( FIELD_OFFSET(struct list_processes_reply, process_count) == 12 );
+C_ASSERT( FIELD_OFFSET(struct list_processes_reply, info_size) == 16 );
+C_ASSERT( sizeof(struct list_processes_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct wait_debug_event_request, get_handle) == 12 );
 C_ASSERT( sizeof(struct wait_debug_event_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct wait_debug_event_reply, pid) == 8 );
@@ -1425,7 +1435,9 @@ C_ASSERT( FIELD_OFFSET(struct get_key_value_request, hkey) == 12 );
 C_ASSERT( sizeof(struct get_key_value_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, total) == 12 );
-C_ASSERT( sizeof(struct get_key_value_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, key_id) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, key_seq) == 20 );
+C_ASSERT( sizeof(struct get_key_value_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, index) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, info_class) == 20 );
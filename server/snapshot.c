@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -223,3 +224,119 @@ DECL_HANDLER(next_thread)
         release_object( snapshot );
     }
 }
+
+/* state of a list_processes request */
+struct list_processes_info
+{
+    unsigned int  flags;         /* LIST_PROCESS_* flags */
+    process_id_t  pid;           /* process to list, 0 for all */
+    int           handles_only;  /* only return the handle counts */
+    int           count;         /* number of processes listed so far */
+    data_size_t   size;          /* size of the data so far */
+    char         *data;          /* reply data, NULL when only computing the size */
+};
+
+/* add the info for a process to a list_processes reply */
+static int list_process( struct process *process, void *arg )
+{
+    struct list_processes_info *info = arg;
+    struct process_info *process_info = NULL;
+    struct process_dll *exe_module, *dll;
+    struct thread *thread;
+    data_size_t name_len;
+
+    if (!process->running_threads) return 0;
+    if (info->pid && get_process_id( process ) != info->pid) return 0;
+
+    info->count++;
+    if (info->handles_only)
+    {
+        if (info->data) ((int *)info->data)[info->count - 1] = get_handle_table_count( process );
+        info->size += sizeof(int);
+        return 0;
+    }
+
+    exe_module = get_process_exe_module( process );
+    name_len = exe_module && exe_module->filename ? exe_module->namelen : 0;
+    if (info->data)
+    {
+        process_info = (struct process_info *)(info->data + info->size);
+        process_info->start_time   = process->start_time;
+        process_info->name_len     = name_len;
+        process_info->thread_count = 0;
+        process_info->module_count = 0;
+        process_info->priority     = process->priority;
+        process_info->pid          = get_process_id( process );
+        process_info->parent_pid   = process->parent_id;
+        process_info->handle_count = get_handle_table_count( process );
+        process_info->unix_pid     = process->unix_pid;
+        if (name_len) memcpy( process_info + 1, exe_module->filename, name_len );
+    }
+    info->size += sizeof(*process_info) + ((name_len + 7) & ~7);
+
+    if (info->flags & LIST_PROCESS_THREADS)
+    {
+        LIST_FOR_EACH_ENTRY( thread, &process->thread_list, struct thread, proc_entry )
+        {
+            if (thread->state == TERMINATED) continue;
+            if (info->data)
+            {
+                struct thread_info *thread_info = (struct thread_info *)(info->data + info->size);
+                thread_info->start_time       = get_thread_creation_time( thread );
+                thread_info->tid              = get_thread_id( thread );
+                thread_info->base_priority    = thread->priority;
+                thread_info->current_priority = thread->priority;  /* FIXME */
+                thread_info->unix_tid         = get_thread_unix_tid( thread );
+                process_info->thread_count++;
+            }
+            info->size += sizeof(struct thread_info);
+        }
+    }
+
+    if (info->flags & LIST_PROCESS_MODULES)
+    {
+        LIST_FOR_EACH_ENTRY( dll, &process->dlls, struct process_dll, entry )
+        {
+            name_len = dll->filename ? dll->namelen : 0;
+            if (info->data)
+            {
+                struct module_info *module_info = (struct module_info *)(info->data + info->size);
+                module_info->base     = dll->base;
+                module_info->size     = dll->size;
+                module_info->name_len = name_len;
+                if (name_len) memcpy( module_info + 1, dll->filename, name_len );
+                process_info->module_count++;
+            }
+            info->size += sizeof(struct module_info) + ((name_len + 7) & ~7);
+        }
+    }
+    return 0;
+}
+
+/* retrieve processes with their threads and modules in a single request */
+DECL_HANDLER(list_processes)
+{
+    struct list_processes_info info;
+
+    info.flags        = req->flags;
+    info.pid          = req->pid;
+    info.handles_only = req->version && req->version == process_list_version;
+    info.count        = 0;
+    info.size         = 0;
+    info.data         = NULL;
+    enum_processes( list_process, &info );
+
+    reply->version       = process_list_version;
+    reply->process_count = info.count;
+    reply->info_size     = info.size;
+    if (info.size > get_reply_max_size())
+    {
+        set_error( STATUS_INFO_LENGTH_MISMATCH );
+        return;
+    }
+    if (!info.size || !(info.data = set_reply_data_size( info.size ))) return;
+    memset( info.data, 0, info.size );  /* clear the name padding */
+    info.count = 0;
+    info.size  = 0;
+    enum_processes( list_process, &info );
+}
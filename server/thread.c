@@ -512,6 +512,7 @@ static void set_thread_info( struct thread *thread,
         {
             thread->priority = req->priority;
             set_scheduler_priority( thread );
+            process_list_changed();
         }
         else
             set_error( STATUS_INVALID_PARAMETER );
@@ -1337,6 +1338,7 @@ DECL_HANDLER(init_thread)
     current->unix_tid = req->unix_tid;
     current->teb      = req->teb;
     current->entry_point = process->peb ? req->entry : 0;
+    process_list_changed();  /* unix_tid is part of the process list data */
 
     if (!process->peb)  /* first thread, initialize the process too */
     {
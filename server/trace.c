@@ -2332,6 +2332,21 @@ static void dump_next_thread_reply( const struct next_thread_reply *req )
     fprintf( stderr, ", unix_tid=%d", req->unix_tid );
 }
 
+static void dump_list_processes_request( const struct list_processes_request *req )
+{
+    fprintf( stderr, " flags=%08x", req->flags );
+    fprintf( stderr, ", pid=%04x", req->pid );
+    fprintf( stderr, ", version=%08x", req->version );
+}
+
+static void dump_list_processes_reply( const struct list_processes_reply *req )
+{
+    fprintf( stderr, " version=%08x", req->version );
+    fprintf( stderr, ", process_count=%d", req->process_count );
+    fprintf( stderr, ", info_size=%u", req->info_size );
+    dump_varargs_bytes( ", data=", cur_size );
+}
+
 static void dump_wait_debug_event_request( const struct wait_debug_event_request *req )
 {
     fprintf( stderr, " get_handle=%d", req->get_handle );
@@ -2496,6 +2511,8 @@ static void dump_get_key_value_reply( const struct get_key_value_reply *req )
 {
     fprintf( stderr, " type=%d", req->type );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", key_id=%08x", req->key_id );
+    fprintf( stderr, ", key_seq=%08x", req->key_seq );
     dump_varargs_bytes( ", data=", cur_size );
 }
 
@@ -4700,6 +4717,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_snapshot_request,
     (dump_func)dump_next_process_request,
     (dump_func)dump_next_thread_request,
+    (dump_func)dump_list_processes_request,
     (dump_func)dump_wait_debug_event_request,
     (dump_func)dump_queue_exception_event_request,
     (dump_func)dump_get_exception_status_request,
@@ -5004,6 +5022,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_snapshot_reply,
     (dump_func)dump_next_process_reply,
     (dump_func)dump_next_thread_reply,
+    (dump_func)dump_list_processes_reply,
     (dump_func)dump_wait_debug_event_reply,
     (dump_func)dump_queue_exception_event_reply,
     (dump_func)dump_get_exception_status_reply,
@@ -5308,6 +5327,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "create_snapshot",
     "next_process",
     "next_thread",
+    "list_processes",
     "wait_debug_event",
     "queue_exception_event",
     "get_exception_status",
@@ -0,0 +1,335 @@
+/*
+ * Dump a binary relay log
+ *
+ * Copyright 2017 Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "winedump.h"
+#include "wine/relay_log.h"
+
+#define NB_BUCKETS 24  /* latency buckets: < 1us, < 2us, < 4us, ... */
+
+struct relay_function
+{
+    const char        *name;
+    unsigned int       calls;
+    unsigned long long total;
+    unsigned long long max;
+    unsigned int       buckets[NB_BUCKETS];
+};
+
+struct relay_module
+{
+    const char            *name;
+    unsigned int           base;
+    unsigned int           count;
+    struct relay_function *funcs;
+};
+
+struct relay_frame
+{
+    unsigned short     module;
+    unsigned short     ordinal;
+    unsigned long long time;
+};
+
+struct relay_thread
+{
+    unsigned int        tid;
+    unsigned int        depth;
+    unsigned int        size;
+    struct relay_frame *frames;
+};
+
+static struct relay_module *modules;
+static unsigned int nb_modules;
+static struct relay_thread *threads;
+static unsigned int nb_threads;
+static unsigned long long frequency;
+static unsigned long long start_time;
+
+enum FileSig get_kind_relay(void)
+{
+    const struct relay_log_header *header = PRD(0, sizeof(*header));
+
+    if (header && header->magic == RELAY_LOG_MAGIC) return SIG_RELAY;
+    return SIG_UNKNOWN;
+}
+
+static BOOL dump_part(const char *name)
+{
+    return !globals.dumpsect || !strcmp(globals.dumpsect, "ALL") || !strcmp(globals.dumpsect, name);
+}
+
+static struct relay_function *get_function(unsigned int module, unsigned int ordinal)
+{
+    struct relay_module *mod;
+
+    if (module >= nb_modules) return NULL;
+    mod = &modules[module];
+    if (ordinal >= mod->count)
+    {
+        unsigned int count = max(ordinal + 1, mod->count * 2);
+
+        mod->funcs = realloc(mod->funcs, count * sizeof(*mod->funcs));
+        if (!mod->funcs) fatal("Out of memory");
+        memset(mod->funcs + mod->count, 0, (count - mod->count) * sizeof(*mod->funcs));
+        mod->count = count;
+    }
+    return &mod->funcs[ordinal];
+}
+
+static struct relay_thread *get_thread(unsigned int tid)
+{
+    unsigned int i;
+
+    for (i = 0; i < nb_threads; i++)
+        if (threads[i].tid == tid) return &threads[i];
+
+    threads = realloc(threads, (nb_threads + 1) * sizeof(*threads));
+    if (!threads) fatal("Out of memory");
+    memset(&threads[nb_threads], 0, sizeof(*threads));
+    threads[nb_threads].tid = tid;
+    return &threads[nb_threads++];
+}
+
+static void print_function(unsigned int module, unsigned int ordinal)
+{
+    struct relay_function *func = get_function(module, ordinal);
+
+    if (!func) printf("<bad module %u>.%u", module, ordinal);
+    else if (func->name) printf("%s.%s", modules[module].name, func->name);
+    else printf("%s.%u", modules[module].name, modules[module].base + ordinal);
+}
+
+static void print_time(const struct relay_log_record *record)
+{
+    unsigned long long usec = (record->time - start_time) * 1000000 / frequency;
+
+    printf("%3u.%06u:%04x:", (unsigned int)(usec / 1000000), (unsigned int)(usec % 1000000), record->tid);
+}
+
+static void add_module(const struct relay_log_module *rec)
+{
+    if (rec->module >= nb_modules)
+    {
+        modules = realloc(modules, (rec->module + 1) * sizeof(*modules));
+        if (!modules) fatal("Out of memory");
+        memset(modules + nb_modules, 0, (rec->module + 1 - nb_modules) * sizeof(*modules));
+        nb_modules = rec->module + 1;
+    }
+    modules[rec->module].name = rec->name;
+    modules[rec->module].base = rec->base;
+}
+
+static void dump_call(const struct relay_log_call *rec)
+{
+    struct relay_thread *thread = get_thread(rec->hdr.tid);
+    unsigned int i;
+
+    if (thread->depth == thread->size)
+    {
+        thread->size = max(16, thread->size * 2);
+        thread->frames = realloc(thread->frames, thread->size * sizeof(*thread->frames));
+        if (!thread->frames) fatal("Out of memory");
+    }
+    thread->frames[thread->depth].module = rec->module;
+    thread->frames[thread->depth].ordinal = rec->ordinal;
+    thread->frames[thread->depth].time = rec->hdr.time;
+    thread->depth++;
+
+    if (!dump_part("calls")) return;
+    print_time(&rec->hdr);
+    printf("Call ");
+    print_function(rec->module, rec->ordinal);
+    printf("(");
+    for (i = 0; i < rec->nb_args; i++)
+        printf(i ? ",%08llx" : "%08llx", rec->args[i]);
+    printf(") ret=%08llx\n", rec->ret_addr);
+}
+
+static void dump_ret(const struct relay_log_ret *rec)
+{
+    struct relay_thread *thread = get_thread(rec->hdr.tid);
+    struct relay_function *func = get_function(rec->module, rec->ordinal);
+    unsigned int depth = thread->depth;
+
+    /* frames above the matching one never returned, e.g. because of exceptions;
+     * if there's no matching frame at all, leave the pending calls alone */
+    while (depth)
+    {
+        struct relay_frame *frame = &thread->frames[--depth];
+
+        if (frame->module == rec->module && frame->ordinal == rec->ordinal)
+        {
+            unsigned long long elapsed = rec->hdr.time - frame->time;
+            unsigned long long usec = elapsed * 1000000 / frequency;
+            unsigned int bucket = 0;
+
+            while (usec && bucket < NB_BUCKETS - 1)
+            {
+                usec >>= 1;
+                bucket++;
+            }
+            if (func)
+            {
+                func->calls++;
+                func->total += elapsed;
+                if (elapsed > func->max) func->max = elapsed;
+                func->buckets[bucket]++;
+            }
+            thread->depth = depth;
+            break;
+        }
+    }
+
+    if (!dump_part("calls")) return;
+    print_time(&rec->hdr);
+    printf("Ret  ");
+    print_function(rec->module, rec->ordinal);
+    printf("() retval=%08llx ret=%08llx\n", rec->retval, rec->ret_addr);
+}
+
+static int function_cmp(const void *p1, const void *p2)
+{
+    const struct relay_function *f1 = *(const struct relay_function * const *)p1;
+    const struct relay_function *f2 = *(const struct relay_function * const *)p2;
+
+    if (f1->total != f2->total) return f1->total < f2->total ? 1 : -1;
+    return 0;
+}
+
+static void dump_statistics(void)
+{
+    struct relay_function **sorted;
+    unsigned int i, j, count = 0;
+
+    for (i = 0; i < nb_modules; i++)
+        for (j = 0; j < modules[i].count; j++)
+            if (modules[i].funcs[j].calls) count++;
+    if (!count) return;
+
+    if (!(sorted = malloc(count * sizeof(*sorted)))) fatal("Out of memory");
+    count = 0;
+    for (i = 0; i < nb_modules; i++)
+        for (j = 0; j < modules[i].count; j++)
+            if (modules[i].funcs[j].calls) sorted[count++] = &modules[i].funcs[j];
+    qsort(sorted, count, sizeof(*sorted), function_cmp);
+
+    printf("\nFunction statistics (times in microseconds):\n");
+    printf("%10s %12s %10s %10s  %s\n", "calls", "total", "average", "max", "function");
+    for (i = 0; i < count; i++)
+    {
+        struct relay_function *func = sorted[i];
+        unsigned int module = 0, ordinal, last;
+
+        for (j = 0; j < nb_modules; j++)
+            if (func >= modules[j].funcs && func < modules[j].funcs + modules[j].count) module = j;
+        ordinal = func - modules[module].funcs;
+
+        printf("%10u %12llu %10llu %10llu  ", func->calls, func->total * 1000000 / frequency,
+               func->total * 1000000 / frequency / func->calls, func->max * 1000000 / frequency);
+        print_function(module, ordinal);
+        printf("\n");
+
+        for (last = NB_BUCKETS; last > 0; last--) if (func->buckets[last - 1]) break;
+        printf("%10s histogram:", "");
+        for (j = 0; j < last; j++)
+        {
+            if (!func->buckets[j]) continue;
+            if (j) printf(" <%uus:%u", 1u << j, func->buckets[j]);
+            else printf(" <1us:%u", func->buckets[j]);
+        }
+        printf("\n");
+    }
+    free(sorted);
+}
+
+void relay_dump(void)
+{
+    const struct relay_log_header *header = PRD(0, sizeof(*header));
+    const struct relay_log_record *rec;
+    unsigned long offset = sizeof(*header);
+    unsigned int i;
+
+    printf("Relay log: version %u, process %04x, %u-bit\n",
+           header->version, header->pid, header->pointer_size * 8);
+    if (header->version != RELAY_LOG_VERSION)
+    {
+        printf("Unsupported version\n");
+        return;
+    }
+    frequency = header->frequency ? header->frequency : 1;
+
+    /* per-thread buffers are not flushed in time order, so find the earliest record first */
+    while ((rec = PRD(offset, sizeof(*rec))) && rec->size >= sizeof(*rec) && PRD(offset, rec->size))
+    {
+        if (!start_time || rec->time < start_time) start_time = rec->time;
+        offset += rec->size;
+    }
+    offset = sizeof(*header);
+
+    while ((rec = PRD(offset, sizeof(*rec))))
+    {
+        if (rec->size < sizeof(*rec) || !PRD(offset, rec->size))
+        {
+            printf("Truncated record at offset %08lx\n", offset);
+            break;
+        }
+
+        switch (rec->type)
+        {
+        case RELAY_LOG_MODULE:
+            add_module((const struct relay_log_module *)rec);
+            break;
+        case RELAY_LOG_NAME:
+        {
+            const struct relay_log_name *name = (const struct relay_log_name *)rec;
+            struct relay_function *func = get_function(name->module, name->ordinal);
+            if (func) func->name = name->name;
+            break;
+        }
+        case RELAY_LOG_CALL:
+            dump_call((const struct relay_log_call *)rec);
+            break;
+        case RELAY_LOG_RET:
+            dump_ret((const struct relay_log_ret *)rec);
+            break;
+        default:
+            printf("Unknown record type %u at offset %08lx\n", rec->type, offset);
+            break;
+        }
+        offset += rec->size;
+    }
+
+    if (dump_part("stats")) dump_statistics();
+
+    for (i = 0; i < nb_modules; i++) free(modules[i].funcs);
+    for (i = 0; i < nb_threads; i++) free(threads[i].frames);
+    free(modules);
+    free(threads);
+}